@@ -73,10 +73,7 @@ DistributedMatrix<T> Kinetic<T,NDIM>::kinetic_energy_matrix(World & world,
     reconstruct(world, v);
 
     // apply the derivative operator on each function for each dimension
-    std::vector<vecfuncT> dv(NDIM);
-    for (std::size_t i=0; i<NDIM; ++i) {
-        dv[i]=apply(world, *(gradop[i]), v, false);
-    }
+    std::vector<vecfuncT> dv=apply_derivatives(world, gradop, v, false);
     world.gop.fence();
     for (std::size_t i=0; i<NDIM; ++i) {
         compress(world,dv[i],false);
@@ -100,11 +97,8 @@ DistributedMatrix<T> Kinetic<T,NDIM>::kinetic_energy_matrix(World & world,
     reconstruct(world, vket);
 
     // apply the derivative operator on each function for each dimension
-    std::vector<vecfuncT> dvbra(NDIM),dvket(NDIM);
-    for (std::size_t i=0; i<NDIM; ++i) {
-        dvbra[i]=apply(world, *(gradop[i]), vbra, false);
-        dvket[i]=apply(world, *(gradop[i]), vket, false);
-    }
+    std::vector<vecfuncT> dvbra=apply_derivatives(world, gradop, vbra, false);
+    std::vector<vecfuncT> dvket=apply_derivatives(world, gradop, vket, false);
     world.gop.fence();
     for (std::size_t i=0; i<NDIM; ++i) {
         compress(world,dvbra[i],false);
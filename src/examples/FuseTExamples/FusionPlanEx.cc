@@ -0,0 +1,160 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+  $Id$
+*/
+
+/*!
+  \file examples/FuseTExamples/FusionPlanEx.cc
+  \brief Compares the FuseT fusion planner with greedy and unfused execution
+
+  Compresses N functions u and M functions g, takes all N*M inner products
+  of the compressed trees and reconstructs the u. Compress followed by
+  reconstruct of the same tree cannot share a traversal, so the sequence
+  needs at least two. Each strategy runs on fresh result trees and prints
+  its plan, time and a checksum of the inner products.
+
+  usage: fusionPlanEx [N] [M] [memory budget in MB, 0 for none]
+*/
+
+#include <madness/world/MADworld.h>
+#include <madness/mra/mra.h>
+#include <madness/constants.h>
+#include <madness/mra/FuseT/InnerOp.h>
+#include <madness/mra/FuseT/CompressOp.h>
+#include <madness/mra/FuseT/ReconstructOp.h>
+#include <madness/mra/FuseT/FusedExecutor.h>
+#include <madness/mra/FuseT/FuseT.h>
+
+using namespace madness;
+
+static const double L = 20;     // Half box size
+static const long k = 8;        // wavelet order
+static const double thresh = 1e-8; // precision
+static const double alpha = 1.9; // Exponent
+
+static double uinitial(const coord_3d& r) {
+    const double x=r[0], y=r[1], z=r[2];
+    return exp(-alpha*(2*x*x+3.2*y*y+1.7*z*z))*pow(constants::pi/alpha,-1.5);
+}
+
+static double ginitial(const coord_3d& r) {
+    const double x=r[0], y=r[1], z=r[2];
+    return exp(-alpha*(5*x*x+y*y+z*z))*pow(constants::pi/alpha,-1.5);
+}
+
+// Runs the whole sequence with one strategy and returns the elapsed time
+static double run(World& world, std::vector<real_function_3d>& u, std::vector<real_function_3d>& g,
+                  FusionStrategy strategy, double budget, double& checksum)
+{
+    const int n = u.size(), m = g.size();
+    std::vector<real_function_3d*> uc(n), gc(m), ur(n), ug(n*m);
+    for (int i=0; i<n; i++) {
+        uc[i] = new real_function_3d(real_factory_3d(world));
+        ur[i] = new real_function_3d(real_factory_3d(world));
+    }
+    for (int j=0; j<m; j++) gc[j] = new real_function_3d(real_factory_3d(world));
+    for (int ij=0; ij<n*m; ij++) ug[ij] = new real_function_3d(real_factory_3d(world));
+
+    std::vector<PrimitiveOp<double,3>*> sequence;
+    std::vector<InnerOp<double,3>*> inner;
+    for (int i=0; i<n; i++) sequence.push_back(new CompressOp<double,3>("Compress-u", uc[i], &u[i]));
+    for (int j=0; j<m; j++) sequence.push_back(new CompressOp<double,3>("Compress-g", gc[j], &g[j]));
+    for (int i=0; i<n; i++)
+        for (int j=0; j<m; j++) {
+            inner.push_back(new InnerOp<double,3>("Inner", ug[i*m+j], uc[i], gc[j]));
+            sequence.push_back(inner.back());
+        }
+    for (int i=0; i<n; i++) sequence.push_back(new ReconstructOp<double,3>("Reconstruct-u", ur[i], uc[i]));
+
+    world.gop.fence();
+    double start = wall_time();
+
+    FuseT<double,3> odag(sequence);
+    odag.setFusionStrategy(strategy);
+    odag.setMemoryBudget(budget);
+    odag.processSequence();
+    if (world.rank() == 0) odag.printPlan();
+
+    FusedOpSequence<double,3> fsequence = odag.getFusedOpSequence();
+    FusedExecutor<double,3> fexecutor(world, &fsequence);
+    fexecutor.execute();
+    world.gop.fence();
+
+    double used = wall_time() - start;
+
+    checksum = 0.0;
+    for (std::size_t ij=0; ij<inner.size(); ij++) checksum += inner[ij]->_sum;
+
+    for (std::size_t i=0; i<sequence.size(); i++) delete sequence[i];
+    for (int i=0; i<n; i++) { delete uc[i]; delete ur[i]; }
+    for (int j=0; j<m; j++) delete gc[j];
+    for (int ij=0; ij<n*m; ij++) delete ug[ij];
+    world.gop.fence();
+    return used;
+}
+
+int main(int argc, char** argv)
+{
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    int n = 4, m = 4;
+    double budget = 0.0;
+    if (argc > 1) n = atoi(argv[1]);
+    if (argc > 2) m = atoi(argv[2]);
+    if (argc > 3) budget = atof(argv[3])*1024.0*1024.0;
+
+    FunctionDefaults<3>::set_k(k);
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_refine(true);
+    FunctionDefaults<3>::set_autorefine(false);
+    FunctionDefaults<3>::set_cubic_cell(-L, L);
+
+    std::vector<real_function_3d> u(n), g(m);
+    for (int i=0; i<n; i++) { u[i] = real_factory_3d(world).f(uinitial); u[i].truncate(); }
+    for (int j=0; j<m; j++) { g[j] = real_factory_3d(world).f(ginitial); g[j].truncate(); }
+
+    const char* name[] = {"planned", "greedy", "unfused"};
+    const FusionStrategy strategy[] = {FUSE_PLANNED, FUSE_GREEDY, FUSE_NONE};
+    double used[3], checksum[3];
+    for (int s=0; s<3; s++)
+        used[s] = run(world, u, g, strategy[s], budget, checksum[s]);
+
+    if (world.rank() == 0) {
+        print("");
+        for (int s=0; s<3; s++)
+            printf("%-8s time %8.4fs   sum of inner products %.10e\n", name[s], used[s], checksum[s]);
+    }
+
+    finalize();
+    return 0;
+}
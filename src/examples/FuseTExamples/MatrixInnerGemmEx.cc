@@ -0,0 +1,119 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+  $Id$
+*/
+
+/*!
+  \file examples/FuseTExamples/MatrixInnerGemmEx.cc
+  \brief Compares MatrixInnerOp with matrix_inner from vmra.h
+
+  Builds N Gaussians with different centers and exponents, compresses them
+  and computes the N x N overlap matrix once with matrix_inner and once
+  with MatrixInnerOp, which forms all pairs at a node with a single gemm.
+
+  usage: matrixInnerGemmEx [N] [thresh]
+*/
+
+#include <madness/world/MADworld.h>
+#include <madness/mra/mra.h>
+#include <madness/mra/vmra.h>
+#include <madness/mra/FuseT/MatrixInnerOp.h>
+#include <madness/mra/FuseT/OpExecutor.h>
+
+using namespace madness;
+
+static const double L = 20;     // Half box size
+static const long k = 8;        // wavelet order
+
+class Gaussian : public FunctionFunctorInterface<double,3> {
+    const coord_3d center;
+    const double exponent;
+public:
+    Gaussian(const coord_3d& center, double exponent) : center(center), exponent(exponent) {}
+
+    double operator()(const coord_3d& r) const {
+        double rsq = 0.0;
+        for (int d=0; d<3; d++) rsq += (r[d]-center[d])*(r[d]-center[d]);
+        return exp(-exponent*rsq);
+    }
+};
+
+int main(int argc, char** argv)
+{
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    int n = 50;
+    double thresh = 1e-6;
+    if (argc > 1) n = atoi(argv[1]);
+    if (argc > 2) thresh = atof(argv[2]);
+
+    FunctionDefaults<3>::set_k(k);
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_refine(true);
+    FunctionDefaults<3>::set_autorefine(false);
+    FunctionDefaults<3>::set_cubic_cell(-L, L);
+
+    std::vector<real_function_3d> f(n);
+    for (int i=0; i<n; i++) {
+        coord_3d center;
+        center[0] = 0.1*(i%5); center[1] = -0.1*(i%3); center[2] = 0.05*i;
+        f[i] = real_factory_3d(world).functor(real_functor_3d(new Gaussian(center, 1.0+0.1*i)));
+    }
+    truncate(world, f);
+    compress(world, f);
+    world.gop.fence();
+
+    double start = wall_time();
+    Tensor<double> r_vmra = matrix_inner(world, f, f);
+    double used_vmra = wall_time() - start;
+
+    real_function_3d result = real_factory_3d(world);
+    MatrixInnerOp<double,3> op("MatrixInner", &result, f, f, false, true);
+    OpExecutor<double,3> exe(world);
+    world.gop.fence();
+    start = wall_time();
+    exe.execute(&op, false);
+    double used_fuset = wall_time() - start;
+
+    double err = (r_vmra - *op._r).normf();
+    if (world.rank() == 0) {
+        print("functions", n, "thresh", thresh, "nodes per function", f[0].tree_size());
+        printf("matrix_inner    %8.4fs\n", used_vmra);
+        printf("MatrixInnerOp   %8.4fs\n", used_fuset);
+        print("||difference||", err);
+    }
+
+    world.gop.fence();
+    finalize();
+    return 0;
+}
@@ -110,6 +110,23 @@
   The process map (data distribution) is then modified using the LBDeux
   heuristic and the operations repeated.
 
+  By default the new map comes from LoadBalanceDeux::load_balance, which
+  collects all subtree costs on process 0 and bin-packs them there.  With
+  the argument \c sfc it comes from LoadBalanceDeux::sfc_rebalance
+  instead.  The first time this cuts a space-filling curve through the
+  boxes using distributed prefix sums of their costs, and when balancing
+  once more at the end it only moves the cuts.  Each redistribution
+  prints the entries and bytes moved and the imbalance before and after.
+  Running both for increasing numbers of processes and comparing the
+  \c balance times, e.g.,
+  \verbatim
+  for n in 16 64 256 1024; do
+      mpirun -n $n ./dataloadbal
+      mpirun -n $n ./dataloadbal sfc
+  done
+  \endverbatim
+  shows how the two partitioners scale.
+
   \par Results
 
   \verbatim
@@ -138,6 +155,9 @@ using namespace madness;
 
 static const int NFUNC = 4;
 
+// Partition along a space-filling curve instead of bin packing on process 0
+static bool use_sfc = false;
+
 // A class that behaves like a function to compute a Gaussian of given origin and exponent
 class Gaussian : public FunctionFunctorInterface<double,3> {
 public:
@@ -265,7 +285,15 @@ void test(World& world, bool doloadbal=false) {
         // know that we are about to throw away our functions (f) we
         // could simply call set_pmap() that installs the new map but
         // does not redistribute.
-        FunctionDefaults<3>::redistribute(world, lb.load_balance(2.0,false));
+        // Once the functions are on an SFCPmap, sfc_rebalance() only
+        // moves its cuts as far as needed to bring the imbalance within
+        // the tolerance.
+        WorldDCRedistributeStats stats;
+        if (use_sfc)
+            stats = FunctionDefaults<3>::redistribute(world, lb.sfc_rebalance(0.1));
+        else
+            stats = FunctionDefaults<3>::redistribute(world, lb.load_balance(2.0,false));
+        if (world.rank() == 0) stats.print();
     }
     double loadbal = wall_time() - start;
 
@@ -281,6 +309,9 @@ int main(int argc, char** argv) {
   // Load info for MADNESS numerical routines
   startup(world,argc,argv);
 
+  use_sfc = (argc > 1 && std::string(argv[1]) == "sfc");
+  if (world.rank() == 0) print("processes", world.size(), "partitioner", use_sfc ? "sfc" : "binpack");
+
   // Set/override defaults
   FunctionDefaults<3>::set_cubic_cell(-20,20);
   FunctionDefaults<3>::set_apply_randomize(false);
@@ -294,10 +325,11 @@ int main(int argc, char** argv) {
   test(world, true);
 
   // At end of last test data was redistributed, repeat again three times
+  // (along the curve balancing once more, which should move little)
   if (world.rank() == 0) print("After load balancing");
   test(world);
   test(world);
-  test(world);
+  test(world, use_sfc);
 
   finalize();
 
@@ -53,6 +53,8 @@ namespace madness
 		bool						isPre			() const { return false; } // false does not work. but It should be false.
 		bool						needsParameter	() const { return true; }
         void						reduce			(World& world){}
+		// two-scale filter of the (2k)^NDIM block, one matrix product per dimension
+		double						costPerNode		(int k) const { return 2.0*NDIM*std::pow(2.0*k, NDIM+1.0); }
 	public:	// for CompressOp
 		coeffT						filter			(const coeffT& s) const;
 		std::vector<Slice>			child_patch		(const keyT& child) const;
@@ -117,8 +119,8 @@ namespace madness
 		}
 	
 		// get fetches remote data (here actually local)
-		FuseT_CoeffT<T>*		s_coeff;
-		FuseT_VParameter<T>*	v_parameter;
+		FuseT_CoeffT<T>*				s_coeff;
+		const FuseT_VParameter<T>*	v_parameter;
 		KNODE&					node = _coeffs.find(key).get()->second;
 		if (node.has_children())
 		{
@@ -127,8 +129,7 @@ namespace madness
 			//
 			KNODE	temp;	// new parent which should be connected to its children.
 			s_coeff				= new FuseT_CoeffT<T>();
-			v_parameter			= new FuseT_VParameter<T>();
-			v_parameter->value	= ((FuseT_VParameter<T>*)s.get())->value;
+			v_parameter			= (const FuseT_VParameter<T>*)s.get();	// owned by s
 			tensorT d(this->_cdata.v2k);
 			int i = 0;	
 
@@ -139,7 +140,6 @@ namespace madness
 			for (KeyChildIterator<NDIM> kit(key); kit; ++kit, ++i)
 			{
 				d(child_patch(kit.key())) += ((FuseT_CoeffT<T>*)((v_parameter->value[i].get())))->value.full_tensor_copy();
-				delete v_parameter->value[i].data;
 				temp.set_has_children_recursive(_coeffs_target, kit.key());	 // children
 			}
 
@@ -188,7 +188,7 @@ namespace madness
 
 			//	Making Future form
 			s_coeff->value = ss.full_tensor_copy();
-			FuseTContainer<T> result2(static_cast<Base<T>*>(s_coeff));
+			FuseTContainer<T> result2(s_coeff);
 			return result2;
 		}
 		else
@@ -214,7 +214,7 @@ namespace madness
 				temp.clear_coeff();
 				this->_result->get_impl()->get_coeffs().replace(key,temp);
 			}
-			FuseTContainer<T> result(static_cast<Base<T>*>(s_coeff));
+			FuseTContainer<T> result(s_coeff);
 			return result;
 		}
 
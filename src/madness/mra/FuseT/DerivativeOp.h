@@ -36,6 +36,8 @@ namespace madness
 	bool needsParameter() const { return true; }
 	void reduce(World& world){}
 	bool returnsFuture(){return true;}
+	//left, center and right blocks applied along one dimension
+	double costPerNode(int k) const { return 3*2.0*std::pow(double(k), NDIM+1.0); }
 
     private:
 
@@ -247,11 +249,11 @@ namespace madness
 		//tvec->value.push_back(right.get());		
 		tvec->value.push_back(right);		
 	    }		
-	    FuseTContainer<T> wrapper(static_cast<Base<T>*>(tvec));
+	    FuseTContainer<T> wrapper(tvec);
 	    v_parameter->value.push_back(wrapper);
 	}
 
-	FuseTContainer<T> temp(static_cast<Base<T>*>(v_parameter));
+	FuseTContainer<T> temp(v_parameter);
 	return temp;
     }
 	
@@ -4,9 +4,29 @@
 
 #include "PrimitiveOp.h"
 #include <algorithm>
+#include <cmath>
+#include <limits>
 namespace madness {
     using namespace std;
 
+    /*! How FuseT partitions the operator sequence into valid OpDAGs, each
+      of which is executed by one fused traversal.
+      FUSE_PLANNED : cost model, fewest traversals within the memory budget
+      FUSE_GREEDY  : grow each valid OpDAG until it becomes illegal or
+                     exceeds the memory budget
+      FUSE_NONE    : one traversal per operator*/
+    enum FusionStrategy { FUSE_PLANNED, FUSE_GREEDY, FUSE_NONE };
+
+    //!cost model estimates for one valid OpDAG
+    struct OpDagCost{
+	double _nodes;		//!<nodes visited by the traversal
+	double _flops;		//!<work done by its operators
+	double _memory;		//!<bytes of parameters kept in flight
+	double _cost;		//!<estimated cost in flop equivalents
+
+	OpDagCost() : _nodes(0), _flops(0), _memory(0), _cost(0) {}
+    };
+
         struct ValidOpDag{
 	vector<int> _preOps;
 	vector<int> _postOps;
@@ -50,13 +70,28 @@ namespace madness {
 	  into pre or post compute ops*/
 	void getPrePostOps();
 
+	/*! Bins the operators of one validOpDAG into pre and post compute ops.
+	  Returns false if an operator would have to be both, i.e. the operators
+	  cannot share a traversal. Only the ops of the validOpDAG may carry
+	  validOpDagID in _idValidOpDAG*/
+	bool binPrePostOps(const vector<int>& validOpDAG, int validOpDagID, vector<int>& preOps, vector<int>& postOps);
+
 	//! Once a preOp is identified, this methods adds
 	//!all the producers ops in the chain in preOps
-	void addPreOps(int opIndex, int validOpDagID);
+	void addPreOps(int opIndex, int validOpDagID, vector<int>& preOps);
 
 	//! Once a postOp is identified, this method adds
 	//!all the consumers ops in this chain in postOps
-	void addPostOps(int opIndex, int validOpDagID);
+	void addPostOps(int opIndex, int validOpDagID, vector<int>& postOps);
+
+	//!estimates the number of nodes and the per node cost of every operator
+	void estimateOpCosts();
+
+	//!cost model estimates for fusing operators first..last-1 in one traversal
+	OpDagCost estimateOpDagCost(int first, int last) const;
+
+	//!true if operators first..last-1 can be fused in one traversal
+	bool isValidOpDag(int first, int last);
 
 	//!Helper Method for getPrePostOps.
 	//!Identifies if an oprator should be in preOps 
@@ -167,17 +202,48 @@ namespace madness {
 	//figure out if the analysis is complete
 	bool _isSequenceProcessed;
 
+	//!partitioning strategy and memory budget (bytes, 0 for none)
+	FusionStrategy _strategy;
+	double _memoryBudget;
+
+	//!estimated number of nodes in every tree (operators first, then source trees)
+	vector<double> _estNodes;
+
+	//!estimated flops per node and parameter bytes per node for every operator
+	vector<double> _estFlopsPerNode;
+	vector<double> _estBytesPerNode;
+
+	//!cost model estimates for each valid OpDAG
+	vector<OpDagCost> _opDagCosts;
+
     public:
 
+	//!cost of visiting one node (task, future and parameter handling) and of
+	//!the fence that ends a traversal, in flop equivalents
+	static constexpr double _visitCost = 2.0e4;
+	static constexpr double _fenceCost = 1.0e7;
+
 	FuseT(vector<PrimitiveOp<T,NDIM>*> sequence){
 	    _sequence = sequence;
 	    _numOps = _sequence.size();
 	    _isSequenceProcessed = false;
+	    _strategy = FUSE_PLANNED;
+	    _memoryBudget = 0;
 	}
+
+	void setFusionStrategy(FusionStrategy strategy) { _strategy = strategy; }
+
+	/*! Upper bound on the parameter memory (bytes, per world) of one fused
+	  traversal. 0 means unlimited. An operator that exceeds the budget on
+	  its own still gets a traversal of its own.*/
+	void setMemoryBudget(double bytes) { _memoryBudget = bytes; }
+
+	int numTraversals() const { return _validOpDAGs.size(); }
     
 	void processSequence(){
 
 	    generateOpDAG();
+	    estimateOpCosts();
 	    getValidOpDAGSequence();
 	    getPrePostOps();
 	    _isSequenceProcessed = true;
@@ -186,6 +252,9 @@ namespace madness {
 	
 	void printValidSequences();
 
+	//!prints the chosen partition together with the cost model estimates
+	void printPlan();
+
 	void printOpsAndTrees();
 	
 	FusedOpSequence<T,NDIM> getFusedOpSequence();
@@ -235,40 +304,74 @@ namespace madness {
 
 
     template<typename T, std::size_t NDIM>
-	void FuseT<T,NDIM>::addPreOps(int opIndex, int validOpDagID){
+	void FuseT<T,NDIM>::addPreOps(int opIndex, int validOpDagID, vector<int>& preOps){
 	if (DEBUG) cout<<"Checking for adding to Pre ID : "<<opIndex<<endl;
 	if(!_isVisited[opIndex]) {
 	    _isVisited[opIndex] = true;
 	    _isPre[opIndex] = true;
 	    if(DEBUG) cout<<"Adding to Pre ID : "<<opIndex<<endl;
-	    _preOps[validOpDagID].push_back(opIndex);
+	    preOps.push_back(opIndex);
 	    for (DInfo di: _producerList[opIndex]){ 
 		int index = di._producerIndex;
 		if((index<_numOps) &&_idValidOpDAG[index] == validOpDagID){
 		    if(DEBUG) cout<<"Producer ID of Pre : "<<index<<endl;
-		    addPreOps(index,validOpDagID);
+		    addPreOps(index,validOpDagID,preOps);
 		}
 	    }
 	}
     }
     
     template<typename T, std::size_t NDIM>
-	void FuseT<T,NDIM>::addPostOps(int opIndex, int validOpDagID){
+	void FuseT<T,NDIM>::addPostOps(int opIndex, int validOpDagID, vector<int>& postOps){
 	if (DEBUG) cout<<"Checking for adding to Post ID : "<<opIndex<<endl;
 	if(!_isVisited[opIndex]) {
 	    _isVisited[opIndex] = true;
 	    _isPost[opIndex] = true;
 	    if(DEBUG) cout<<"Adding to Post ID : "<<opIndex<<endl;
-	    _postOps[validOpDagID].push_back(opIndex);
+	    postOps.push_back(opIndex);
 	    for (DInfo di: _consumerList[opIndex]) 
 		if(_idValidOpDAG[di._consumerIndex] == validOpDagID)
 		{
 		    if(DEBUG) cout<<"Consumer ID of Post : "<<di._consumerIndex<<endl;
-		    addPostOps(di._consumerIndex,validOpDagID);
+		    addPostOps(di._consumerIndex,validOpDagID,postOps);
 
 		}
 	}
     }
+
+    template<typename T, std::size_t NDIM>
+	bool FuseT<T,NDIM>::binPrePostOps(const vector<int>& validOpDAG, int validOpDagID, vector<int>& preOps, vector<int>& postOps){
+
+	for (int op : validOpDAG){
+	    _isVisited[op] = false;
+	    _isPre[op] = false;
+	    _isPost[op] = false;
+	}
+
+	for (int op : validOpDAG)
+	    if (!_isVisited[op] && isPreOp(op,validOpDagID))
+		addPreOps(op,validOpDagID,preOps);
+
+	for (int op : validOpDAG)
+	    _isVisited[op] = false;
+
+	for (int op : validOpDAG)
+	    if (!_isVisited[op] && isPostOp(op,validOpDagID))
+		addPostOps(op,validOpDagID,postOps);
+
+	bool valid = true;
+	for (int op : validOpDAG) 
+	    if (_isPost[op] && _isPre[op])
+		valid = false;
+
+	for(int op : validOpDAG)
+	    if(!_isPost[op] && !_isPre[op])
+		preOps.push_back(op);
+
+	std::sort(preOps.begin(),preOps.end());
+	std::sort(postOps.begin(),postOps.end());
+	return valid;
+    }
     
     /*! fills up _preOps and _postOps for each valid OpDag*/
     template<typename T, std::size_t NDIM>
@@ -281,37 +384,10 @@ namespace madness {
 
 	for(int i =0; i< _validOpDAGs.size(); i++)
 	{
-	    vector<int> validOpDAG = _validOpDAGs[i];
-//	    vector<int> source;	    
-//
-//	    for(int op : validOpDAG)
-//		if (isSource(op))
-//		    source.push_back(op);
-
-	    for (int op : validOpDAG)
-		if (!_isVisited[op] && isPreOp(op,i))
-		    addPreOps(op,i);
-
-	    for (int op : validOpDAG)
-		_isVisited[op] = false;
-
-	    for (int op : validOpDAG)
-		if (!_isVisited[op] && isPostOp(op,i))
-		    addPostOps(op,i);
-
-	    for (int op : validOpDAG) 
-		if (_isPost[op] && _isPre[op])
-		    std::cerr<<"Should not be happening"<<std::endl;
-
-	    for(int op : validOpDAG)
-		if(!_isPost[op] && !_isPre[op])
-		    _preOps[i].push_back(op);
-
-	    std::sort(_preOps[i].begin(),_preOps[i].end());
-	    std::sort(_postOps[i].begin(),_postOps[i].end());
-	    
+	    if (!binPrePostOps(_validOpDAGs[i], i, _preOps[i], _postOps[i]))
+		std::cerr<<"Should not be happening"<<std::endl;
 	    
-	    for(int op : validOpDAG)
+	    for(int op : _validOpDAGs[i])
 		_isCompleted[op] = true;
 	}
     }
@@ -366,15 +442,135 @@ namespace madness {
 	}
     }
     
-    //this is incoplete right now. It just returns the entire sequence for now
+    /*! fills up _estNodes, _estFlopsPerNode and _estBytesPerNode. Source
+      trees are measured (a global sum, so processSequence must be called
+      on every rank); the result of an operator is assumed to be as large
+      as its largest operand*/
+    template<typename T, std::size_t NDIM>
+	void FuseT<T,NDIM>::estimateOpCosts(){
+
+	const int k = FunctionDefaults<NDIM>::get_k();
+	const double nodeBytes = std::pow(double(k), double(NDIM))*sizeof(T);
+
+	_estNodes.assign(_trees.size(), 0.0);
+	if (_trees.size() > _numOps){
+	    World& world = _trees[_numOps]->world();
+	    for (int i = _numOps; i < _trees.size(); i++)
+		_estNodes[i] = _trees[i]->get_impl()->get_coeffs().size();
+	    world.gop.sum(&_estNodes[_numOps], _trees.size() - _numOps);
+	}
+
+	//operators only consume trees produced earlier in the sequence
+	_estFlopsPerNode.assign(_numOps, 0.0);
+	_estBytesPerNode.assign(_numOps, 0.0);
+	for (int i = 0; i < _numOps; i++){
+	    for (DInfo di : _producerList[i])
+		if (di._producerIndex != i)
+		    _estNodes[i] = std::max(_estNodes[i], _estNodes[di._producerIndex]);
+	    _estFlopsPerNode[i] = _sequence[i]->costPerNode(k);
+	    if (_sequence[i]->needsParameter() || !_sequence[i]->isPre())
+		_estBytesPerNode[i] = nodeBytes;
+	}
+    }
+
+    /*! A fused traversal visits about as many nodes as its largest tree,
+      does the work of all its operators and keeps the parameters of all
+      of them in flight at once*/
+    template<typename T, std::size_t NDIM>
+	OpDagCost FuseT<T,NDIM>::estimateOpDagCost(int first, int last) const{
+	OpDagCost c;
+	for (int i = first; i < last; i++){
+	    c._nodes = std::max(c._nodes, _estNodes[i]);
+	    c._flops += _estNodes[i]*_estFlopsPerNode[i];
+	    c._memory += _estNodes[i]*_estBytesPerNode[i];
+	}
+	c._cost = c._flops + _visitCost*c._nodes + _fenceCost;
+	return c;
+    }
+
+    template<typename T, std::size_t NDIM>
+	bool FuseT<T,NDIM>::isValidOpDag(int first, int last){
+	vector<int> validOpDAG, preOps, postOps;
+	for (int i = first; i < last; i++){
+	    validOpDAG.push_back(i);
+	    _idValidOpDAG[i] = 0;
+	}
+	bool valid = binPrePostOps(validOpDAG, 0, preOps, postOps);
+	for (int i = first; i < last; i++)
+	    _idValidOpDAG[i] = -1;
+	return valid;
+    }
+
+    /*! Partitions _sequence into consecutive valid OpDAGs. Keeping program
+      order guarantees that every producer runs in the same or an earlier
+      traversal than its consumers.
+      FUSE_PLANNED finds, by dynamic programming over prefixes, the partition
+      with the fewest traversals whose fused groups are valid and fit in the
+      memory budget, breaking ties by the estimated cost.*/
     template<typename T, std::size_t NDIM>
 	void FuseT<T,NDIM>::getValidOpDAGSequence(){
 
-	_validOpDAGs.push_back(vector<int>());
+	_isVisited.assign(_numOps,false);
+	_isPre.assign(_numOps,false);
+	_isPost.assign(_numOps,false);
 	_idValidOpDAG.assign(_sequence.size(), -1);
-	for(int i = 0; i< _sequence.size(); i++){
-	    _validOpDAGs[0].push_back(i);
-	    _idValidOpDAG[i] = 0;	   
+
+	//start[i] is the first operator of the valid OpDAG that ends at i
+	vector<int> start(_numOps+1, 0);
+
+	if (_strategy == FUSE_NONE){
+	    for (int i = 1; i <= _numOps; i++)
+		start[i] = i-1;
+	}
+	else if (_strategy == FUSE_GREEDY){
+	    int first = 0;
+	    for (int i = 1; i <= _numOps; i++){
+		if (i-1 > first){
+		    OpDagCost c = estimateOpDagCost(first,i);
+		    if (!isValidOpDag(first,i) || (_memoryBudget > 0 && c._memory > _memoryBudget))
+			first = i-1;
+		}
+		start[i] = first;
+	    }
+	}
+	else{
+	    const double inf = std::numeric_limits<double>::max();
+	    vector<int> count(_numOps+1, std::numeric_limits<int>::max());
+	    vector<double> cost(_numOps+1, inf);
+	    count[0] = 0;
+	    cost[0] = 0;
+	    for (int i = 1; i <= _numOps; i++){
+		for (int j = i-1; j >= 0; j--){
+		    OpDagCost c = estimateOpDagCost(j,i);
+		    //memory only grows as the group is extended to the left
+		    if (j < i-1 && _memoryBudget > 0 && c._memory > _memoryBudget)
+			break;
+		    if (j < i-1 && !isValidOpDag(j,i))
+			continue;
+		    if (count[j]+1 < count[i] ||
+			(count[j]+1 == count[i] && cost[j]+c._cost < cost[i])){
+			count[i] = count[j]+1;
+			cost[i] = cost[j]+c._cost;
+			start[i] = j;
+		    }
+		}
+	    }
+	}
+
+	//walk the partition back from the end of the sequence
+	vector<int> bounds;
+	for (int i = _numOps; i > 0; i = start[i])
+	    bounds.push_back(i);
+	bounds.push_back(0);
+	std::reverse(bounds.begin(), bounds.end());
+
+	for (int g = 0; g+1 < bounds.size(); g++){
+	    _validOpDAGs.push_back(vector<int>());
+	    for (int i = bounds[g]; i < bounds[g+1]; i++){
+		_validOpDAGs[g].push_back(i);
+		_idValidOpDAG[i] = g;
+	    }
+	    _opDagCosts.push_back(estimateOpDagCost(bounds[g], bounds[g+1]));
 	}
 
 	//initialize _preOps and _postOps
@@ -417,6 +613,41 @@ namespace madness {
     }
     
 
+    template<typename T, std::size_t NDIM>
+	void FuseT<T,NDIM>::printPlan(){
+	if(!_isSequenceProcessed){
+	    cout<<"Sequence not processed!"<<endl;
+	    return;
+	}
+
+	const char* strategy[] = {"planned", "greedy", "unfused"};
+	OpDagCost total;
+	for (const OpDagCost& c : _opDagCosts){
+	    total._flops += c._flops;
+	    total._memory = std::max(total._memory, c._memory);
+	    total._cost += c._cost;
+	}
+
+	cout<<endl<<"Fusion Plan ("<<strategy[_strategy]<<")"<<endl;
+	cout<<"Traversals : "<<_validOpDAGs.size()<<"  Operators : "<<_numOps;
+	if (_memoryBudget > 0)
+	    cout<<"  Memory Budget : "<<_memoryBudget/(1024.0*1024.0)<<" MB";
+	cout<<endl;
+	cout<<"Estimated cost : "<<total._cost<<"  flops : "<<total._flops
+	    <<"  peak parameter memory : "<<total._memory/(1024.0*1024.0)<<" MB"<<endl;
+	cout<<"________________________"<<endl;
+	for(int i =0; i< _validOpDAGs.size(); i++){
+	    const OpDagCost& c = _opDagCosts[i];
+	    cout<<"Traversal "<<i<<" : nodes "<<c._nodes<<"  flops "<<c._flops
+		<<"  memory "<<c._memory/(1024.0*1024.0)<<" MB  cost "<<c._cost<<endl;
+	    for(int id : _preOps[i])
+		cout<<"   pre  "<<id<<" "<<_sequence[id]->_opName<<"  nodes "<<_estNodes[id]<<endl;
+	    for(int id : _postOps[i])
+		cout<<"   post "<<id<<" "<<_sequence[id]->_opName<<"  nodes "<<_estNodes[id]<<endl;
+	}
+	cout<<"________________________"<<endl;
+    }
+
         template<typename T, std::size_t NDIM>
 	void FuseT<T,NDIM>::printOpsAndTrees(){
 	    if(!_isSequenceProcessed){
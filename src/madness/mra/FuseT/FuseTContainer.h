@@ -8,6 +8,9 @@
 #include <madness/world/MADworld.h>
 #include <madness/world/buffer_archive.h>
 #include <madness/tensor/gentensor.h>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
 #define DIM 3
 using namespace madness;
 
@@ -67,15 +70,13 @@ struct WhatAmI<FuseT_VArgT<T>> {static const WHAT_AM_I t=WHAT_AM_I::FuseT_VArgT;
 template<typename T>
 struct WhatAmI<FuseT_VParameter<T>> {static const WHAT_AM_I t=WHAT_AM_I::FuseT_VParameter;};
 
-// Simple base class
-// Do I have to add get() methods for a variety of return types?
+// Empty tag base for the payload types.  It is deliberately non-virtual:
+// the payload type is tracked by the FuseTContainer tag, so neither copying
+// nor (de)serializing a container goes through virtual dispatch.
 template <typename T>
 class Base
 {
 public:
-	virtual WHAT_AM_I what() const = 0;
-	virtual ~Base() {};
-
 	template<typename Archive>
 	void serialize(Archive& ar) {  }
 };
@@ -89,6 +90,7 @@ public:
 
 	FuseT_Type() { }
 	FuseT_Type(const FuseT_Type& other) : value (other.value) { }
+	FuseT_Type(FuseT_Type&& other) : value (std::move(other.value)) { }
 	FuseT_Type(T &v) { value = v; }
 	~FuseT_Type() { }	
 
@@ -107,6 +109,7 @@ public:
 	FuseT_VType() { value = std::vector<int>(); }
 	FuseT_VType(int size) {value = std::vector<int>(size); }
 	FuseT_VType(const FuseT_VType& other) : value (other.value) { }
+	FuseT_VType(FuseT_VType&& other) : value (std::move(other.value)) { }
 	FuseT_VType(std::vector<int> &v) { value = v; }
 	~FuseT_VType() { }
 
@@ -126,6 +129,7 @@ public:
 	
 	FuseT_CoeffT() { }
 	FuseT_CoeffT(const FuseT_CoeffT& other) : value (other.value) { }
+	FuseT_CoeffT(FuseT_CoeffT&& other) : value (std::move(other.value)) { }
 	FuseT_CoeffT(coeffT &v) { value = v; }
 	~FuseT_CoeffT() { }
 	
@@ -146,6 +150,7 @@ public:
 	FuseT_VCoeffT() { value = std::vector<coeffT>(); } 
 	FuseT_VCoeffT(int size) { value = std::vector<coeffT>(size); }
 	FuseT_VCoeffT(const FuseT_VCoeffT& other) : value (other.value) { }
+	FuseT_VCoeffT(FuseT_VCoeffT&& other) : value (std::move(other.value)) { }
 	FuseT_VCoeffT(std::vector<coeffT> &v) { value = v; }
 	~FuseT_VCoeffT() { value.clear();}
 	
@@ -169,6 +174,7 @@ public:
 	FuseT_VArgT() { value = std::vector<argT>(); } 
 	FuseT_VArgT(int size) { value = std::vector<argT>(size); }
 	FuseT_VArgT(const FuseT_VArgT& other) : value (other.value) { }
+	FuseT_VArgT(FuseT_VArgT&& other) : value (std::move(other.value)) { }
 	FuseT_VArgT(std::vector<argT> &v) { value = v; }
 	argT& operator[](int idx){return value[idx];}
 	~FuseT_VArgT() { value.clear();}
@@ -190,6 +196,7 @@ public:
 	FuseT_VParameter() { value = std::vector<FuseTContainer<T>>(); }
 	FuseT_VParameter(int size) { value = std::vector<FuseTContainer<T>>(size); }
 	FuseT_VParameter(const FuseT_VParameter& other) : value (other.value) { }
+	FuseT_VParameter(FuseT_VParameter&& other) : value (std::move(other.value)) { }
 	FuseT_VParameter(std::vector<FuseTContainer<T> > &v) { value = v; }
 	~FuseT_VParameter() { value.clear();}
 	FuseTContainer<T> operator[](int i){return value[i];}
@@ -202,120 +209,158 @@ public:
 //
 //	FuseTContainer
 //
+//	A tagged union over the FuseT_* payload types.  The payload lives in an
+//	inline buffer, so passing parameters between operators does not touch
+//	the heap for the wrapper itself, and copies, moves, destruction and
+//	serialization all dispatch on the tag with a switch.
+//
 template <typename T>
 class FuseTContainer
 {
+	// All vector payloads hold exactly one std::vector, whose size does not
+	// depend on the element type (FuseT_VParameter is still incomplete here).
+	static const std::size_t buffer_size =
+		(sizeof(GenTensor<T>) > sizeof(std::vector<int>)) ?
+		((sizeof(GenTensor<T>) > sizeof(T)) ? sizeof(GenTensor<T>) : sizeof(T)) :
+		((sizeof(std::vector<int>) > sizeof(T)) ? sizeof(std::vector<int>) : sizeof(T));
+
+	typedef typename std::aligned_storage<buffer_size, alignof(std::max_align_t)>::type bufferT;
+
+	bufferT		_buffer;
+	WHAT_AM_I	_what;
+
+	template <typename U>
+	U* as() { return reinterpret_cast<U*>(&_buffer); }
+
+	template <typename U>
+	const U* as() const { return reinterpret_cast<const U*>(&_buffer); }
+
+	template <typename U>
+	static void check_fits()
+	{
+		static_assert(sizeof(U) <= buffer_size, "FuseTContainer buffer is too small for payload");
+		static_assert(alignof(U) <= alignof(bufferT), "FuseTContainer buffer is misaligned for payload");
+	}
+
+	// Default-constructs the payload for tag t (used when deserializing)
 	void allocate(WHAT_AM_I t)
 	{
-		if (t == WHAT_AM_I::FuseT_CoeffT)
-			data = static_cast<Base<T>*>(new FuseT_CoeffT<T>);
-		else if (t == WHAT_AM_I::FuseT_VCoeffT)
-			data = static_cast<Base<T>*>(new FuseT_VCoeffT<T>);
-		else if (t == WHAT_AM_I::FuseT_VArgT)
-			data = static_cast<Base<T>*>(new FuseT_VArgT<T>);
-		else if (t == WHAT_AM_I::FuseT_VParameter)
-			data = static_cast<Base<T>*>(new FuseT_VParameter<T>);
-		else if (t == WHAT_AM_I::FuseT_Type)
-			data = static_cast<Base<T>*>(new FuseT_Type<T>);
-		else if (t == WHAT_AM_I::FuseT_VType)
-			data = static_cast<Base<T>*>(new FuseT_VType<T>);
-		else
-			data = 0;
+		switch(t)
+		{
+			case WHAT_AM_I::FuseT_CoeffT:		emplace<FuseT_CoeffT<T> >();		break;
+			case WHAT_AM_I::FuseT_VCoeffT:		emplace<FuseT_VCoeffT<T> >();		break;
+			case WHAT_AM_I::FuseT_VArgT:		emplace<FuseT_VArgT<T> >();			break;
+			case WHAT_AM_I::FuseT_VParameter:	emplace<FuseT_VParameter<T> >();	break;
+			case WHAT_AM_I::FuseT_Type:			emplace<FuseT_Type<T> >();			break;
+			case WHAT_AM_I::FuseT_VType:		emplace<FuseT_VType<T> >();			break;
+			default:							clear();
+		}
 	}
 
-public:
-	Base<T>* data;
+	void copy_from(const FuseTContainer& other)
+	{
+		switch(other._what)
+		{
+			case WHAT_AM_I::FuseT_CoeffT:		emplace<FuseT_CoeffT<T> >(*other.as<FuseT_CoeffT<T> >());			break;
+			case WHAT_AM_I::FuseT_VCoeffT:		emplace<FuseT_VCoeffT<T> >(*other.as<FuseT_VCoeffT<T> >());			break;
+			case WHAT_AM_I::FuseT_VArgT:		emplace<FuseT_VArgT<T> >(*other.as<FuseT_VArgT<T> >());				break;
+			case WHAT_AM_I::FuseT_VParameter:	emplace<FuseT_VParameter<T> >(*other.as<FuseT_VParameter<T> >());	break;
+			case WHAT_AM_I::FuseT_Type:			emplace<FuseT_Type<T> >(*other.as<FuseT_Type<T> >());				break;
+			case WHAT_AM_I::FuseT_VType:		emplace<FuseT_VType<T> >(*other.as<FuseT_VType<T> >());				break;
+			default:							clear();
+		}
+	}
 
-	// Default constructor makes an empty wrapper
-	FuseTContainer() : data(0) {}
-	
-	// Need to handle "data" pointer
-	FuseTContainer<T>& operator=(FuseTContainer<T> other)
+	void move_from(FuseTContainer& other)
 	{
-		FuseT_Type<T>*			copiedFuseTType;
-		FuseT_VType<T>*			copiedFuseTVType;
-		FuseT_CoeffT<T>*		copiedFuseTCoeffT;
-		FuseT_VCoeffT<T>*		copiedFuseTVCoeffT;
-		FuseT_VArgT<T>*		copiedFuseTVArgT;
-		FuseT_VParameter<T>*	copiedFuseTVParameter;
-
-		switch(other.what())
-		{	
-			case WHAT_AM_I::FuseT_Type:
-				//std::cout<<"=Type"<<std::endl;
-				copiedFuseTType	= new FuseT_Type<T>();
-				copiedFuseTType->value	= ((FuseT_Type<T>*)(other.data))->value;
-				this->data = static_cast<Base<T>*>(copiedFuseTType);
-				break;
-			case WHAT_AM_I::FuseT_VType:
-				//std::cout<<"=Type"<<std::endl;
-				copiedFuseTVType		= new FuseT_VType<T>();
-				copiedFuseTVType->value	= ((FuseT_VType<T>*)(other.data))->value;
-				this->data				= static_cast<Base<T>*>(copiedFuseTVType);
-				break;
-			case WHAT_AM_I::FuseT_CoeffT:
-				//std::cout<<"=CoeffT"<<std::endl;
-				copiedFuseTCoeffT = new FuseT_CoeffT<T>();
-				copiedFuseTCoeffT->value = ((FuseT_CoeffT<T>*)(other.data))->value;
-				this->data = static_cast<Base<T>*>(copiedFuseTCoeffT);
-				break;
-			case WHAT_AM_I::FuseT_VCoeffT:
-				//std::cout<<"=VCoeffT"<<std::endl;
-				copiedFuseTVCoeffT = new FuseT_VCoeffT<T>();
-				copiedFuseTVCoeffT->value = ((FuseT_VCoeffT<T>*)(other.data))->value;								
-				this->data = static_cast<Base<T>*>(copiedFuseTVCoeffT);
-				break;
-			case WHAT_AM_I::FuseT_VArgT:
-				//std::cout<<"=VCoeffT"<<std::endl;
-				copiedFuseTVArgT = new FuseT_VArgT<T>();
-				copiedFuseTVArgT->value	= ((FuseT_VArgT<T>*)(other.data))->value;								
-				this->data = static_cast<Base<T>*>(copiedFuseTVArgT);
-				break;
-			case WHAT_AM_I::FuseT_VParameter:
-				//std::cout<<"=VParameter"<<std::endl;
-				copiedFuseTVParameter = new FuseT_VParameter<T>();
-				copiedFuseTVParameter->value = ((FuseT_VParameter<T>*)(other.data))->value;
-				this->data = static_cast<Base<T>*>(copiedFuseTVParameter);
-				break;
-			case WHAT_AM_I::EMPTY:
-				//std::cout<<"=EMPTY"<<std::endl;
-
-				break;
-			default:
-				std::cout << "=ERROR!!!!" << std::endl;
+		switch(other._what)
+		{
+			case WHAT_AM_I::FuseT_CoeffT:		emplace<FuseT_CoeffT<T> >(std::move(*other.as<FuseT_CoeffT<T> >()));			break;
+			case WHAT_AM_I::FuseT_VCoeffT:		emplace<FuseT_VCoeffT<T> >(std::move(*other.as<FuseT_VCoeffT<T> >()));			break;
+			case WHAT_AM_I::FuseT_VArgT:		emplace<FuseT_VArgT<T> >(std::move(*other.as<FuseT_VArgT<T> >()));				break;
+			case WHAT_AM_I::FuseT_VParameter:	emplace<FuseT_VParameter<T> >(std::move(*other.as<FuseT_VParameter<T> >()));	break;
+			case WHAT_AM_I::FuseT_Type:			emplace<FuseT_Type<T> >(std::move(*other.as<FuseT_Type<T> >()));				break;
+			case WHAT_AM_I::FuseT_VType:		emplace<FuseT_VType<T> >(std::move(*other.as<FuseT_VType<T> >()));				break;
+			default:							clear();
 		}
+		other.clear();
+	}
+
+public:
+	// Default constructor makes an empty wrapper
+	FuseTContainer() : _what(WHAT_AM_I::EMPTY) {}
+
+	FuseTContainer(const FuseTContainer<T>& other) : _what(WHAT_AM_I::EMPTY) { copy_from(other); }
+
+	FuseTContainer(FuseTContainer<T>&& other) : _what(WHAT_AM_I::EMPTY) { move_from(other); }
+
+	// Adopts a heap-allocated payload: its value is moved into the inline
+	// buffer and the pointer is deleted.
+	template <typename U>
+	explicit FuseTContainer(U* obj) : _what(WHAT_AM_I::EMPTY) { set(obj); }
+
+	FuseTContainer<T>& operator=(const FuseTContainer<T>& other)
+	{
+		if (this != &other) copy_from(other);
+		return *this;
+	}
+
+	FuseTContainer<T>& operator=(FuseTContainer<T>&& other)
+	{
+		if (this != &other) move_from(other);
 		return *this;
 	}
 
-	FuseTContainer(Base<T>* obj) : data(obj) {}	// !!! TAKES OWNERSHIP OF POINTER
-												// should use shared_ptr
+	~FuseTContainer() { clear(); }
 
 	// Returns type identity
-	WHAT_AM_I what() const
+	WHAT_AM_I what() const { return _what; }
+
+	// Returns the payload, or 0 if the container is empty
+	Base<T>* get() const
 	{
-		if (data) 
-			return data->what();
-		else
-			return WHAT_AM_I::EMPTY;
+		if (_what == WHAT_AM_I::EMPTY) return 0;
+		return const_cast<Base<T>*>(as<Base<T> >());
 	}
 
-	Base<T>* get() const
+	// Constructs a payload of type U in place, replacing the current one
+	template <typename U, typename... Args>
+	U& emplace(Args&&... args)
 	{
-		return data;
+		check_fits<U>();
+		clear();
+		U* p = new (&_buffer) U(std::forward<Args>(args)...);
+		_what = WhatAmI<U>::t;
+		return *p;
 	}
 
-	void set(Base<T>* p)
+	// Adopts a heap-allocated payload (see the pointer constructor)
+	template <typename U>
+	void set(U* p)
 	{
-		data = p;
+		if (p)
+		{
+			emplace<U>(std::move(*p));
+			delete p;
+		}
+		else
+			clear();
 	}
 
-	~FuseTContainer() 
-	{	///////////////////////////////////////////////////////	
-		// should be memory leak.
-		// please check this out
-		//if (data != 0)
-		//	delet data;
-	}//delete data;}	// what about this?
+	void clear()
+	{
+		switch(_what)
+		{
+			case WHAT_AM_I::FuseT_CoeffT:		as<FuseT_CoeffT<T> >()->~FuseT_CoeffT<T>();			break;
+			case WHAT_AM_I::FuseT_VCoeffT:		as<FuseT_VCoeffT<T> >()->~FuseT_VCoeffT<T>();		break;
+			case WHAT_AM_I::FuseT_VArgT:		as<FuseT_VArgT<T> >()->~FuseT_VArgT<T>();			break;
+			case WHAT_AM_I::FuseT_VParameter:	as<FuseT_VParameter<T> >()->~FuseT_VParameter<T>();	break;
+			case WHAT_AM_I::FuseT_Type:			as<FuseT_Type<T> >()->~FuseT_Type<T>();				break;
+			case WHAT_AM_I::FuseT_VType:		as<FuseT_VType<T> >()->~FuseT_VType<T>();			break;
+			default:							break;
+		}
+		_what = WHAT_AM_I::EMPTY;
+	}
 
 	template <typename Archive>
 	static void do_serialize(const Archive& ar, FuseTContainer& w, bool deserialize)
@@ -324,15 +369,86 @@ public:
 		ar & t;
 		if (deserialize) w.allocate(static_cast<WHAT_AM_I>(t));
 
-		if (w.what() == WHAT_AM_I::FuseT_CoeffT)			ar & *static_cast<FuseT_CoeffT<T>*>(w.data);
-		else if (w.what() == WHAT_AM_I::FuseT_VCoeffT)		ar & *static_cast<FuseT_VCoeffT<T>*>(w.data);
-		else if (w.what() == WHAT_AM_I::FuseT_VArgT)		ar & *static_cast<FuseT_VArgT<T>*>(w.data);
-		else if (w.what() == WHAT_AM_I::FuseT_VParameter)	ar & *static_cast<FuseT_VParameter<T>*>(w.data);
-		else if (w.what() == WHAT_AM_I::FuseT_Type)			ar & *static_cast<FuseT_Type<T>*>(w.data);
-		else if (w.what() == WHAT_AM_I::FuseT_VType)		ar & *static_cast<FuseT_VType<T>*>(w.data);
-		else if (w.what() == WHAT_AM_I::EMPTY)				ar & *static_cast<Base<T>*>(w.data);
-		else	
-			std::cout<<__func__<<" wft"<<std::endl;
+		switch(w.what())
+		{
+			case WHAT_AM_I::FuseT_CoeffT:		ar & *w.template as<FuseT_CoeffT<T> >();		break;
+			case WHAT_AM_I::FuseT_VCoeffT:		ar & *w.template as<FuseT_VCoeffT<T> >();		break;
+			case WHAT_AM_I::FuseT_VArgT:		ar & *w.template as<FuseT_VArgT<T> >();			break;
+			case WHAT_AM_I::FuseT_VParameter:	ar & *w.template as<FuseT_VParameter<T> >();	break;
+			case WHAT_AM_I::FuseT_Type:			ar & *w.template as<FuseT_Type<T> >();			break;
+			case WHAT_AM_I::FuseT_VType:		ar & *w.template as<FuseT_VType<T> >();			break;
+			default:							break;
+		}
+	}
+};
+
+//
+//	FuseTParamArray
+//
+//	Per-node parameters of a fused traversal, one slot per operator in the
+//	FusedOpSequence and indexed by the operator's position in it.  Slots are
+//	sized once for the whole sequence, replacing the std::map<int,...> that
+//	was rebuilt at every node.  has(i) plays the role of map::find(i).
+//
+template <typename T>
+class FuseTParamArray
+{
+	std::vector<FuseTContainer<T> >	_slots;
+	std::vector<unsigned char>		_set;
+
+public:
+	FuseTParamArray() {}
+
+	explicit FuseTParamArray(std::size_t n) : _slots(n), _set(n, 0) {}
+
+	std::size_t size() const { return _slots.size(); }
+
+	// True if slot i has been assigned
+	bool has(int i) const { return i >= 0 && std::size_t(i) < _set.size() && _set[i]; }
+
+	// Returns slot i, marking it as assigned
+	FuseTContainer<T>& operator[](int i)
+	{
+		MADNESS_ASSERT(i >= 0 && std::size_t(i) < _slots.size());
+		_set[i] = 1;
+		return _slots[i];
+	}
+
+	const FuseTContainer<T>& operator[](int i) const
+	{
+		MADNESS_ASSERT(i >= 0 && std::size_t(i) < _slots.size());
+		return _slots[i];
+	}
+
+	// Only assigned slots go on the wire
+	template <typename Archive>
+	static void do_serialize(const Archive& ar, FuseTParamArray& w, bool deserialize)
+	{
+		std::size_t n = w._slots.size();
+		std::size_t nset = 0;
+		for (std::size_t i=0; i<w._set.size(); i++) nset += w._set[i];
+		ar & n & nset;
+		if (deserialize)
+		{
+			w._slots.clear();
+			w._slots.resize(n);
+			w._set.assign(n, 0);
+			for (std::size_t k=0; k<nset; k++)
+			{
+				int i;
+				ar & i;
+				ar & w[i];
+			}
+		}
+		else
+		{
+			for (std::size_t i=0; i<n; i++)
+			{
+				if (!w._set[i]) continue;
+				int ii = i;
+				ar & ii & w._slots[i];
+			}
+		}
 	}
 };
 
@@ -357,6 +473,24 @@ namespace madness
 				w.do_serialize(ar, w, true);
 			}
 		};
+
+		template <class Archive, typename T>
+		struct ArchiveStoreImpl<Archive, FuseTParamArray<T> >
+		{
+			static void store(const Archive& ar, const FuseTParamArray<T>& w)
+			{
+				FuseTParamArray<T>::do_serialize(ar, const_cast<FuseTParamArray<T>&>(w), false);
+			}
+		};
+
+		template <class Archive, typename T>
+		struct ArchiveLoadImpl<Archive, FuseTParamArray<T> >
+		{
+			static void load(const Archive& ar, FuseTParamArray<T>& w)
+			{
+				FuseTParamArray<T>::do_serialize(ar, w, true);
+			}
+		};
 	}
 }
 
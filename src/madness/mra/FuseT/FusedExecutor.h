@@ -47,7 +47,8 @@ namespace madness {
 	typedef WorldContainer<Key<NDIM>,FunctionNode<T,NDIM>>dcT;
 	typedef FunctionNode<T,NDIM>KNODE;
 	typedef GenTensor<T>coeffT;
-	typedef map<int, FuseTContainer<T> > paraMap;
+	//parameters of each operator at a node, indexed by its position in _fOps->_sequence
+	typedef FuseTParamArray<T> paraMap;
 	typedef vector<Future<paraMap > > postParameter;
 	
     private:
@@ -56,13 +57,17 @@ namespace madness {
 	Future <paraMap> continueTraversal(keyT key, const LocalFuseInfo<T,NDIM>& lInfo, paraMap& pMap, LocalFuseInfo<T,NDIM>& newlInfo, vector<paraMap> &pMapVec, int lastIdx, FuseTContainer<T>& lastReturn);
 
 	FusedOpSequence<T,NDIM>* _fOps;
-	map<int,FuseTContainer<T> >  fusedPostCompute(keyT Key, const vector<int> postComputeOps, vector<Future<paraMap> >& v);
+	paraMap  fusedPostCompute(keyT Key, const vector<int> postComputeOps, vector<Future<paraMap> >& v);
 	dcT _coeffs; 
+	int _inlineLevel;
+
+	bool inlineChildren(const keyT& key) const;
+	bool runInline(const keyT& child, const LocalFuseInfo<T,NDIM>& lInfo) const;
 
     public: 
 	/*passes world, fOp and coeffs. The last parameters is used to figure out 
 	  the distribution of keys amoung multiple MPI ranks*/
-    FusedExecutor(World& world, FusedOpSequence<T,NDIM>* fOp): woT(world), _world(world){
+    FusedExecutor(World& world, FusedOpSequence<T,NDIM>* fOp): woT(world), _world(world), _inlineLevel(-1){
 
 	    woT::process_pending();
 	const std::shared_ptr<WorldDCPmapInterface<Key<NDIM> > > _pmap(FunctionDefaults<NDIM>::get_pmap());		    
@@ -72,8 +77,41 @@ namespace madness {
 
     }
 	void execute(); 
+
+	//!Task coarsening: from level n down, a leaf child owned by this rank
+	//!is traversed by a direct call instead of a task, unless the thread
+	//!pool is running short of work. A negative n (the
+	//!default) spawns a task for every node.
+	void set_inline_level(int n) { _inlineLevel = n; }
     };
 
+    //true if the children of key may be traversed inline; decided once per
+    //node so the queue length is sampled only once
+    template<typename T, std::size_t NDIM>
+	bool FusedExecutor<T,NDIM>::inlineChildren(const keyT& key) const
+    {
+	return _inlineLevel >= 0 && key.level() + 1 >= Level(_inlineLevel)
+	    && ThreadPool::queue_size() >= ThreadPool::size();
+    }
+
+    //true if the child is local leaf-level work: no preCompute op and no
+    //postCompute operand continues below it, so its traversal stays on this rank
+    template<typename T, std::size_t NDIM>
+	bool FusedExecutor<T,NDIM>::runInline(const keyT& child, const LocalFuseInfo<T,NDIM>& lInfo) const
+    {
+	if(_coeffs.owner(child) != _world.rank())
+	    return false;
+	for(int i : lInfo._preCompute)
+	    if(!_fOps->_sequence[i]->isDone(child))
+		return false;
+	for(int i : lInfo._postOperands){
+	    const dcT& source = _fOps->_trees[i]->get_impl()->get_coeffs();
+	    if(source.probe(child) && source.find(child).get()->second.has_children())
+		return false;
+	}
+	return true;
+    }
+
 
     template<typename T, std::size_t NDIM>
 	void FusedExecutor<T,NDIM>::execute()
@@ -94,7 +132,7 @@ namespace madness {
 		//the key is the order in which the operations appear in _fOps->sequence
 		//cout<<"Second Execution Time"<<endl<<fflush;
 		if(_world.rank() == _coeffs.owner(keyT(0))){  
-		    paraMap pMap;
+		    paraMap pMap(_fOps->_sequence.size());
 		    fusedTraversal(keyT(0),lInfo,pMap);
 		}	    
 		
@@ -111,9 +149,8 @@ namespace madness {
 	}
     }
 
-    //typedef map<int, FuseTContainer<T> > paraMap;
     template<typename T, std::size_t NDIM>
-	Future <map<int,FuseTContainer<T> > > 
+	Future <FuseTParamArray<T> > 
 	FusedExecutor<T,NDIM>::continueTraversal(keyT key, const LocalFuseInfo<T,NDIM>& lInfo, paraMap& pMap, LocalFuseInfo<T,NDIM> &newlInfo, vector<paraMap> &pMapVec, int lastIdx, FuseTContainer<T>& lastReturn){
 
 	//process the preCompute Op that was computed before this call
@@ -234,16 +271,26 @@ namespace madness {
 	    if(DEBUG) cout<<"Recursive Call"<<endl;
 	    // Main-Computation
 	    v = future_vector_factory<paraMap>(1<<NDIM);
+	    const bool inl = inlineChildren(key);
 	    int i =0;
 	    for (KeyChildIterator<NDIM> kit(key); kit; ++kit, i++) {
 		const keyT& child = kit.key();
-		v[i] = woT::task(_coeffs.owner(child), &feT::fusedTraversal, child, newlInfo, pMapVec[i]);
+		if(inl && runInline(child, newlInfo))
+		    v[i] = fusedTraversal(child, newlInfo, pMapVec[i]);
+		else
+		    v[i] = woT::task(_coeffs.owner(child), &feT::fusedTraversal, child, newlInfo, pMapVec[i]);
 	    }
 	}
 
 	if(DEBUG) cout<<"After Recursive Call"<<endl;
 	if(lInfo._postCompute.size() > 0){
 	    if(DEBUG) cout<<"Calling Post Compute"<<endl;
+	    //children traversed inline may already have delivered their parameters
+	    bool ready = true;
+	    for(unsigned int i=0; i<v.size() && ready; i++)
+		ready = v[i].probe();
+	    if(ready && _inlineLevel >= 0 && key.level() >= Level(_inlineLevel))
+		return Future<paraMap>(fusedPostCompute(key, lInfo._postCompute, v));
 	    return woT::task(_world.rank(), &feT::fusedPostCompute, key, lInfo._postCompute, v);
 	}
 
@@ -254,9 +301,8 @@ namespace madness {
     }
 
 
-    //typedef map<int, FuseTContainer<T> > paraMap;
     template<typename T, std::size_t NDIM>
-	Future <map<int,FuseTContainer<T> > > 
+	Future <FuseTParamArray<T> > 
 	FusedExecutor<T,NDIM>::fusedTraversal(keyT key, const LocalFuseInfo<T,NDIM>& lInfo, paraMap& pMap)
     {
 	if(DEBUG1){ cout<<" Key : "<<key.level()<<" Translation : " ;
@@ -268,31 +314,32 @@ namespace madness {
 	}
 	LocalFuseInfo<T,NDIM> newlInfo;
 	//will hold new parameters
-	vector<paraMap> pMapVec = vector<paraMap>(1<<NDIM);
+	vector<paraMap> pMapVec = vector<paraMap>(1<<NDIM, paraMap(_fOps->_sequence.size()));
 	FuseTContainer<T> temp = FuseTContainer<T>();
 	//cout<<"About to enter continue traversal"<<endl;
 	return continueTraversal(key,lInfo,pMap,newlInfo,pMapVec, -1, temp);
     }
 
         template<typename T, std::size_t NDIM>
-	    map<int,FuseTContainer<T> >  FusedExecutor<T,NDIM>::fusedPostCompute(keyT key, const vector<int> postComputeOps, vector<Future<paraMap> >& v){
+	    FuseTParamArray<T>  FusedExecutor<T,NDIM>::fusedPostCompute(keyT key, const vector<int> postComputeOps, vector<Future<paraMap> >& v){
 
 
-	paraMap returnPara;
+	paraMap returnPara(_fOps->_sequence.size());
 	for(int i : postComputeOps){
 	    
 	    //vector of return parameters form each child for this operator
-	    vector<FuseTContainer<T> > temp;
+	    FuseTContainer<T> para;
+	    vector<FuseTContainer<T> >& temp = para.template emplace<FuseT_VParameter<T> >().value;
 	    //the first condition makes sure that v is not empty
 	    //the second condition makes sure that operator i produces coeffs at a child node
-	    if(v.size() > 0 && v[0].get().find(i) != v[0].get().end()){
+	    if(v.size() > 0 && v[0].get().has(i)){
 		int j = 0;
+		temp.reserve(1<<NDIM);
 		for (KeyChildIterator<NDIM> kit(key); kit; ++kit, j++) {
-		    FuseTContainer<T> t = v[j].get()[i];
-		    temp.push_back(t);
+		    const paraMap& child = v[j].get();
+		    temp.push_back(child.has(i) ? child[i] : FuseTContainer<T>());
 		}
 	    }
-	    FuseTContainer<T> para(static_cast<Base<T>*>(new FuseT_VParameter<T>(temp)));
 	    PrimitiveOp<T,NDIM>* postOp = _fOps->_sequence[i];
 	    returnPara[i] = postOp->compute(key,para);
 	}
@@ -63,6 +63,8 @@ namespace madness
 	bool						isPre			() const { return true; } // false does not work. but It should be false.
 	bool						needsParameter	() const { return false; }
 	void						reduce			(World& world);
+	// one (left x right x coefficients) product per node
+	double						costPerNode		(int k) const { return 2.0*_left.size()*_right.size()*std::pow(2.0*k, double(NDIM)); }
 
     public:	
 	// MatrixInnerOpp
@@ -88,6 +90,24 @@ namespace madness
 	
 		
 	int						_k;		// Wavelet order
+
+	//!Per-thread partial result and packing workspace. Slot i belongs to
+	//!pool thread i; the last slot is shared by all other threads and is
+	//!guarded by _sharedMutex
+	struct Partial
+	{
+		Tensor<TENSOR_RESULT_TYPE(T,T)>	r;
+		std::vector<T>					A, B, C;
+	};
+	std::vector<Partial>		_partials;
+	Mutex						_sharedMutex;
+
+	//!Collects the coefficient tensors of the operands that have coefficients at key
+	void						gather			(const std::vector<dcT>& coeffs, const keyT& key, std::vector<int>& index, std::vector<tensorT>& c) const;
+
+	//!Adds the products of the coefficients at one node to partial p
+	void						accumulate		(Partial& p, const std::vector<int>& leftIndex, const std::vector<tensorT>& leftC,
+												 const std::vector<int>& rightIndex, const std::vector<tensorT>& rightC);
     };
 		
     // Constructor
@@ -122,136 +142,92 @@ namespace madness
 
 		this->_dInfoVec.push_back(DependencyInfo<T,NDIM>(output,true,false,false,false));
 
+		_partials.resize(ThreadPool::size()+1);
+
 		woT(f[0].world());
     }
 	
-    //
-    //	it should hangle both a parent and a leaf node.
-    //
     template <typename T, std::size_t NDIM>
-	FuseTContainer<T>
-	MatrixInnerOp<T,NDIM>::compute(const keyT& key, const FuseTContainer<T> &s)
+	void
+	MatrixInnerOp<T,NDIM>::gather(const std::vector<dcT>& coeffs, const keyT& key, std::vector<int>& index, std::vector<tensorT>& c) const
     {
-	//	std::cout<<__func__<<", key: "<<key<<std::endl;
-
-		FuseT_VType<T>* inheritedLeft;
-		FuseT_VType<T>*	inheritedRight;
-
-		inheritedLeft	= new FuseT_VType<T>;
-		inheritedRight	= new FuseT_VType<T>;
-
-		for (unsigned int i=0; i<_left.size(); i++) {
-			if(_left[i]->get_coeffs().probe(key)) {
-				inheritedLeft->value.push_back(i);
-			}
-		}
-
-		for (unsigned int i=0; i<_right.size(); i++) {
-			if(_right[i]->get_coeffs().probe(key))  {
-				inheritedRight->value.push_back(i);
-			}
+		for (unsigned int i=0; i<coeffs.size(); i++)
+		{
+			// local lookup only: the node is owned by this rank or absent
+			typename dcT::const_accessor acc;
+			if (!coeffs[i].find(acc, key) || !acc->second.has_coeff()) continue;
+
+			tensorT t = acc->second.coeff().full_tensor();
+			if (!t.iscontiguous()) t = copy(t);
+			index.push_back(i);
+			c.push_back(t);
 		}
+    }
 
-		if(inheritedLeft->value.empty())
+    //
+    //	The coefficients of all operands present at the node are packed as the
+    //	rows of one matrix per side and every pair is formed by a single gemm
+    //	(C = A B^T).
+    //
+    template <typename T, std::size_t NDIM>
+	void
+	MatrixInnerOp<T,NDIM>::accumulate(Partial& p, const std::vector<int>& leftIndex, const std::vector<tensorT>& leftC,
+									  const std::vector<int>& rightIndex, const std::vector<tensorT>& rightC)
+    {
+		if (p.r.size() == 0)
+			p.r = Tensor<TENSOR_RESULT_TYPE(T,T)>(_left.size(), _right.size());
+
+		const long leftSize		= leftIndex.size();
+		const long rightSize	= rightIndex.size();
+		const long n = leftC[0].size();
+		p.A.resize(leftSize*n);
+		p.B.resize(rightSize*n);
+		p.C.resize(leftSize*rightSize);
+		for (long i=0; i<leftSize; i++)
 		{
-			return FuseTContainer<T>();
+			MADNESS_ASSERT(leftC[i].size() == n);
+			std::copy(leftC[i].ptr(), leftC[i].ptr()+n, &p.A[i*n]);
 		}
-
-		if(inheritedRight->value.empty()) 
+		for (long j=0; j<rightSize; j++)
 		{
-			return FuseTContainer<T>();
+			MADNESS_ASSERT(rightC[j].size() == n);
+			std::copy(rightC[j].ptr(), rightC[j].ptr()+n, &p.B[j*n]);
 		}
 
+		// column-major view: A is n x leftSize, B is n x rightSize, C is leftSize x rightSize
+		const cblas::CBLAS_TRANSPOSE opA = TensorTypeData<T>::iscomplex ? cblas::ConjTrans : cblas::Trans;
+		cblas::gemm(opA, cblas::NoTrans, leftSize, rightSize, n, T(1), &p.A[0], n, &p.B[0], n, T(0), &p.C[0], leftSize);
 
-		unsigned int indexLeft;
-		unsigned int indexRight;
-		unsigned int leftSize	= inheritedLeft->value.size();
-		unsigned int rightSize	= inheritedRight->value.size();
-
-		// The Pre-Computatio
-		// Assumption: the size of coefficient --> 16*16*16 = 4096
-		double* A = (double*)malloc(sizeof(double)*16*16*16*leftSize);
-		double* B = (double*)malloc(sizeof(double)*16*16*16*rightSize);
-		double* C = (double*)malloc(sizeof(double)*leftSize*rightSize);
-		unsigned int k,l,m;
+		for (long j=0; j<rightSize; j++)
+			for (long i=0; i<leftSize; i++)
+				p.r(leftIndex[i], rightIndex[j]) += p.C[i + j*leftSize];
+    }
 
-		//
-	//
-		for (unsigned int i=0; i<leftSize; i++)
+    template <typename T, std::size_t NDIM>
+	FuseTContainer<T>
+	MatrixInnerOp<T,NDIM>::compute(const keyT& key, const FuseTContainer<T> &s)
+    {
+		std::vector<int>		leftIndex, rightIndex;
+		std::vector<tensorT>	leftC, rightC;
+
+		gather(_left_v_coeffs, key, leftIndex, leftC);
+		if (leftIndex.empty()) return FuseTContainer<T>();
+		gather(_right_v_coeffs, key, rightIndex, rightC);
+		if (rightIndex.empty()) return FuseTContainer<T>();
+
+		// pool threads own their partial; everybody else shares the last one
+		const ThreadBase* thread = ThreadBase::this_thread();
+		const int ind = thread ? thread->get_pool_thread_index() : -1;
+		if (ind >= 0 && ind+1 < int(_partials.size()))
 		{
-			indexLeft = inheritedLeft->value[i];
-			const KNODE& fnode = _left_v_coeffs[indexLeft].find(key).get()->second;
-
-
-			// 3D array to 1D array with i for fnode and j for gnode
-				if (fnode.has_coeff())
-			{
-				for (k=0; k<16; k++) 
-					for (l=0; l<16; l++) 
-						for (m=0; m<16; m++) 
-							A[i*16*16*16 + k*16*16 + l*16 + m] = (fnode.coeff())(k,l,m);	
-			}
-			else
-			{
-				for (k=0; k<16; k++) 
-					for (l=0; l<16; l++) 
-						for (m=0; m<16; m++) 
-							A[i*16*16*16 + k*16*16 + l*16 + m] = 0.0;
-							}
+			accumulate(_partials[ind], leftIndex, leftC, rightIndex, rightC);
 		}
-
-
-		//
-		for (unsigned int i=0; i<rightSize; i++)
+		else
 		{
-			indexRight = inheritedRight->value[i];
-			const KNODE& gnode = _right_v_coeffs[indexRight].find(key).get()->second;
-
-
-			// 3D array to 1D array with i for fnode and j for gnode
-				if (gnode.has_coeff())
-			{
-				for (k=0; k<16; k++) 
-					for (l=0; l<16; l++) 
-						for (m=0; m<16; m++) 
-							B[i*16*16*16 + k*16*16 + l*16 + m] = (gnode.coeff())(k,l,m);	
-			}
-			else
-			{
-				for (k=0; k<16; k++) 
-					for (l=0; l<16; l++) 
-						for (m=0; m<16; m++) 
-							B[i*16*16*16 + k*16*16 + l*16 + m] = 0.0;
-							}
-		}
-
-		// 
-		for (k=0; k<leftSize; k++)
-			for (l=0; l<rightSize; l++)
-				C[k*rightSize + l] = 0.0;
-
-		//
-		//
-		//
-		cblas::gemm(cblas::CBLAS_TRANSPOSE::Trans, cblas::CBLAS_TRANSPOSE::NoTrans, leftSize, rightSize, 16*16*16, 1, A, 16*16*16, B, 16*16*16, 1, C, leftSize);
-
-
-		// The Post-Computation
-		for (k=0; k<leftSize; k++)
-		{	
-			indexLeft = inheritedLeft->value[k];	
-			for (l=0; l<rightSize; l++)
-			{
-				indexRight = inheritedRight->value[l];
-				(*this->_r)(indexLeft, indexRight) += C[k + l*leftSize];	// k*rightSize + l --> row-major
-			}
+			ScopedMutex<Mutex> obolus(_sharedMutex);
+			accumulate(_partials.back(), leftIndex, leftC, rightIndex, rightC);
 		}
 
-		delete A;
-		delete B;
-		delete C;
-
-
 		return FuseTContainer<T>();
 	}
 
@@ -265,12 +241,14 @@ namespace madness
 
 
 	    for (unsigned int i=0; i<_left.size(); i++) {
-		if(_left[i]->get_coeffs().probe(key))
-		    isE1 = isE1 || _left_v_coeffs[i].find(key).get()->second.has_children();
+		typename dcT::const_accessor acc;
+		if(_left_v_coeffs[i].find(acc, key))
+		    isE1 = isE1 || acc->second.has_children();
 	    }
 	    for (unsigned int i=0; i<_right.size(); i++) {
-		if(_right[i]->get_coeffs().probe(key))
-		    isE2 = isE2 || _right_v_coeffs[i].find(key).get()->second.has_children();
+		typename dcT::const_accessor acc;
+		if(_right_v_coeffs[i].find(acc, key))
+		    isE2 = isE2 || acc->second.has_children();
 	    }
 	    
 	    return !(isE1 && isE2);
@@ -280,6 +258,11 @@ namespace madness
 	template<typename T, std::size_t NDIM>
 	void  
 	MatrixInnerOp<T,NDIM>::reduce(World& world){
+		for (unsigned int i=0; i<_partials.size(); i++)
+		{
+			if (_partials[i].r.size()) *_r += _partials[i].r;
+			_partials[i] = Partial();
+		}
 		world.gop.sum(_r->ptr(),_left.size()*_right.size());
 	}
 
@@ -81,8 +81,6 @@ namespace madness
 	    }else if (s.what() == WHAT_AM_I::FuseT_VCoeffT) {
 		parameter = ((FuseT_VCoeffT<T>*)s.get())->value;
 		
-		delete (s.data);
-		
 		//printf ("target: %p vs. parameter: %p\n", &parameter, &(((FuseT_VCoeffT<T>*)s.get())->value));
 
 	    }else{
@@ -154,11 +152,11 @@ namespace madness
 		if (rc.size())
 		    tvec->value[1] = copy(rss(child_patch(child)));
 		
-		FuseTContainer<T> wrapper(static_cast<Base<T>*>(tvec));
+		FuseTContainer<T> wrapper(tvec);
 		v_parameter->value.push_back(wrapper);
 
 	    }
-	    FuseTContainer<T> temp(static_cast<Base<T>*>(v_parameter));
+	    FuseTContainer<T> temp(v_parameter);
 	    return temp;
 
 
@@ -25,8 +25,15 @@ namespace madness
 		OpExecutor(World& world)
 		: woT(world)
 		,_world(world)
+		,_inlineLevel(-1)
 		{ woT::process_pending(); }
 
+		//!Task coarsening: from level n down, a leaf child owned by this rank
+		//!is visited by a direct call instead of a task, unless the thread
+		//!pool is running short of work. A negative n (the default) spawns a
+		//!task for every node.
+		void						set_inline_level(int n) { _inlineLevel = n; }
+
 		Future<FuseTContainer<T>>	traverseTree	(const keyT key, const FuseTContainer<T> &s);
 		FuseTContainer<T>			PostCompute		(const keyT key, const std::vector<Future<FuseTContainer<T>>> &v);
 		void						execute			(PrimitiveOp<T,NDIM>* pOp, bool isBlocking);
@@ -38,7 +45,30 @@ namespace madness
 		PrimitiveOp<T,NDIM>*	_pOp;
 		dcT*					coeffs;
 		Function<T,NDIM>*		_result;
+		int						_inlineLevel;
+
+		bool						inlineChildren	(const keyT& key) const;
+		bool						runInline		(const keyT& child) const;
     };
+
+	// True if the children of key may be visited inline. Decided once per
+	// node, so the queue length is sampled only once.
+	template<typename T, std::size_t NDIM>
+	bool
+	OpExecutor<T,NDIM>::inlineChildren(const keyT& key) const
+	{
+		return _inlineLevel >= 0 && key.level() + 1 >= Level(_inlineLevel)
+			&& ThreadPool::queue_size() >= ThreadPool::size();
+	}
+
+	// True if the child is leaf-level work on this rank: its subtree is the
+	// child alone, so a direct call never recurses into remote nodes
+	template<typename T, std::size_t NDIM>
+	bool
+	OpExecutor<T,NDIM>::runInline(const keyT& child) const
+	{
+		return coeffs->owner(child) == _world.rank() && _pOp->isDone(child);
+	}
 	
 	//
 	template<typename T, std::size_t NDIM>
@@ -57,26 +87,39 @@ namespace madness
 		{
 			if (!_pOp->isPre() && _pOp->needsParameter())
 				v = future_vector_factory<FuseTContainer<T> >(1<<NDIM);		
+			const bool inl = inlineChildren(key);
 			int i = 0;
 			for (KeyChildIterator<NDIM> kit(key); kit; ++kit, ++i)
 			{
 				const keyT& child = kit.key();
 				
-				if (_pOp->needsParameter())
+				const FuseTContainer<T>& para = (_pOp->needsParameter() && _pOp->isPre()) ?
+					((FuseT_VParameter<T>*)(temp.get()))->value[i] : temp;
+
+				if (inl && runInline(child))
 				{
-					if (_pOp->isPre())
-						woT::task(coeffs->owner(child), &OpExecutor<T,NDIM>::traverseTree, child, ((FuseT_VParameter<T>*)(temp.get()))->value[i]);	
+					if (!v.empty())
+						v[i] = traverseTree(child, para);
 					else
-						v[i] = woT::task(coeffs->owner(child), &OpExecutor<T,NDIM>::traverseTree, child, temp);
+						traverseTree(child, para);
 				}
-				else 
-					woT::task(coeffs->owner(child), &OpExecutor<T,NDIM>::traverseTree, child, temp);
+				else if (!v.empty())
+					v[i] = woT::task(coeffs->owner(child), &OpExecutor<T,NDIM>::traverseTree, child, para);
+				else
+					woT::task(coeffs->owner(child), &OpExecutor<T,NDIM>::traverseTree, child, para);
 			}
 		}
 
 		// Post-Computation
 		if (!_pOp->isPre())
 		{
+			// children visited inline may already have delivered their results
+			bool ready = true;
+			for (unsigned int i=0; i<v.size() && ready; ++i)
+				ready = v[i].probe();
+			if (ready && _inlineLevel >= 0 && key.level() >= Level(_inlineLevel))
+				return Future<FuseTContainer<T>>(PostCompute(key, v));
+
 			Future<FuseTContainer<T>> returnVal = woT::task(_world.rank(), &OpExecutor<T,NDIM>::PostCompute, key, v);
 
 			if (!v.empty())
@@ -101,7 +144,7 @@ namespace madness
 	    vector<FuseTContainer <T> > temp;
 	    for(auto a: v)
 		temp.push_back(a.get());
-	    return _pOp->compute(key, FuseTContainer<T>(static_cast<Base<T>*>(new FuseT_VParameter<T>(temp))));
+	    return _pOp->compute(key, FuseTContainer<T>(new FuseT_VParameter<T>(temp)));
 	}
 
 
@@ -128,10 +171,10 @@ namespace madness
 			{
 				const keyT& child = kit.key();
 				
-				if (_pOp->needsParameter())
-				    woT::task(coeffs->owner(child), &OpExecutor<T,NDIM>::traverseTreeFuture, child, ((FuseT_VParameter<T>*)(temp.get()))->value[i],false);
-				else
-				    woT::task(coeffs->owner(child), &OpExecutor<T,NDIM>::traverseTreeFuture, child, temp,false);
+				const FuseTContainer<T>& para = _pOp->needsParameter() ?
+					((FuseT_VParameter<T>*)(temp.get()))->value[i] : temp;
+
+				woT::task(coeffs->owner(child), &OpExecutor<T,NDIM>::traverseTreeFuture, child, para, false);
 			}
 		}
 
@@ -70,6 +70,10 @@ namespace madness
 	virtual void reduce(World& world) = 0;
 	virtual bool returnsFuture(){ return false;}
 
+	//!estimated flops spent at one node for wavelet order k. Used by the FuseT
+	//!fusion planner; the default is a pointwise operation on the coefficients
+	virtual double costPerNode(int k) const { return std::pow(double(k), double(NDIM)); }
+
 	//!used for postCompute ops to see if it needs to be pushed to the compute stack or not
 	virtual bool notEmpty(map<int,bool>& notEmptyMap) const{return true;}
 	void setComplete(bool isComplete) { _isComplete=isComplete; }
@@ -31,6 +31,8 @@ namespace madness
 		bool				isPre			() const { return true; }
 		bool				needsParameter	() const { return true; }
         void reduce(World& world){}
+		// unfilter of the (2k)^NDIM block, one matrix product per dimension
+		double				costPerNode		(int k) const { return 2.0*NDIM*std::pow(2.0*k, NDIM+1.0); }
 	public:
 		std::vector<Slice>			child_patch		(const keyT& child) const;
 
@@ -77,7 +79,6 @@ namespace madness
 			if (s.what() == WHAT_AM_I::FuseT_CoeffT) 
 			{
 				s_coeff->value = (((FuseT_CoeffT<T>*)s.get())->value).full_tensor_copy();
-				delete s.data;
 			}
 			else
 			{
@@ -143,12 +144,12 @@ namespace madness
 					ss.reduce_rank(_i1->thresh());
 					s_coeff_s.value = ss;
 
-					FuseTContainer<T> wrapper(static_cast<Base<T>*>(new FuseT_CoeffT<T>(s_coeff_s.value)));
+					FuseTContainer<T> wrapper(new FuseT_CoeffT<T>(s_coeff_s.value));
 					v_parameter.value.push_back(wrapper);
 				}
 
 				//	Wrapping ReconstructV<T> to FuseTContainer<T>
-				FuseTContainer<T> temp(static_cast<Base<T>*>(new FuseT_VParameter<T>(v_parameter.value)));
+				FuseTContainer<T> temp(new FuseT_VParameter<T>(v_parameter.value));
 				return temp;
 			}
 			else
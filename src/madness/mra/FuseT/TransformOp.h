@@ -269,19 +269,19 @@ namespace madness
 		FuseT_VParameter<T> v_parameter;
 		FuseT_VParameter<T> inner_parameter;
 	
-		FuseTContainer<T>	candiParameter_L(static_cast<Base<T>*> (new FuseT_VType<T>(whichNodesLeft.value)));	
-		FuseTContainer<T>	candiParameter_R(static_cast<Base<T>*> (new FuseT_VType<T>(whichNodesRight.value)));	
+		FuseTContainer<T>	candiParameter_L(new FuseT_VType<T>(whichNodesLeft.value));	
+		FuseTContainer<T>	candiParameter_R(new FuseT_VType<T>(whichNodesRight.value));	
 		inner_parameter.value.push_back(candiParameter_L);
 		inner_parameter.value.push_back(candiParameter_R);
 
 		for (KeyChildIterator<NDIM> kit(key); kit; ++kit)
 		{
-			FuseTContainer<T> wrapper(static_cast<Base<T>*>(new FuseT_VParameter<T>(inner_parameter.value)));
+			FuseTContainer<T> wrapper(new FuseT_VParameter<T>(inner_parameter.value));
 			v_parameter.value.push_back(wrapper);
 		}
 
 		// Return Parameters
-		FuseTContainer<T> targets(static_cast<Base<T>*>(new FuseT_VParameter<T>(v_parameter.value)));
+		FuseTContainer<T> targets(new FuseT_VParameter<T>(v_parameter.value));
 		return targets;
 */
 	}
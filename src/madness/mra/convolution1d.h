@@ -37,6 +37,7 @@
 #include <limits.h>
 #include <madness/tensor/tensor.h>
 #include <madness/mra/simplecache.h>
+#include <madness/mra/convolution1d_cache.h>
 #include <madness/mra/adquad.h>
 #include <madness/mra/twoscale.h>
 #include <madness/tensor/mtxmq.h>
@@ -160,12 +161,17 @@ namespace madness {
         double N_up, N_diff, N_F;               ///< the norms according to Beylkin 2008, Eq. (21) ff
 
 
+        /// empty data, to be filled by serialize
+        ConvolutionData1D() : Rnorm(0.0), Tnorm(0.0), Rnormf(0.0), Tnormf(0.0), NSnormf(0.0),
+                              N_up(0.0), N_diff(0.0), N_F(0.0) {}
+
         /// ctor for NS form
         /// make the operator matrices r^n and \uparrow r^(n-1)
         /// @param[in]  R   operator matrix of the requested level;     NS: unfilter(r^(n+1)); modified NS: r^n
         /// @param[in]  T   upsampled operator matrix from level n-1;   NS: r^n; modified NS: filter( r^(n-1) )
         ConvolutionData1D(const Tensor<Q>& R, const Tensor<Q>& T) : R(R), T(T) {
             Rnormf = R.normf();
+            N_F = N_up = N_diff = 0.0;
             // Making the approximations is expensive ... only do it for
             // significant components
             if (Rnormf > 1e-20) {
@@ -211,6 +217,12 @@ namespace madness {
 
 
 
+        template <typename Archive>
+        void serialize(const Archive& ar) {
+            ar & R & T & RU & RVT & TU & TVT & Rs & Ts
+               & Rnorm & Tnorm & Rnormf & Tnormf & NSnormf & N_up & N_diff & N_F;
+        }
+
         /// approximate the operator matrices using SVD, and abuse Rs to hold the error instead of
         /// the singular values (seriously, who named this??)
         void make_approx(const Tensor<Q>& R,
@@ -287,6 +299,17 @@ namespace madness {
         /// Compute the projection of the operator onto the double order polynomials
         virtual Tensor<Q> rnlp(Level n, Translation lx) const = 0;
 
+        /// The parameters of the kernel, stored with each block in the Convolution1DDiskCache ... empty if it is not to be cached
+        virtual std::vector<double> disk_cache_params() const {return std::vector<double>();}
+
+        /// Identifies the kernel in the Convolution1DDiskCache ... zero if it is not to be cached
+        virtual hashT disk_cache_id() const {
+            const std::vector<double> params=disk_cache_params();
+            if (params.empty()) return 0;
+            const hashT id=hash_range(params.begin(), params.end());
+            return id ? id : 1;
+        }
+
         /// Returns true if the block of rnlp is expected to be small
         virtual bool issmall(Level n, Translation lx) const = 0;
 
@@ -415,6 +438,12 @@ namespace madness {
 
             // PROFILE_MEMBER_FUNC(Convolution1D); // Too fine grain for routine profiling
 
+            ConvolutionData1D<Q> cached;
+            if (Convolution1DDiskCache::load(disk_cache_id(), disk_cache_params(), Convolution1DDiskCache::NS, n, lx, cached)) {
+                ns_cache.set(n,lx,cached);
+                return ns_cache.getptr(n,lx);
+            }
+
             Tensor<Q> R, T;
             if (!get_issmall(n, lx)) {
                 Translation lx2 = lx*2;
@@ -468,6 +497,7 @@ namespace madness {
             }
 
             ns_cache.set(n,lx,ConvolutionData1D<Q>(R,T));
+            if (R.size()) Convolution1DDiskCache::store(disk_cache_id(), disk_cache_params(), Convolution1DDiskCache::NS, n, lx, *ns_cache.getptr(n,lx));
 
             return ns_cache.getptr(n,lx);
         };
@@ -493,6 +523,9 @@ namespace madness {
             if (get_issmall(n, lx)) {
                 r = Tensor<Q>(twok);
             }
+            else if (Convolution1DDiskCache::load(disk_cache_id(), disk_cache_params(), Convolution1DDiskCache::RNLP, n, lx, r)) {
+                // computed by an earlier run
+            }
             else if (n < natural_level()) {
                 Tensor<Q>  R(2*twok);
                 R(Slice(0,twok-1)) = get_rnlp(n+1,2*lx);
@@ -500,6 +533,7 @@ namespace madness {
 
                 R = transform(R, hgT2k);
                 r = copy(R(Slice(0,twok-1)));
+                Convolution1DDiskCache::store(disk_cache_id(), disk_cache_params(), Convolution1DDiskCache::RNLP, n, lx, r);
             }
             else {
                 // PROFILE_BLOCK(Convolution1Drnlp); // Too fine grain for routine profiling
@@ -514,6 +548,7 @@ namespace madness {
                 else {
                     r = rnlp(n, lx);
                 }
+                Convolution1DDiskCache::store(disk_cache_id(), disk_cache_params(), Convolution1DDiskCache::RNLP, n, lx, r);
             }
 
             rnlp_cache.set(n, lx, r);
@@ -706,6 +741,12 @@ namespace madness {
             return natlev;
         }
 
+        /// The parameters of the kernel coeff*exp(-expnt*x^2)*x^m for the Convolution1DDiskCache
+        virtual std::vector<double> disk_cache_params() const {
+            return std::vector<double>{expnt, std::real(coeff), std::imag(coeff), double(this->k), double(m),
+                                       double(Convolution1D<Q>::maxR), this->arg, double(sizeof(Q))};
+        }
+
         /// Compute the projection of the operator onto the double order polynomials
 
         /// The returned reference is to a cached tensor ... if you want to
@@ -833,30 +874,26 @@ namespace madness {
 
     template <typename Q>
     struct GaussianConvolution1DCache {
-        static ConcurrentHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > > map;
-        typedef typename ConcurrentHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > >::iterator iterator;
-        typedef typename ConcurrentHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > >::datumT datumT;
+        typedef WriteOnceHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > > mapT;
+        static mapT map;
 
         static std::shared_ptr< GaussianConvolution1D<Q> > get(int k, double expnt, int m, bool periodic) {
             hashT key = hash_value(expnt);
             hash_combine(key, k);
             hash_combine(key, m);
             hash_combine(key, int(periodic));
-            iterator it = map.find(key);
-            if (it == map.end()) {
-                map.insert(datumT(key, std::shared_ptr< GaussianConvolution1D<Q> >(new GaussianConvolution1D<Q>(k,
-                                                                                                          Q(sqrt(expnt/constants::pi)),
-                                                                                                          expnt,
-                                                                                                          m,
-                                                                                                          periodic
-                                                                                                          ))));
-                it = map.find(key);
-                //printf("conv1d: making  %d %.8e\n",k,expnt);
-            }
-            else {
+            const std::shared_ptr< GaussianConvolution1D<Q> >* p = map.find(key);
+            if (p) {
                 //printf("conv1d: reusing %d %.8e\n",k,expnt);
+                return *p;
             }
-            return it->second;
+            //printf("conv1d: making  %d %.8e\n",k,expnt);
+            return map.insert(key, std::shared_ptr< GaussianConvolution1D<Q> >(new GaussianConvolution1D<Q>(k,
+                                                                                                       Q(sqrt(expnt/constants::pi)),
+                                                                                                       expnt,
+                                                                                                       m,
+                                                                                                       periodic
+                                                                                                       )));
         }
     };
 }
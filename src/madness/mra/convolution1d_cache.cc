@@ -0,0 +1,286 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+
+/// \file mra/convolution1d_cache.cc
+
+#include <madness/mra/convolution1d_cache.h>
+#include <madness/world/worldmutex.h>
+#include <madness/world/print.h>
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace madness {
+
+    namespace {
+
+        /// bump format_version when the layout of the file changes
+        const char magic[8] = {'M','A','D','C','1','D','\0','\0'};
+        const uint32_t format_version = 2;
+        const uint32_t operator_version = Convolution1DDiskCache::operator_version;
+
+        struct headerT {
+            char magic[8];
+            uint32_t format_version;
+            uint32_t operator_version;
+            uint32_t endian;        // 0x01020304 as written
+            uint32_t pad;
+        };
+
+        struct recordT {
+            uint64_t id;
+            int64_t lx;
+            int32_t kind;
+            int32_t n;
+            uint64_t nbyte;         // payload size, the payload is padded to 8 bytes
+        };
+
+        struct recordkeyT {
+            hashT id;
+            Translation lx;
+            int kind;
+            Level n;
+
+            bool operator==(const recordkeyT& other) const {
+                return id==other.id and lx==other.lx and kind==other.kind and n==other.n;
+            }
+        };
+
+        struct recordhashT {
+            std::size_t operator()(const recordkeyT& key) const {
+                hashT h=key.id;
+                hash_combine(h, key.lx);
+                hash_combine(h, key.kind);
+                hash_combine(h, key.n);
+                return h;
+            }
+        };
+
+        typedef std::unordered_map< recordkeyT, std::pair<std::size_t,std::size_t>, recordhashT > indexT;
+
+        int fd=-1;                          ///< the cache file
+        bool writable=false;
+        const unsigned char* map=0;         ///< the file mapped at open
+        std::size_t mapsize=0;
+        indexT index;                       ///< records in the mapping, read only after open
+        std::unordered_set<recordkeyT, recordhashT> written;   ///< records appended since open
+        std::size_t scanned=0;              ///< end of the records seen by this process
+        Mutex mutex;                        ///< serializes appends by the threads of this process
+        std::atomic<long> nhit(0), nmiss(0), nstale(0), nstore(0);
+
+        std::size_t padded(std::size_t nbyte) {return (nbyte+7) & ~std::size_t(7);}
+
+        /// call f(key,offset,nbyte) for the complete records in data[begin,end), return the end of the last one
+        template <typename callbackT>
+        std::size_t scan(const unsigned char* data, std::size_t begin, std::size_t end, callbackT f) {
+            std::size_t off=begin;
+            while (off+sizeof(recordT) <= end) {
+                recordT rec;
+                memcpy(&rec, data+off, sizeof(rec));
+                const std::size_t next=off+sizeof(rec)+padded(rec.nbyte);
+                if (rec.nbyte>end or next>end) break;
+                f(recordkeyT{rec.id, Translation(rec.lx), rec.kind, Level(rec.n)}, off+sizeof(rec), rec.nbyte);
+                off=next;
+            }
+            return off;
+        }
+
+        bool write_all(int fd, const void* data, std::size_t nbyte) {
+            const char* p=static_cast<const char*>(data);
+            while (nbyte) {
+                ssize_t n=::write(fd, p, nbyte);
+                if (n<=0) return false;
+                p+=n;
+                nbyte-=n;
+            }
+            return true;
+        }
+    }
+
+
+    bool Convolution1DDiskCache::open(const std::string& filename) {
+        close();
+
+        writable=true;
+        fd=::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd<0) {
+            writable=false;
+            fd=::open(filename.c_str(), O_RDONLY);
+        }
+        if (fd<0) {
+            print("Convolution1DDiskCache: cannot open",filename);
+            return false;
+        }
+
+        headerT header;
+        memcpy(header.magic, magic, sizeof(magic));
+        header.format_version=format_version;
+        header.operator_version=operator_version;
+        header.endian=0x01020304;
+        header.pad=0;
+
+        // the first process writes the header, a writer also cuts off a truncated record
+        flock(fd, writable ? LOCK_EX : LOCK_SH);
+        struct stat st;
+        fstat(fd, &st);
+        std::size_t size=st.st_size;
+        if (size==0 and writable) {
+            write_all(fd, &header, sizeof(header));
+            size=sizeof(header);
+        }
+
+        bool ok=(size>=sizeof(header));
+        if (ok) {
+            map=static_cast<const unsigned char*>(mmap(0, size, PROT_READ, MAP_SHARED, fd, 0));
+            if (map==MAP_FAILED) {
+                map=0;
+                ok=false;
+            }
+        }
+        if (ok) {
+            mapsize=size;
+            ok=(memcmp(map, &header, sizeof(header))==0);
+        }
+        if (ok) {
+            scanned=scan(map, sizeof(header), mapsize,
+                         [](const recordkeyT& key, std::size_t off, std::size_t nbyte) {
+                             index.insert(std::make_pair(key, std::make_pair(off,nbyte)));
+                         });
+            if (writable and scanned<mapsize) {
+                if (ftruncate(fd, scanned)) writable=false;
+            }
+        }
+        flock(fd, LOCK_UN);
+
+        if (not ok) {
+            print("Convolution1DDiskCache: ignoring",filename,"... not a cache file of this version");
+            close();
+            return false;
+        }
+        return true;
+    }
+
+
+    void Convolution1DDiskCache::close() {
+        if (map) munmap(const_cast<unsigned char*>(map), mapsize);
+        if (fd>=0) ::close(fd);
+        fd=-1;
+        map=0;
+        mapsize=0;
+        scanned=0;
+        writable=false;
+        index.clear();
+        written.clear();
+    }
+
+
+    bool Convolution1DDiskCache::is_open() {
+        return map!=0;
+    }
+
+
+    Convolution1DDiskCache::statsT Convolution1DDiskCache::stats() {
+        statsT s;
+        s.nhit=nhit;
+        s.nmiss=nmiss;
+        s.nstale=nstale;
+        s.nstore=nstore;
+        return s;
+    }
+
+
+    void Convolution1DDiskCache::tally(outcomeT outcome) {
+        if (outcome==HIT) nhit++;
+        else if (outcome==MISS) nmiss++;
+        else nstale++;
+    }
+
+
+    const void* Convolution1DDiskCache::find(hashT id, kindT kind, Level n, Translation lx, std::size_t& nbyte) {
+        indexT::const_iterator it=index.find(recordkeyT{id, lx, int(kind), n});
+        if (it==index.end()) return 0;
+        nbyte=it->second.second;
+        return map+it->second.first;
+    }
+
+
+    void Convolution1DDiskCache::append(hashT id, kindT kind, Level n, Translation lx,
+                                        const void* data, std::size_t nbyte) {
+        if (not writable) return;
+        const recordkeyT key{id, lx, int(kind), n};
+        ScopedMutex<Mutex> hold(mutex);
+        if (index.count(key) or written.count(key)) return;
+
+        flock(fd, LOCK_EX);
+
+        // pick up the records other processes appended since we last looked
+        struct stat st;
+        fstat(fd, &st);
+        const std::size_t size=st.st_size;
+        if (size>scanned) {
+            std::vector<unsigned char> tail(size-scanned);
+            if (pread(fd, tail.data(), tail.size(), scanned)==ssize_t(tail.size())) {
+                scanned+=scan(tail.data(), 0, tail.size(),
+                              [](const recordkeyT& k, std::size_t, std::size_t) {written.insert(k);});
+            }
+        }
+
+        if (not written.count(key)) {
+            recordT rec;
+            rec.id=id;
+            rec.lx=lx;
+            rec.kind=kind;
+            rec.n=n;
+            rec.nbyte=nbyte;
+            std::vector<unsigned char> buf(sizeof(rec)+padded(nbyte), 0);
+            memcpy(buf.data(), &rec, sizeof(rec));
+            memcpy(buf.data()+sizeof(rec), data, nbyte);
+            if (write_all(fd, buf.data(), buf.size())) {
+                scanned+=buf.size();
+                written.insert(key);
+                nstore++;
+            }
+            else {
+                writable=false;
+            }
+        }
+
+        flock(fd, LOCK_UN);
+    }
+
+}
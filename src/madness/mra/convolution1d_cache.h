@@ -0,0 +1,148 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_MRA_CONVOLUTION1D_CACHE_H__INCLUDED
+#define MADNESS_MRA_CONVOLUTION1D_CACHE_H__INCLUDED
+
+#include <madness/world/worldhash.h>
+#include <madness/world/buffer_archive.h>
+#include <madness/mra/key.h>
+#include <string>
+#include <vector>
+
+/// \file mra/convolution1d_cache.h
+/// \brief Persistent file cache of the matrix elements of 1D convolutions
+
+namespace madness {
+
+    /// Persistent cache of 1D operator blocks in a memory-mapped file
+
+    /// Computing the blocks of a Convolution1D (rnlp by quadrature, the NS form with
+    /// its SVDs) is a noticeable part of the startup of short runs.  Once a cache
+    /// file is opened (open(), or MAD_OPERATOR_CACHE=<file> in the environment when
+    /// calling startup()) Convolution1D looks blocks up in the file before computing
+    /// them and appends the ones it had to compute.  The file is mapped read-only and
+    /// shared, so the ranks on a node share one copy in the page cache.  Blocks
+    /// appended during a run are seen by processes that open the file later.
+    ///
+    /// The file holds a header (magic, format version, version of the operator code)
+    /// followed by records of a fixed descriptor and a payload written with a
+    /// BufferOutputArchive.  Records are keyed by an id of the kernel (see
+    /// Convolution1D::disk_cache_id, zero means not cached), the kind of block, the
+    /// level and the translation.  The payload starts with operator_version and the
+    /// parameters of the kernel (see Convolution1D::disk_cache_params), which load()
+    /// compares before it uses the block, so a colliding id or a block computed by
+    /// other code is computed again instead of being used.  Writers append whole records with one write while
+    /// holding an flock on the file and skip records another process has appended
+    /// in the meantime; a truncated record at the end is cut off when the file is
+    /// opened for writing.
+    ///
+    /// Lookups read an index that is built when the file is opened and not changed
+    /// afterwards, so they take no locks.  open() and close() must be called while no
+    /// other thread uses the cache.
+    class Convolution1DDiskCache {
+    public:
+        /// kinds of cached blocks
+        enum kindT {RNLP=1, NS=2};
+
+        /// bump when the computed blocks change, older records are then not used
+        static const unsigned int operator_version = 1;
+
+        /// counters of the current process
+        struct statsT {
+            long nhit;      ///< blocks found in the file
+            long nmiss;     ///< blocks looked up but not found
+            long nstale;    ///< blocks found with other parameters or an older operator_version
+            long nstore;    ///< blocks appended to the file
+        };
+
+        /// open (or create) a cache file, returns false if it is not usable
+
+        /// A file that cannot be opened for writing is used read-only.
+        static bool open(const std::string& filename);
+
+        /// unmap and close the cache file
+        static void close();
+
+        /// true if a cache file is open
+        static bool is_open();
+
+        static statsT stats();
+
+        /// look up a block and deserialize it into value, returns false if absent
+
+        /// A block stored with other parameters or by another operator_version
+        /// is treated as absent.
+        template <typename T>
+        static bool load(hashT id, const std::vector<double>& params, kindT kind, Level n, Translation lx, T& value) {
+            if (not id or not is_open()) return false;
+            std::size_t nbyte=0;
+            const void* p=find(id, kind, n, lx, nbyte);
+            if (not p) {
+                tally(MISS);
+                return false;
+            }
+            archive::BufferInputArchive ar(p, nbyte);
+            unsigned int version=0;
+            std::vector<double> stored;
+            ar & version & stored;
+            if (version!=operator_version or stored!=params) {
+                tally(STALE);
+                return false;
+            }
+            ar & value;
+            tally(HIT);
+            return true;
+        }
+
+        /// append a block unless it is already in the file
+        template <typename T>
+        static void store(hashT id, const std::vector<double>& params, kindT kind, Level n, Translation lx, const T& value) {
+            if (not id or not is_open()) return;
+            const unsigned int version=operator_version;
+            archive::BufferOutputArchive count;
+            count & version & params & value;
+            std::vector<unsigned char> buf(count.size());
+            archive::BufferOutputArchive ar(buf.data(), buf.size());
+            ar & version & params & value;
+            append(id, kind, n, lx, buf.data(), buf.size());
+        }
+
+    private:
+        enum outcomeT {HIT, MISS, STALE};
+        static void tally(outcomeT outcome);
+        static const void* find(hashT id, kindT kind, Level n, Translation lx, std::size_t& nbyte);
+        static void append(hashT id, kindT kind, Level n, Translation lx, const void* data, std::size_t nbyte);
+    };
+
+}
+
+#endif // MADNESS_MRA_CONVOLUTION1D_CACHE_H__INCLUDED
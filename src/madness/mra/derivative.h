@@ -33,6 +33,8 @@
 #define MADNESS_DERIVATIVE_H__INCLUDED
 
 #include <iostream>
+#include <map>
+#include <vector>
 #include <madness/world/MADworld.h>
 #include <madness/world/worlddc.h>
 #include <madness/world/print.h>
@@ -59,6 +61,9 @@ namespace madness {
 
     template<typename T, std::size_t NDIM>
 	class DerivativeOp;
+
+    template<typename T, std::size_t NDIM>
+    class DerivativeHalo;
 }
 
 
@@ -90,6 +95,27 @@ namespace madness {
         typedef WorldContainer<Key<NDIM> , FunctionNode<T, NDIM> > dcT;
         typedef FunctionNode<T,NDIM> nodeT;
 
+        /// A node with all neighbors at hand, ready for do_diff2i/do_diff2b
+        struct diff2T {
+            keyT key;
+            argT left, center, right;
+
+            diff2T() {}
+
+            diff2T(const keyT& key, const argT& left, const argT& center, const argT& right)
+                : key(key), left(left), center(center), right(right) {}
+
+            template <typename Archive> void serialize(const Archive& ar) {
+                ar & key & left & center & right;
+            }
+        };
+
+        /// Number of nodes differentiated by one task in the halo-based diff
+        static const std::size_t diff2_batch_size = 32;
+
+        /// The interior nodes of several functions sharing a key, with their neighbors
+        typedef std::vector< std::pair<std::size_t,diff2T> > stackT;
+
 
         DerivativeBase(World& world, std::size_t axis, int k, BoundaryConditions<NDIM> bc)
             : WorldObject< DerivativeBase<T, NDIM> >(world)
@@ -105,6 +131,9 @@ namespace madness {
 
         virtual ~DerivativeBase() { }
 
+        /// The boundary conditions of this operator
+        const BoundaryConditions<NDIM>& get_bc() const { return bc; }
+
 
 
         void forward_do_diff1(const implT* f, implT* df, const keyT& key,
@@ -171,6 +200,93 @@ namespace madness {
             }
         }
 
+        /// Like do_diff1, but takes missing neighbors from \c halo
+
+        /// Nodes whose neighbors are all found are appended to \c work
+        /// for do_diff2_batch instead of being spawned one task each.  Nodes
+        /// that are not local, or whose neighbors are not in the halo, go
+        /// through forward_do_diff1 as before.
+        void do_diff1_halo(const implT* f, implT* df, const keyT& key,
+                           const argT& left,
+                           const argT& center,
+                           const argT& right,
+                           const DerivativeHalo<T,NDIM>& halo,
+                           std::vector<diff2T>& work) const {
+            if (f->get_coeffs().owner(key) != world.rank()) {
+                forward_do_diff1(f, df, key, left, center, right);
+                return;
+            }
+
+            argT l = left, r = right;
+            if ((!l.second.has_data() && !find_in_halo(f, halo, key, -1, l)) ||
+                (!r.second.has_data() && !find_in_halo(f, halo, key, 1, r))) {
+                forward_do_diff1(f, df, key, l, center, r);
+            }
+            else if ((!l.second.has_data()) || (!r.second.has_data())) {
+                // One of the neighbors is below us in the tree ... recur down
+                df->get_coeffs().replace(key,nodeT(coeffT(),true));
+                for (KeyChildIterator<NDIM> kit(key); kit; ++kit) {
+                    const keyT& child = kit.key();
+                    if ((child.translation()[axis]&1) == 0) {
+                        do_diff1_halo(f, df, child, l, center, center, halo, work);
+                    }
+                    else {
+                        do_diff1_halo(f, df, child, center, center, r, halo, work);
+                    }
+                }
+            }
+            else {
+                work.push_back(diff2T(key, l, center, r));
+            }
+        }
+
+        /// Differentiate a batch of nodes whose neighbors are known
+        void do_diff2_batch(const implT* f, implT* df, const std::vector<diff2T>& work) const {
+            for (std::size_t i=0; i<work.size(); ++i) {
+                const diff2T& w = work[i];
+                if (w.left.first.is_invalid() || w.right.first.is_invalid()) {
+                    do_diff2b(f, df, w.key, w.left, w.center, w.right);
+                }
+                else {
+                    do_diff2i(f, df, w.key, w.left, w.center, w.right);
+                }
+            }
+        }
+
+        /// Differentiate a batch of keys of several functions at once
+
+        /// \c work[i].second holds, for key \c work[i].first, the nodes of
+        /// all functions that have one there, tagged with the function index.
+        void do_diff2_vector(const std::vector<const implT*>& f, const std::vector<implT*>& df,
+                             const std::vector< std::pair<keyT,stackT> >& work) const {
+            for (std::size_t i=0; i<work.size(); ++i) {
+                stackT interior;
+                for (std::size_t j=0; j<work[i].second.size(); ++j) {
+                    const std::size_t ifn = work[i].second[j].first;
+                    const diff2T& w = work[i].second[j].second;
+                    if (w.left.first.is_invalid() || w.right.first.is_invalid()) {
+                        do_diff2b(f[ifn], df[ifn], w.key, w.left, w.center, w.right);
+                    }
+                    else {
+                        interior.push_back(work[i].second[j]);
+                    }
+                }
+                if (!interior.empty()) do_diff2i_stacked(f, df, work[i].first, interior);
+            }
+        }
+
+        /// do_diff2i for the same key of several functions
+
+        /// The default just loops over the functions; derived classes can
+        /// differentiate the stacked coefficients in one go.
+        virtual void do_diff2i_stacked(const std::vector<const implT*>& f, const std::vector<implT*>& df,
+                                       const keyT& key, const stackT& interior) const {
+            for (std::size_t j=0; j<interior.size(); ++j) {
+                const diff2T& w = interior[j].second;
+                do_diff2i(f[interior[j].first], df[interior[j].first], key, w.left, w.center, w.right);
+            }
+        }
+
         virtual void do_diff2b(const implT* f, implT* df, const keyT& key,
                                const argT& left,
                                const argT& center,
@@ -205,6 +321,81 @@ namespace madness {
             return df;
         }
 
+        /// Differentiate using the neighbor coefficients gathered in \c halo
+
+        /// \c halo must have been made for \c f (it is ignored otherwise)
+        /// and \c f must not have changed since.  One halo can serve the
+        /// derivatives along all axes.
+        Function<T,NDIM>
+        operator()(const functionT& f, const DerivativeHalo<T,NDIM>& halo, bool fence=true) const {
+            if (halo.get_impl() != f.get_impl().get()) return (*this)(f,fence);
+            if (VERIFY_TREE) f.verify_tree();
+            MADNESS_ASSERT(!f.is_compressed());
+
+            functionT df;
+            df.set_impl(f,false);
+
+            df.get_impl()->diff(this, f.get_impl().get(), halo, fence);
+            return df;
+        }
+
+        /// Differentiate several functions in one traversal of their trees
+
+        /// The leaves of all functions are collected by key, so that the
+        /// nodes of a key are differentiated together by do_diff2i_stacked.
+        /// \c halo must come from DerivativeHalo::make(v).
+        std::vector<functionT>
+        operator()(const std::vector<functionT>& v,
+                   const std::vector< std::shared_ptr< DerivativeHalo<T,NDIM> > >& halo,
+                   bool fence=true) const {
+            MADNESS_ASSERT(halo.size() == v.size());
+            std::vector<functionT> df(v.size());
+            std::vector<const implT*> fimpl(v.size());
+            std::vector<implT*> dfimpl(v.size());
+            for (std::size_t i=0; i<v.size(); ++i) {
+                MADNESS_ASSERT(halo[i]->get_impl() == v[i].get_impl().get());
+                df[i].set_impl(v[i],false);
+                fimpl[i] = v[i].get_impl().get();
+                dfimpl[i] = df[i].get_impl().get();
+            }
+
+            std::map<keyT,stackT> nodes;
+            for (std::size_t i=0; i<v.size(); ++i) {
+                std::vector<diff2T> work;
+                const dcT& coeffs = fimpl[i]->get_coeffs();
+                for (typename dcT::const_iterator it=coeffs.begin(); it!=coeffs.end(); ++it) {
+                    const keyT& key = it->first;
+                    const nodeT& node = it->second;
+                    if (node.has_coeff()) {
+                        do_diff1_halo(fimpl[i], dfimpl[i], key, argT(), argT(key,node.coeff()), argT(), *halo[i], work);
+                    }
+                    else {
+                        dfimpl[i]->get_coeffs().replace(key,nodeT(coeffT(),true)); // Empty internal node
+                    }
+                }
+                for (std::size_t j=0; j<work.size(); ++j)
+                    nodes[work[j].key].push_back(std::make_pair(i,work[j]));
+            }
+
+            // Batches of about diff2_batch_size nodes
+            std::vector< std::pair<keyT,stackT> > work;
+            std::size_t nwork = 0;
+            for (typename std::map<keyT,stackT>::const_iterator it=nodes.begin(); it!=nodes.end(); ++it) {
+                work.push_back(*it);
+                nwork += it->second.size();
+                if (nwork >= diff2_batch_size) {
+                    world.taskq.add(*this, &DerivativeBase<T,NDIM>::do_diff2_vector, fimpl, dfimpl, work, TaskAttributes::hipri());
+                    work.clear();
+                    nwork = 0;
+                }
+            }
+            if (!work.empty())
+                world.taskq.add(*this, &DerivativeBase<T,NDIM>::do_diff2_vector, fimpl, dfimpl, work, TaskAttributes::hipri());
+
+            if (fence) world.gop.fence();
+            return df;
+        }
+
 
         static bool enforce_bc(int bc_left, int bc_right, Level n, Translation& l) {
             Translation two2n = 1ul << n;
@@ -246,6 +437,17 @@ namespace madness {
             }
         }
 
+        /// Neighbor of \c key from \c halo, or zero if outside the volume; false if not in the halo
+        bool find_in_halo(const implT* f, const DerivativeHalo<T,NDIM>& halo,
+                          const keyT& key, int step, argT& result) const {
+            keyT neigh = neighbor(key, step);
+            if (neigh.is_invalid()) {
+                result = argT(neigh,coeffT(vk,f->get_tensor_args())); // Zero bc
+                return true;
+            }
+            return halo.find(neigh, result);
+        }
+
         Future<argT>
         find_neighbor(const implT* f, const Key<NDIM>& key, int step) const {
             keyT neigh = neighbor(key, step);
@@ -267,11 +469,220 @@ namespace madness {
     };  // End of the DerivativeBase class
 
 
+    /// Coefficients of the axial neighbors of all local leaves of a function
+
+    /// DerivativeBase::find_neighbor fetches every neighbor with its own
+    /// hipri task, for each node, axis and derivative.  The halo instead
+    /// collects the neighbors along all axes once, with one batched
+    /// FunctionImpl::find_halo request per owner and round.  A round is
+    /// needed for each level a lookup walks up across processes and each
+    /// level a neighbor is refined below the leaf.
+    ///
+    /// Construction is collective and the function must not change while
+    /// the halo is in use.
+    template <typename T, std::size_t NDIM>
+    class DerivativeHalo {
+    public:
+        typedef Key<NDIM> keyT;
+        typedef GenTensor<T> coeffT;
+        typedef std::pair<keyT,coeffT> argT;
+        typedef FunctionImpl<T,NDIM> implT;
+
+    private:
+        /// A leaf (or child of a leaf) needing its neighbor along an axis
+        struct itemT {
+            keyT key;
+            std::size_t axis;
+            int step;
+            itemT(const keyT& key, std::size_t axis, int step) : key(key), axis(axis), step(step) {}
+        };
+
+        const implT* impl;
+        BoundaryConditions<NDIM> bc;
+        std::map<keyT,argT> nodes;  ///< Neighbor key -> same as find_neighbor would return
+        int nround;
+
+        std::vector<itemT> items;   ///< Lookups still to be satisfied
+        std::map<keyT,keyT> query;  ///< Unresolved neighbor -> key to ask for next
+        std::vector<keyT> neighs, asked; ///< Requests of the current round
+        std::vector< std::vector<std::size_t> > index; ///< Positions in neighs of each reply
+        std::vector< Future< std::vector<argT> > > replies; ///< Replies of the current round
+
+        DerivativeHalo(const BoundaryConditions<NDIM>& bc) : impl(0), bc(bc), nround(0) {}
+
+        keyT neighbor(const itemT& item) const {
+            Vector<Translation,NDIM> l = item.key.translation();
+            l[item.axis] += item.step;
+            if (!DerivativeBase<T,NDIM>::enforce_bc(bc(item.axis,0), bc(item.axis,1), item.key.level(), l[item.axis]))
+                return keyT::invalid();
+            return keyT(item.key.level(),l);
+        }
+
+        /// Queue the lookups for all local leaves of reconstructed \c f
+        void init(const Function<T,NDIM>& f) {
+            impl = f.get_impl().get();
+            const typename implT::dcT& coeffs = impl->get_coeffs();
+            for (typename implT::dcT::const_iterator it=coeffs.begin(); it!=coeffs.end(); ++it) {
+                if (!it->second.has_coeff()) continue;
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    items.push_back(itemT(it->first,d,-1));
+                    items.push_back(itemT(it->first,d,1));
+                }
+            }
+        }
+
+        /// Ask for every neighbor not found yet, one batch per owner; false if done
+        bool send_round() {
+            for (std::size_t i=0; i<items.size(); ++i) {
+                keyT neigh = neighbor(items[i]);
+                if (!neigh.is_invalid() && !nodes.count(neigh) && !query.count(neigh))
+                    query[neigh] = neigh;
+            }
+            if (query.empty()) return false;
+
+            neighs.clear();
+            asked.clear();
+            for (typename std::map<keyT,keyT>::const_iterator it=query.begin(); it!=query.end(); ++it) {
+                neighs.push_back(it->first);
+                asked.push_back(it->second);
+            }
+            const typename implT::dcT& coeffs = impl->get_coeffs();
+            KeyBatches<keyT> batches(asked, [&coeffs](const keyT& key) {return coeffs.owner(key);});
+            index.resize(batches.size());
+            replies.resize(batches.size());
+            for (std::size_t b=0; b<batches.size(); ++b) {
+                index[b] = batches.index(b);
+                if (batches.owner(b) == impl->world.rank())
+                    replies[b] = Future< std::vector<argT> >(impl->find_halo(batches.batch(b)));
+                else
+                    replies[b] = impl->task(batches.owner(b), &implT::find_halo, batches.batch(b), TaskAttributes::hipri());
+            }
+            return true;
+        }
+
+        /// Wait for the replies of the current round and queue the lookups they lead to
+        void receive_round() {
+            for (std::size_t b=0; b<replies.size(); ++b) {
+                const std::vector<argT>& reply = replies[b].get();
+                for (std::size_t i=0; i<index[b].size(); ++i) {
+                    const keyT& neigh = neighs[index[b][i]];
+                    if (reply[i].second.has_data() || reply[i].first == asked[index[b][i]]) {
+                        nodes[neigh] = reply[i];
+                        query.erase(neigh);
+                    }
+                    else {
+                        query[neigh] = reply[i].first; // Ancestor on another process
+                    }
+                }
+            }
+            replies.clear();
+            ++nround;
+
+            // Neighbors refined below a leaf are needed by its children on the near face
+            const typename implT::dcT& coeffs = impl->get_coeffs();
+            const ProcessID me = impl->world.rank();
+            std::vector<itemT> next;
+            for (std::size_t i=0; i<items.size(); ++i) {
+                keyT neigh = neighbor(items[i]);
+                if (neigh.is_invalid()) continue;
+                typename std::map<keyT,argT>::const_iterator it = nodes.find(neigh);
+                if (it == nodes.end()) {
+                    next.push_back(items[i]);
+                }
+                else if (!it->second.second.has_data()) {
+                    const Translation parity = (items[i].step < 0) ? 0 : 1;
+                    for (KeyChildIterator<NDIM> kit(items[i].key); kit; ++kit) {
+                        const keyT& child = kit.key();
+                        if ((child.translation()[items[i].axis]&1) == parity && coeffs.owner(child) == me)
+                            next.push_back(itemT(child, items[i].axis, items[i].step));
+                    }
+                }
+            }
+            items.swap(next);
+        }
+
+    public:
+        /// Gather the halo of \c f, which is reconstructed if necessary
+
+        /// Neighbors are computed with boundary conditions \c bc; derivatives
+        /// with other conditions still work but fall back to find_neighbor
+        /// for the keys that differ.
+        DerivativeHalo(const Function<T,NDIM>& f,
+                       const BoundaryConditions<NDIM>& bc=FunctionDefaults<NDIM>::get_bc())
+            : impl(0), bc(bc), nround(0)
+        {
+            f.reconstruct();
+            init(f);
+            while (send_round()) receive_round();
+        }
+
+        /// Gather the halos of several functions, sharing the exchange rounds
+
+        /// The requests of all functions for a round are sent before waiting
+        /// for any reply.
+        static std::vector< std::shared_ptr<DerivativeHalo> >
+        make(const std::vector< Function<T,NDIM> >& v,
+             const BoundaryConditions<NDIM>& bc=FunctionDefaults<NDIM>::get_bc()) {
+            std::vector< std::shared_ptr<DerivativeHalo> > halos(v.size());
+            if (v.empty()) return halos;
+            bool must_fence = false;
+            for (std::size_t i=0; i<v.size(); ++i) {
+                if (v[i].is_compressed()) {
+                    v[i].reconstruct(false);
+                    must_fence = true;
+                }
+            }
+            if (must_fence) v[0].world().gop.fence();
+
+            for (std::size_t i=0; i<v.size(); ++i) {
+                halos[i].reset(new DerivativeHalo(bc));
+                halos[i]->init(v[i]);
+            }
+            std::vector<bool> active(v.size(), true);
+            for (bool more=true; more; ) {
+                more = false;
+                for (std::size_t i=0; i<v.size(); ++i) {
+                    if (active[i]) active[i] = halos[i]->send_round();
+                }
+                for (std::size_t i=0; i<v.size(); ++i) {
+                    if (active[i]) {
+                        halos[i]->receive_round();
+                        more = true;
+                    }
+                }
+            }
+            return halos;
+        }
+
+        /// The function this halo was made for
+        const implT* get_impl() const { return impl; }
+
+        /// The boundary conditions used to find the neighbors
+        const BoundaryConditions<NDIM>& get_bc() const { return bc; }
+
+        /// Look up a neighbor; false if it is not in the halo
+        bool find(const keyT& neigh, argT& result) const {
+            typename std::map<keyT,argT>::const_iterator it = nodes.find(neigh);
+            if (it == nodes.end()) return false;
+            result = it->second;
+            return true;
+        }
+
+        /// Number of neighbors in the halo
+        std::size_t size() const { return nodes.size(); }
+
+        /// Number of exchange rounds it took to build the halo
+        int get_nround() const { return nround; }
+    };
+
+
     /// Implements derivatives operators with variety of boundary conditions on simulation domain
     template <typename T, std::size_t NDIM>
     class Derivative : public DerivativeBase<T, NDIM> {
     private:
         typedef DerivativeBase<T, NDIM> baseT;
+        typedef typename baseT::diff2T diff2T;
+        typedef typename baseT::stackT stackT;
 
     public:
         typedef Tensor<T>               tensorT  ;
@@ -295,6 +706,7 @@ namespace madness {
         Tensor<double> right_r0, right_rp; ///< Blocks of the derivative for the right boundary
         Tensor<double> right_r0t, right_rpt; ///< Blocks of the derivative for the right boundary
         Tensor<double> bv_left, bv_right ; ///< Blocks of the derivative operator for the boundary contribution
+        Tensor<double> rstackt           ; ///< rpt, r0t and rmt stacked, for do_diff2i_stacked
 
     public:
 	const std::size_t get_axis() const{
@@ -430,6 +842,71 @@ namespace madness {
 //#endif
 
         }
+        /// do_diff2i for several functions as one matrix multiply
+
+        /// The left, center and right blocks of all functions are gathered
+        /// into X(3k, n*a*b), where a and b are the sizes of the dimensions
+        /// before and after the axis, so that one inner(X,rstackt) applies
+        /// rpt, r0t and rmt and sums their contributions.
+        void do_diff2i_stacked(const std::vector<const implT*>& f, const std::vector<implT*>& df,
+                               const keyT& key, const stackT& interior) const {
+            const std::size_t n = interior.size();
+            bool full = (n > 1);
+            for (std::size_t j=0; full && j<n; ++j) {
+                const diff2T& w = interior[j].second;
+                full = w.left.second.tensor_type()==TT_FULL && w.center.second.tensor_type()==TT_FULL
+                    && w.right.second.tensor_type()==TT_FULL;
+            }
+            if (!full) {
+                baseT::do_diff2i_stacked(f, df, key, interior);
+                return;
+            }
+
+            const long k = this->k;
+            long a = 1, b = 1;
+            for (std::size_t d=0; d<this->axis; ++d) a *= k;
+            for (std::size_t d=this->axis+1; d<NDIM; ++d) b *= k;
+            const long nab = n*a*b;
+
+            const keyT lkey = this->neighbor(key,-1), rkey = this->neighbor(key,1);
+            Tensor<T> X(3*k, nab);
+            for (std::size_t j=0; j<n; ++j) {
+                const diff2T& w = interior[j].second;
+                implT* dfj = df[interior[j].first];
+                Tensor<T> t[3] = {
+                    dfj->parent_to_child(w.left.second, w.left.first, lkey).full_tensor(),
+                    dfj->parent_to_child(w.center.second, w.center.first, key).full_tensor(),
+                    dfj->parent_to_child(w.right.second, w.right.first, rkey).full_tensor()};
+                for (int s=0; s<3; ++s) {
+                    if (!t[s].iscontiguous()) t[s] = copy(t[s]);
+                    const T* restrict src = t[s].ptr();
+                    for (long p=0; p<a; ++p) {
+                        for (long i=0; i<k; ++i) {
+                            T* restrict dst = X.ptr() + (s*k+i)*nab + (j*a+p)*b;
+                            for (long q=0; q<b; ++q) dst[q] = src[(p*k+i)*b+q];
+                        }
+                    }
+                }
+            }
+
+            // R((j*a+p)*b+q, i) = sum(si) X(si, (j*a+p)*b+q) rstackt(si, i)
+            const Tensor<T> R = inner(X, rstackt, 0, 0);
+
+            const double scale = FunctionDefaults<NDIM>::get_rcell_width()[this->axis]*pow(2.0,(double) key.level());
+            for (std::size_t j=0; j<n; ++j) {
+                implT* dfj = df[interior[j].first];
+                Tensor<T> d(this->vk);
+                T* restrict dst = d.ptr();
+                for (long p=0; p<a; ++p) {
+                    for (long i=0; i<k; ++i) {
+                        const T* restrict src = R.ptr() + (j*a+p)*b*k + i;
+                        for (long q=0; q<b; ++q) dst[(p*k+i)*b+q] = scale*src[q*k];
+                    }
+                }
+                dfj->get_coeffs().replace(key,nodeT(coeffT(d,dfj->get_thresh(),TT_FULL),false));
+            }
+        }
+
     private:
         void initCoefficients()  {
             r0 = Tensor<double>(this->k,this->k);
@@ -559,6 +1036,11 @@ namespace madness {
             left_rmt = transpose(left_rm);
             left_r0t = transpose(left_r0);
 
+            rstackt = Tensor<double>(3*this->k,this->k);
+            rstackt(Slice(0,this->k-1),_) = rpt;
+            rstackt(Slice(this->k,2*this->k-1),_) = r0t;
+            rstackt(Slice(2*this->k,-1),_) = rmt;
+
 
             //print(rm.normf(),r0.normf(),rp.normf(),left_rm.normf(),left_r0.normf(),right_r0.normf(),right_rp.normf(),bv_left.normf(),bv_right.normf());
         }
@@ -638,6 +1120,24 @@ namespace madness {
     }
 
 
+    /// Applies a set of derivative operators (e.g. the gradient) to a function
+
+    /// The neighbor coefficients are gathered once in a DerivativeHalo and
+    /// shared by all operators.
+    /// @return result[i] = D[i](f)
+    template <typename T, std::size_t NDIM>
+    std::vector< Function<T,NDIM> >
+    apply(const std::vector< std::shared_ptr< Derivative<T,NDIM> > >& D,
+          const Function<T,NDIM>& f, bool fence=true) {
+        std::vector< Function<T,NDIM> > df(D.size());
+        if (D.empty()) return df;
+        DerivativeHalo<T,NDIM> halo(f, D[0]->get_bc());
+        for (std::size_t i=0; i<D.size(); ++i) df[i] = (*D[i])(f, halo, false);
+        if (fence) f.world().gop.fence();
+        return df;
+    }
+
+
     namespace archive {
         template <class Archive, class T, std::size_t NDIM>
         struct ArchiveLoadImpl<Archive,const DerivativeBase<T,NDIM>*> {
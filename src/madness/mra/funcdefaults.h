@@ -183,6 +183,8 @@ namespace madness {
         static bool debug;             ///< Controls output of debug info
         static bool truncate_on_project; ///< If true initial projection inserts at n-1 not n
         static bool apply_randomize;   ///< If true use randomization for load balancing in apply integral operator
+        static std::size_t apply_buffer_size; ///< Boxes buffered per thread in apply before flushing; 0 disables
+        static bool pack_results;      ///< Whether new functions keep the coefficients they compute in single precision
         static bool project_randomize; ///< If true use randomization for load balancing in project/refine
         static BoundaryConditions<NDIM> bc; ///< Default boundary conditions
         static Tensor<double> cell ;   ///< cell[NDIM][2] Simulation cell, cell(0,0)=xlo, cell(0,1)=xhi, ...
@@ -331,6 +333,36 @@ namespace madness {
             apply_randomize=value;
         }
 
+        /// Gets the number of result boxes each thread buffers in apply before flushing
+        static std::size_t get_apply_buffer_size() {
+            return apply_buffer_size;
+        }
+
+        /// Sets the number of result boxes each thread buffers in apply before flushing
+
+        /// Zero (the default) disables buffering, i.e. every partial result is
+        /// sent as its own task.  With buffering on, an apply_only() without a
+        /// fence leaves results in the buffers until
+        /// FunctionImpl::flush_apply_buffer() is called after a fence.
+        static void set_apply_buffer_size(std::size_t value) {
+            apply_buffer_size=value;
+        }
+
+        /// Gets the default for keeping computed coefficients in single precision
+        static bool get_pack_results() {
+            return pack_results;
+        }
+
+        /// Sets the default for keeping computed coefficients in single precision
+
+        /// New functions take this flag from the factory, results of
+        /// operations from their source function.  If it is set, compress,
+        /// reconstruct and apply pack the coefficients they compute (see
+        /// Function::pack()).
+        static void set_pack_results(bool value) {
+            pack_results=value;
+        }
+
 
         /// Gets the random load balancing for projection flag
         static bool get_project_randomize() {
@@ -421,9 +453,12 @@ namespace madness {
         }
 
         /// Sets the default process map and redistributes all functions using the old map
-        static void redistribute(World& world, const std::shared_ptr< WorldDCPmapInterface< Key<NDIM> > >& newpmap) {
-            pmap->redistribute(world,newpmap);
+
+        /// Returns what was moved and the imbalance before and after
+        static WorldDCRedistributeStats redistribute(World& world, const std::shared_ptr< WorldDCPmapInterface< Key<NDIM> > >& newpmap) {
+            WorldDCRedistributeStats stats = pmap->redistribute(world,newpmap);
             pmap = newpmap;
+            return stats;
         }
 
     };
@@ -0,0 +1,502 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_MRA_FUNCFILE_H__INCLUDED
+#define MADNESS_MRA_FUNCFILE_H__INCLUDED
+
+#include <madness/mra/mra.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// \file mra/funcfile.h
+/// \brief Read-only files holding one function, read lazily through mmap
+/// \ingroup mra
+
+/// A function file holds the reconstructed tree of one function:
+///  - a FunctionFileHeader at offset zero,
+///  - the scaling coefficients of the leaves, k^NDIM values of T per box
+///    in the order of Tensor, each block starting at a multiple of
+///    FunctionFileHeader::align bytes,
+///  - at FunctionFileHeader::index_offset, one FunctionFileEntry per box
+///    sorted by level and then translation.
+///
+/// Numbers are in the byte order of the writer.  A FunctionFile maps the
+/// file into memory, so that evaluating the function at a few points,
+/// plotting a slice or computing overlaps only reads the pages of the boxes
+/// involved, on any number of processes and without a World.
+///
+/// \code
+///   write_function_file(psi, "psi.mfn");      // or archive_to_function_file
+///   FunctionFile<double,3> file("psi.mfn");
+///   double value = file.eval(coord_3d(0.5));
+///   double overlap = file.inner(phi);         // collective in the world of phi
+/// \endcode
+
+namespace madness {
+
+    /// Leading bytes of a function file
+    struct FunctionFileHeader {
+        static const uint64_t align = 64;   ///< Alignment in bytes of the coefficient blocks and the index
+        static const uint32_t current_version = 1;
+
+        char magic[8];              ///< "MADFUNC" and a zero
+        uint32_t version;
+        uint32_t id;                ///< TensorTypeData<T>::id of the coefficients
+        uint32_t ndim;
+        uint32_t k;
+        uint64_t nnode;             ///< Number of boxes in the index
+        uint64_t index_offset;      ///< Offset in bytes of the index
+        double cell[6][2];          ///< Cell in user coordinates, the first ndim rows are used
+    };
+
+    /// One box in the index of a function file
+    template <std::size_t NDIM>
+    struct FunctionFileEntry {
+        int64_t n;                  ///< Level
+        int64_t l[NDIM];            ///< Translation
+        uint64_t offset;            ///< Offset in bytes of the coefficients, zero if the box has none
+        uint64_t has_children;      ///< Nonzero in the interior of the tree
+
+        /// Order of the index, by level and then translation
+        bool operator<(const FunctionFileEntry& b) const {
+            if (n != b.n) return n < b.n;
+            return std::lexicographical_compare(l, l+NDIM, b.l, b.l+NDIM);
+        }
+    };
+
+    namespace detail {
+        /// Appends the coefficients of a box to a function file being written and records the box
+        template <typename T, std::size_t NDIM>
+        void write_function_file_box(std::ofstream& file, uint64_t& offset,
+                                     std::vector< FunctionFileEntry<NDIM> >& index,
+                                     const Key<NDIM>& key, bool has_children, const Tensor<T>& c) {
+            FunctionFileEntry<NDIM> entry;
+            entry.n = key.level();
+            for (std::size_t d=0; d<NDIM; ++d) entry.l[d] = key.translation()[d];
+            entry.offset = 0;
+            entry.has_children = has_children;
+            if (c.size()) {
+                const char zeros[FunctionFileHeader::align] = {0};
+                const uint64_t pad = (FunctionFileHeader::align - offset%FunctionFileHeader::align)%FunctionFileHeader::align;
+                file.write(zeros, pad);
+                offset += pad;
+                entry.offset = offset;
+                file.write(reinterpret_cast<const char*>(c.ptr()), c.size()*sizeof(T));
+                offset += c.size()*sizeof(T);
+            }
+            index.push_back(entry);
+        }
+    }
+
+    /// Writes \c f to a function file, collective
+
+    /// \c f is reconstructed.  Process zero writes the file, receiving the
+    /// boxes of the other processes one process at a time.  A packed \c f
+    /// (see Function::pack()) throws; unpack() it first.
+    template <typename T, std::size_t NDIM>
+    void write_function_file(const Function<T,NDIM>& f, const std::string& filename) {
+        PROFILE_FUNC;
+        MADNESS_ASSERT(NDIM <= 6);
+        typedef typename FunctionImpl<T,NDIM>::dcT dcT;
+        World& world = f.world();
+        f.reconstruct();
+        const dcT& coeffs = f.get_impl()->get_coeffs();
+        Tag tag = world.mpi.unique_tag();
+
+        if (world.rank() == 0) {
+            std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+            if (!file) MADNESS_EXCEPTION("write_function_file: could not open the file", 0);
+
+            FunctionFileHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::strcpy(header.magic, "MADFUNC");
+            header.version = FunctionFileHeader::current_version;
+            header.id = TensorTypeData<T>::id;
+            header.ndim = NDIM;
+            header.k = f.k();
+            const Tensor<double>& cell = FunctionDefaults<NDIM>::get_cell();
+            for (std::size_t d=0; d<NDIM; ++d) {
+                header.cell[d][0] = cell(d,0);
+                header.cell[d][1] = cell(d,1);
+            }
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header)); // rewritten below
+
+            uint64_t offset = sizeof(header);
+            std::vector< FunctionFileEntry<NDIM> > index;
+            for (typename dcT::const_iterator it=coeffs.begin(); it!=coeffs.end(); ++it) {
+                const FunctionNode<T,NDIM>& node = it->second;
+                detail::write_function_file_box(file, offset, index, it->first, node.has_children(),
+                                                node.has_coeff() ? node.coeff().full_tensor_copy() : Tensor<T>());
+            }
+            for (ProcessID p=1; p<world.size(); ++p) {
+                world.mpi.Send(int(1),p,tag); // Tell client to start sending
+                archive::MPIInputArchive source(world, p);
+                std::size_t count = 0;
+                source & count;
+                while (count--) {
+                    Key<NDIM> key;
+                    bool has_children = false;
+                    Tensor<T> c;
+                    source & key & has_children & c;
+                    detail::write_function_file_box(file, offset, index, key, has_children, c);
+                }
+            }
+
+            const char zeros[FunctionFileHeader::align] = {0};
+            const uint64_t pad = (FunctionFileHeader::align - offset%FunctionFileHeader::align)%FunctionFileHeader::align;
+            file.write(zeros, pad);
+            std::sort(index.begin(), index.end());
+            header.nnode = index.size();
+            header.index_offset = offset + pad;
+            file.write(reinterpret_cast<const char*>(index.data()), index.size()*sizeof(FunctionFileEntry<NDIM>));
+            file.seekp(0);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.close();
+            if (!file) MADNESS_EXCEPTION("write_function_file: could not write the file", 0);
+        }
+        else {
+            int flag;
+            world.mpi.Recv(flag,0,tag);
+            archive::MPIOutputArchive dest(world, 0);
+            dest & coeffs.size();
+            for (typename dcT::const_iterator it=coeffs.begin(); it!=coeffs.end(); ++it) {
+                const FunctionNode<T,NDIM>& node = it->second;
+                dest & it->first & node.has_children()
+                     & (node.has_coeff() ? node.coeff().full_tensor_copy() : Tensor<T>());
+            }
+            dest.flush();
+        }
+        world.gop.fence();
+    }
+
+    /// Converts a function saved by save() or save_sharded(), or alone to any ParallelOutputArchive, to a function file, collective
+    template <typename T, std::size_t NDIM>
+    void archive_to_function_file(World& world, const std::string& archivename, const std::string& filename) {
+        Function<T,NDIM> f;
+        archive::ParallelInputArchive ar(world, archivename.c_str());
+        ar & f;
+        ar.close();
+        write_function_file(f, filename);
+    }
+
+    /// A function file mapped into memory, read-only
+
+    /// Opening the file reads only the header; the index and the coefficients
+    /// are paged in as boxes are looked up.  Nothing is collective except
+    /// inner(), so any process may open and use the file on its own.
+    template <typename T, std::size_t NDIM>
+    class FunctionFile {
+    public:
+        typedef Key<NDIM> keyT;
+        typedef Vector<double,NDIM> coordT;
+        typedef FunctionFileEntry<NDIM> entryT;
+
+    private:
+        void* base;                     ///< Start of the mapped file
+        std::size_t nbyte;              ///< Size of the mapped file
+        const FunctionFileHeader* header;
+        const entryT* index;
+        const FunctionCommonData<T,NDIM>* cdata;
+        coordT lo, width;               ///< Cell in user coordinates
+        double volume;                  ///< Volume of the cell
+
+        FunctionFile(const FunctionFile&);
+        FunctionFile& operator=(const FunctionFile&);
+
+        void unmap() {
+            if (base) munmap(base, nbyte);
+            base = 0;
+        }
+
+        void check(bool ok, const char* msg) {
+            if (!ok) {
+                unmap();
+                MADNESS_EXCEPTION(msg, 0);
+            }
+        }
+
+        const T* block(const entryT* e) const {
+            return reinterpret_cast<const T*>(static_cast<const char*>(base) + e->offset);
+        }
+
+        /// The coefficients of a box of the file, zero if it has none
+        Tensor<T> copy_block(const entryT* e) const {
+            Tensor<T> c(cdata->vk);
+            if (e->offset) std::memcpy(c.ptr(), block(e), c.size()*sizeof(T));
+            return c;
+        }
+
+        /// Value at \c x in simulation coordinates within box of level \c n with coefficients \c c
+        T eval_box(Level n, const coordT& x, const T* c) const {
+            const int k = cdata->k;
+            std::vector<double> px(NDIM*k);
+            for (std::size_t d=0; d<NDIM; ++d) legendre_scaling_functions(x[d], k, &px[d*k]);
+
+            // contract the last index first, in place after the first pass
+            long m = 1;
+            for (std::size_t d=1; d<NDIM; ++d) m *= k;
+            std::vector<T> v(m);
+            const double* p = &px[(NDIM-1)*k];
+            for (long i=0; i<m; ++i) {
+                T sum = T(0.0);
+                for (int r=0; r<k; ++r) sum += c[i*k+r]*p[r];
+                v[i] = sum;
+            }
+            for (long d=long(NDIM)-2; d>=0; --d) {
+                m /= k;
+                p = &px[d*k];
+                for (long i=0; i<m; ++i) {
+                    T sum = T(0.0);
+                    for (int r=0; r<k; ++r) sum += v[i*k+r]*p[r];
+                    v[i] = sum;
+                }
+            }
+            return v[0]*std::pow(2.0,0.5*NDIM*n)/std::sqrt(volume);
+        }
+
+    public:
+        /// Maps the file, throwing if it is not a function file of this type and dimension
+        explicit FunctionFile(const std::string& filename)
+            : base(0), nbyte(0), header(0), index(0), cdata(0), volume(1.0)
+        {
+            const int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0) MADNESS_EXCEPTION("FunctionFile: could not open the file", 0);
+            struct stat st;
+            if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(FunctionFileHeader)) {
+                ::close(fd);
+                MADNESS_EXCEPTION("FunctionFile: not a function file", 0);
+            }
+            nbyte = st.st_size;
+            base = mmap(0, nbyte, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (base == MAP_FAILED) {
+                base = 0;
+                MADNESS_EXCEPTION("FunctionFile: could not map the file", 0);
+            }
+
+            header = static_cast<const FunctionFileHeader*>(base);
+            check(std::strncmp(header->magic, "MADFUNC", 8) == 0, "FunctionFile: not a function file");
+            check(header->version == FunctionFileHeader::current_version, "FunctionFile: unknown version");
+            check(header->id == uint32_t(TensorTypeData<T>::id), "FunctionFile: wrong type of coefficients");
+            check(header->ndim == NDIM, "FunctionFile: wrong dimension");
+            check(header->index_offset + header->nnode*sizeof(entryT) <= nbyte, "FunctionFile: file too short");
+            index = reinterpret_cast<const entryT*>(static_cast<const char*>(base) + header->index_offset);
+            cdata = &FunctionCommonData<T,NDIM>::get(header->k);
+            for (std::size_t d=0; d<NDIM; ++d) {
+                lo[d] = header->cell[d][0];
+                width[d] = header->cell[d][1] - header->cell[d][0];
+                volume *= width[d];
+            }
+        }
+
+        ~FunctionFile() {unmap();}
+
+        int k() const {return header->k;}
+
+        /// Number of boxes in the tree
+        std::size_t size() const {return header->nnode;}
+
+        /// Cell in user coordinates, the same layout as FunctionDefaults::get_cell()
+        Tensor<double> get_cell() const {
+            Tensor<double> cell(NDIM,2);
+            for (std::size_t d=0; d<NDIM; ++d) {
+                cell(d,0) = header->cell[d][0];
+                cell(d,1) = header->cell[d][1];
+            }
+            return cell;
+        }
+
+        /// The box \c key in the index, or null if it is not in the tree
+        const entryT* find(const keyT& key) const {
+            entryT e;
+            e.n = key.level();
+            for (std::size_t d=0; d<NDIM; ++d) e.l[d] = key.translation()[d];
+            const entryT* end = index + header->nnode;
+            const entryT* it = std::lower_bound(index, end, e);
+            if (it == end || e < *it) return 0;
+            return it;
+        }
+
+        /// Scaling coefficients of the function in box \c key, which may be anywhere in or below the tree
+
+        /// Above the leaves they are summed from the children with the
+        /// twoscale coefficients, cf. FunctionImpl::downsample, and below
+        /// them refined from the leaf, cf. FunctionImpl::upsample.  Both are
+        /// exact, so only the boxes at and below \c key or the one leaf above
+        /// it are read.
+        Tensor<T> coeff(const keyT& key) const {
+            const entryT* e = find(key);
+            Tensor<double> matrices[NDIM];
+            if (e) {
+                if (!e->has_children) return copy_block(e);
+                const Tensor<double> h[2] = {cdata->h0T, cdata->h1T};
+                Tensor<T> result(cdata->vk);
+                for (KeyChildIterator<NDIM> kit(key); kit; ++kit) {
+                    for (std::size_t d=0; d<NDIM; ++d) matrices[d] = h[kit.key().translation()[d]%2];
+                    result += general_transform(coeff(kit.key()), matrices);
+                }
+                return result;
+            }
+
+            std::vector<keyT> path(1, key);
+            while (path.back().level() > 0) {
+                e = find(path.back().parent());
+                if (e) break;
+                path.push_back(path.back().parent());
+            }
+            if (!e || e->has_children) return Tensor<T>(cdata->vk); // Outside of the tree
+            Tensor<T> s = copy_block(e);
+            const Tensor<double> h[2] = {cdata->h0, cdata->h1};
+            for (long i=path.size()-1; i>=0; --i) {
+                for (std::size_t d=0; d<NDIM; ++d) matrices[d] = h[path[i].translation()[d]%2];
+                s = general_transform(s, matrices);
+            }
+            return s;
+        }
+
+        /// Value at a point in user coordinates, reading the boxes from the root down to the leaf
+        T eval(const coordT& xuser) const {
+            const double eps=1e-15;
+            coordT x;
+            for (std::size_t d=0; d<NDIM; ++d) {
+                x[d] = (xuser[d] - lo[d])/width[d];
+                // If on the boundary, move the point just inside the volume
+                if (x[d] < -eps || x[d] > 1.0+eps) {
+                    MADNESS_EXCEPTION("FunctionFile::eval: coordinate out of the cell in dimension", d);
+                }
+                x[d] = std::min(std::max(x[d], eps), 1.0-eps);
+            }
+
+            Level n = 0;
+            Vector<Translation,NDIM> l(0);
+            while (1) {
+                const entryT* e = find(keyT(n,l));
+                if (!e) return T(0.0);
+                if (!e->has_children) return e->offset ? eval_box(n, x, block(e)) : T(0.0);
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    double xd = x[d]*2.0;
+                    int ld = int(xd);
+                    if (ld == 2) ld = 1;
+                    x[d] = xd - ld;
+                    l[d] = 2*l[d] + ld;
+                }
+                ++n;
+            }
+        }
+
+        /// Values on a regular grid, e.g. for plotting, cf. Function::eval_cube()
+
+        /// @param[in] cell The corners of the grid in user coordinates
+        /// @param[in] npt How many points to evaluate in each dimension
+        Tensor<T> eval_cube(const Tensor<double>& cell, const std::vector<long>& npt) const {
+            MADNESS_ASSERT(static_cast<std::size_t>(cell.dim(0))>=NDIM && cell.dim(1)==2 && npt.size()>=NDIM);
+            Tensor<T> r(NDIM, &npt[0]);
+            coordT x;
+            long ind[NDIM];
+            for (IndexIterator it(NDIM, &npt[0]); it; ++it) {
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    ind[d] = it[d];
+                    x[d] = cell(d,0);
+                    if (npt[d] > 1) x[d] += it[d]*(cell(d,1)-cell(d,0))/(npt[d]-1);
+                }
+                r(ind) = eval(x);
+            }
+            return r;
+        }
+
+        /// Inner product of the function in the file with \c g, collective in the world of \c g
+
+        /// \c g must have the same k and cell as the file.  It is
+        /// reconstructed, and every process reads the boxes under or above
+        /// the leaves of \c g that it owns.
+        T inner(const Function<T,NDIM>& g) const {
+            typedef typename FunctionImpl<T,NDIM>::dcT dcT;
+            MADNESS_ASSERT(g.k() == k());
+            const Tensor<double>& cell = FunctionDefaults<NDIM>::get_cell();
+            for (std::size_t d=0; d<NDIM; ++d) {
+                MADNESS_ASSERT(std::abs(cell(d,0) - lo[d]) <= 1e-12*width[d]);
+                MADNESS_ASSERT(std::abs(cell(d,1) - lo[d] - width[d]) <= 1e-12*width[d]);
+            }
+            g.reconstruct();
+            const dcT& coeffs = g.get_impl()->get_coeffs();
+            T sum = T(0.0);
+            for (typename dcT::const_iterator it=coeffs.begin(); it!=coeffs.end(); ++it) {
+                const FunctionNode<T,NDIM>& node = it->second;
+                if (node.has_coeff()) sum += coeff(it->first).trace_conj(node.coeff().full_tensor_copy());
+            }
+            g.world().gop.sum(sum);
+            return sum;
+        }
+    };
+
+    /// A functor backed by a function file, for making a Function from it
+
+    /// The functor provides the exact scaling coefficients of any box, so
+    /// projecting it with the k of the file reproduces the stored function
+    /// and each process reads only the boxes it projects.  With
+    /// FunctionFactory::is_on_demand() nothing is projected and boxes are
+    /// read when they are used.
+    /// \code
+    ///   std::shared_ptr< FunctionFile<double,3> > file(new FunctionFile<double,3>("psi.mfn"));
+    ///   real_function_3d psi = real_factory_3d(world).k(file->k())
+    ///       .functor(real_functor_3d(new FunctionFileFunctor<double,3>(file)));
+    /// \endcode
+    template <typename T, std::size_t NDIM>
+    class FunctionFileFunctor : public FunctionFunctorInterface<T,NDIM> {
+        std::shared_ptr< FunctionFile<T,NDIM> > file;
+
+    public:
+        typedef GenTensor<T> coeffT;
+
+        FunctionFileFunctor(const std::shared_ptr< FunctionFile<T,NDIM> >& file) : file(file) {}
+
+        T operator()(const Vector<double,NDIM>& x) const {return file->eval(x);}
+
+        coeffT coeff(const Key<NDIM>& key) const {
+            return coeffT(file->coeff(key), FunctionDefaults<NDIM>::get_thresh(), TT_FULL);
+        }
+
+        bool provides_coeff() const {return true;}
+    };
+
+}
+
+#endif // MADNESS_MRA_FUNCFILE_H__INCLUDED
@@ -53,6 +53,9 @@ namespace madness {
     template <typename T, std::size_t NDIM>
     class DerivativeBase;
 
+    template <typename T, std::size_t NDIM>
+    class DerivativeHalo;
+
     template<typename T, std::size_t NDIM>
     class FunctionImpl;
 
@@ -117,12 +120,32 @@ namespace madness {
     };
 
 
+    /// The single precision type in which a FunctionNode keeps packed coefficients
+    template <typename T> struct packed_coeff_type {typedef T type;};
+    template <> struct packed_coeff_type<double> {typedef float type;};
+    template <> struct packed_coeff_type<double_complex> {typedef float_complex type;};
+
+    /// Transforms packed coefficients like fast_transform, reading them in single precision
+
+    /// The products accumulate in double precision (see the mixed mTxmq).
+    /// Complex coefficients are converted to double precision first.
+    inline Tensor<double> packed_transform(const Tensor<float>& t, const Tensor<double>& c) {
+        Tensor<double> result(t.ndim(), t.dims(), false), work(t.ndim(), t.dims(), false);
+        return fast_transform(t, c, result, work);
+    }
+
+    inline Tensor<double_complex> packed_transform(const Tensor<float_complex>& t, const Tensor<double>& c) {
+        const Tensor<double_complex> s = t;
+        return transform(s, c);
+    }
+
     /// FunctionNode holds the coefficients, etc., at each node of the 2^NDIM-tree
     template<typename T, std::size_t NDIM>
     class FunctionNode {
     public:
     	typedef GenTensor<T> coeffT;
     	typedef Tensor<T> tensorT;
+        typedef Tensor<typename packed_coeff_type<T>::type> packedT;
     private:
         // Should compile OK with these volatile but there should
         // be no need to set as volatile since the container internally
@@ -132,6 +155,7 @@ namespace madness {
         double _norm_tree; ///< After norm_tree will contain norm of coefficients summed up tree
         bool _has_children; ///< True if there are children
         coeffT buffer; ///< The coefficients, if any
+        packedT _packed; ///< The coefficients in single precision, if packed
 
     public:
         typedef WorldContainer<Key<NDIM> , FunctionNode<T, NDIM> > dcT; ///< Type of container holding the nodes
@@ -162,7 +186,8 @@ namespace madness {
         FunctionNode<T, NDIM>&
         operator=(const FunctionNode<T, NDIM>& other) {
             if (this != &other) {
-                coeff() = copy(other.coeff());
+                _coeffs = copy(other._coeffs);
+                _packed = copy(other._packed);
                 _norm_tree = other._norm_tree;
                 _has_children = other._has_children;
             }
@@ -176,13 +201,19 @@ namespace madness {
         template<typename Q>
         FunctionNode<Q, NDIM>
         convert() const {
+            if (is_packed()) {
+                // packing the converted coefficients again gives the same single precision values
+                FunctionNode<Q, NDIM> result(unpacked(), _has_children);
+                result.pack();
+                return result;
+            }
             return FunctionNode<Q, NDIM> (copy(coeff()), _has_children);
         }
 
         /// Returns true if there are coefficients in this node
         bool
         has_coeff() const {
-            return _coeffs.has_data();
+            return _coeffs.has_data() || _packed.has_data();
         }
 
 
@@ -211,6 +242,7 @@ namespace madness {
         coeff() {
             MADNESS_ASSERT(_coeffs.ndim() == -1 || (_coeffs.dim(0) <= 2
                                                     * MAXK && _coeffs.dim(0) >= 0));
+            if (is_packed()) MADNESS_EXCEPTION("FunctionNode: coefficients are packed, call unpack()",1);
             return const_cast<coeffT&>(_coeffs);
         }
 
@@ -219,15 +251,62 @@ namespace madness {
         /// Returns an empty tensor if there are no coefficeints.
         const coeffT&
         coeff() const {
+            if (is_packed()) MADNESS_EXCEPTION("FunctionNode: coefficients are packed, call unpack()",1);
             return const_cast<const coeffT&>(_coeffs);
         }
 
         /// Returns the number of coefficients in this node
         size_t size() const {
-            return _coeffs.size();
+            return _coeffs.size() + _packed.size();
         }
 
-    public:
+        /// Returns true if the coefficients are kept in single precision (see pack())
+        bool is_packed() const {
+            return _packed.has_data();
+        }
+
+        /// Returns the coefficients kept in single precision, an empty tensor if not packed
+        const packedT& packed_coeff() const {
+            return _packed;
+        }
+
+        /// Returns a non-const reference to the coefficients kept in single precision
+        packedT& packed_coeff() {
+            return _packed;
+        }
+
+        /// Keeps the coefficients in single precision, halving their memory
+
+        /// Only full rank coefficients are packed.  Until unpack() is
+        /// called coeff() throws, operations that can read packed nodes
+        /// use packed_coeff().
+        void pack() {
+            if (_coeffs.has_data() && _coeffs.tensor_type()==TT_FULL) {
+                const tensorT& t = _coeffs.full_tensor();
+                _packed = packedT(t.ndim(), t.dims(), false);
+                const T* p = t.ptr();
+                typename packed_coeff_type<T>::type* q = _packed.ptr();
+                for (long i=0; i<t.size(); ++i) q[i] = p[i];
+                _coeffs = coeffT();
+            }
+        }
+
+        /// Restores the coefficients to full precision after pack()
+        void unpack() {
+            if (is_packed()) {
+                _coeffs = unpacked();
+                _packed = packedT();
+            }
+        }
+
+        /// The packed coefficients converted back to full precision
+        coeffT unpacked() const {
+            tensorT t(_packed.ndim(), _packed.dims(), false);
+            const typename packed_coeff_type<T>::type* q = _packed.ptr();
+            T* p = t.ptr();
+            for (long i=0; i<t.size(); ++i) p[i] = q[i];
+            return coeffT(t, -1.0, TT_FULL);
+        }
 
         /// reduces the rank of the coefficients (if applicable)
         void reduceRank(const double& eps) {
@@ -266,6 +345,7 @@ namespace madness {
 
         /// Takes a \em shallow copy of the coeff --- same as \c this->coeff()=coeff
         void set_coeff(const coeffT& coeffs) {
+            _packed = packedT();
             coeff() = coeffs;
             if ((_coeffs.has_data()) and ((_coeffs.dim(0) < 0) || (_coeffs.dim(0)>2*MAXK))) {
                 print("set_coeff: may have a problem");
@@ -276,13 +356,14 @@ namespace madness {
 
         /// Clears the coefficients (has_coeff() will subsequently return false)
         void clear_coeff() {
-            coeff()=coeffT();
+            _coeffs=coeffT();
+            _packed=packedT();
         }
 
         /// Scale the coefficients of this node
         template <typename Q>
         void scale(Q a) {
-            _coeffs.scale(a);
+            coeff().scale(a);
         }
 
         /// Sets the value of norm_tree
@@ -396,12 +477,22 @@ namespace madness {
         }
 
         T trace_conj(const FunctionNode<T,NDIM>& rhs) const {
-            return this->_coeffs.trace_conj((rhs._coeffs));
+            return coeff().trace_conj(rhs.coeff());
         }
 
+        /// Packed coefficients are written in full precision, so the
+        /// layout is the same as for unpacked nodes and a loaded node is
+        /// never packed
         template <typename Archive>
         void serialize(Archive& ar) {
-            ar & coeff() & _has_children & _norm_tree;
+            if (Archive::is_output_archive && is_packed()) {
+                coeffT c = unpacked();
+                ar & c & _has_children & _norm_tree;
+            }
+            else {
+                ar & _coeffs & _has_children & _norm_tree;
+                if (Archive::is_input_archive) _packed = packedT();
+            }
         }
 
     };
@@ -726,6 +817,68 @@ namespace madness {
     };
 
 
+    /// per-thread accumulation buffers for the results of an operator apply
+
+    /// Each pool thread sums the partial results it produces into its own
+    /// map, keyed by the destination box, so that many (source, displacement)
+    /// pairs landing on the same box cost one accumulate on the owner instead
+    /// of one task each.  Threads outside the pool share the last slot, which
+    /// is guarded by a mutex.  A slot is handed back to the caller for
+    /// flushing once it holds threshold boxes; drain() collects whatever is
+    /// left and must only be called when no apply tasks are running.
+    template<typename T, std::size_t NDIM>
+    class ApplyBuffer {
+    public:
+        typedef Key<NDIM> keyT;
+        typedef Tensor<T> tensorT;
+        typedef std::map<keyT,tensorT> mapT;
+
+    private:
+        std::vector<mapT> slots;
+        Mutex shared_mutex;        ///< guards slots.back()
+        const std::size_t threshold;
+
+        bool add(mapT& slot, const keyT& key, const tensorT& t, mapT& full) {
+            typename mapT::iterator it=slot.find(key);
+            if (it==slot.end()) slot.insert(std::make_pair(key,t));
+            else it->second += t;
+            if (slot.size()<threshold) return false;
+            full.swap(slot);
+            return true;
+        }
+
+        ApplyBuffer(const ApplyBuffer&);
+        ApplyBuffer& operator=(const ApplyBuffer&);
+
+    public:
+        ApplyBuffer(std::size_t threshold)
+            : slots(ThreadPool::size()+1), threshold(std::max(threshold,std::size_t(1))) {}
+
+        /// sum t into the calling thread's buffer
+
+        /// @return true if the buffer is full; its contents are then moved to full
+        bool add(const keyT& key, const tensorT& t, mapT& full) {
+            const ThreadBase* thread=ThreadBase::this_thread();
+            const int ind = thread ? thread->get_pool_thread_index() : -1;
+            if (ind>=0 && ind+1<int(slots.size())) return add(slots[ind],key,t,full);
+            ScopedMutex<Mutex> guard(shared_mutex);
+            return add(slots.back(),key,t,full);
+        }
+
+        /// merge all buffers into result and empty them
+        void drain(mapT& result) {
+            for (std::size_t i=0; i<slots.size(); ++i) {
+                for (typename mapT::iterator it=slots[i].begin(); it!=slots[i].end(); ++it) {
+                    typename mapT::iterator jt=result.find(it->first);
+                    if (jt==result.end()) result.insert(*it);
+                    else jt->second += it->second;
+                }
+                mapT().swap(slots[i]);
+            }
+        }
+    };
+
+
     /// a class to track where relevant (parent) coeffs are
 
     /// E.g. if a 6D function is composed of two 3D functions their coefficients must be tracked.
@@ -914,6 +1067,7 @@ namespace madness {
         int truncate_mode; ///< 0=default=(|d|<thresh), 1=(|d|<thresh/2^n), 1=(|d|<thresh/4^n);
         bool autorefine; ///< If true, autorefine where appropriate
         bool truncate_on_project; ///< If true projection inserts at level n-1 not n
+        bool pack_results; ///< If true compress, reconstruct and apply pack the coefficients they compute
         TensorArgs targs; ///< type of tensor to be used in the FunctionNodes
 
         const FunctionCommonData<T,NDIM>& cdata;
@@ -924,6 +1078,9 @@ namespace madness {
 
         dcT coeffs; ///< The coefficients
 
+        /// buffers partial results of apply; null unless an apply is in progress
+        std::shared_ptr< ApplyBuffer<T,NDIM> > apply_buffer;
+
         // Disable the default copy constructor
         FunctionImpl(const FunctionImpl<T,NDIM>& p);
 
@@ -953,6 +1110,7 @@ namespace madness {
             , truncate_mode(factory._truncate_mode)
             , autorefine(factory._autorefine)
             , truncate_on_project(factory._truncate_on_project)
+            , pack_results(factory._pack_results)
             , nonstandard(false)
             , targs(factory._thresh,FunctionDefaults<NDIM>::get_tensor_type())
             , cdata(FunctionCommonData<T,NDIM>::get(k))
@@ -1016,6 +1174,7 @@ namespace madness {
             , truncate_mode(other.truncate_mode)
                          , autorefine(other.autorefine)
                          , truncate_on_project(other.truncate_on_project)
+                         , pack_results(other.pack_results)
                          , nonstandard(other.nonstandard)
                          , targs(other.targs)
                          , cdata(FunctionCommonData<T,NDIM>::get(k))
@@ -1196,6 +1355,10 @@ namespace madness {
 
         void set_autorefine(bool value);
 
+        bool get_pack_results() const;
+
+        void set_pack_results(bool value);
+
         int get_k() const;
 
         const dcT& get_coeffs() const;
@@ -1236,6 +1399,9 @@ namespace madness {
         /// @param[in]  key   the key of the current function node
         Future<bool> truncate_spawn(const keyT& key, double tol);
 
+        /// truncate_spawn for a group of sibling keys owned by this process, in one task
+        Future< std::vector<bool> > truncate_spawn_batch(const std::vector<keyT>& keys, double tol);
+
         /// Actually do the truncate operation
         /// @param[in] key the key to the current function node being evaluated for truncation
         /// @param[in] tol the tolerance for thresholding
@@ -2157,6 +2323,25 @@ namespace madness {
         };
 
 
+        /// pack or unpack the coefficients of the nodes, see FunctionNode::pack()
+        struct do_pack {
+            typedef Range<typename dcT::iterator> rangeT;
+
+            bool pack;
+
+            do_pack() : pack(true) {}
+            do_pack(bool pack) : pack(pack) {}
+
+            bool operator()(typename rangeT::iterator& it) const {
+                nodeT& node = it->second;
+                if (pack) node.pack();
+                else node.unpack();
+                return true;
+            }
+            template <typename Archive> void serialize(const Archive& ar) {}
+        };
+
+
 
         /// check symmetry wrt particle exchange
         struct do_check_symmetry_local {
@@ -3496,6 +3681,18 @@ namespace madness {
         // Called by result function to differentiate f
         void diff(const DerivativeBase<T,NDIM>* D, const implT* f, bool fence);
 
+        // Called by result function to differentiate f with neighbors from a halo
+        void diff(const DerivativeBase<T,NDIM>* D, const implT* f,
+                  const DerivativeHalo<T,NDIM>& halo, bool fence);
+
+        /// Batched find_neighbor lookups for DerivativeHalo, keys must be local
+
+        /// For each key returns what sock_it_to_me would, walking up the
+        /// tree as long as the parent is local.  If the walk reaches a parent
+        /// on another process, that parent is returned with empty
+        /// coefficients so the caller can ask its owner.
+        std::vector< std::pair<keyT,coeffT> > find_halo(const std::vector<keyT>& keys) const;
+
         /// Returns key of general neighbor enforcing BC
 
         /// Out of volume keys are mapped to enforce the BC as follows.
@@ -3907,6 +4104,12 @@ namespace madness {
         /// @param[in]  targs   target tensor arguments (threshold and full/low rank)
         void reduce_rank(const TensorArgs& targs, bool fence);
 
+        /// keep the coefficients in single precision, see FunctionNode::pack()
+        void pack(bool fence);
+
+        /// restore the coefficients to full precision
+        void unpack(bool fence);
+
         T eval_cube(Level n, coordT& x, const tensorT& c) const;
 
         /// Transform sum coefficients at level n to sums+differences at level n-1
@@ -3945,6 +4148,21 @@ namespace madness {
 
         coeffT unfilter(const coeffT& s) const;
 
+        /// filter() applied to several tensors at once
+
+        /// \c s has dimensions (2k,...,2k,m) and holds m tensors of
+        /// dimension \c cdata.v2k interleaved in its last index.  The m
+        /// transforms are done as NDIM products with \c cdata.hgT of m times
+        /// the usual size.  Returns the filtered tensors with dimensions
+        /// (m,2k,...,2k), i.e. each one contiguous.
+        tensorT filter_stacked(const tensorT& s) const;
+
+        /// unfilter() applied to several tensors at once, cf filter_stacked
+        tensorT unfilter_stacked(const tensorT& s) const;
+
+        /// the transform shared by filter_stacked and unfilter_stacked
+        tensorT transform_stacked(const tensorT& s, const Tensor<double>& c) const;
+
         /// downsample the sum coefficients of level n+1 to sum coeffs on level n
 
         /// specialization of the filter method, will yield only the sum coefficients
@@ -4043,6 +4261,27 @@ namespace madness {
         //        void reconstruct_op(const keyT& key, const tensorT& s);
         void reconstruct_op(const keyT& key, const coeffT& s);
 
+        /// reconstruct_op for a group of sibling keys owned by this process, sent in one message
+
+        /// Every key but the last gets its own task, so the children keep
+        /// unfiltering in parallel.
+        void reconstruct_batch(const std::vector<keyT>& keys, const std::vector<coeffT>& s);
+
+        /// reconstruct several functions in a single traversal of the union of their trees
+
+        /// All functions must share the process map and the wavelet order of
+        /// this, which only drives the traversal and need not be one of them.
+        /// At each node the sum and difference coefficients of all functions
+        /// are unfiltered together (cf unfilter_stacked).
+        void reconstruct_vector(const std::vector<implT*>& v, bool fence);
+
+        /// reconstruct_op for the functions of v at key; s holds their sum coefficients
+        void reconstruct_vector_op(const std::vector<implT*>& v, const keyT& key, const std::vector<coeffT>& s);
+
+        /// reconstruct_vector_op for a group of sibling keys owned by this process, sent in one message
+        void reconstruct_vector_batch(const std::vector<implT*>& v, const std::vector<keyT>& keys,
+                const std::vector< std::vector<coeffT> >& s);
+
         /// compress the wave function
 
         /// after application there will be sum coefficients at the root level,
@@ -4055,6 +4294,72 @@ namespace madness {
         // Invoked on node where key is local
         Future<coeffT > compress_spawn(const keyT& key, bool nonstandard, bool keepleaves, bool redundant);
 
+        /// compress_spawn for a group of sibling keys owned by this process, in one task
+        Future< std::vector<coeffT> > compress_spawn_batch(const std::vector<keyT>& keys,
+                bool nonstandard, bool keepleaves, bool redundant);
+
+        /// compress several functions in a single traversal of the union of their trees
+
+        /// All functions must share the process map and the wavelet order of
+        /// this, which only drives the traversal and need not be one of them.
+        /// At each node the child sum coefficients of all functions are
+        /// filtered together (cf filter_stacked).  The result is the same as
+        /// compress(false,false,false,fence) for each function.
+        void compress_vector(const std::vector<implT*>& v, bool fence);
+
+        /// compress_spawn for the functions of v; invoked on node where key is local
+
+        /// @return the sum coefficients of each function of v at key
+        Future< std::vector<coeffT> > compress_vector_spawn(const std::vector<implT*>& v, const keyT& key);
+
+        /// compress_vector_spawn for a group of sibling keys owned by this process, in one task
+        Future< std::vector< std::vector<coeffT> > > compress_vector_spawn_batch(const std::vector<implT*>& v,
+                const std::vector<keyT>& keys);
+
+        /// compress_op for the functions of v that have children at key
+
+        /// @param[in] v        the functions
+        /// @param[in] key      this's key
+        /// @param[in] leaves   sum coefficients of the functions for which key is a leaf
+        /// @param[in] children sum coefficients of the child nodes of the other functions
+        /// @return             the sum coefficients of each function of v at key
+        std::vector<coeffT> compress_vector_op(const std::vector<implT*>& v, const keyT& key,
+                const std::vector<coeffT>& leaves,
+                const std::vector< Future< std::vector<coeffT> > >& children);
+
+        /// compress, norm_tree and truncate in a single traversal of the reconstructed tree
+
+        /// The result is the same compressed tree as compress() followed by
+        /// truncate(), but the wavelet coefficients of truncated nodes are never
+        /// stored.  norm_tree of every node is set to the norm of the function
+        /// in its box, as norm_tree() does on the reconstructed tree.
+        void compress_truncate(double tol, bool fence);
+
+        /// What compress_truncate_spawn passes from a node to its parent
+        struct CompressTruncateResult {
+            coeffT s;           ///< sum coefficients of the node
+            double norm;        ///< norm of the function in the box of the node
+            bool has_coeff;     ///< true if the node or any of its descendants keeps coefficients
+
+            template <typename Archive> void serialize(const Archive& ar) {
+                ar & s & norm & has_coeff;
+            }
+        };
+
+        Future<CompressTruncateResult> compress_truncate_spawn(const keyT& key, double tol);
+
+        /// compress_truncate_spawn for a group of sibling keys owned by this process, in one task
+        Future< std::vector<CompressTruncateResult> > compress_truncate_spawn_batch(const std::vector<keyT>& keys, double tol);
+
+        /// compute the wavelet coefficients of a node and keep or truncate them
+
+        /// @param[in] key  this's key
+        /// @param[in] v    results of the child nodes
+        /// @param[in] tol  truncation tolerance
+        /// @return         the sum coefficients, norm and whether coefficients were kept
+        CompressTruncateResult compress_truncate_op(const keyT& key,
+                const std::vector< Future<CompressTruncateResult> >& v, double tol);
+
         /// convert this to redundant, i.e. have sum coefficients on all levels
         void make_redundant(const bool fence);
 
@@ -4069,6 +4374,12 @@ namespace madness {
 
         Future<double> norm_tree_spawn(const keyT& key);
 
+        /// norm_tree_spawn for a group of sibling keys owned by this process, in one task
+        Future< std::vector<double> > norm_tree_spawn_batch(const std::vector<keyT>& keys);
+
+        /// The children of \c key grouped by owner, one group per spawned task
+        KeyBatches<keyT> child_batches(const keyT& key) const;
+
         /// truncate using a tree in reconstructed form
 
         /// must be invoked where key is local
@@ -4116,7 +4427,9 @@ namespace madness {
                 const keyT& key = it->first;
                 nodeT& node = it->second;
                 if (key.level()> 0 && node.has_coeff()) {
-                    if (node.has_children()) {
+                    if (node.is_packed() and node.has_children()) {
+                        node.packed_coeff()(impl->cdata.s0)=0.0;
+                    } else if (node.has_children()) {
                         // Zero out scaling coeffs
                         node.coeff()(impl->cdata.s0)=0.0;
                         node.reduceRank(impl->targs.thresh);
@@ -4271,65 +4584,146 @@ namespace madness {
             // use to have static in front, but this is not thread-safe
             const std::vector<bool> is_periodic(NDIM,false); // Periodic sum is already done when making rnlp
 
-            for (typename std::vector<opkeyT>::const_iterator it=disp.begin(); it != disp.end(); ++it) {
-                //                const opkeyT& d = *it;
+            // working assumption here is that the operator is isotropic and
+            // montonically decreasing with distance
+            const double tol = truncate_tol(thresh, key);
+
+            // screen all displacements against the precomputed norm tables first
+            std::vector<int> index;
+            op->screen(source, cnorm, tol/fac, index);
 
+            // order the surviving displacements by translation, so that displacements
+            // applied together share the operator blocks of their leading dimensions
+            std::sort(index.begin(), index.end(), [&disp](int a, int b) {
+                return disp[a].translation() < disp[b].translation();
+            });
+
+            // destination keys of the surviving displacements
+            std::vector<keyT> dest(index.size());
+            const Key<NDIM-opdim> nullkey(key.level());
+            for (std::size_t i=0; i<index.size(); ++i) {
                 keyT d;
-                Key<NDIM-opdim> nullkey(key.level());
-                if (op->particle()==1) d=it->merge_with(nullkey);
-                if (op->particle()==2) d=nullkey.merge_with(*it);
+                if (op->particle()==1) d=disp[index[i]].merge_with(nullkey);
+                if (op->particle()==2) d=nullkey.merge_with(disp[index[i]]);
+                dest[i] = neighbor(key, d, is_periodic);
+            }
+
+            // apply the displacements in chunks, which bounds the memory held by
+            // the results while the separated terms of a chunk are transformed together
+            const std::size_t nchunk=16;
+            std::vector<opkeyT> shifts;
+            for (std::size_t i0=0; i0<index.size(); i0+=nchunk) {
+                const std::size_t i1=std::min(index.size(), i0+nchunk);
+                shifts.clear();
+                for (std::size_t i=i0; i<i1; ++i) shifts.push_back(disp[index[i]]);
+                const std::vector<tensorT> result = op->apply(source, shifts, c, tol/fac/cnorm);
+                for (std::size_t i=i0; i<i1; ++i) {
+                    if (result[i-i0].normf()> 0.3*tol/fac) {
+                        accumulate_buffered(dest[i], result[i-i0]);
+                    }
+                }
+            }
+        }
 
-                keyT dest = neighbor(key, d, is_periodic);
 
-                if (dest.is_valid()) {
-                    double opnorm = op->norm(key.level(), *it, source);
-                    // working assumption here is that the operator is isotropic and
-                    // montonically decreasing with distance
-                    double tol = truncate_tol(thresh, key);
+        /// accumulate the result of an apply into box dest
 
-                    //print("APP", key, dest, cnorm, opnorm, (cnorm*opnorm> tol/fac));
+        /// Goes through the apply buffer if there is one, otherwise sends
+        /// an accumulate task to the owner of dest.
+        void accumulate_buffered(const keyT& dest, const tensorT& t) {
+            ApplyBuffer<T,NDIM>* buffer=apply_buffer.get();
+            if (not buffer) {
+                coeffs.task(dest, &nodeT::accumulate2, t, coeffs, dest, TaskAttributes::hipri());
+                return;
+            }
+            typename ApplyBuffer<T,NDIM>::mapT full;
+            if (buffer->add(dest, t, full)) send_accumulate_batches(full);
+        }
 
-                    if (cnorm*opnorm> tol/fac) {
+        /// send buffered results to their owners, one batch per process
+        void send_accumulate_batches(const typename ApplyBuffer<T,NDIM>::mapT& buf) {
+            typedef std::vector< std::pair<keyT,tensorT> > batchT;
+            std::map<ProcessID,batchT> batches;
+            for (typename ApplyBuffer<T,NDIM>::mapT::const_iterator it=buf.begin(); it!=buf.end(); ++it) {
+                batches[coeffs.owner(it->first)].push_back(*it);
+            }
+            for (typename std::map<ProcessID,batchT>::const_iterator it=batches.begin(); it!=batches.end(); ++it) {
+                if (it->first == world.rank()) accumulate_batch(it->second);
+                else woT::task(it->first, &implT::accumulate_batch, it->second, TaskAttributes::hipri());
+            }
+        }
 
-                        // // Most expensive part is the kernel ... do it in a separate task
-                        // if (d.distsq()==0) {
-                        //     // This introduces finer grain parallelism
-                        //     ProcessID where = world.rank();
-                        //     do_op_args<opdim> args(source, *it, dest, tol, fac, cnorm);
-                        //     woT::task(where, &implT:: template do_apply_kernel<opT,R,opdim>, op, c, args);
-                        // } else {
-                            tensorT result = op->apply(source, *it, c, tol/fac/cnorm);
-                            if (result.normf()> 0.3*tol/fac) {
-                                coeffs.task(dest, &nodeT::accumulate2, result, coeffs, dest, TaskAttributes::hipri());
-                            }
-                        // }
-                    } else if (d.distsq() >= 1)
-                        break; // Assumes monotonic decay beyond nearest neighbor
-                }
+        /// accumulate a batch of results into local boxes
+        void accumulate_batch(const std::vector< std::pair<keyT,tensorT> >& batch) {
+            for (std::size_t i=0; i<batch.size(); ++i) {
+                typename dcT::accessor acc;
+                coeffs.insert(acc, batch[i].first);
+                acc->second.accumulate2(batch[i].second, coeffs, batch[i].first);
             }
         }
 
+        /// send whatever is left in the apply buffer to the owners and remove it
+
+        /// Must be called on all processes after the apply tasks have completed,
+        /// i.e. after a fence.  Another fence is needed before the result can be used.
+        /// @return false if there was no buffer, i.e. nothing needs to be fenced
+        bool flush_apply_buffer() {
+            if (not apply_buffer) return false;
+            typename ApplyBuffer<T,NDIM>::mapT buf;
+            apply_buffer->drain(buf);
+            apply_buffer.reset();
+            send_accumulate_batches(buf);
+            return true;
+        }
+
+        /// spawn do_apply on packed coefficients, which the operator reads in single precision
+        template <typename opT>
+        void spawn_packed_apply(opT& op, ProcessID p, const keyT& key, const Tensor<float>& c) {
+            woT::task(p, &implT:: template do_apply<opT,float>, &op, key, c);
+        }
+
+        /// spawn do_apply on packed complex coefficients, which are converted to double precision
+        template <typename opT>
+        void spawn_packed_apply(opT& op, ProcessID p, const keyT& key, const Tensor<float_complex>& c) {
+            const Tensor<double_complex> cc = c;
+            woT::task(p, &implT:: template do_apply<opT,double_complex>, &op, key, cc);
+        }
 
         /// apply an operator on f to return this
+
+        /// Packed nodes of f (see FunctionNode::pack()) are read in single
+        /// precision.  If FunctionDefaults::get_apply_buffer_size() is nonzero the partial
+        /// results are summed in per-thread buffers before being sent to their
+        /// owners.  Without a fence the caller must fence, call
+        /// flush_apply_buffer() and fence again before using the result.
         template <typename opT, typename R>
         void apply(opT& op, const FunctionImpl<R,NDIM>& f, bool fence) {
             PROFILE_MEMBER_FUNC(FunctionImpl);
             MADNESS_ASSERT(!op.modified());
+            const std::size_t bufsize=FunctionDefaults<NDIM>::get_apply_buffer_size();
+            if (bufsize > 0) apply_buffer.reset(new ApplyBuffer<T,NDIM>(bufsize));
             typename dcT::const_iterator end = f.coeffs.end();
             for (typename dcT::const_iterator it=f.coeffs.begin(); it!=end; ++it) {
                 // looping through all the coefficients in the source
                 const keyT& key = it->first;
                 const FunctionNode<R,NDIM>& node = it->second;
                 if (node.has_coeff()) {
-                    if (node.coeff().dim(0) != k || op.doleaves) {
+                    const long dim0 = node.is_packed() ? node.packed_coeff().dim(0) : node.coeff().dim(0);
+                    if (dim0 != k || op.doleaves) {
                         ProcessID p = FunctionDefaults<NDIM>::get_apply_randomize() ? world.random_proc() : coeffs.owner(key);
 //                        woT::task(p, &implT:: template do_apply<opT,R>, &op, key, node.coeff()); //.full_tensor_copy() ????? why copy ????
-                        woT::task(p, &implT:: template do_apply<opT,R>, &op, key, node.coeff().reconstruct_tensor());
+                        if (node.is_packed()) spawn_packed_apply(op, p, key, node.packed_coeff());
+                        else woT::task(p, &implT:: template do_apply<opT,R>, &op, key, node.coeff().reconstruct_tensor());
                     }
                 }
             }
-            if (fence)
+            if (fence) {
                 world.gop.fence();
+                if (bufsize > 0) {
+                    flush_apply_buffer();
+                    world.gop.fence();
+                }
+            }
 
             this->compressed=true;
             this->nonstandard=true;
@@ -95,6 +95,7 @@ namespace madness {
         bool _empty;
         bool _autorefine;
         bool _truncate_on_project;
+        bool _pack_results;
         bool _fence;
         bool _is_on_demand;
         bool _compressed;
@@ -126,6 +127,7 @@ namespace madness {
             _autorefine(FunctionDefaults<NDIM>::get_autorefine()),
             _truncate_on_project(
                                  FunctionDefaults<NDIM>::get_truncate_on_project()),
+            _pack_results(FunctionDefaults<NDIM>::get_pack_results()),
             _fence(true), // _bc(FunctionDefaults<NDIM>::get_bc()),
             _is_on_demand(false),
             _compressed(false),
@@ -231,6 +233,11 @@ namespace madness {
             return self();
         }
         FunctionFactory&
+        pack_results(bool flag=true) {
+            _pack_results = flag;
+            return self();
+        }
+        FunctionFactory&
         truncate_on_project() {
             _truncate_on_project = true;
             return self();
@@ -41,6 +41,7 @@
 
 #include <madness/mra/key.h>
 #include <madness/mra/funcdefaults.h>
+#include <madness/mra/sfcpmap.h>
 
 /// \file mra/lbdeux.h
 /// \brief Implements (2nd generation) static load/data balancing for functions
@@ -389,6 +390,147 @@ namespace madness {
 
             return std::shared_ptr< WorldDCPmapInterface<keyT> >(new LBDeuxPmap<NDIM>(map));
         }
+
+        /// Partitions the tree into segments of a space-filling curve of about equal cost
+
+        /// Each box at level \c n (SFCPmap::default_level if negative) weighs
+        /// the cost of its subtree, and a leaf above that level its own cost.
+        /// The cost of interior nodes above level \c n is not counted.  Use
+        /// either this or load_balance(), since both sum the costs up the tree.
+        ///
+        /// Unlike load_balance() nothing is collected on one process.  The
+        /// weights are sent to the processes owning equal pieces of the curve,
+        /// so each one holds its piece in curve order.  A global sum of the
+        /// totals of the pieces gives every process the cost before its piece,
+        /// hence the cuts falling inside it, and a global minimum combines
+        /// them.  Besides the weights, which move once, only vectors of
+        /// world.size() numbers are communicated.
+        std::shared_ptr< WorldDCPmapInterface<keyT> > sfc_pmap(Level n=-1, SFCCurve curve=SFC_HILBERT, bool printstuff=false) {
+            if (n < 0) n = SFCPmap<NDIM>::default_level(world.size());
+            std::vector< std::pair<uint64_t,double> > local;
+            double before, total;
+            sfc_order(n, curve, local, before, total);
+
+            // Process q+1 starts at the first box whose middle reaches (q+1)/nproc
+            // of the total, as in SFCPmap::partition
+            const int nproc = world.size();
+            std::vector<double> targets(nproc-1);
+            for (int q=0; q<nproc-1; ++q) targets[q] = total*(q+1)/nproc;
+            std::vector<uint64_t> cuts = sfc_first(local, before, targets, false);
+
+            if (printstuff && world.rank() == 0) {
+                print("THESE ARE THE CUTS ALONG THE CURVE");
+                print(cuts);
+            }
+            world.gop.fence();
+
+            return std::shared_ptr< WorldDCPmapInterface<keyT> >(new SFCPmap<NDIM>(world, n, curve, cuts));
+        }
+
+        /// Moves the cuts of the current SFCPmap no further than needed to balance the cost
+
+        /// The boxes are weighed as in sfc_pmap(), along the curve and at the
+        /// level of the map the tree was made with.  The cost of each process
+        /// may differ from the average by \c tolerance times the average, so
+        /// each cut may lie anywhere in a window around its ideal position; a
+        /// cut already in its window stays and one outside moves to the near
+        /// end.  Only the boxes a cut passes over change owner, which is the
+        /// least cost that can move while the windows do not overlap, i.e.,
+        /// for a tolerance below one.  To keep the bytes moved small let the
+        /// cost of a node grow with its size.
+        ///
+        /// If the tree was not made with an SFCPmap for this number of
+        /// processes everything has to move anyway and this is sfc_pmap().
+        std::shared_ptr< WorldDCPmapInterface<keyT> > sfc_rebalance(double tolerance=0.1, bool printstuff=false) {
+            std::shared_ptr< SFCPmap<NDIM> > old = std::dynamic_pointer_cast< SFCPmap<NDIM> >(tree.get_pmap());
+            if (!old || int(old->get_cuts().size()) != world.size()-1) return sfc_pmap(-1, SFC_HILBERT, printstuff);
+
+            std::vector< std::pair<uint64_t,double> > local;
+            double before, total;
+            sfc_order(old->get_level(), old->get_curve(), local, before, total);
+
+            const int nproc = world.size();
+            const double slack = 0.5*tolerance*total/nproc;
+            std::vector<double> lo(nproc-1), hi(nproc-1);
+            for (int q=0; q<nproc-1; ++q) {
+                lo[q] = total*(q+1)/nproc - slack;
+                hi[q] = total*(q+1)/nproc + slack;
+            }
+            const std::vector<uint64_t> first = sfc_first(local, before, lo, false);
+            const std::vector<uint64_t> last = sfc_first(local, before, hi, true);
+            std::vector<uint64_t> cuts = old->get_cuts();
+            for (int q=0; q<nproc-1; ++q) cuts[q] = std::max(first[q], std::min(cuts[q], last[q]));
+
+            if (printstuff && world.rank() == 0) {
+                print("THESE ARE THE CUTS ALONG THE CURVE");
+                print(old->get_cuts());
+                print(cuts);
+            }
+            world.gop.fence();
+
+            return std::shared_ptr< WorldDCPmapInterface<keyT> >(new SFCPmap<NDIM>(world, old->get_level(), old->get_curve(), cuts));
+        }
+
+    private:
+        /// Sends the weights of the boxes at level \c n to the owners of equal pieces of the curve
+
+        /// On return \c local holds the (curve index, cost) pairs of the piece
+        /// of this process in curve order, \c before the cost of the pieces
+        /// preceding it and \c total the cost of all of them.
+        void sfc_order(Level n, SFCCurve curve, std::vector< std::pair<uint64_t,double> >& local,
+                       double& before, double& total) {
+            sum();
+
+            std::shared_ptr< SFCPmap<NDIM> > order(new SFCPmap<NDIM>(world, n, curve));
+            treeT weights(world, order);
+            const_iteratorT end = tree.end();
+            for (const_iteratorT it=tree.begin(); it!=end; ++it) {
+                const keyT& key = it->first;
+                if (key.level() == n || (key.level() < n && !it->second.has_children())) {
+                    weights.replace(key, it->second);
+                }
+            }
+            world.gop.fence();
+
+            local.clear();
+            local.reserve(weights.size());
+            const_iteratorT wend = weights.end();
+            for (const_iteratorT it=weights.begin(); it!=wend; ++it) {
+                local.push_back(std::make_pair(order->index(it->first), it->second.get_total_cost()));
+            }
+            std::sort(local.begin(), local.end());
+
+            const int nproc = world.size();
+            std::vector<double> totals(nproc, 0.0);
+            for (std::size_t i=0; i<local.size(); ++i) totals[world.rank()] += local[i].second;
+            world.gop.sum(&totals[0], nproc);
+            total = before = 0.0;
+            for (int p=0; p<nproc; ++p) {
+                if (p < world.rank()) before += totals[p];
+                total += totals[p];
+            }
+        }
+
+        /// The first box along the curve whose middle reaches (or if \c strict passes) each target cost
+
+        /// \c targets must not decrease.  Pieces of later processes propose
+        /// later boxes for targets already reached before them, hence a
+        /// global minimum gives the answer.  Beyond the last box the result
+        /// is the largest index.
+        std::vector<uint64_t> sfc_first(const std::vector< std::pair<uint64_t,double> >& local, double before,
+                                        const std::vector<double>& targets, bool strict) {
+            std::vector<uint64_t> cuts(targets.size(), std::numeric_limits<uint64_t>::max());
+            std::size_t q = 0;
+            for (std::size_t i=0; i<local.size(); ++i) {
+                const double middle = before + 0.5*local[i].second;
+                while (q < targets.size() && (strict ? middle > targets[q] : middle >= targets[q])) {
+                    cuts[q++] = local[i].first;
+                }
+                before += local[i].second;
+            }
+            if (!cuts.empty()) world.gop.min(&cuts[0], cuts.size());
+            return cuts;
+        }
     };
 }
 
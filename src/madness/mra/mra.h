@@ -69,6 +69,7 @@ namespace madness {
 #include <madness/world/worlddc.h>
 #include <madness/mra/funcdefaults.h>
 #include <madness/mra/function_factory.h>
+#include <madness/mra/sfcpmap.h>
 #include <madness/mra/lbdeux.h>
 #include <madness/mra/funcimpl.h>
 
@@ -546,6 +547,25 @@ namespace madness {
         }
 
 
+        /// Returns value of pack_results flag (see FunctionDefaults::set_pack_results()).  No communication.
+        bool pack_results() const {
+            PROFILE_MEMBER_FUNC(Function);
+            if (!impl) return false;
+            return impl->get_pack_results();
+        }
+
+
+        /// Sets the value of the pack_results flag.  Optional global fence.
+
+        /// A fence is required to ensure consistent global state.
+        void set_pack_results(bool value, bool fence = true) {
+            PROFILE_MEMBER_FUNC(Function);
+            verify();
+            impl->set_pack_results(value);
+            if (fence) impl->world.gop.fence();
+        }
+
+
         /// Returns value of truncation threshold.  No communication.
         double thresh() const {
             PROFILE_MEMBER_FUNC(Function);
@@ -593,6 +613,27 @@ namespace madness {
         }
 
 
+        /// Compresses and truncates the function in one traversal of the tree, with optional fence
+
+        /// Gives the same result as compress() followed by truncate(), without
+        /// storing the wavelet coefficients that are truncated, and also sets
+        /// norm_tree of each node to the norm of the function in its box.  If
+        /// the function is already compressed it is just truncated.
+        ///
+        /// Returns this for chaining.
+        /// @param[in] tol Tolerance for truncating the coefficients. Default 0.0 means use the implementation's member value \c thresh instead.
+        /// @param[in] fence Do fence
+        Function<T,NDIM>& compress_truncate(double tol = 0.0, bool fence = true) {
+            PROFILE_MEMBER_FUNC(Function);
+            if (!impl) return *this;
+            verify();
+            if (is_compressed()) impl->truncate(tol,fence);
+            else impl->compress_truncate(tol,fence);
+            if (VERIFY_TREE) verify_tree();
+            return *this;
+        }
+
+
         /// Returns a shared-pointer to the implementation
         const std::shared_ptr< FunctionImpl<T,NDIM> >& get_impl() const {
             PROFILE_MEMBER_FUNC(Function);
@@ -1497,6 +1538,31 @@ namespace madness {
             impl->reduce_rank(impl->get_tensor_args(),fence);
             return *this;
         }
+
+        /// Keeps the coefficients in single precision, which halves their memory
+
+        /// For functions that are kept but not used for a while, e.g. the
+        /// orbitals of earlier iterations.  Single precision keeps about 7
+        /// digits, so this is meant for thresholds well above 1e-7.  Until
+        /// unpack() is called the function can be copied, stored,
+        /// redistributed, compressed, reconstructed and used as the source
+        /// of apply() in up to 3 dimensions, which read the packed
+        /// coefficients and accumulate in double precision; other
+        /// operations throw.  Stored or redistributed
+        /// nodes are written in full precision and arrive unpacked, so
+        /// restart files keep their layout.
+        Function<T,NDIM>& pack(const bool fence=true) {
+            verify();
+            impl->pack(fence);
+            return *this;
+        }
+
+        /// Restores the coefficients to full precision after pack()
+        Function<T,NDIM>& unpack(const bool fence=true) {
+            verify();
+            impl->unpack(fence);
+            return *this;
+        }
     };
 
     template <typename T, typename opT, int NDIM>
@@ -1922,6 +1988,9 @@ namespace madness {
 
 
     /// Apply operator ONLY in non-standard form - required other steps missing !!
+
+    /// Without a fence the result may still sit in the apply buffers; call
+    /// flush_apply_buffer(result,false) before using it.
     template <typename opT, typename R, std::size_t NDIM>
     Function<TENSOR_RESULT_TYPE(typename opT::opT,R), NDIM>
     apply_only(const opT& op, const Function<R,NDIM>& f, bool fence=true) {
@@ -1961,6 +2030,17 @@ namespace madness {
         return result;
     }
 
+    /// Sends the results an unfenced apply_only() left in the apply buffers
+
+    /// A fenced apply_only() has flushed already.  Otherwise this fences,
+    /// flushes and fences again, so it must be called on all processes.
+    template <typename T, std::size_t NDIM>
+    void flush_apply_buffer(Function<T,NDIM>& result, bool fenced) {
+        if (fenced) return;
+        result.world().gop.fence();
+        if (result.get_impl()->flush_apply_buffer()) result.world().gop.fence();
+    }
+
     /// Apply operator in non-standard form
 
     /// Returns a new function with the same distribution
@@ -1985,6 +2065,7 @@ namespace madness {
     		MADNESS_ASSERT(not op.is_slaterf12);
     	    ff.get_impl()->make_redundant(true);
             result = apply_only(op, ff, fence);
+            flush_apply_buffer(result, fence);
             ff.get_impl()->undo_redundant(false);
             result.get_impl()->trickle_down(true);
 
@@ -2007,6 +2088,7 @@ namespace madness {
                 fff.get_impl()->timer_compress_svd.print("compress_svd");
             }
             result = apply_only(op, fff, fence);
+            flush_apply_buffer(result, fence);
             result.reconstruct();
 //            fff.clear();
             if (op.destructive()) {
@@ -2309,6 +2391,17 @@ namespace madness {
         ar2 & f;
     }
 
+    /// Saves a function, every process writing its own nodes to its own shard
+
+    /// Any number of processes can load() it again.  Older versions of
+    /// MADNESS cannot read the shards; use save() for that.
+    template <class T, std::size_t NDIM>
+    void save_sharded(const Function<T,NDIM>& f, const std::string name) {
+        archive::ParallelOutputArchive ar2(f.world(), name.c_str(), 0);
+        ar2 & f;
+    }
+
+    /// Loads a function saved by save(), save_sharded() or to any ParallelOutputArchive
     template <class T, std::size_t NDIM>
     void load(Function<T,NDIM>& f, const std::string name) {
         archive::ParallelInputArchive ar2(f.world(), name.c_str(), 1);
@@ -2322,6 +2415,7 @@ namespace madness {
 #include <madness/mra/operator.h>
 #include <madness/mra/functypedefs.h>
 #include <madness/mra/vmra.h>
+#include <madness/mra/funcfile.h>
 // #include <madness/mra/mraimpl.h> !!!!!!!!!!!!! NOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO  !!!!!!!!!!!!!!!!!!
 
 #endif // MADNESS_MRA_MRA_H__INCLUDED
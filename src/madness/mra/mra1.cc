@@ -44,12 +44,12 @@
 namespace madness {
 
     template <>
-    ConcurrentHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double> > >
-    GaussianConvolution1DCache<double>::map = ConcurrentHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double> > >();
+    GaussianConvolution1DCache<double>::mapT
+    GaussianConvolution1DCache<double>::map = GaussianConvolution1DCache<double>::mapT();
 
     template <>
-    ConcurrentHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double_complex> > >
-    GaussianConvolution1DCache<double_complex>::map = ConcurrentHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double_complex> > >();
+    GaussianConvolution1DCache<double_complex>::mapT
+    GaussianConvolution1DCache<double_complex>::map = GaussianConvolution1DCache<double_complex>::mapT();
 
 #ifdef FUNCTION_INSTANTIATE_1
 
@@ -296,6 +296,12 @@ namespace madness {
     template <typename T, std::size_t NDIM>
     void FunctionImpl<T,NDIM>::set_autorefine(bool value) {autorefine = value;}
 
+    template <typename T, std::size_t NDIM>
+    bool FunctionImpl<T,NDIM>::get_pack_results() const {return pack_results;}
+
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::set_pack_results(bool value) {pack_results = value;}
+
     template <typename T, std::size_t NDIM>
     int FunctionImpl<T,NDIM>::get_k() const {return k;}
 
@@ -1057,6 +1063,33 @@ namespace madness {
     }
 
 
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::diff(const DerivativeBase<T,NDIM>* D, const implT* f,
+                                    const DerivativeHalo<T,NDIM>& halo, bool fence) {
+        typedef std::pair<keyT,coeffT> argT;
+        typedef typename DerivativeBase<T,NDIM>::diff2T diff2T;
+        std::vector<diff2T> work;
+        typename dcT::const_iterator end = f->coeffs.end();
+        for (typename dcT::const_iterator it=f->coeffs.begin(); it!=end; ++it) {
+            const keyT& key = it->first;
+            const nodeT& node = it->second;
+            if (node.has_coeff()) {
+                D->do_diff1_halo(f, this, key, argT(), argT(key,node.coeff()), argT(), halo, work);
+                if (work.size() >= DerivativeBase<T,NDIM>::diff2_batch_size) {
+                    world.taskq.add(*D, &DerivativeBase<T,NDIM>::do_diff2_batch, f, this, work, TaskAttributes::hipri());
+                    work.clear();
+                }
+            }
+            else {
+                coeffs.replace(key,nodeT(coeffT(),true)); // Empty internal node
+            }
+        }
+        if (!work.empty())
+            world.taskq.add(*D, &DerivativeBase<T,NDIM>::do_diff2_batch, f, this, work, TaskAttributes::hipri());
+        if (fence) world.gop.fence();
+    }
+
+
     /// return the a std::pair<key, node>, which MUST exist
     template <typename T, std::size_t NDIM>
     std::pair<Key<NDIM>,ShallowNode<T,NDIM> > FunctionImpl<T,NDIM>::find_datum(keyT key) const {
@@ -1175,6 +1208,16 @@ namespace madness {
         flo_unary_op_node_inplace(do_reduce_rank(targs),fence);
     }
 
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::pack(bool fence) {
+        flo_unary_op_node_inplace(do_pack(true),fence);
+    }
+
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::unpack(bool fence) {
+        flo_unary_op_node_inplace(do_pack(false),fence);
+    }
+
 
     /// Transform sum coefficients at level n to sums+differences at level n-1
 
@@ -1231,6 +1274,49 @@ namespace madness {
         return transform(s,cdata.hg);
     }
 
+    template <typename T, std::size_t NDIM>
+    typename FunctionImpl<T,NDIM>::tensorT FunctionImpl<T,NDIM>::filter_stacked(const tensorT& s) const {
+        return transform_stacked(s,cdata.hgT);
+    }
+
+    template <typename T, std::size_t NDIM>
+    typename FunctionImpl<T,NDIM>::tensorT FunctionImpl<T,NDIM>::unfilter_stacked(const tensorT& s) const {
+        return transform_stacked(s,cdata.hg);
+    }
+
+    /// Each of the NDIM products contracts the leading index and appends the
+    /// transformed one, as in fast_transform.  The stacking index starts
+    /// last, so it is carried along as part of the rows and ends up first.
+    template <typename T, std::size_t NDIM>
+    typename FunctionImpl<T,NDIM>::tensorT FunctionImpl<T,NDIM>::transform_stacked(const tensorT& s, const Tensor<double>& c) const {
+        MADNESS_ASSERT(s.ndim()==NDIM+1 && s.iscontiguous());
+        const long dimj = c.dim(1);
+        const long m = s.dim(NDIM);
+        std::vector<long> dims(NDIM+1,dimj);
+        dims[0] = m;
+        tensorT result(dims,false);
+        tensorT work(dims,false);
+
+        const double* pc = c.ptr();
+        T *t0=work.ptr(), *t1=result.ptr();
+        if (NDIM&1) std::swap(t0,t1);
+
+        const long dimi = s.size()/dimj;
+        const T* src = s.ptr();
+        for (std::size_t n=0; n<NDIM; ++n) {
+            if (IS_ODD(dimi) || IS_ODD(dimj)) {
+                for (long i=0; i<dimi*dimj; ++i) t0[i] = 0.0;
+                mTxm(dimi, dimj, dimj, t0, src, pc);
+            }
+            else {
+                mTxmq(dimi, dimj, dimj, t0, src, pc);
+            }
+            src = t0;
+            std::swap(t0,t1);
+        }
+        return result;
+    }
+
     /// downsample the sum coefficients of level n+1 to sum coeffs on level n
 
     /// specialization of the filter method, will yield only the sum coefficients
@@ -1456,6 +1542,21 @@ namespace madness {
             world.gop.fence();
     }
 
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::reconstruct_vector(const std::vector<implT*>& v, bool fence) {
+        for (std::size_t i=0; i<v.size(); ++i) {
+            MADNESS_ASSERT(not v[i]->is_redundant());
+            MADNESS_ASSERT(v[i]->get_pmap() == get_pmap() && v[i]->get_k() == k);
+            v[i]->nonstandard = v[i]->compressed = v[i]->redundant = false;
+        }
+        if (!v.empty() && world.rank() == coeffs.owner(cdata.key0)) {
+            woT::task(world.rank(), &implT::reconstruct_vector_op, v, cdata.key0,
+                      std::vector<coeffT>(v.size()));
+        }
+        if (fence)
+            world.gop.fence();
+    }
+
     /// compress the wave function
 
     /// after application there will be sum coefficients at the root level,
@@ -1485,6 +1586,136 @@ namespace madness {
             world.gop.fence();
     }
 
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::compress_vector(const std::vector<implT*>& v, bool fence) {
+        for (std::size_t i=0; i<v.size(); ++i) {
+            MADNESS_ASSERT(not v[i]->is_redundant());
+            MADNESS_ASSERT(v[i]->get_pmap() == get_pmap() && v[i]->get_k() == k);
+            v[i]->compressed = true;
+            v[i]->nonstandard = false;
+            v[i]->redundant = false;
+        }
+        if (!v.empty() && world.rank() == coeffs.owner(cdata.key0)) {
+            compress_vector_spawn(v, cdata.key0);
+        }
+        if (fence)
+            world.gop.fence();
+    }
+
+    /// compress, norm_tree and truncate in a single traversal, optional fence
+
+    /// If tol<=0 the default value of this->thresh is used
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::compress_truncate(double tol, bool fence) {
+        MADNESS_ASSERT(not is_compressed());
+        if (tol <= 0.0)
+            tol = thresh;
+        // Must set true here so that successive calls without fence do the right thing
+        this->compressed = true;
+        this->nonstandard = false;
+        this->redundant = false;
+
+        if (world.rank() == coeffs.owner(cdata.key0)) {
+            compress_truncate_spawn(cdata.key0, tol);
+        }
+        if (fence)
+            world.gop.fence();
+    }
+
+    template <typename T, std::size_t NDIM>
+    Future<typename FunctionImpl<T,NDIM>::CompressTruncateResult>
+    FunctionImpl<T,NDIM>::compress_truncate_spawn(const keyT& key, double tol) {
+        MADNESS_ASSERT(coeffs.probe(key));
+        nodeT& node = coeffs.find(key).get()->second;
+        if (node.has_children()) {
+            std::vector< Future<CompressTruncateResult> > v = world.taskq.batch<CompressTruncateResult>(child_batches(key),
+                [this,tol](ProcessID p, const std::vector<keyT>& keys) {
+                    return woT::task(p, &implT::compress_truncate_spawn_batch, keys, tol, TaskAttributes::hipri());
+                });
+            return woT::task(world.rank(),&implT::compress_truncate_op, key, v, tol, TaskAttributes::hipri());
+        }
+        else {
+            // leaves keep no coefficients in compressed form
+            CompressTruncateResult result = {node.coeff(), node.coeff().normf(), false};
+            node.set_norm_tree(result.norm);
+            node.clear_coeff();
+            return Future<CompressTruncateResult>(result);
+        }
+    }
+
+    template <typename T, std::size_t NDIM>
+    Future< std::vector<typename FunctionImpl<T,NDIM>::CompressTruncateResult> >
+    FunctionImpl<T,NDIM>::compress_truncate_spawn_batch(const std::vector<keyT>& keys, double tol) {
+        std::vector< Future<CompressTruncateResult> > v;
+        v.reserve(keys.size());
+        for (std::size_t i=0; i<keys.size(); ++i) v.push_back(compress_truncate_spawn(keys[i], tol));
+        return world.taskq.gather(v);
+    }
+
+    template <typename T, std::size_t NDIM>
+    typename FunctionImpl<T,NDIM>::CompressTruncateResult
+    FunctionImpl<T,NDIM>::compress_truncate_op(const keyT& key,
+            const std::vector< Future<CompressTruncateResult> >& v, double tol) {
+        double cpu0=cpu_time();
+        // Copy child scaling coeffs into contiguous block
+        tensorT d(cdata.v2k);
+        double norm = 0.0;
+        bool child_has_coeff = false;
+        int i=0;
+        for (KeyChildIterator<NDIM> kit(key); kit; ++kit,++i) {
+            const CompressTruncateResult& r = v[i].get();
+            if (r.s.has_data()) d(child_patch(kit.key())) += r.s.full_tensor_copy();
+            norm += r.norm*r.norm;
+            child_has_coeff = child_has_coeff || r.has_coeff;
+        }
+        norm = sqrt(norm);
+
+        d = filter(d);
+        double cpu1=cpu_time();
+        timer_filter.accumulate(cpu1-cpu0);
+        cpu0=cpu1;
+
+        typename dcT::accessor acc;
+        MADNESS_ASSERT(coeffs.find(acc, key));
+        nodeT& node = acc->second;
+
+        if (node.has_coeff()) {
+            const tensorT c = node.coeff().full_tensor_copy();
+            if (c.dim(0) == k) {
+                d(cdata.s0) += c;
+            }
+            else {
+                d += c;
+            }
+        }
+
+        // tighter thresh for internal nodes
+        TensorArgs targs2=targs;
+        targs2.thresh*=0.1;
+
+        // need the deep copy for contiguity
+        CompressTruncateResult result = {coeffT(copy(d(cdata.s0)),targs2), norm, true};
+        if (key.level() > 0) d(cdata.s0) = 0.0;
+        node.set_norm_tree(norm);
+
+        // As truncate_op: a parent of coefficients is kept, and not below level 2
+        if (!child_has_coeff && key.level() > 1 && d.normf() < truncate_tol(tol,key)) {
+            node.clear_coeff();
+            node.set_has_children(false);
+            for (KeyChildIterator<NDIM> kit(key); kit; ++kit) {
+                coeffs.erase(kit.key());
+            }
+            result.has_coeff = false;
+        }
+        else {
+            node.set_coeff(coeffT(d,targs2));
+        }
+        cpu1=cpu_time();
+        timer_compress_svd.accumulate(cpu1-cpu0);
+
+        return result;
+    }
+
     /// convert this to redundant, i.e. have sum coefficients on all levels
     template <typename T, std::size_t NDIM>
     void FunctionImpl<T,NDIM>::make_redundant(const bool fence) {
@@ -1542,11 +1773,10 @@ namespace madness {
     Future<double> FunctionImpl<T,NDIM>::norm_tree_spawn(const keyT& key) {
         nodeT& node = coeffs.find(key).get()->second;
         if (node.has_children()) {
-            std::vector< Future<double> > v = future_vector_factory<double>(1<<NDIM);
-            int i=0;
-            for (KeyChildIterator<NDIM> kit(key); kit; ++kit,++i) {
-                v[i] = woT::task(coeffs.owner(kit.key()), &implT::norm_tree_spawn, kit.key());
-            }
+            std::vector< Future<double> > v = world.taskq.batch<double>(child_batches(key),
+                [this](ProcessID p, const std::vector<keyT>& keys) {
+                    return woT::task(p, &implT::norm_tree_spawn_batch, keys);
+                });
             return woT::task(world.rank(),&implT::norm_tree_op, key, v);
         }
         else {
@@ -1558,6 +1788,22 @@ namespace madness {
         }
     }
 
+    template <typename T, std::size_t NDIM>
+    Future< std::vector<double> > FunctionImpl<T,NDIM>::norm_tree_spawn_batch(const std::vector<keyT>& keys) {
+        std::vector< Future<double> > v;
+        v.reserve(keys.size());
+        for (std::size_t i=0; i<keys.size(); ++i) v.push_back(norm_tree_spawn(keys[i]));
+        return world.taskq.gather(v);
+    }
+
+    template <typename T, std::size_t NDIM>
+    KeyBatches< Key<NDIM> > FunctionImpl<T,NDIM>::child_batches(const keyT& key) const {
+        std::vector<keyT> children;
+        children.reserve(1<<NDIM);
+        for (KeyChildIterator<NDIM> kit(key); kit; ++kit) children.push_back(kit.key());
+        return KeyBatches<keyT>(children, [this](const keyT& child) {return coeffs.owner(child);});
+    }
+
     /// truncate using a tree in reconstructed form
 
     /// must be invoked where key is local
@@ -1689,6 +1935,7 @@ namespace madness {
             coeffT dd=coeffT(d,targs2);
             acc->second.set_coeff(dd);
         }
+        if (pack_results) acc->second.pack();
         cpu1=cpu_time();
         timer_compress_svd.accumulate(cpu1-cpu0);
 
@@ -1733,6 +1980,11 @@ namespace madness {
         TensorArgs tight_args(targs);
         tight_args.thresh*=0.01;
         double begin=wall_time();
+        if (apply_buffer) {
+            world.gop.fence();
+            flush_apply_buffer();
+            world.gop.fence();
+        }
         flo_unary_op_node_inplace(do_consolidate_buffer(tight_args),true);
 
         // reduce the rank of the final nodes, leave full tensors unchanged
@@ -1853,7 +2105,8 @@ namespace madness {
         typename dcT::const_iterator end = coeffs.end();
         for (typename dcT::const_iterator it=coeffs.begin(); it!=end; ++it) {
             const nodeT& node = it->second;
-            if (node.has_coeff()) sum+=node.coeff().real_size();
+            if (node.is_packed()) sum+=node.size()*sizeof(typename packed_coeff_type<T>::type)/sizeof(T);
+            else if (node.has_coeff()) sum+=node.coeff().real_size();
         }
         world.gop.sum(sum);
         return sum;
@@ -1979,6 +2232,14 @@ namespace madness {
         return sum*pow(2.0,0.5*NDIM*n)/sqrt(FunctionDefaults<NDIM>::get_cell_volume());
     }
 
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::reconstruct_batch(const std::vector<keyT>& keys, const std::vector<coeffT>& s) {
+        if (keys.empty()) return;
+        for (std::size_t i=0; i+1<keys.size(); ++i)
+            woT::task(world.rank(), &implT::reconstruct_op, keys[i], s[i]);
+        reconstruct_op(keys.back(), s.back());
+    }
+
     template <typename T, std::size_t NDIM>
     void FunctionImpl<T,NDIM>::reconstruct_op(const keyT& key, const coeffT& s) {
         //PROFILE_MEMBER_FUNC(FunctionImpl);
@@ -2005,24 +2266,51 @@ namespace madness {
         }
 
         if (node.has_children() || node.has_coeff()) { // Must allow for inconsistent state from transform, etc.
-            coeffT d = node.coeff();
-            if (!d.has_data())		d = coeffT(cdata.v2k,targs);
-            if (key.level() > 0)	d(cdata.s0) += s; // -- note accumulate for NS summation
-            if (d.dim(0)==2*get_k()) {              // d might be pre-truncated if it's a leaf
-                d = unfilter(d);
+            coeffT d;
+            bool repack=false;
+            if (node.is_packed() && node.packed_coeff().dim(0)==2*get_k()) {
+                // unfilter reading the packed coefficients in single precision,
+                // the sum coefficients from the parent are unfiltered on their own
+                tensorT dd = packed_transform(node.packed_coeff(), cdata.hg);
+                if (key.level() > 0 && s.has_data()) dd += transform(s.full_tensor(), cdata.hgsonly);
+                d = coeffT(dd,targs);
+            }
+            else {
+                // a packed leaf accumulates the sum coefficients in full precision
+                repack = node.is_packed();
+                node.unpack();
+                d = node.coeff();
+                if (!d.has_data())		d = coeffT(cdata.v2k,targs);
+                if (key.level() > 0)	d(cdata.s0) += s; // -- note accumulate for NS summation
+                if (d.dim(0)==2*get_k()) d = unfilter(d); // d might be pre-truncated if it's a leaf
+            }
+            if (d.dim(0)==2*get_k()) {
                 node.clear_coeff();
                 node.set_has_children(true);
-                for (KeyChildIterator<NDIM> kit(key); kit; ++kit) {
-                    const keyT& child = kit.key();
-                    coeffT ss = copy(d(child_patch(child)));
-                    ss.reduce_rank(thresh);
+                const KeyBatches<keyT> batches = child_batches(key);
+                for (std::size_t b=0; b<batches.size(); ++b) {
+                    const std::vector<keyT>& children = batches.batch(b);
+                    std::vector<coeffT> ss(children.size());
+                    for (std::size_t i=0; i<children.size(); ++i) {
+                        ss[i] = copy(d(child_patch(children[i])));
+                        ss[i].reduce_rank(thresh);
+                    }
                     //PROFILE_BLOCK(recon_send); // Too fine grain for routine profiling
-                    woT::task(coeffs.owner(child), &implT::reconstruct_op, child, ss);
+                    // each child unfilters its own block, so only a remote
+                    // group is worth sending as one message
+                    if (batches.owner(b) == world.rank()) {
+                        for (std::size_t i=0; i<children.size(); ++i)
+                            woT::task(world.rank(), &implT::reconstruct_op, children[i], ss[i]);
+                    }
+                    else {
+                        woT::task(batches.owner(b), &implT::reconstruct_batch, children, ss);
+                    }
                 }
             } else {
                 MADNESS_ASSERT(node.is_leaf());
                 //                node.coeff()+=s;
                 node.coeff().reduce_rank(targs.thresh);
+                if (repack or pack_results) node.pack();
             }
         }
         else {
@@ -2030,6 +2318,92 @@ namespace madness {
             if (s.has_no_data()) ss=coeffT(cdata.vk,targs);
             if (key.level()) node.set_coeff(copy(ss));
             else node.set_coeff(ss);
+            if (pack_results) node.pack();
+        }
+    }
+
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::reconstruct_vector_batch(const std::vector<implT*>& v, const std::vector<keyT>& keys,
+            const std::vector< std::vector<coeffT> >& s) {
+        if (keys.empty()) return;
+        for (std::size_t i=0; i+1<keys.size(); ++i)
+            woT::task(world.rank(), &implT::reconstruct_vector_op, v, keys[i], s[i]);
+        reconstruct_vector_op(v, keys.back(), s.back());
+    }
+
+    /// same as reconstruct_op for each function, but with a single unfilter for all interior nodes
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::reconstruct_vector_op(const std::vector<implT*>& v, const keyT& key,
+            const std::vector<coeffT>& s) {
+        std::vector<implT*> interior;
+        std::vector<coeffT> dd;
+        for (std::size_t i=0; i<v.size(); ++i) {
+            implT* f = v[i];
+            typename dcT::iterator it = f->coeffs.find(key).get();
+            if (it == f->coeffs.end()) {
+                f->coeffs.replace(key,nodeT(coeffT(),false));
+                it = f->coeffs.find(key).get();
+            }
+            nodeT& node = it->second;
+
+            if (node.has_children() && !node.has_coeff()) {
+                node.set_coeff(coeffT(cdata.v2k,f->targs));
+            }
+
+            if (node.has_children() || node.has_coeff()) {
+                coeffT d = node.coeff();
+                if (!d.has_data())		d = coeffT(cdata.v2k,f->targs);
+                if (key.level() > 0)	d(cdata.s0) += s[i];
+                if (d.dim(0)==2*get_k()) {
+                    interior.push_back(f);
+                    dd.push_back(d);
+                    node.clear_coeff();
+                    node.set_has_children(true);
+                } else {
+                    MADNESS_ASSERT(node.is_leaf());
+                    node.coeff().reduce_rank(f->targs.thresh);
+                }
+            }
+            else {
+                coeffT ss=s[i];
+                if (s[i].has_no_data()) ss=coeffT(cdata.vk,f->targs);
+                if (key.level()) node.set_coeff(copy(ss));
+                else node.set_coeff(ss);
+            }
+        }
+        if (interior.empty()) return;
+
+        const long m = interior.size();
+        std::vector<long> dims(NDIM+1,2*k);
+        dims[NDIM] = m;
+        tensorT d(dims,false);
+        std::vector<Slice> fun(NDIM+1,_);
+        for (long j=0; j<m; ++j) {
+            fun[NDIM] = Slice(j,j,0);
+            d(fun) = dd[j].full_tensor_copy();
+        }
+        d = unfilter_stacked(d);
+
+        const KeyBatches<keyT> batches = child_batches(key);
+        for (std::size_t b=0; b<batches.size(); ++b) {
+            const std::vector<keyT>& children = batches.batch(b);
+            std::vector< std::vector<coeffT> > ss(children.size(), std::vector<coeffT>(m));
+            for (std::size_t i=0; i<children.size(); ++i) {
+                std::vector<Slice> patch = child_patch(children[i]);
+                patch.insert(patch.begin(), Slice());
+                for (long j=0; j<m; ++j) {
+                    patch[0] = Slice(j,j,0);
+                    ss[i][j] = copy(d(patch));
+                    ss[i][j].reduce_rank(interior[j]->thresh);
+                }
+            }
+            if (batches.owner(b) == world.rank()) {
+                for (std::size_t i=0; i<children.size(); ++i)
+                    woT::task(world.rank(), &implT::reconstruct_vector_op, interior, children[i], ss[i]);
+            }
+            else {
+                woT::task(batches.owner(b), &implT::reconstruct_vector_batch, interior, children, ss);
+            }
         }
     }
 
@@ -2517,11 +2891,10 @@ namespace madness {
         }
         nodeT& node = it->second;
         if (node.has_children()) {
-            std::vector< Future<bool> > v = future_vector_factory<bool>(1<<NDIM);
-            int i=0;
-            for (KeyChildIterator<NDIM> kit(key); kit; ++kit,++i) {
-                v[i] = woT::task(coeffs.owner(kit.key()), &implT::truncate_spawn, kit.key(), tol, TaskAttributes::generator());
-            }
+            std::vector< Future<bool> > v = world.taskq.batch<bool>(child_batches(key),
+                [this,tol](ProcessID p, const std::vector<keyT>& keys) {
+                    return woT::task(p, &implT::truncate_spawn_batch, keys, tol, TaskAttributes::generator());
+                });
             return woT::task(world.rank(),&implT::truncate_op, key, tol, v);
         }
         else {
@@ -2539,6 +2912,14 @@ namespace madness {
         }
     }
 
+    template <typename T, std::size_t NDIM>
+    Future< std::vector<bool> > FunctionImpl<T,NDIM>::truncate_spawn_batch(const std::vector<keyT>& keys, double tol) {
+        std::vector< Future<bool> > v;
+        v.reserve(keys.size());
+        for (std::size_t i=0; i<keys.size(); ++i) v.push_back(truncate_spawn(keys[i], tol));
+        return world.taskq.gather(v);
+    }
+
 
     template <typename T, std::size_t NDIM>
     bool FunctionImpl<T,NDIM>::truncate_op(const keyT& key, double tol, const std::vector< Future<bool> >& v) {
@@ -2687,6 +3068,29 @@ namespace madness {
         }
     }
 
+    template <typename T, std::size_t NDIM>
+    std::vector< std::pair<Key<NDIM>,GenTensor<T> > >
+    FunctionImpl<T,NDIM>::find_halo(const std::vector<keyT>& keys) const {
+        std::vector< std::pair<keyT,coeffT> > result;
+        result.reserve(keys.size());
+        for (std::size_t i=0; i<keys.size(); ++i) {
+            keyT key = keys[i];
+            while (!coeffs.probe(key)) {
+                MADNESS_ASSERT(key.level() > 0);
+                key = key.parent();
+                if (coeffs.owner(key) != world.rank()) break;
+            }
+            if (coeffs.owner(key) == world.rank()) {
+                const nodeT& node = coeffs.find(key).get()->second;
+                result.push_back(std::pair<keyT,coeffT>(key, node.has_coeff() ? node.coeff() : coeffT()));
+            }
+            else {
+                result.push_back(std::pair<keyT,coeffT>(key,coeffT()));
+            }
+        }
+        return result;
+    }
+
     // like sock_it_to_me, but it replaces empty node with averaged coeffs from further down the tree
     template <typename T, std::size_t NDIM>
     void FunctionImpl<T,NDIM>::sock_it_to_me_too(const keyT& key,
@@ -3062,19 +3466,17 @@ namespace madness {
         // get fetches remote data (here actually local)
         nodeT& node = coeffs.find(key).get()->second;
         if (node.has_children()) {
-            std::vector< Future<coeffT > > v = future_vector_factory<coeffT >(1<<NDIM);
-            int i=0;
-            for (KeyChildIterator<NDIM> kit(key); kit; ++kit,++i) {
-                //PROFILE_BLOCK(compress_send); // Too fine grain for routine profiling
-                // readily available
-                v[i] = woT::task(coeffs.owner(kit.key()), &implT::compress_spawn, kit.key(),
-                                 nonstandard, keepleaves, redundant, TaskAttributes::hipri());
-            }
+            //PROFILE_BLOCK(compress_send); // Too fine grain for routine profiling
+            std::vector< Future<coeffT > > v = world.taskq.batch<coeffT>(child_batches(key),
+                [=](ProcessID p, const std::vector<keyT>& keys) {
+                    return woT::task(p, &implT::compress_spawn_batch, keys,
+                                     nonstandard, keepleaves, redundant, TaskAttributes::hipri());
+                });
             if (redundant) {std::cout<<"omg..."<<std::endl; return woT::task(world.rank(),&implT::make_redundant_op, key, v);}
             return woT::task(world.rank(),&implT::compress_op, key, v, nonstandard, redundant);
         }
         else {
-            Future<coeffT > result(node.coeff());
+            Future<coeffT > result(node.is_packed() ? node.unpacked() : node.coeff());
             if (!keepleaves) {
 				node.clear_coeff();
 			}
@@ -3082,6 +3484,126 @@ namespace madness {
         }
     }
 
+    template <typename T, std::size_t NDIM>
+    Future< std::vector< GenTensor<T> > > FunctionImpl<T,NDIM>::compress_spawn_batch(const std::vector<keyT>& keys,
+            bool nonstandard, bool keepleaves, bool redundant) {
+        std::vector< Future<coeffT> > v;
+        v.reserve(keys.size());
+        for (std::size_t i=0; i<keys.size(); ++i)
+            v.push_back(compress_spawn(keys[i], nonstandard, keepleaves, redundant));
+        return world.taskq.gather(v);
+    }
+
+    template <typename T, std::size_t NDIM>
+    Future< std::vector< GenTensor<T> > > FunctionImpl<T,NDIM>::compress_vector_spawn(const std::vector<implT*>& v,
+                                                                                    const keyT& key) {
+        // leaves return their sum coefficients, the others go on to the children
+        std::vector<coeffT> leaves(v.size());
+        std::vector<implT*> interior;
+        for (std::size_t i=0; i<v.size(); ++i) {
+            MADNESS_ASSERT(v[i]->coeffs.probe(key));
+            nodeT& node = v[i]->coeffs.find(key).get()->second;
+            if (node.has_children()) {
+                interior.push_back(v[i]);
+            }
+            else {
+                leaves[i] = node.is_packed() ? node.unpacked() : node.coeff();
+                node.clear_coeff();
+            }
+        }
+        if (interior.empty()) return Future< std::vector<coeffT> >(leaves);
+
+        std::vector< Future< std::vector<coeffT> > > children =
+            world.taskq.batch< std::vector<coeffT> >(child_batches(key),
+                [=](ProcessID p, const std::vector<keyT>& keys) {
+                    return woT::task(p, &implT::compress_vector_spawn_batch, interior, keys,
+                                     TaskAttributes::hipri());
+                });
+        return woT::task(world.rank(), &implT::compress_vector_op, v, key, leaves, children);
+    }
+
+    template <typename T, std::size_t NDIM>
+    Future< std::vector< std::vector< GenTensor<T> > > > FunctionImpl<T,NDIM>::compress_vector_spawn_batch(
+            const std::vector<implT*>& v, const std::vector<keyT>& keys) {
+        std::vector< Future< std::vector<coeffT> > > f;
+        f.reserve(keys.size());
+        for (std::size_t i=0; i<keys.size(); ++i) f.push_back(compress_vector_spawn(v, keys[i]));
+        return world.taskq.gather(f);
+    }
+
+    /// same as compress_op for each function with children at key, but with a single filter
+
+    /// children[i][j] are the sum coefficients of the j-th function with
+    /// children at key in its i-th child box
+    template <typename T, std::size_t NDIM>
+    std::vector< GenTensor<T> > FunctionImpl<T,NDIM>::compress_vector_op(const std::vector<implT*>& v,
+            const keyT& key, const std::vector<coeffT>& leaves,
+            const std::vector< Future< std::vector<coeffT> > >& children) {
+
+        std::vector<coeffT> result(leaves);
+        std::vector<std::size_t> interior;
+        for (std::size_t i=0; i<v.size(); ++i) {
+            if (v[i]->coeffs.find(key).get()->second.has_children()) interior.push_back(i);
+        }
+        const long m = interior.size();
+
+        double cpu0=cpu_time();
+        // Copy child scaling coeffs of all functions into one block, function index last
+        std::vector<long> dims(NDIM+1,2*k);
+        dims[NDIM] = m;
+        tensorT d(dims);
+        int i=0;
+        for (KeyChildIterator<NDIM> kit(key); kit; ++kit,++i) {
+            const std::vector<coeffT>& s = children[i].get();
+            MADNESS_ASSERT(long(s.size()) == m);
+            std::vector<Slice> patch = child_patch(kit.key());
+            patch.push_back(Slice());
+            for (long j=0; j<m; ++j) {
+                patch[NDIM] = Slice(j,j,0);
+                d(patch) += s[j].full_tensor_copy();
+            }
+        }
+
+        d = filter_stacked(d);
+        double cpu1=cpu_time();
+        timer_filter.accumulate(cpu1-cpu0);
+        cpu0=cpu1;
+
+        std::vector<Slice> fun(NDIM+1,_);
+        for (long j=0; j<m; ++j) {
+            implT* f = v[interior[j]];
+            fun[0] = Slice(j,j,0);
+            tensorT dj = copy(d(fun));
+
+            typename dcT::accessor acc;
+            MADNESS_ASSERT(f->coeffs.find(acc, key));
+
+            if (acc->second.has_coeff()) {
+                const tensorT c = acc->second.coeff().full_tensor_copy();
+                if (c.dim(0) == k) {
+                    dj(cdata.s0) += c;
+                }
+                else {
+                    dj += c;
+                }
+            }
+
+            // tighter thresh for internal nodes
+            TensorArgs targs2=f->targs;
+            targs2.thresh*=0.1;
+
+            // need the deep copy for contiguity
+            result[interior[j]] = coeffT(copy(dj(cdata.s0)),targs2);
+            if (key.level()> 0) dj(cdata.s0) = 0.0;
+            acc->second.set_coeff(coeffT(dj,targs2));
+            if (f->pack_results) acc->second.pack();
+        }
+        cpu1=cpu_time();
+        timer_compress_svd.accumulate(cpu1-cpu0);
+
+        return result;
+    }
+
     template <typename T, std::size_t NDIM>
     void FunctionImpl<T,NDIM>::plot_cube_kernel(archive::archive_ptr< Tensor<T> > ptr,
                                                 const keyT& key,
@@ -3304,6 +3826,8 @@ namespace madness {
         debug = false;
         truncate_on_project = true;
         apply_randomize = false;
+        apply_buffer_size = 0;
+        pack_results = false;
         project_randomize = false;
         bc = BoundaryConditions<NDIM>(BC_FREE);
         tt = TT_FULL;
@@ -3329,6 +3853,8 @@ namespace madness {
     		std::cout << "                           debug" <<  ": " << debug << std::endl;
     		std::cout << "             truncate_on_project" <<  ": " << truncate_on_project << std::endl;
     		std::cout << "                 apply_randomize" <<  ": " << apply_randomize << std::endl;
+    		std::cout << "               apply_buffer_size" <<  ": " << apply_buffer_size << std::endl;
+    		std::cout << "                    pack_results" <<  ": " << pack_results << std::endl;
     		std::cout << "               project_randomize" <<  ": " << project_randomize << std::endl;
     		std::cout << "                              bc" <<  ": " << bc << std::endl;
     		std::cout << "                              tt" <<  ": " << tt << std::endl;
@@ -3348,6 +3874,8 @@ namespace madness {
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::debug;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::truncate_on_project;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::apply_randomize;
+    template <std::size_t NDIM> std::size_t FunctionDefaults<NDIM>::apply_buffer_size;
+    template <std::size_t NDIM> bool FunctionDefaults<NDIM>::pack_results;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::project_randomize;
     template <std::size_t NDIM> BoundaryConditions<NDIM> FunctionDefaults<NDIM>::bc;
     template <std::size_t NDIM> TensorType FunctionDefaults<NDIM>::tt;
@@ -38,9 +38,14 @@
 /// \ingroup function
 
 #include <type_traits>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <functional>
 #include <limits.h>
 #include <madness/mra/adquad.h>
 #include <madness/tensor/mtxmq.h>
+#include <madness/tensor/mtxmq_batch.h>
 #include <madness/tensor/aligned.h>
 #include <madness/tensor/tensor_lapack.h>
 #include <madness/constants.h>
@@ -77,6 +82,33 @@ namespace madness {
     };
 
 
+    /// operator norms of all displacements of one level in structure-of-arrays layout
+
+    /// Entries are aligned with SeparatedConvolution::get_disp(n). Translations and
+    /// squared distances are copied when the table is made; the norms are computed in
+    /// order of increasing distance when screening first reaches them and are published
+    /// through nnorm, so after warm-up screening is a pass over contiguous arrays.
+    template <std::size_t NDIM>
+    struct DisplacementNormTable {
+        std::vector<Translation> t[NDIM];   ///< translations, one array per dimension
+        std::vector<uint64_t> distsq;       ///< squared length of each displacement
+        std::vector<double> norm;           ///< operator norms, valid below nnorm
+        std::atomic<int> nnorm;             ///< number of norms computed so far
+        Mutex mutex;                        ///< serializes computing the norms
+
+        explicit DisplacementNormTable(const std::vector< Key<NDIM> >& disp)
+            : distsq(disp.size()), norm(disp.size()), nnorm(0) {
+            for (std::size_t d=0; d<NDIM; ++d) t[d].resize(disp.size());
+            for (std::size_t i=0; i<disp.size(); ++i) {
+                for (std::size_t d=0; d<NDIM; ++d) t[d][i]=disp[i].translation()[d];
+                distsq[i]=disp[i].distsq();
+            }
+        }
+
+        int size() const {return distsq.size();}
+    };
+
+
     /// Convolutions in separated form (including Gaussian)
 
     /* this stuff is very confusing, poorly commented, and extremely poorly named!
@@ -149,6 +181,20 @@ namespace madness {
         mutable SimpleCache< SeparatedConvolutionData<Q,NDIM>, NDIM > data; ///< cache for all terms, dims and displacements
         mutable SimpleCache< SeparatedConvolutionData<Q,NDIM>, 2*NDIM > mod_data; ///< cache for all terms, dims and displacements
 
+        // norm tables for screening, NS form by level, modified NS form by level and source parity;
+        // shared between copies of the operator
+        static const int normtab_maxlevel=64;
+        struct NormTables {
+            std::unique_ptr< std::atomic<DisplacementNormTable<NDIM>*>[] > slot;
+            Mutex mutex;
+            NormTables() : slot(new std::atomic<DisplacementNormTable<NDIM>*>[size()]()) {}
+            ~NormTables() {
+                for (int i=0; i<size(); ++i) delete slot[i].load();
+            }
+            static int size() {return normtab_maxlevel*(1+(1<<NDIM));}
+        };
+        std::shared_ptr<NormTables> normtab;
+
     public:
 
         bool& modified() {return modified_;}
@@ -180,6 +226,16 @@ namespace madness {
             const Q* VT;
         };
 
+        /// the transformations of one separated term, applied to f and accumulated into result
+        template <typename T, typename R>
+        struct TransformationTerm {
+            long dimk;
+            Transformation trans[NDIM];
+            const T* f;
+            R* result;
+            Q mufac;
+        };
+
 //        /// return the right block of the upsampled operator (modified NS only)
 //
 //        /// unlike the operator matrices on the natural level the upsampled operator
@@ -283,6 +339,137 @@ namespace madness {
         }
 
 
+        /// number of leading steps two terms have in common, -1 if their inputs differ
+
+        /// The first d steps of apply_transformations give the same intermediate
+        /// for both terms if they start from the same input and the first d
+        /// transformations are the same matrices with the same rank.
+        template <typename T, typename R>
+        static long shared_steps(const TransformationTerm<T,R>& a, const TransformationTerm<T,R>& b) {
+            if (a.f!=b.f or a.dimk!=b.dimk) return -1;
+            long d=0;
+            while (d<long(NDIM)-1 and a.trans[d].U==b.trans[d].U and a.trans[d].r==b.trans[d].r) ++d;
+            return d;
+        }
+
+        /// accumulate a batch of separated terms into their results
+
+        /// Does the same as apply_transformation for each term.  The terms are
+        /// ordered by input and leading transformations, so that a group of terms
+        /// that differ only in the last dimension (one separated term for the
+        /// displacements of a column) shares the first NDIM-1 steps, and the
+        /// steps shared with the previous group are not done again.  The last
+        /// step and the VT steps of a group are run in chunks whose work arrays
+        /// fit in cache, each step a single call of mTxmq_batch for the whole
+        /// chunk.  The truncated factors of low-rank terms are used in place
+        /// rather than copied.
+        template <typename T, typename R>
+        void apply_transformations(const std::vector< TransformationTerm<T,R> >& terms) const {
+            if (terms.empty()) return;
+
+            std::vector<std::size_t> order(terms.size());
+            for (std::size_t i=0; i<order.size(); ++i) order[i]=i;
+            std::sort(order.begin(), order.end(), [&terms](std::size_t i, std::size_t j) {
+                const TransformationTerm<T,R>& a=terms[i];
+                const TransformationTerm<T,R>& b=terms[j];
+                if (a.f!=b.f) return std::less<const T*>()(a.f,b.f);
+                if (a.dimk!=b.dimk) return a.dimk<b.dimk;
+                for (std::size_t d=0; d+1<NDIM; ++d) {
+                    if (a.trans[d].U!=b.trans[d].U) return std::less<const Q*>()(a.trans[d].U,b.trans[d].U);
+                    if (a.trans[d].r!=b.trans[d].r) return a.trans[d].r<b.trans[d].r;
+                }
+                return i<j;
+            });
+
+            long maxsize=1;
+            for (const TransformationTerm<T,R>& term : terms) {
+                long size=1;
+                for (std::size_t d=0; d<NDIM; ++d) size *= term.dimk;
+                maxsize=std::max(maxsize,size);
+            }
+            const long stride=(maxsize+7) & ~7L;
+            const long nchunk=std::min(long(terms.size()), std::max(1L, 16384L/stride));
+
+            // lead[d] holds the result of steps 0..d of the current group
+            Tensor<R> lead(std::vector<long>(1,std::max(1L,long(NDIM)-1)*stride), false);
+            Tensor<R> work(std::vector<long>(1,2*nchunk*stride), false);
+            std::vector< mTxmqBatchItem<T,Q,R> > items0(nchunk);
+            std::vector< mTxmqBatchItem<R,Q,R> > items(nchunk);
+            std::vector<R*> w1(nchunk), w2(nchunk);
+            std::vector<long> size(nchunk);
+            std::vector<const TransformationTerm<T,R>*> term(nchunk);
+
+            const TransformationTerm<T,R>* previous=0;
+            for (std::size_t first=0; first<terms.size(); ) {
+                const TransformationTerm<T,R>& group=terms[order[first]];
+                std::size_t last=first+1;
+                while (last<terms.size() and shared_steps(group,terms[order[last]])==long(NDIM)-1) ++last;
+
+                // the leading steps of the group, starting after those it shares with the previous group
+                const long dimk=group.dimk;
+                long leadsize=1;
+                for (std::size_t d=0; d<NDIM; ++d) leadsize *= dimk;
+                const long done=previous ? std::max(0L,shared_steps(*previous,group)) : 0;
+                for (long d=0; d<long(NDIM)-1; ++d) {
+                    const Transformation& trans=group.trans[d];
+                    R* out=lead.ptr()+d*stride;
+                    if (d==0 and d>=done) {
+                        mTxmqBatchItem<T,Q,R> item{leadsize/dimk, trans.r, dimk, dimk, out, group.f, trans.U};
+                        mTxmq_batch(1, &item);
+                    }
+                    else if (d>=done) {
+                        mTxmqBatchItem<R,Q,R> item{leadsize/dimk, trans.r, dimk, dimk, out, out-stride, trans.U};
+                        mTxmq_batch(1, &item);
+                    }
+                    leadsize=trans.r*leadsize/dimk;
+                }
+                previous=&group;
+
+                for (std::size_t chunk=first; chunk<last; chunk+=nchunk) {
+                    const long n=std::min(nchunk, long(last-chunk));
+
+                    // the last dimension
+                    for (long t=0; t<n; ++t) {
+                        term[t]=&terms[order[chunk+t]];
+                        const Transformation& trans=term[t]->trans[NDIM-1];
+                        w1[t]=work.ptr()+2*t*stride;
+                        w2[t]=w1[t]+stride;
+                        if (NDIM==1) items0[t]=mTxmqBatchItem<T,Q,R>{leadsize/dimk, trans.r, dimk, dimk, w1[t], group.f, trans.U};
+                        else items[t]=mTxmqBatchItem<R,Q,R>{leadsize/dimk, trans.r, dimk, dimk, w1[t], lead.ptr()+(long(NDIM)-2)*stride, trans.U};
+                        size[t]=trans.r*leadsize/dimk;
+                    }
+                    if (NDIM==1) mTxmq_batch(n, items0.data());
+                    else mTxmq_batch(n, items.data());
+
+                    // If all blocks of a term are full rank we can skip its transposes
+                    for (std::size_t d=0; d<NDIM; ++d) {
+                        std::size_t nitem=0;
+                        for (long t=0; t<n; ++t) {
+                            bool doit=false;
+                            for (std::size_t dd=0; dd<NDIM; ++dd) doit = doit || term[t]->trans[dd].VT;
+                            if (not doit) continue;
+
+                            const Transformation& trans=term[t]->trans[d];
+                            if (trans.VT) {
+                                items[nitem++]=mTxmqBatchItem<R,Q,R>{size[t]/trans.r, dimk, trans.r, dimk,
+                                                                     w2[t], w1[t], trans.VT};
+                                size[t]=dimk*size[t]/trans.r;
+                            }
+                            else {
+                                fast_transpose(dimk, size[t]/dimk, w1[t], w2[t]);
+                            }
+                            std::swap(w1[t],w2[t]);
+                        }
+                        mTxmq_batch(nitem, items.data());
+                    }
+
+                    for (long t=0; t<n; ++t) aligned_axpy(size[t], term[t]->result, w1[t], term[t]->mufac);
+                }
+                first=last;
+            }
+        }
+
+
         /// accumulate into result
         template <typename T, typename R>
         void apply_transformation3(const Tensor<T> trans2[NDIM],
@@ -366,22 +553,23 @@ namespace madness {
         }
 
 
-        /// Apply one of the separated terms, accumulating into the result
+        /// Add the transformations of one of the separated terms to a batch
+
+        /// The batch is applied with apply_transformations, accumulating into
+        /// result and result0.
         template <typename T>
-        void muopxv_fast(ApplyTerms at,
-                         const ConvolutionData1D<Q>* const ops_1d[NDIM],
-                         const Tensor<T>& f, const Tensor<T>& f0,
-                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& result,
-                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& result0,
-                         double tol,
-                         const Q mufac,
-                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& work1,
-                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& work2,
-                         Tensor<Q>& work5) const {
+        void muopxv_batch(ApplyTerms at,
+                          const ConvolutionData1D<Q>* const ops_1d[NDIM],
+                          const Tensor<T>& f, const Tensor<T>& f0,
+                          Tensor<TENSOR_RESULT_TYPE(T,Q)>& result,
+                          Tensor<TENSOR_RESULT_TYPE(T,Q)>& result0,
+                          double tol,
+                          const Q mufac,
+                          std::vector< TransformationTerm<T,TENSOR_RESULT_TYPE(T,Q)> >& batch) const {
 
             //PROFILE_MEMBER_FUNC(SeparatedConvolution); // Too fine grain for routine profiling
-            Transformation trans[NDIM];
-            Tensor<T> trans2[NDIM];
+            TransformationTerm<T,TENSOR_RESULT_TYPE(T,Q)> term;
+            Transformation* trans=term.trans;
 
             double Rnorm = 1.0;
             for (std::size_t d=0; d<NDIM; ++d) Rnorm *= ops_1d[d]->Rnorm;
@@ -415,11 +603,12 @@ namespace madness {
                         trans[d].U = ops_1d[d]->RU.ptr();
                         trans[d].VT = ops_1d[d]->RVT.ptr();
                     }
-                    trans2[d]=ops_1d[d]->R;
                 }
-                apply_transformation(twok, trans, f, work1, work2, work5, mufac, result);
-    //            apply_transformation2(n, twok, tol, trans2, f, work1, work2, work5, mufac, result);
-//                apply_transformation3(trans2, f, mufac, result);
+                term.dimk=twok;
+                term.f=f.ptr();
+                term.result=result.ptr();
+                term.mufac=mufac;
+                batch.push_back(term);
             }
 
             double Tnorm = 1.0;
@@ -449,11 +638,12 @@ namespace madness {
                         trans[d].U = ops_1d[d]->TU.ptr();
                         trans[d].VT = ops_1d[d]->TVT.ptr();
                     }
-                    trans2[d]=ops_1d[d]->T;
                 }
-                apply_transformation(k, trans, f0, work1, work2, work5, -mufac, result0);
-//                apply_transformation2(n, k, tol, trans2, f0, work1, work2, work5, -mufac, result0);
-//                apply_transformation3(trans2, f0, -mufac, result0);
+                term.dimk=k;
+                term.f=f0.ptr();
+                term.result=result0.ptr();
+                term.mufac=-mufac;
+                batch.push_back(term);
             }
         }
 
@@ -785,6 +975,17 @@ namespace madness {
         }
 
 
+        /// compute the norms of a norm table up to entry end (exclusive)
+        void make_norms(DisplacementNormTable<NDIM>& tab, const Key<NDIM>& source, int end) const {
+            ScopedMutex<Mutex> hold(tab.mutex);
+            int nnorm=tab.nnorm.load(std::memory_order_relaxed);
+            if (nnorm>=end) return;
+            const std::vector< Key<NDIM> >& disp=get_disp(source.level());
+            for (; nnorm<end; ++nnorm) tab.norm[nnorm]=getop(source.level(),disp[nnorm],source)->norm;
+            tab.nnorm.store(nnorm,std::memory_order_release);
+        }
+
+
         void check_cubic() {
             // !!! NB ... cell volume obtained from global defaults
             const Tensor<double>& cell_width = FunctionDefaults<NDIM>::get_cell_width();
@@ -885,6 +1086,7 @@ namespace madness {
                 , vk(NDIM,k)
                 , v2k(NDIM,2*k)
                 , s0(std::max<std::size_t>(2,NDIM),Slice(0,k-1))
+                , normtab(new NormTables)
         {
             // Presently we must have periodic or non-periodic in all dimensions.
             for (std::size_t d=1; d<NDIM; ++d) {
@@ -921,6 +1123,7 @@ namespace madness {
                 , vk(NDIM,k)
                 , v2k(NDIM,2*k)
                 , s0(std::max<std::size_t>(2,NDIM),Slice(0,k-1))
+                , normtab(new NormTables)
         {
             // Presently we must have periodic or non-periodic in all dimensions.
             for (std::size_t d=1; d<NDIM; ++d) {
@@ -952,6 +1155,7 @@ namespace madness {
                 , vk(NDIM,k)
                 , v2k(NDIM,2*k)
                 , s0(std::max<std::size_t>(2,NDIM),Slice(0,k-1))
+                , normtab(new NormTables)
         {
             // Presently we must have periodic or non-periodic in all dimensions.
             for (std::size_t d=1; d<NDIM; ++d) {
@@ -997,6 +1201,7 @@ namespace madness {
                 , vk(NDIM,k)
                 , v2k(NDIM,2*k)
                 , s0(std::max<std::size_t>(2,NDIM),Slice(0,k-1))
+                , normtab(new NormTables)
         {
             // Presently we must have periodic or non-periodic in all dimensions.
             for (std::size_t d=1; d<NDIM; ++d) {
@@ -1049,6 +1254,120 @@ namespace madness {
             return getop(n, d, source_key)->norm;
         }
 
+        /// return the norm table for the displacements of a source box
+
+        /// In the NS form the table depends only on the level, in the modified NS form
+        /// also on the parity of the source translation (see getop_modified).
+        DisplacementNormTable<NDIM>& get_norm_table(const Key<NDIM>& source) const {
+            const Level n=source.level();
+            MADNESS_ASSERT(n<normtab_maxlevel);
+            int slot=n;
+            if (modified()) {
+                int parity=0;
+                for (std::size_t d=0; d<NDIM; ++d) parity |= (source.translation()[d]&1)<<d;
+                slot=normtab_maxlevel + (n<<NDIM) + parity;
+            }
+            DisplacementNormTable<NDIM>* p=normtab->slot[slot].load(std::memory_order_acquire);
+            if (p) return *p;
+
+            ScopedMutex<Mutex> hold(normtab->mutex);
+            p=normtab->slot[slot].load(std::memory_order_relaxed);
+            if (not p) {
+                p=new DisplacementNormTable<NDIM>(get_disp(n));
+                normtab->slot[slot].store(p,std::memory_order_release);
+            }
+            return *p;
+        }
+
+        /// screen all displacements of a source box in one pass before any kernel is applied
+
+        /// Same criterion as the displacement loop in FunctionImpl::do_apply: a displacement
+        /// survives if its destination box exists and cnorm*opnorm > tol, and the scan stops
+        /// at the first displacement beyond the nearest neighbors that fails the test
+        /// (assumes monotonic decay). Validity and norm masks are formed block by block over
+        /// the norm table, the stopping rule is then applied to the masks.
+        /// @param[in]  source  the source key, see get_source_key
+        /// @param[in]  cnorm   norm of the source coefficients
+        /// @param[in]  tol     screening threshold for cnorm*opnorm
+        /// @param[out] index   indices into get_disp(source.level()) of surviving displacements
+        void screen(const Key<NDIM>& source, double cnorm, double tol, std::vector<int>& index) const {
+            static const int blocksize=64;
+            DisplacementNormTable<NDIM>& tab=get_norm_table(source);
+            const int ndisp=tab.size();
+
+            // displacement t is valid if 0 <= l+t < 2^n in every dimension
+            const Translation twon=Translation(1)<<source.level();
+            Translation lo[NDIM], hi[NDIM];
+            for (std::size_t d=0; d<NDIM; ++d) {
+                lo[d]=-source.translation()[d];
+                hi[d]=twon-source.translation()[d];
+            }
+
+            index.clear();
+            unsigned char valid[blocksize], pass[blocksize];
+            for (int begin=0; begin<ndisp; begin+=blocksize) {
+                const int end=std::min(begin+blocksize,ndisp);
+                if (tab.nnorm.load(std::memory_order_acquire)<end) make_norms(tab,source,end);
+
+                const int nb=end-begin;
+                const double* norm=&tab.norm[begin];
+                for (int i=0; i<nb; ++i) {
+                    pass[i]=(cnorm*norm[i]>tol);
+                    valid[i]=1;
+                }
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    const Translation* t=&tab.t[d][begin];
+                    for (int i=0; i<nb; ++i) valid[i] &= (t[i]>=lo[d]) & (t[i]<hi[d]);
+                }
+
+                for (int i=0; i<nb; ++i) {
+                    if (not valid[i]) continue;
+                    if (pass[i]) index.push_back(begin+i);
+                    else if (tab.distsq[begin+i]>=1) return;
+                }
+            }
+        }
+
+        /// screen the displacements of an interior box of level n with unit coefficient norm
+
+        /// Fills the norm table of level n and, through getop, the operator caches of all
+        /// displacements it passes over; see warm_up.
+        /// @return number of displacements that survive the screening
+        std::size_t warm_up_level(Level n, double tol) const {
+            const Translation center=(Translation(1)<<n)/2 & ~Translation(1);
+            const int nparity=(modified() and n>0) ? (1<<NDIM) : 1;
+            std::size_t nsurvive=0;
+            std::vector<int> index;
+            for (int parity=0; parity<nparity; ++parity) {
+                Vector<Translation,NDIM> l;
+                for (std::size_t d=0; d<NDIM; ++d) l[d]=center + ((parity>>d)&1);
+                screen(Key<NDIM>(n,l), 1.0, tol, index);
+                nsurvive+=index.size();
+            }
+            return nsurvive;
+        }
+
+        /// precompute the operator for all displacements that apply can reach at thresh
+
+        /// Applying the operator fills its caches and those of the Convolution1D terms on
+        /// demand, so the first application makes all threads compute and insert the same
+        /// entries. This does that work up front, one task per level, for an interior box
+        /// with coefficient norm one screened as in FunctionImpl::do_apply.
+        /// @param[in]  thresh  truncation threshold of the functions to be applied to
+        /// @param[in]  nmax    finest level to prepare
+        /// @return number of displacements that survive the screening, summed over levels
+        std::size_t warm_up(double thresh, Level nmax=FunctionDefaults<NDIM>::get_max_refine_level()) const {
+            World& world=this->get_world();
+            std::vector< Future<std::size_t> > nsurvive;
+            for (Level n=0; n<=nmax; ++n) {
+                nsurvive.push_back(world.taskq.add(*this, &SeparatedConvolution<Q,NDIM>::warm_up_level,
+                                                   n, 0.1*thresh));
+            }
+            std::size_t sum=0;
+            for (Future<std::size_t>& f : nsurvive) sum+=f.get();
+            return sum;
+        }
+
         /// return that part of a hi-dim key that serves as the base for displacements of this operator
 
         /// if the function and the operator have the same dimension return key
@@ -1116,6 +1435,24 @@ namespace madness {
                                               const Key<NDIM>& shift,
                                               const Tensor<T>& coeff,
                                               double tol) const {
+            return apply(source, std::vector< Key<NDIM> >(1,shift), coeff, tol)[0];
+        }
+
+        /// apply this operator on coefficients in full rank form for several displacements
+
+        /// The separated terms of all displacements go into one batch, so that
+        /// apply_transformations can share the leading transforms and the
+        /// operator matrices across displacements of the same source box.
+        /// @param[in]  coeff   source coeffs in full rank
+        /// @param[in]  source  the source key
+        /// @param[in]  shifts  the displacements, where the source coeffs come from
+        /// @param[in]  tol     thresh/#neigh*cnorm
+        /// @return     one tensor of full rank per displacement with the result op(coeff)
+        template <typename T>
+        std::vector< Tensor<TENSOR_RESULT_TYPE(T,Q)> > apply(const Key<NDIM>& source,
+                                                             const std::vector< Key<NDIM> >& shifts,
+                                                             const Tensor<T>& coeff,
+                                                             double tol) const {
             //PROFILE_MEMBER_FUNC(SeparatedConvolution); // Too fine grain for routine profiling
             MADNESS_ASSERT(coeff.ndim()==NDIM);
 
@@ -1147,35 +1484,31 @@ namespace madness {
             at.r_term=true;
             at.t_term=(source.level()>0);
 
-            /// SeparatedConvolutionData keeps data for all terms and all dimensions and 1 displacement
-            const SeparatedConvolutionData<Q,NDIM>* op = getop(source.level(), shift, source);
-
-            //print("sepop",source,shift,op->norm,tol);
-
-            Tensor<resultT> r(v2k), r0(vk);
-            Tensor<resultT> work1(v2k,false), work2(v2k,false);
-            Tensor<Q> work5(2*k,2*k);
-
-            if (modified()) {
-                   r=Tensor<resultT>(vk);
-                   work1=Tensor<resultT>(vk,false);
-                   work2=Tensor<resultT>(vk,false);
-                   work5=Tensor<Q>(k,k);
-            }
+            const std::size_t nshift=shifts.size();
+            std::vector< Tensor<resultT> > r(nshift), r0(nshift);
 
             const Tensor<T> f0 = copy(coeff(s0));
-            for (int mu=0; mu<rank; ++mu) {
-                // SeparatedConvolutionInternal keeps data for 1 term and all dimensions and 1 displacement
-                const SeparatedConvolutionInternal<Q,NDIM>& muop =  op->muops[mu];
-                if (muop.norm > tol) {
-                    // ops is of ConvolutionND, returns data for 1 term and all dimensions
-                    Q fac = ops[mu].getfac();
-                    muopxv_fast(at, muop.ops, *input, f0, r, r0, tol/std::abs(fac), fac,
-                                work1, work2, work5);
+            std::vector< TransformationTerm<T,resultT> > batch;
+            batch.reserve(2*rank*nshift);
+            for (std::size_t i=0; i<nshift; ++i) {
+                /// SeparatedConvolutionData keeps data for all terms and all dimensions and 1 displacement
+                const SeparatedConvolutionData<Q,NDIM>* op = getop(source.level(), shifts[i], source);
+
+                r[i] = modified() ? Tensor<resultT>(vk) : Tensor<resultT>(v2k);
+                r0[i] = Tensor<resultT>(vk);
+                for (int mu=0; mu<rank; ++mu) {
+                    // SeparatedConvolutionInternal keeps data for 1 term and all dimensions and 1 displacement
+                    const SeparatedConvolutionInternal<Q,NDIM>& muop =  op->muops[mu];
+                    if (muop.norm > tol) {
+                        // ops is of ConvolutionND, returns data for 1 term and all dimensions
+                        Q fac = ops[mu].getfac();
+                        muopxv_batch(at, muop.ops, *input, f0, r[i], r0[i], tol/std::abs(fac), fac, batch);
+                    }
                 }
             }
+            apply_transformations(batch);
 
-            r(s0).gaxpy(1.0,r0,1.0);
+            for (std::size_t i=0; i<nshift; ++i) r[i](s0).gaxpy(1.0,r0[i],1.0);
             double cpu1=cpu_time();
             timer_full.accumulate(cpu1-cpu0);
 
@@ -1215,10 +1548,6 @@ namespace madness {
             // can't use predefined slices and vectors -- they have the wrong dimension
             const std::vector<Slice> s00(coeff.ndim(),Slice(0,k-1));
 
-            // some workspace
-            Tensor<resultT> work1(v2k,false), work2(v2k,false);
-            Tensor<Q> work5(2*k,2*k);
-
             // sliced input and final result
             const GenTensor<T> f0 = copy(coeff(s00));
             GenTensor<resultT> final=copy(coeff);
@@ -1230,7 +1559,7 @@ namespace madness {
             for (int r=0; r<coeff.rank(); ++r) {
 
                 // get the appropriate singular vector (left or right depends on particle)
-                // and apply the full tensor muopxv_fast on it, term by term
+                // and apply the full tensor muopxv_batch on it, term by term
                 s[0]=Slice(r,r);
                 const Tensor<T> chunk=coeff.config().ref_vector(particle()-1)(s).reshape(2*k,2*k,2*k);
                 const Tensor<T> chunk0=f0.config().ref_vector(particle()-1)(s).reshape(k,k,k);
@@ -1245,17 +1574,19 @@ namespace madness {
 
                 // this loop will return on result and result0 the terms [(P+Q) G (P+Q)]_1,
                 // and [P Q P]_1, respectively
+                std::vector< TransformationTerm<T,resultT> > batch;
                 for (int mu=0; mu<rank; ++mu) {
                     const SeparatedConvolutionInternal<Q,NDIM>& muop =  op->muops[mu];
 
 //                    if (muop.norm > tol2*std::abs(weight)) {
 
                         Q fac = ops[mu].getfac();
-                        muopxv_fast(at, muop.ops, chunk, chunk0, result, result0,
-                                tol/std::abs(fac), fac, work1, work2, work5);
+                        muopxv_batch(at, muop.ops, chunk, chunk0, result, result0,
+                                tol/std::abs(fac), fac, batch);
 
 //                    }
                 }
+                apply_transformations(batch);
 
 
                 // reinsert the transformed terms into result, leaving the other particle unchanged
@@ -0,0 +1,213 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_MRA_SFCPMAP_H__INCLUDED
+#define MADNESS_MRA_SFCPMAP_H__INCLUDED
+
+#include <madness/world/worlddc.h>
+#include <madness/mra/key.h>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+/// \file mra/sfcpmap.h
+/// \brief Process map assigning contiguous pieces of a space-filling curve to processes
+/// \ingroup function
+
+namespace madness {
+
+    /// The space-filling curves that SFCPmap can follow
+    enum SFCCurve {SFC_MORTON, SFC_HILBERT};
+
+    /// Position of box \c l at level \c n along a space-filling curve
+
+    /// Returns a value in [0,2^(NDIM*n)), hence NDIM*n must not exceed 63.
+    /// The Morton (Z-order) index interleaves the bits of the translations.
+    /// The Hilbert index first transforms the translations in place following
+    /// J. Skilling, AIP Conf. Proc. 707, 381 (2004), so that boxes that are
+    /// consecutive along the curve are always face neighbors.
+    template <std::size_t NDIM>
+    uint64_t sfc_index(const Vector<Translation,NDIM>& l, Level n, SFCCurve curve) {
+        uint64_t x[NDIM];
+        for (std::size_t d=0; d<NDIM; ++d) x[d] = l[d];
+
+        if (curve == SFC_HILBERT && n > 0) {
+            const uint64_t m = uint64_t(1) << (n-1);
+            // undo excess work
+            for (uint64_t q=m; q>1; q>>=1) {
+                const uint64_t p = q-1;
+                for (std::size_t i=0; i<NDIM; ++i) {
+                    if (x[i] & q) {
+                        x[0] ^= p;                              // invert
+                    }
+                    else {
+                        const uint64_t t = (x[0]^x[i]) & p;     // exchange
+                        x[0] ^= t;
+                        x[i] ^= t;
+                    }
+                }
+            }
+            // Gray encode
+            for (std::size_t i=1; i<NDIM; ++i) x[i] ^= x[i-1];
+            uint64_t t = 0;
+            for (uint64_t q=m; q>1; q>>=1) {
+                if (x[NDIM-1] & q) t ^= q-1;
+            }
+            for (std::size_t i=0; i<NDIM; ++i) x[i] ^= t;
+        }
+
+        // interleave the bits, most significant first
+        uint64_t index = 0;
+        for (Level b=n-1; b>=0; --b) {
+            for (std::size_t i=0; i<NDIM; ++i) index = (index << 1) | ((x[i] >> b) & 0x1);
+        }
+        return index;
+    }
+
+    /// A pmap that assigns contiguous segments of a space-filling curve to processes
+
+    /// The boxes at level \c n are ordered along a Morton or Hilbert curve and
+    /// each process owns one segment of that order, together with all the
+    /// descendants of its boxes.  A box at a coarser level belongs to the owner
+    /// of its first descendant at level \c n, except the root which is always
+    /// on process 0.  Hence whole subtrees stay on one process and most of the
+    /// neighbors that derivatives, apply and multiplication touch are local,
+    /// unlike the hashed maps (LevelPmap, SimplePmap, WorldDCDefaultPmap).
+    ///
+    /// The segments are equal in length unless the cuts are computed from the
+    /// weights of the boxes, e.g., by LoadBalanceDeux::sfc_pmap.
+    template <std::size_t NDIM>
+    class SFCPmap : public WorldDCPmapInterface< Key<NDIM> > {
+        typedef Key<NDIM> keyT;
+        const int nproc;
+        const Level n;
+        const SFCCurve curve;
+        std::vector<uint64_t> cuts;     ///< cuts[p] is the first curve index owned by process p+1
+
+    public:
+        /// Segments of equal length at level \c n (default_level if negative)
+        SFCPmap(World& world, Level n=-1, SFCCurve curve=SFC_HILBERT)
+            : nproc(world.size())
+            , n(n<0 ? default_level(world.size()) : n)
+            , curve(curve)
+            , cuts(nproc-1)
+        {
+            MADNESS_ASSERT(NDIM*this->n <= 63);
+            const uint64_t total = uint64_t(1) << (NDIM*this->n);
+            for (int p=1; p<nproc; ++p) {
+                cuts[p-1] = (total/nproc)*p + ((total%nproc)*p)/nproc;
+            }
+        }
+
+        /// Segments ending at the given cuts, which must be the same on all processes
+
+        /// \c cuts holds world.size()-1 non-decreasing curve indices;
+        /// cuts[p] is the first index owned by process p+1.
+        SFCPmap(World& world, Level n, SFCCurve curve, const std::vector<uint64_t>& cuts)
+            : nproc(world.size())
+            , n(n)
+            , curve(curve)
+            , cuts(cuts)
+        {
+            MADNESS_ASSERT(NDIM*n <= 63);
+            MADNESS_ASSERT(int(cuts.size()) == nproc-1);
+        }
+
+        /// The smallest level with at least 64 boxes per process
+        static Level default_level(int nproc) {
+            Level n = 1;
+            while (NDIM*(n+1) <= 63 && (uint64_t(1) << (NDIM*n)) < uint64_t(64)*nproc) ++n;
+            return n;
+        }
+
+        /// Cuts giving each of \c nproc processes about the same total weight
+
+        /// \c weights holds (curve index, weight) pairs of boxes at the level of
+        /// the map in any order; an index may appear more than once.  A process
+        /// starts at the box whose middle is closest to its share of the total.
+        static std::vector<uint64_t> partition(std::vector< std::pair<uint64_t,double> > weights, int nproc) {
+            std::sort(weights.begin(), weights.end());
+            double total = 0.0;
+            for (std::size_t i=0; i<weights.size(); ++i) total += weights[i].second;
+
+            std::vector<uint64_t> cuts;
+            cuts.reserve(nproc-1);
+            double sum = 0.0;
+            for (std::size_t i=0; i<weights.size(); ++i) {
+                while (int(cuts.size()) < nproc-1 &&
+                       sum + 0.5*weights[i].second >= total*(cuts.size()+1)/nproc) {
+                    cuts.push_back(weights[i].first);
+                }
+                sum += weights[i].second;
+            }
+            while (int(cuts.size()) < nproc-1) cuts.push_back(std::numeric_limits<uint64_t>::max());
+            return cuts;
+        }
+
+        /// Position along the curve of the box at the level of the map that contains or starts \c key
+        uint64_t index(const keyT& key) const {
+            const Level m = key.level();
+            Vector<Translation,NDIM> l = key.translation();
+            if (m > n) {
+                for (std::size_t d=0; d<NDIM; ++d) l[d] >>= (m-n);
+            }
+            else if (m < n) {
+                for (std::size_t d=0; d<NDIM; ++d) l[d] <<= (n-m);
+            }
+            return sfc_index<NDIM>(l, n, curve);
+        }
+
+        /// The process owning position \c i along the curve
+        ProcessID owner_of_index(uint64_t i) const {
+            return std::upper_bound(cuts.begin(), cuts.end(), i) - cuts.begin();
+        }
+
+        ProcessID owner(const keyT& key) const {
+            if (key.level() == 0) return 0;
+            return owner_of_index(index(key));
+        }
+
+        Level get_level() const {return n;}
+
+        SFCCurve get_curve() const {return curve;}
+
+        const std::vector<uint64_t>& get_cuts() const {return cuts;}
+
+        void print() const {
+            madness::print("SFCPmap", (curve == SFC_HILBERT ? "hilbert" : "morton"), "level", n);
+        }
+    };
+
+}
+
+#endif // MADNESS_MRA_SFCPMAP_H__INCLUDED
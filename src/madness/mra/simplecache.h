@@ -34,18 +34,135 @@
 #define MADNESS_MRA_SIMPLECACHE_H__INCLUDED
 
 #include <madness/mra/key.h>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 namespace madness {
+
+    /// Hash map for write-once data with lock-free lookups
+
+    /// Entries are never replaced or removed, so lookups take no locks: each entry
+    /// is allocated once and published into an open-addressing table with an atomic
+    /// store, and a full table is replaced by a larger copy that is published the
+    /// same way.  Writers are serialized by a mutex.  Superseded tables are kept
+    /// until the map is destroyed, so a reader still probing one never touches freed
+    /// memory, and pointers to values stay valid for the lifetime of the map.
+    template <typename keyT, typename valueT, typename hashfunT = Hash<keyT> >
+    class WriteOnceHashMap {
+    public:
+        typedef std::pair<const keyT, valueT> datumT;
+
+    private:
+        struct tableT {
+            const std::size_t mask;
+            std::unique_ptr< std::atomic<datumT*>[] > slot;
+            explicit tableT(std::size_t size) : mask(size-1), slot(new std::atomic<datumT*>[size]()) {}
+        };
+
+        std::atomic<tableT*> table;     ///< the current table
+        std::vector<tableT*> tables;    ///< all tables so far, the last one is current
+        std::vector<datumT*> data;      ///< all entries in order of insertion
+        Mutex mutex;                    ///< serializes writers
+        hashfunT hashfun;
+
+        /// insert an entry that is known to be absent into table t
+        static void put(tableT* t, datumT* datum, hashT h) {
+            std::size_t i=h & t->mask;
+            while (t->slot[i].load(std::memory_order_relaxed)) i=(i+1) & t->mask;
+            t->slot[i].store(datum,std::memory_order_release);
+        }
+
+        /// grow the table so that it stays at most half full with one more entry
+        void reserve_one() {
+            tableT* t=tables.back();
+            if (2*(data.size()+1) <= t->mask+1) return;
+            tableT* bigger=new tableT(2*(t->mask+1));
+            for (datumT* datum : data) put(bigger, datum, hashfun(datum->first));
+            tables.push_back(bigger);
+            table.store(bigger,std::memory_order_release);
+        }
+
+        void copy_from(const WriteOnceHashMap& other) {
+            ScopedMutex<Mutex> hold(other.mutex);
+            for (const datumT* datum : other.data) insert(datum->first,datum->second);
+        }
+
+    public:
+        explicit WriteOnceHashMap(std::size_t size=64) : tables(1,nullptr) {
+            std::size_t n=2;
+            while (n<size) n*=2;
+            tables[0]=new tableT(n);
+            table.store(tables[0]);
+        }
+
+        WriteOnceHashMap(const WriteOnceHashMap& other) : WriteOnceHashMap() {
+            copy_from(other);
+        }
+
+        /// replaces the contents ... invalidates pointers into this map
+        WriteOnceHashMap& operator=(const WriteOnceHashMap& other) {
+            if (this != &other) {
+                clear();
+                copy_from(other);
+            }
+            return *this;
+        }
+
+        ~WriteOnceHashMap() {
+            for (datumT* datum : data) delete datum;
+            for (tableT* t : tables) delete t;
+        }
+
+        /// Returns a pointer to the value of key, or NULL if key is absent
+        const valueT* find(const keyT& key) const {
+            const tableT* t=table.load(std::memory_order_acquire);
+            std::size_t i=hashfun(key) & t->mask;
+            while (const datumT* datum=t->slot[i].load(std::memory_order_acquire)) {
+                if (datum->first==key) return &datum->second;
+                i=(i+1) & t->mask;
+            }
+            return 0;
+        }
+
+        /// Inserts (key,value) unless key is present and returns the cached value
+        const valueT& insert(const keyT& key, const valueT& value) {
+            ScopedMutex<Mutex> hold(mutex);
+            const valueT* p=find(key);
+            if (p) return *p;
+            reserve_one();
+            datumT* datum=new datumT(key,value);
+            data.push_back(datum);
+            put(tables.back(), datum, hashfun(key));
+            return datum->second;
+        }
+
+        /// Removes all entries ... not safe with concurrent readers
+        void clear() {
+            ScopedMutex<Mutex> hold(mutex);
+            for (datumT* datum : data) delete datum;
+            data.clear();
+            for (std::size_t i=0; i+1<tables.size(); ++i) delete tables[i];
+            tables.erase(tables.begin(),tables.end()-1);
+            tableT* t=tables.back();
+            for (std::size_t i=0; i<=t->mask; ++i) t->slot[i].store(nullptr,std::memory_order_relaxed);
+        }
+
+        std::size_t size() const {
+            ScopedMutex<Mutex> hold(mutex);
+            return data.size();
+        }
+    };
+
     /// Simplified interface around hash_map to cache stuff for 1D
 
     /// This is a write once cache --- subsequent writes of elements
     /// have no effect (so that pointers/references to cached data
-    /// cannot be invalidated)
+    /// cannot be invalidated).  Lookups are lock free (see WriteOnceHashMap).
     template <typename Q, std::size_t NDIM>
     class SimpleCache {
     private:
-        typedef ConcurrentHashMap< Key<NDIM>, Q > mapT;
-        typedef std::pair<Key<NDIM>, Q> pairT;
+        typedef WriteOnceHashMap< Key<NDIM>, Q > mapT;
         mapT cache;
 
     public:
@@ -54,18 +171,13 @@ namespace madness {
         SimpleCache(const SimpleCache& c) : cache(c.cache) {};
 
         SimpleCache& operator=(const SimpleCache& c) {
-            if (this != &c) {
-                cache.clear();
-                cache = c.cache;
-            }
+            if (this != &c) cache = c.cache;
             return *this;
         }
 
         /// If key is present return pointer to cached value, otherwise return NULL
         inline const Q* getptr(const Key<NDIM>& key) const {
-            typename mapT::const_iterator test = cache.find(key);
-            if (test == cache.end()) return 0;
-            return &(test->second);
+            return cache.find(key);
         }
 
 
@@ -89,7 +201,7 @@ namespace madness {
 
         /// Set value associated with key ... gives ownership of a new copy to the container
         inline void set(const Key<NDIM>& key, const Q& val) {
-            cache.insert(pairT(key,val));
+            cache.insert(key,val);
         }
 
         inline void set(Level n, Translation l, const Q& val) {
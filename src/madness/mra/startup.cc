@@ -63,6 +63,7 @@ namespace madness {
 
         // Process environment variables
         if (getenv("MRA_DATA_DIR")) data_dir = getenv("MRA_DATA_DIR");
+        if (getenv("MAD_OPERATOR_CACHE")) Convolution1DDiskCache::open(getenv("MAD_OPERATOR_CACHE"));
 
         // Need to add an RC file ...
 
@@ -116,6 +117,18 @@ namespace madness {
         MADNESS_ASSERT(gauss_legendre_test());
         MADNESS_ASSERT(test_two_scale_coefficients());
 
+        // The mTxmq kernels chosen per shape are kept in a file, which is
+        // written by the first run after timing the kernels
+        if (getenv("MAD_MTXMQ_TUNE")) {
+            const std::string filename = getenv("MAD_MTXMQ_TUNE");
+            if (!mTxmq_load_tuning(filename)) {
+#ifdef FUNCTION_INSTANTIATE_3
+                mTxmq_tune(FunctionDefaults<3>::get_k(), 3);
+#endif
+                if (world.rank() == 0) mTxmq_save_tuning(filename);
+            }
+        }
+
         // print the configuration options
         if (doprint && world.rank() == 0) {
             print("");
@@ -126,6 +139,7 @@ namespace madness {
             print("   number of processors ...", world.size());
             print("    processor frequency ...", cpu_frequency());
             print("            host system ...", HOST_SYSTEM);
+            print("          mTxmq kernels ...", mTxmq_kernels<double,double,double>().front().name);
             print("          configured by ...", MADNESS_CONFIGURATION_USER);
             print("          configured on ...", MADNESS_CONFIGURATION_HOST);
             print("          configured at ...", MADNESS_CONFIGURATION_DATE);
@@ -3680,4 +3680,229 @@ namespace madness {
         //cout << "MAXERR " << maxerr << endl;
         return (maxerr < 2e-13);
     }
+
+    /// screen displacements one by one with the operator norm, as do_apply used to
+    static void screen_reference(const SeparatedConvolution<double,3>& op, const Key<3>& source,
+                                 double cnorm, double tol, std::vector<int>& index) {
+        const std::vector< Key<3> >& disp = op.get_disp(source.level());
+        const Translation twon = Translation(1)<<source.level();
+        index.clear();
+        for (std::size_t i=0; i<disp.size(); ++i) {
+            bool valid=true;
+            for (std::size_t d=0; d<3; ++d) {
+                Translation l = source.translation()[d] + disp[i].translation()[d];
+                valid = valid and (l>=0) and (l<twon);
+            }
+            if (valid) {
+                double opnorm = op.norm(source.level(), disp[i], source);
+                if (cnorm*opnorm > tol) index.push_back(i);
+                else if (disp[i].distsq() >= 1) break;
+            }
+        }
+    }
+
+    /// compare and time the norm-table screening against the per-displacement loop
+    bool test_screen(World& world) {
+        SeparatedConvolution<double,3> op = CoulombOperator(world, 1.e-4, 1.e-6);
+        const double tols[] = {1.e-2, 1.e-5, 1.e-8};
+        const int nrep = 20;
+
+        // boxes in the corner, at the edge and in the interior of each level
+        std::vector< Key<3> > keys;
+        for (Level n=0; n<8; ++n) {
+            const Translation twon = Translation(1)<<n;
+            const Translation l[] = {0, twon/2, twon-1};
+            for (Translation lx : l) for (Translation ly : l) for (Translation lz : l)
+                keys.push_back(Key<3>(n, Vector<Translation,3>{lx,ly,lz}));
+        }
+
+        bool ok=true;
+        std::vector<int> index, refindex;
+        for (const Key<3>& key : keys) {
+            for (double tol : tols) {
+                op.screen(key, 1.0, tol, index);
+                screen_reference(op, key, 1.0, tol, refindex);
+                ok = ok and (index==refindex);
+            }
+        }
+
+        std::size_t nsurvive=0;
+        double start=wall_time();
+        for (int rep=0; rep<nrep; ++rep) {
+            for (const Key<3>& key : keys) {
+                for (double tol : tols) {
+                    screen_reference(op, key, 1.0, tol, refindex);
+                    nsurvive += refindex.size();
+                }
+            }
+        }
+        double tref=wall_time()-start;
+
+        start=wall_time();
+        for (int rep=0; rep<nrep; ++rep) {
+            for (const Key<3>& key : keys) {
+                for (double tol : tols) {
+                    op.screen(key, 1.0, tol, index);
+                    nsurvive -= index.size();
+                }
+            }
+        }
+        double ttab=wall_time()-start;
+        ok = ok and (nsurvive==0);
+
+        if (world.rank()==0) {
+            printf("   screening %zu boxes: per-displacement %.2e s, norm tables %.2e s\n",
+                   keys.size()*nrep*3, tref, ttab);
+        }
+        return ok;
+    }
+
+    typedef std::vector< std::pair< Key<3>,Key<3> > > workT;
+
+    /// apply op to c for the (source,displacement) pairs work[first,last), return the sum of result norms
+    static double apply_chunk(const SeparatedConvolution<double,3>* op, const workT* work,
+                              std::size_t first, std::size_t last, const Tensor<double>* c) {
+        double sum=0.0;
+        for (std::size_t i=first; i<last; ++i) {
+            sum += op->apply((*work)[i].first, (*work)[i].second, *c, 1.e-12).normf();
+        }
+        return sum;
+    }
+
+    /// apply op for all pairs in work split over ntask concurrent tasks, return the wall time
+    static double time_apply(World& world, const SeparatedConvolution<double,3>& op, const workT& work,
+                             const Tensor<double>& c, int ntask, double& sum) {
+        double start=wall_time();
+        std::vector< Future<double> > part;
+        for (int i=0; i<ntask; ++i) {
+            part.push_back(world.taskq.add(apply_chunk, &op, &work, work.size()*i/ntask,
+                                           work.size()*(i+1)/ntask, &c));
+        }
+        sum=0.0;
+        for (Future<double>& f : part) sum+=f.get();
+        return wall_time()-start;
+    }
+
+    /// compare warmed-up and on-demand operator caches and time apply with increasing thread count
+    bool test_cache(World& world) {
+        const double thresh=1.e-6;
+        const Level nmax=6;
+        const int k=FunctionDefaults<3>::get_k();
+        const int nthread=std::max(1,int(ThreadPool::size()));
+
+        // the nearest neighbors of an interior box on each level
+        workT work;
+        for (Level n=2; n<=nmax; ++n) {
+            const Key<3> source(n, Vector<Translation,3>(Translation(1)<<(n-1)));
+            for (const Key<3>& d : Displacements<3>().get_disp(n, false)) {
+                if (d.distsq()<=3) work.push_back(std::make_pair(source,d));
+            }
+        }
+        Tensor<double> c(2*k,2*k,2*k);
+        c.fillrandom();
+
+        // parameters not used elsewhere so that also the Gaussian terms start cold
+        SeparatedConvolution<double,3> cold = CoulombOperator(world, 3.e-4, 7.e-7);
+        double sumcold=0.0;
+        double tcold=time_apply(world, cold, work, c, nthread, sumcold);
+
+        SeparatedConvolution<double,3> warm = CoulombOperator(world, 3.e-4, 7.e-7);
+        double start=wall_time();
+        std::size_t nsurvive=warm.warm_up(thresh, nmax);
+        double twarm=wall_time()-start;
+
+        bool ok=true;
+        std::vector<int> index, refindex;
+        for (Level n=0; n<=nmax; ++n) {
+            const Key<3> source(n, Vector<Translation,3>((Translation(1)<<n)/2));
+            warm.screen(source, 1.0, 0.1*thresh, index);
+            cold.screen(source, 1.0, 0.1*thresh, refindex);
+            ok = ok and (index==refindex);
+        }
+
+        if (world.rank()==0) {
+            printf("   cache: cold apply of %zu blocks with %d tasks %.2e s, warm_up of %zu displacements %.2e s\n",
+                   work.size(), nthread, tcold, nsurvive, twarm);
+        }
+        double t1=0.0;
+        for (int ntask=1; ntask<=nthread; ntask=(ntask<nthread and 2*ntask>nthread) ? nthread : 2*ntask) {
+            double sum=0.0;
+            double t=time_apply(world, warm, work, c, ntask, sum);
+            if (ntask==1) t1=t;
+            ok = ok and (std::abs(sum-sumcold) <= 1.e-12*sumcold);
+            if (world.rank()==0) printf("   cache: warm apply with %2d tasks %.2e s  speedup %.2f\n", ntask, t, t1/t);
+        }
+        return ok;
+    }
+
+    /// make the NS form of a Gaussian for a range of levels and translations, return the wall time
+    static double make_ns(const GaussianConvolution1D<double>& g, std::vector<const ConvolutionData1D<double>*>& ns) {
+        double start=wall_time();
+        ns.clear();
+        for (Level n=0; n<10; ++n) {
+            for (Translation l=-3; l<=3; ++l) ns.push_back(g.nonstandard(n,l));
+        }
+        return wall_time()-start;
+    }
+
+    /// a Gaussian whose id in the Convolution1DDiskCache collides with that of another kernel
+    struct CollidingGaussian : public GaussianConvolution1D<double> {
+        const hashT id;
+        CollidingGaussian(int k, double coeff, double expnt, hashT id)
+            : GaussianConvolution1D<double>(k, coeff, expnt, 0, false), id(id) {}
+        hashT disk_cache_id() const {return id;}
+    };
+
+    /// store operator blocks in a Convolution1DDiskCache and compare them after reading them back
+    bool test_disk_cache(World& world) {
+        const std::string filename="test_disk_cache."+std::to_string(world.rank());
+        std::remove(filename.c_str());
+        const int k=FunctionDefaults<3>::get_k();
+        const double expnt=1234.5;
+        const double coeff=sqrt(expnt/constants::pi);
+
+        bool ok=Convolution1DDiskCache::open(filename);
+        std::vector<const ConvolutionData1D<double>*> computed, loaded;
+        GaussianConvolution1D<double> g0(k, coeff, expnt, 0, false);
+        double tcompute=make_ns(g0, computed);
+        Convolution1DDiskCache::statsT stats0=Convolution1DDiskCache::stats();
+
+        // a new process would see the blocks only after opening the file
+        ok = ok and Convolution1DDiskCache::open(filename);
+        GaussianConvolution1D<double> g1(k, coeff, expnt, 0, false);
+        double tload=make_ns(g1, loaded);
+        Convolution1DDiskCache::statsT stats1=Convolution1DDiskCache::stats();
+
+        // blocks of another kernel under the same id are computed, not loaded
+        std::vector<const ConvolutionData1D<double>*> colliding, reference;
+        CollidingGaussian g2(k, coeff, 2.0*expnt, g0.disk_cache_id());
+        make_ns(g2, colliding);
+        Convolution1DDiskCache::statsT stats2=Convolution1DDiskCache::stats();
+        Convolution1DDiskCache::close();
+        std::remove(filename.c_str());
+        GaussianConvolution1D<double> g3(k, coeff, 2.0*expnt, 0, false);
+        make_ns(g3, reference);
+        for (std::size_t i=0; i<colliding.size(); ++i) {
+            ok = ok and (colliding[i]->Rnormf==reference[i]->Rnormf) and (colliding[i]->NSnormf==reference[i]->NSnormf);
+        }
+        ok = ok and (stats2.nhit==stats1.nhit) and (stats2.nstale>stats1.nstale);
+
+        for (std::size_t i=0; i<computed.size(); ++i) {
+            const ConvolutionData1D<double>& a=*computed[i];
+            const ConvolutionData1D<double>& b=*loaded[i];
+            ok = ok and (a.Rnormf==b.Rnormf) and (a.Tnormf==b.Tnormf) and (a.NSnormf==b.NSnormf);
+            ok = ok and (a.R.size()==b.R.size()) and (a.RU.size()==b.RU.size());
+            if (a.R.size() and b.R.size()) {
+                ok = ok and ((a.R-b.R).normf()==0.0) and ((a.T-b.T).normf()==0.0);
+                ok = ok and ((a.RVT-b.RVT).normf()==0.0) and ((a.TU-b.TU).normf()==0.0);
+            }
+        }
+        ok = ok and (stats0.nstore>0) and (stats1.nhit>stats0.nhit) and (stats1.nstore==stats0.nstore);
+
+        if (world.rank()==0) {
+            printf("   disk cache: %zu ns blocks computed in %.2e s, loaded in %.2e s (%ld blocks stored, %ld hits)\n",
+                   computed.size(), tcompute, tload, stats0.nstore, stats1.nhit-stats0.nhit);
+        }
+        return ok;
+    }
 }
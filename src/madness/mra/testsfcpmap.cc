@@ -0,0 +1,160 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testsfcpmap.cc
+/// \brief Compares process maps by the messages and wall time of apply and diff
+
+/// Run with several MPI processes, e.g., mpirun -np 8 testsfcpmap.
+/// For each map the same function (Gaussians on a lattice, roughly the
+/// shape of the density of a molecule) is projected, then the Coulomb
+/// operator and the three derivatives are applied.  Messages and bytes are
+/// summed over all processes; imbalance is the largest number of nodes on
+/// a process divided by the average.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/operator.h>
+
+using namespace madness;
+
+typedef std::shared_ptr< WorldDCPmapInterface< Key<3> > > pmapT;
+
+static const double L = 20.0;
+static const double thresh = 1e-6;
+static const int k = 8;
+
+template <typename T, std::size_t NDIM>
+struct lbcost {
+    double operator()(const Key<NDIM>& key, const FunctionNode<T,NDIM>& node) const {
+        return 1.0;
+    }
+};
+
+/// Sum of Gaussians centered on a 3x3x3 lattice
+static double density(const coord_3d& r) {
+    double sum = 0.0;
+    for (int i=-1; i<=1; ++i) {
+        for (int j=-1; j<=1; ++j) {
+            for (int l=-1; l<=1; ++l) {
+                const double x=r[0]-2.5*i, y=r[1]-2.5*j, z=r[2]-2.5*l;
+                sum += exp(-8.0*(x*x+y*y+z*z));
+            }
+        }
+    }
+    return sum;
+}
+
+struct Counts {
+    double nmsg, nbyte;
+    Counts(World& world) {
+        const RMIStats& stats = RMI::get_stats();
+        nmsg = stats.nmsg_sent;
+        nbyte = stats.nbyte_sent;
+        world.gop.sum(nmsg);
+        world.gop.sum(nbyte);
+    }
+};
+
+/// Prints messages, bytes and wall time of what was done since \c c0 and \c t0
+static void report(World& world, const std::string& pmap, const std::string& op, const Counts& c0, double t0) {
+    const double t1 = wall_time();
+    const Counts c1(world);
+    if (world.rank() == 0) {
+        printf("%-16s %-8s %12.0f %14.0f %10.3f\n", pmap.c_str(), op.c_str(),
+               c1.nmsg-c0.nmsg, c1.nbyte-c0.nbyte, t1-t0);
+    }
+}
+
+static void benchmark(World& world, const std::string& name, const pmapT& pmap) {
+    FunctionDefaults<3>::set_pmap(pmap);
+
+    real_function_3d f = real_factory_3d(world).f(density);
+    f.truncate();
+
+    double nnode = f.get_impl()->get_coeffs().size();
+    double maxnode = nnode;
+    world.gop.sum(nnode);
+    world.gop.max(maxnode);
+    if (world.rank() == 0) {
+        printf("%-16s %-8s %12.0f %14s %10.2f\n", name.c_str(), "nodes", nnode, "imbalance", maxnode*world.size()/nnode);
+    }
+
+    real_convolution_3d op = CoulombOperator(world, 1e-3, thresh);
+    world.gop.fence();
+    Counts c0(world);
+    double t0 = wall_time();
+    real_function_3d g = apply(op, f);
+    world.gop.fence();
+    report(world, name, "apply", c0, t0);
+
+    c0 = Counts(world);
+    t0 = wall_time();
+    for (int axis=0; axis<3; ++axis) {
+        real_derivative_3d D = free_space_derivative<double,3>(world, axis);
+        real_function_3d df = D(f);
+    }
+    world.gop.fence();
+    report(world, name, "diff", c0, t0);
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world,argc,argv);
+
+    FunctionDefaults<3>::set_k(k);
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_refine(true);
+    FunctionDefaults<3>::set_initial_level(3);
+    FunctionDefaults<3>::set_truncate_mode(1);
+    FunctionDefaults<3>::set_cubic_cell(-L/2,L/2);
+
+    if (world.rank() == 0) {
+        print("\nprocesses", world.size(), "k", k, "thresh", thresh, "\n");
+        printf("%-16s %-8s %12s %14s %10s\n", "pmap", "", "messages", "bytes", "wall (s)");
+    }
+
+    const pmapT level(new LevelPmap< Key<3> >(world));
+    benchmark(world, "LevelPmap", level);
+    benchmark(world, "SFCPmap morton", pmapT(new SFCPmap<3>(world, -1, SFC_MORTON)));
+    benchmark(world, "SFCPmap hilbert", pmapT(new SFCPmap<3>(world, -1, SFC_HILBERT)));
+
+    // cuts weighted by the number of nodes below each box
+    FunctionDefaults<3>::set_pmap(level);
+    real_function_3d f = real_factory_3d(world).f(density);
+    f.truncate();
+    LoadBalanceDeux<3> lb(world);
+    lb.add_tree(f, lbcost<double,3>(), true);
+    benchmark(world, "SFCPmap weighted", lb.sfc_pmap());
+
+    world.gop.fence();
+    finalize();
+    return 0;
+}
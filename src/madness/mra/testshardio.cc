@@ -0,0 +1,171 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testshardio.cc
+/// \brief Compares the throughput of saving and loading functions through I/O nodes and in shards
+
+/// Run with several MPI processes, e.g., mpirun -np 8 testshardio.
+/// A vector of functions (sums of Gaussians, roughly the shape of orbitals)
+/// is saved and loaded with one writer, with the usual number of writers
+/// (one per 20 processes) and with one shard per process.  The throughput
+/// counts the bytes of the coefficients.
+///
+/// With the argument \c save the functions are only saved in shards, to
+/// \c shardio, and with \c load they are only loaded from there and
+/// compared with the projected ones, so that the two steps can be run
+/// with different numbers of processes.  An optional second argument
+/// gives the number of functions (default 20).
+
+#include <madness/mra/mra.h>
+#include <cstdlib>
+
+using namespace madness;
+
+static const double L = 20.0;
+static const double thresh = 1e-6;
+static const int k = 8;
+
+/// Sum of Gaussians at a few points that depend on \c i
+class Orbital : public FunctionFunctorInterface<double,3> {
+    std::vector<coord_3d> centers;
+public:
+    Orbital(int i) {
+        for (int j=0; j<4; ++j) {
+            coord_3d c;
+            for (int d=0; d<3; ++d) c[d] = 4.0*std::sin(1.3*i + 2.1*j + 0.7*d);
+            centers.push_back(c);
+        }
+    }
+
+    double operator()(const coord_3d& r) const {
+        double sum = 0.0;
+        for (std::size_t j=0; j<centers.size(); ++j) {
+            const double x=r[0]-centers[j][0], y=r[1]-centers[j][1], z=r[2]-centers[j][2];
+            sum += exp(-2.0*(x*x+y*y+z*z));
+        }
+        return sum;
+    }
+};
+
+static void save_functions(World& world, const std::vector<real_function_3d>& f, const char* name, int nio) {
+    archive::ParallelOutputArchive ar(world, name, nio);
+    ar & f.size();
+    for (std::size_t i=0; i<f.size(); ++i) ar & f[i];
+    ar.close();
+}
+
+static std::vector<real_function_3d> load_functions(World& world, const char* name) {
+    archive::ParallelInputArchive ar(world, name);
+    std::size_t n = 0;
+    ar & n;
+    std::vector<real_function_3d> f(n);
+    for (std::size_t i=0; i<n; ++i) ar & f[i];
+    ar.close();
+    return f;
+}
+
+/// Largest norm of the difference between the functions, relative to the norm
+static double error(World& world, const std::vector<real_function_3d>& f, const std::vector<real_function_3d>& g) {
+    MADNESS_ASSERT(f.size() == g.size());
+    double err = 0.0;
+    for (std::size_t i=0; i<f.size(); ++i) err = std::max(err, (f[i]-g[i]).norm2()/f[i].norm2());
+    return err;
+}
+
+static void benchmark(World& world, const std::vector<real_function_3d>& f, const std::string& name, int nio) {
+    double nbyte = 0.0;
+    for (std::size_t i=0; i<f.size(); ++i) nbyte += f[i].size()*sizeof(double);
+
+    world.gop.fence();
+    double t0 = wall_time();
+    save_functions(world, f, "shardio", nio);
+    world.gop.fence();
+    const double tsave = wall_time() - t0;
+
+    t0 = wall_time();
+    std::vector<real_function_3d> g = load_functions(world, "shardio");
+    world.gop.fence();
+    const double tload = wall_time() - t0;
+
+    const double err = error(world, f, g);
+    archive::ParallelOutputArchive::remove(world, "shardio");
+    if (world.rank() == 0) {
+        printf("%-12s %8d %10.1f %10.3f %10.1f %10.3f %10.1f %10.1e\n", name.c_str(), nio, nbyte*1e-6,
+               tsave, nbyte*1e-6/tsave, tload, nbyte*1e-6/tload, err);
+    }
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world,argc,argv);
+
+    const std::string mode = (argc > 1 ? argv[1] : "");
+    const int nfunc = (argc > 2 ? std::atoi(argv[2]) : 20);
+
+    FunctionDefaults<3>::set_k(k);
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_refine(true);
+    FunctionDefaults<3>::set_initial_level(3);
+    FunctionDefaults<3>::set_truncate_mode(1);
+    FunctionDefaults<3>::set_cubic_cell(-L/2,L/2);
+
+    std::vector<real_function_3d> f(nfunc);
+    for (int i=0; i<nfunc; ++i) {
+        f[i] = real_factory_3d(world).functor(std::shared_ptr<FunctionFunctorInterface<double,3> >(new Orbital(i))).nofence();
+    }
+    world.gop.fence();
+    truncate(world, f);
+
+    if (mode == "save") {
+        save_functions(world, f, "shardio", 0);
+        if (world.rank() == 0) print("saved", nfunc, "functions in", world.size(), "shards");
+    }
+    else if (mode == "load") {
+        std::vector<real_function_3d> g = load_functions(world, "shardio");
+        const double err = error(world, f, g);
+        if (world.rank() == 0) print("loaded", g.size(), "functions on", world.size(), "processes, error", err);
+    }
+    else {
+        if (world.rank() == 0) {
+            print("\nprocesses", world.size(), "functions", nfunc, "k", k, "thresh", thresh, "\n");
+            printf("%-12s %8s %10s %10s %10s %10s %10s %10s\n", "", "writers", "MB", "save (s)", "MB/s",
+                   "load (s)", "MB/s", "error");
+        }
+        benchmark(world, f, "one writer", 1);
+        benchmark(world, f, "writers", (world.size()-1)/20 + 1);
+        benchmark(world, f, "shards", 0);
+    }
+
+    world.gop.fence();
+    finalize();
+    return 0;
+}
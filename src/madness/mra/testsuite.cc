@@ -657,6 +657,33 @@ int test_diff(World& world) {
 
         if (world.rank() == 0) print("    error", err);
     }
+
+    // the halo-based gradient must reproduce the node-by-node derivatives
+    std::vector< std::shared_ptr< Derivative<T,NDIM> > > grad = gradient_operator<T,NDIM>(world);
+    START_TIMER;
+    std::vector< Function<T,NDIM> > gradf = apply(grad, f);
+    END_TIMER("halo grad");
+    for (std::size_t axis=0; axis<NDIM; ++axis) {
+        double err = (gradf[axis] - (*grad[axis])(f)).norm2();
+        CHECK(err, thresh, "err in test_diff halo");
+    }
+
+    // stacked derivative of functions with different trees
+    coordT shifted(0.5);
+    functorT functor2(new Gaussian<T,NDIM>(shifted, 3.0*expnt, coeff));
+    std::vector< Function<T,NDIM> > v(3);
+    v[0] = f;
+    v[1] = FunctionFactory<T,NDIM>(world).functor(functor2);
+    v[2] = f*T(2.0);
+    START_TIMER;
+    std::vector< std::vector< Function<T,NDIM> > > gradv = apply_derivatives(world, grad, v);
+    END_TIMER("stacked grad");
+    for (std::size_t axis=0; axis<NDIM; ++axis) {
+        for (std::size_t i=0; i<v.size(); ++i) {
+            double err = (gradv[axis][i] - (*grad[axis])(v[i])).norm2();
+            CHECK(err, thresh, "err in test_diff stacked");
+        }
+    }
     world.gop.fence();
     if (not ok) return 1;
     return 0;
@@ -666,6 +693,9 @@ int test_diff(World& world) {
 
 namespace madness {
     extern bool test_rnlp();
+    extern bool test_screen(World& world);
+    extern bool test_cache(World& world);
+    extern bool test_disk_cache(World& world);
 }
 
 template <typename T, std::size_t NDIM>
@@ -682,6 +712,25 @@ int test_op(World& world) {
     	else print("test_rnlp              FAIL");
     }
 
+    if (NDIM==3) {
+        bool screen_ok=test_screen(world);
+        if (world.rank()==0) {
+            if (screen_ok) print("test_screen            OK");
+            else print("test_screen            FAIL");
+        }
+        bool cache_ok=test_cache(world);
+        if (world.rank()==0) {
+            if (cache_ok) print("test_cache             OK");
+            else print("test_cache             FAIL");
+        }
+        bool disk_ok=test_disk_cache(world);
+        if (world.rank()==0) {
+            if (disk_ok) print("test_disk_cache        OK");
+            else print("test_disk_cache        FAIL");
+        }
+        ok = ok and screen_ok and cache_ok and disk_ok;
+    }
+
     typedef Vector<double,NDIM> coordT;
     typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
 
@@ -896,6 +945,18 @@ int test_coulomb(World& world) {
     }
     CHECK(rerr, 10.0*thresh, "err in test_coulomb");
 
+    // the apply buffers must not change the result beyond roundoff, also
+    // when the apply is not fenced
+    f.standard();
+    const std::size_t bufsize=FunctionDefaults<3>::get_apply_buffer_size();
+    FunctionDefaults<3>::set_apply_buffer_size(64);
+    Function<double,3> r0 = apply(op,f,false);
+    world.gop.fence();
+    FunctionDefaults<3>::set_apply_buffer_size(bufsize);
+    double bufdiff=(r-r0).norm2();
+    if (world.rank() == 0) print("    buffered apply diff", bufdiff);
+    CHECK(bufdiff, 1e-4*thresh, "apply buffer in test_coulomb");
+
     if (ok) return 0;
     return 1;
 }
@@ -1218,6 +1279,40 @@ int test_io(World& world) {
     if (world.rank() == 0) print("err = ", err);
     CHECK(err,1e-12,"test_io");
 
+    // one shard per process, with several containers in one archive
+    Function<T,NDIM> h = copy(f).scale(T(2.0));
+    archive::ParallelOutputArchive sout(world, "shards", 0);
+    sout & f & long(42) & h;
+    sout.close();
+
+    Function<T,NDIM> g1, g2;
+    long answer = 0;
+    archive::ParallelInputArchive sin(world, "shards");
+    CHECK(double(sin.num_shards())-world.size(), 0.5, "number of shards");
+    sin & g1 & answer & g2;
+    sin.close();
+    sin.remove();
+
+    CHECK((g1-f).norm2(), 1e-12, "first function from shards");
+    CHECK(double(answer-42), 0.5, "number between shards");
+    CHECK((g2-h).norm2(), 1e-12, "second function from shards");
+    CHECK(double(archive::ParallelInputArchive::exists(world, "shards")), 0.5, "shards removed");
+
+    // save() keeps the format with one writer, save_sharded() writes shards
+    save(f, "saved");
+    save_sharded(h, "saved_sharded");
+    Function<T,NDIM> g3 = copy(f), g4 = copy(f);
+    load(g3, "saved");
+    load(g4, "saved_sharded");
+    {
+        archive::ParallelInputArchive plain(world, "saved");
+        CHECK(double(plain.is_sharded()), 0.5, "save() is not sharded");
+    }
+    archive::ParallelOutputArchive::remove(world, "saved");
+    archive::ParallelOutputArchive::remove(world, "saved_sharded");
+    CHECK((g3-f).norm2(), 1e-12, "function from save()");
+    CHECK((g4-h).norm2(), 1e-12, "function from save_sharded()");
+
     //    MADNESS_ASSERT(err == 0.0);
 
     if (world.rank() == 0) print("test_io OK");
@@ -1226,6 +1321,417 @@ int test_io(World& world) {
     return 1;
 }
 
+/// number of nodes of f with coefficients in full precision
+template <typename T, std::size_t NDIM>
+long count_unpacked(const Function<T,NDIM>& f) {
+    typedef typename FunctionImpl<T,NDIM>::dcT dcT;
+    long n = 0;
+    for (typename dcT::const_iterator it=f.get_impl()->get_coeffs().begin(); it!=f.get_impl()->get_coeffs().end(); ++it) {
+        if (it->second.has_coeff() && !it->second.is_packed()) ++n;
+    }
+    f.world().gop.sum(n);
+    return n;
+}
+
+template <typename T, std::size_t NDIM>
+int test_pack(World& world) {
+    if (world.rank() == 0) {
+        print("\nTest pack - type =", archive::get_type_name<T>(),", ndim =",NDIM,"\n");
+    }
+    bool ok=true;
+    typedef Vector<double,NDIM> coordT;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
+
+    FunctionDefaults<NDIM>::set_k(6);
+    FunctionDefaults<NDIM>::set_thresh(1e-4);
+    FunctionDefaults<NDIM>::set_truncate_mode(0);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+    FunctionDefaults<NDIM>::set_cubic_cell(-10,10);
+
+    const coordT origin(0.0);
+    const double expnt = 10.0;
+    const double coeff = pow(2.0/PI,0.25*NDIM);
+    functorT functor(new Gaussian<T,NDIM>(origin, expnt, coeff));
+    Function<T,NDIM> f = FunctionFactory<T,NDIM>(world).functor(functor);
+    const double norm = f.norm2();
+
+    for (int compressed=0; compressed<2; ++compressed) {
+        if (compressed) f.compress();
+        Function<T,NDIM> g = copy(f);
+        const double size = g.size();
+        const double nodes = g.tree_size()*(sizeof(Key<NDIM>) + sizeof(FunctionNode<T,NDIM>));
+        const double real_size = g.get_impl()->real_size() - nodes;
+        g.pack();
+        CHECK(g.size()-size, 0.5, "number of packed coefficients");
+        CHECK((g.get_impl()->real_size() - nodes)/real_size - 0.5, 1e-12, "memory of packed coefficients");
+
+        // the coefficients of a packed node may not be used
+        long nthrow = 0;
+        typedef typename FunctionImpl<T,NDIM>::dcT dcT;
+        for (typename dcT::const_iterator it=g.get_impl()->get_coeffs().begin(); it!=g.get_impl()->get_coeffs().end(); ++it) {
+            if (!it->second.is_packed()) continue;
+            try {
+                it->second.coeff();
+            }
+            catch (const MadnessException&) {
+                ++nthrow;
+            }
+            break;
+        }
+        world.gop.sum(nthrow);
+        CHECK(double(nthrow == 0), 0.5, "coeff() of packed node throws");
+
+        // packed nodes are stored in full precision and load unpacked
+        int nio = (world.size()-1)/20 + 1;
+        archive::ParallelOutputArchive out(world, "packed", nio);
+        out & g;
+        out.close();
+        Function<T,NDIM> h;
+        archive::ParallelInputArchive in(world, "packed", nio);
+        in & h;
+        in.close();
+        in.remove();
+        long nloaded = 0;
+        for (typename dcT::const_iterator it=h.get_impl()->get_coeffs().begin(); it!=h.get_impl()->get_coeffs().end(); ++it) {
+            if (it->second.is_packed()) ++nloaded;
+        }
+        world.gop.sum(nloaded);
+        CHECK(double(nloaded), 0.5, "packed function loads unpacked");
+
+        // compress and reconstruct read the packed coefficients and
+        // pack what they compute if pack_results is set
+        Function<T,NDIM> p = copy(g);
+        p.set_pack_results(true);
+        if (compressed) p.reconstruct();
+        else p.compress();
+        CHECK(double(count_unpacked(p)), 0.5, "transform of packed function");
+        p.unpack();
+        p.set_pack_results(false);
+        if (compressed) p.compress();
+        else p.reconstruct();
+
+        g.unpack();
+        double err = (g-f).norm2();
+        if (world.rank() == 0) print("compressed", compressed, "err", err);
+        CHECK(err, 1e-7*norm, "err in packed function");
+        err = (h-g).norm2();
+        CHECK(err, 1e-14, "err in stored packed function");
+        err = (p-f).norm2();
+        CHECK(err, 1e-7*norm, "err in transformed packed");
+    }
+
+    // apply reads the packed coefficients of the source
+    Tensor<double> coeffs(1), exponents(1);
+    exponents(0L) = 10.0;
+    coeffs(0L) = pow(exponents(0L)/PI, 0.5*NDIM);
+    SeparatedConvolution<T,NDIM> op(world, coeffs, exponents);
+    Function<T,NDIM> g = copy(f);
+    g.pack();
+    g.set_pack_results(true);
+    Function<T,NDIM> r = apply(op, g);
+    CHECK(double(count_unpacked(g)), 0.5, "source of apply stays packed");
+    CHECK(double(count_unpacked(r)), 0.5, "result of apply is packed");
+    r.set_pack_results(false);
+    r.unpack();
+    Function<T,NDIM> s = apply(op, f);
+    const double err = (r-s).norm2();
+    if (world.rank() == 0) print("apply err", err);
+    CHECK(err, 1e-6*s.norm2(), "err in apply of packed");
+
+    if (world.rank() == 0) print("test_pack OK");
+    world.gop.fence();
+    if (ok) return 0;
+    return 1;
+}
+
+template <typename T, std::size_t NDIM>
+int test_compress_truncate(World& world) {
+    if (world.rank() == 0) {
+        print("\nTest compress_truncate - type =", archive::get_type_name<T>(),", ndim =",NDIM,"\n");
+    }
+    bool ok=true;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
+
+    FunctionDefaults<NDIM>::set_k(8);
+    FunctionDefaults<NDIM>::set_thresh(1e-8);
+    FunctionDefaults<NDIM>::set_truncate_mode(0);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+    const bool truncate_on_project = FunctionDefaults<NDIM>::get_truncate_on_project();
+    FunctionDefaults<NDIM>::set_truncate_on_project(false);
+    FunctionDefaults<NDIM>::set_cubic_cell(-10,10);
+    const double tol = 1e-5;
+
+    std::vector< Function<T,NDIM> > v(8);
+    for (std::size_t i=0; i<v.size(); ++i) {
+        functorT functor(RandomGaussian<T,NDIM>(FunctionDefaults<NDIM>::get_cell(),1e3));
+        v[i] = FunctionFactory<T,NDIM>(world).functor(functor);
+    }
+    std::vector< Function<T,NDIM> > u = copy(world, v);
+    std::vector< Function<T,NDIM> > w = copy(world, v);
+    std::vector<double> norms = norm2s(world, v);
+
+    // one function at a time, separate traversals against the fused one
+    START_TIMER;
+    for (std::size_t i=0; i<v.size(); ++i) {
+        v[i].compress();
+        v[i].norm_tree();
+        v[i].truncate(tol);
+    }
+    END_TIMER("separate");
+    START_TIMER;
+    for (std::size_t i=0; i<u.size(); ++i) u[i].compress_truncate(tol);
+    END_TIMER("compress_truncate");
+
+    for (std::size_t i=0; i<v.size(); ++i) {
+        CHECK(double(v[i].tree_size())-double(u[i].tree_size()), 0.5, "tree size");
+        CHECK((v[i]-u[i]).norm2(), 1e-14*norms[i], "fused vs separate");
+        CHECK(u[i].norm2()-norms[i], 10*tol, "norm after truncation");
+
+        // the norm of the whole function is at the root
+        const Key<NDIM> key0(0);
+        if (u[i].get_impl()->get_coeffs().is_local(key0)) {
+            const double norm_tree = u[i].get_impl()->get_coeffs().find(key0).get()->second.get_norm_tree();
+            CHECK(norm_tree-norms[i], 1e-12*norms[i], "norm_tree at the root");
+        }
+    }
+
+    // vector variant
+    START_TIMER;
+    truncate(world, w, tol);
+    END_TIMER("vector truncate");
+    for (std::size_t i=0; i<w.size(); ++i) {
+        CHECK((w[i]-u[i]).norm2(), 1e-14*norms[i], "vector truncate");
+    }
+
+    FunctionDefaults<NDIM>::set_truncate_on_project(truncate_on_project);
+    if (world.rank() == 0) print("test_compress_truncate OK");
+    world.gop.fence();
+    if (ok) return 0;
+    return 1;
+}
+
+template <typename T, std::size_t NDIM>
+int test_vector_compress(World& world) {
+    if (world.rank() == 0) {
+        print("\nTest vector compress/reconstruct - type =", archive::get_type_name<T>(),", ndim =",NDIM,"\n");
+    }
+    bool ok=true;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
+
+    FunctionDefaults<NDIM>::set_k(8);
+    FunctionDefaults<NDIM>::set_thresh(1e-8);
+    FunctionDefaults<NDIM>::set_truncate_mode(0);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+    FunctionDefaults<NDIM>::set_cubic_cell(-10,10);
+
+    std::vector< Function<T,NDIM> > v(8);
+    for (std::size_t i=0; i<v.size(); ++i) {
+        functorT functor(RandomGaussian<T,NDIM>(FunctionDefaults<NDIM>::get_cell(),1e3));
+        // one function with another k, which cannot share the traversal
+        v[i] = FunctionFactory<T,NDIM>(world).functor(functor).k(i==3 ? 6 : 8);
+    }
+    std::vector< Function<T,NDIM> > u = copy(world, v);
+    std::vector<double> norms = norm2s(world, v);
+
+    // the same function twice must be compressed only once
+    std::vector< Function<T,NDIM> > w(v);
+    w.push_back(v[1]);
+
+    START_TIMER;
+    for (std::size_t i=0; i<u.size(); ++i) u[i].compress(false);
+    world.gop.fence();
+    END_TIMER("compress one by one");
+    START_TIMER;
+    compress(world, w);
+    END_TIMER("vector compress");
+
+    for (std::size_t i=0; i<v.size(); ++i) {
+        CHECK(double(!v[i].is_compressed()), 0.5, "is compressed");
+        CHECK(double(v[i].tree_size())-double(u[i].tree_size()), 0.5, "tree size");
+        CHECK((v[i]-u[i]).norm2(), 1e-14*norms[i]+1e-30, "vector compress");
+    }
+
+    START_TIMER;
+    for (std::size_t i=0; i<u.size(); ++i) u[i].reconstruct(false);
+    world.gop.fence();
+    END_TIMER("reconstruct one by one");
+    START_TIMER;
+    reconstruct(world, w);
+    END_TIMER("vector reconstruct");
+
+    for (std::size_t i=0; i<v.size(); ++i) {
+        CHECK(double(v[i].is_compressed()), 0.5, "is reconstructed");
+        CHECK(double(v[i].tree_size())-double(u[i].tree_size()), 0.5, "tree size");
+        CHECK((v[i]-u[i]).norm2(), 1e-14*norms[i]+1e-30, "vector reconstruct");
+    }
+
+    if (world.rank() == 0) print("test_vector_compress OK");
+    world.gop.fence();
+    if (ok) return 0;
+    return 1;
+}
+
+template <typename T, std::size_t NDIM>
+int test_sfcpmap(World& world) {
+    if (world.rank() == 0) {
+        print("\nTest SFCPmap - type =", archive::get_type_name<T>(),", ndim =",NDIM,"\n");
+    }
+    bool ok=true;
+    typedef Key<NDIM> keyT;
+    typedef std::shared_ptr< WorldDCPmapInterface<keyT> > pmapT;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
+
+    // both curves visit every box at level n once, the Hilbert curve only steps to face neighbors
+    const Level n = 3;
+    const long nbox = 1L<<(NDIM*n);
+    for (int curve=SFC_MORTON; curve<=SFC_HILBERT; ++curve) {
+        std::vector< Vector<Translation,NDIM> > boxes(nbox);
+        std::vector<bool> seen(nbox,false);
+        long nrepeat = 0;
+        for (IndexIterator it(std::vector<long>(NDIM,1L<<n)); it; ++it) {
+            Vector<Translation,NDIM> l;
+            for (std::size_t d=0; d<NDIM; ++d) l[d] = it[d];
+            const uint64_t i = sfc_index<NDIM>(l, n, SFCCurve(curve));
+            if (i >= uint64_t(nbox) || seen[i]) {
+                ++nrepeat;
+            }
+            else {
+                seen[i] = true;
+                boxes[i] = l;
+            }
+        }
+        CHECK(double(nrepeat), 0.5, "curve is a bijection");
+        if (curve == SFC_HILBERT) {
+            long njump = 0;
+            for (long i=1; i<nbox; ++i) {
+                Translation dist = 0;
+                for (std::size_t d=0; d<NDIM; ++d) dist += std::abs(boxes[i][d]-boxes[i-1][d]);
+                if (dist != 1) ++njump;
+            }
+            CHECK(double(njump), 0.5, "hilbert steps to neighbors");
+        }
+    }
+
+    // equal weights give segments of equal weight
+    std::vector< std::pair<uint64_t,double> > weights;
+    for (long i=0; i<64; ++i) weights.push_back(std::make_pair(uint64_t(63-i), 1.0));
+    std::vector<uint64_t> cuts = SFCPmap<NDIM>::partition(weights, 4);
+    CHECK(std::abs(double(cuts[0])-16)+std::abs(double(cuts[1])-32)+std::abs(double(cuts[2])-48), 0.5, "partition");
+
+    // owners are in range and do not decrease along the curve
+    const SFCPmap<NDIM> pmap(world);
+    long nbad = 0;
+    ProcessID last = 0;
+    for (IndexIterator it(std::vector<long>(NDIM,1L<<pmap.get_level())); it; ++it) {
+        Vector<Translation,NDIM> l;
+        for (std::size_t d=0; d<NDIM; ++d) l[d] = it[d];
+        const ProcessID p = pmap.owner(keyT(pmap.get_level(), l));
+        if (p < 0 || p >= world.size()) ++nbad;
+    }
+    for (uint64_t i=0; i < (uint64_t(1) << (NDIM*pmap.get_level())); ++i) {
+        const ProcessID p = pmap.owner_of_index(i);
+        if (p < last) ++nbad;
+        last = p;
+    }
+    CHECK(double(nbad), 0.5, "owners along the curve");
+
+    // functions survive redistribution to a weighted map and work under it
+    FunctionDefaults<NDIM>::set_k(8);
+    FunctionDefaults<NDIM>::set_thresh(1e-8);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+    FunctionDefaults<NDIM>::set_cubic_cell(-10,10);
+    functorT functor(RandomGaussian<T,NDIM>(FunctionDefaults<NDIM>::get_cell(),1e3));
+    Function<T,NDIM> f = FunctionFactory<T,NDIM>(world).functor(functor);
+    const double norm = f.norm2();
+    const double norm2 = (f*f).norm2();
+    Vector<double,NDIM> x(0.1);
+    const T value = f(x);
+
+    const pmapT oldpmap = FunctionDefaults<NDIM>::get_pmap();
+    LoadBalanceDeux<NDIM> lb(world);
+    lb.add_tree(f, lbcost<T,NDIM>(), true);
+    FunctionDefaults<NDIM>::redistribute(world, lb.sfc_pmap());
+    CHECK(std::abs(f.norm2()-norm), 1e-14*norm+1e-30, "norm after redistribution");
+    CHECK(std::abs(f(x)-value), 1e-14*norm+1e-30, "value after redistribution");
+    CHECK(std::abs((f*f).norm2()-norm2), 1e-12*norm2+1e-30, "product under SFCPmap");
+
+    // rebalancing with unchanged costs keeps the cuts, so nothing moves
+    LoadBalanceDeux<NDIM> lb2(world);
+    lb2.add_tree(f, lbcost<T,NDIM>(), true);
+    WorldDCRedistributeStats stats = FunctionDefaults<NDIM>::redistribute(world, lb2.sfc_rebalance(0.1));
+    CHECK(stats.nmoved, 0.5, "nothing moves when balanced");
+    CHECK(std::abs(stats.imbalance_after-stats.imbalance_before), 1e-12, "imbalance unchanged");
+    CHECK(std::abs(f.norm2()-norm), 1e-14*norm+1e-30, "norm after rebalancing");
+    FunctionDefaults<NDIM>::redistribute(world, oldpmap);
+
+    if (world.rank() == 0) print("test_sfcpmap OK");
+    world.gop.fence();
+    if (ok) return 0;
+    return 1;
+}
+
+template <typename T, std::size_t NDIM>
+int test_funcfile(World& world) {
+    if (world.rank() == 0) {
+        print("\nTest function file - type =", archive::get_type_name<T>(),", ndim =",NDIM,"\n");
+    }
+    bool ok=true;
+    typedef Vector<double,NDIM> coordT;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
+
+    FunctionDefaults<NDIM>::set_k(6);
+    FunctionDefaults<NDIM>::set_thresh(1e-8);
+    FunctionDefaults<NDIM>::set_truncate_mode(0);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+    FunctionDefaults<NDIM>::set_cubic_cell(-10,10);
+
+    // g is coarser than f near the origin and finer far away
+    const double coeff = pow(2.0/PI,0.25*NDIM);
+    functorT ffunctor(new Gaussian<T,NDIM>(coordT(0.0), 10.0, coeff));
+    functorT gfunctor(new Gaussian<T,NDIM>(coordT(0.3), 1.0, 1.0));
+    Function<T,NDIM> f = FunctionFactory<T,NDIM>(world).functor(ffunctor);
+    Function<T,NDIM> g = FunctionFactory<T,NDIM>(world).functor(gfunctor);
+
+    save(f, "funcfile");
+    archive_to_function_file<T,NDIM>(world, "funcfile", "funcfile.mfn");
+    archive::ParallelOutputArchive::remove(world, "funcfile");
+
+    FunctionFile<T,NDIM> file("funcfile.mfn");
+    CHECK(std::abs(double(file.size())-double(f.tree_size())), 0.5, "number of boxes");
+
+    coordT x(0.1);
+    x[0] = -0.23;
+    CHECK(std::abs(file.eval(x)-f(x)), 1e-12, "eval from the file");
+
+    Tensor<double> cell(NDIM,2);
+    for (std::size_t d=0; d<NDIM; ++d) {
+        cell(d,0) = -1.0;
+        cell(d,1) = 0.7;
+    }
+    std::vector<long> npt(NDIM,7);
+    CHECK((file.eval_cube(cell,npt)-f.eval_cube(cell,npt)).normf(), 1e-10, "eval_cube from the file");
+
+    CHECK(std::abs(file.inner(g)-inner(f,g)), 1e-12, "inner with the file");
+
+    std::shared_ptr< FunctionFile<T,NDIM> > pfile(new FunctionFile<T,NDIM>("funcfile.mfn"));
+    Function<T,NDIM> h = FunctionFactory<T,NDIM>(world).k(pfile->k())
+        .functor(functorT(new FunctionFileFunctor<T,NDIM>(pfile)));
+    CHECK((h-f).norm2(), 1e-12, "function backed by the file");
+
+    world.gop.fence();
+    if (world.rank() == 0) std::remove("funcfile.mfn");
+
+    if (world.rank() == 0) print("test_funcfile OK");
+    world.gop.fence();
+    if (ok) return 0;
+    return 1;
+}
+
 template <typename T, std::size_t NDIM>
 int test_apply_push_1d(World& world) {
     typedef Vector<double,NDIM> coordT;
@@ -1335,6 +1841,11 @@ int main(int argc, char**argv) {
         nfail+=test_plot<double,1>(world);
         nfail+=test_apply_push_1d<double,1>(world);
         nfail+=test_io<double,1>(world);
+        nfail+=test_pack<double,1>(world);
+        nfail+=test_compress_truncate<double,1>(world);
+        nfail+=test_vector_compress<double,1>(world);
+        nfail+=test_sfcpmap<double,1>(world);
+        nfail+=test_funcfile<double,1>(world);
 
         // stupid location for this test
         GenericConvolution1D<double,GaussianGenericFunctor<double> > gen(10,GaussianGenericFunctor<double>(100.0,100.0),0);
@@ -1353,6 +1864,8 @@ int main(int argc, char**argv) {
         nfail+=test_op<double_complex,1>(world);
         nfail+=test_plot<double_complex,1>(world);
         nfail+=test_io<double_complex,1>(world);
+        nfail+=test_pack<double_complex,1>(world);
+        nfail+=test_vector_compress<double_complex,1>(world);
 
         //TaskInterface::debug = true;
         nfail+=test_basic<double,2>(world);
@@ -1371,6 +1884,11 @@ int main(int argc, char**argv) {
         nfail+=test_coulomb(world);
         nfail+=test_plot<double,3>(world);
         nfail+=test_io<double,3>(world);
+        nfail+=test_pack<double,3>(world);
+        nfail+=test_compress_truncate<double,3>(world);
+        nfail+=test_vector_compress<double,3>(world);
+        nfail+=test_sfcpmap<double,3>(world);
+        nfail+=test_funcfile<double,3>(world);
 
         test_plot<double,4>(world); // slow unless reduce npt in test_plot
 
@@ -123,6 +123,7 @@
 #include <madness/mra/derivative.h>
 #include <madness/tensor/distributed_matrix.h>
 #include <cstdio>
+#include <algorithm>
 
 namespace madness {
 
@@ -135,13 +136,25 @@ namespace madness {
                   bool fence=true) {
 
         PROFILE_BLOCK(Vcompress);
+        typedef FunctionImpl<T,NDIM> implT;
+        std::vector<implT*> shared;
         bool must_fence = false;
         for (unsigned int i=0; i<v.size(); ++i) {
-            if (!v[i].is_compressed()) {
-                v[i].compress(false);
+            if (v[i].get_impl() && !v[i].is_compressed()) {
+                implT* impl = v[i].get_impl().get();
+                if (std::find(shared.begin(), shared.end(), impl) != shared.end()) continue;
+                if (VERIFY_TREE) v[i].verify_tree();
+                // functions sharing the tree layout of the first one are compressed together
+                if (shared.empty() || (impl->get_pmap() == shared[0]->get_pmap() && impl->get_k() == shared[0]->get_k())) {
+                    shared.push_back(impl);
+                }
+                else {
+                    v[i].compress(false);
+                }
                 must_fence = true;
             }
         }
+        if (!shared.empty()) shared[0]->compress_vector(shared, false);
 
         if (fence && must_fence) world.gop.fence();
     }
@@ -153,13 +166,24 @@ namespace madness {
                      const std::vector< Function<T,NDIM> >& v,
                      bool fence=true) {
         PROFILE_BLOCK(Vreconstruct);
+        typedef FunctionImpl<T,NDIM> implT;
+        std::vector<implT*> shared;
         bool must_fence = false;
         for (unsigned int i=0; i<v.size(); ++i) {
-            if (v[i].is_compressed()) {
-                v[i].reconstruct(false);
+            if (v[i].get_impl() && v[i].is_compressed()) {
+                implT* impl = v[i].get_impl().get();
+                if (std::find(shared.begin(), shared.end(), impl) != shared.end()) continue;
+                // functions sharing the tree layout of the first one are reconstructed together
+                if (shared.empty() || (impl->get_pmap() == shared[0]->get_pmap() && impl->get_k() == shared[0]->get_k())) {
+                    shared.push_back(impl);
+                }
+                else {
+                    v[i].reconstruct(false);
+                }
                 must_fence = true;
             }
         }
+        if (!shared.empty()) shared[0]->reconstruct_vector(shared, false);
 
         if (fence && must_fence) world.gop.fence();
     }
@@ -215,6 +239,32 @@ namespace madness {
     }
 
 
+    /// Keeps the coefficients of a vector of functions in single precision, see Function::pack()
+    template <typename T, std::size_t NDIM>
+    void pack(World& world,
+              std::vector< Function<T,NDIM> >& v,
+              bool fence=true) {
+        PROFILE_BLOCK(Vpack);
+        for (unsigned int i=0; i<v.size(); ++i) {
+            v[i].pack(false);
+        }
+        if (fence) world.gop.fence();
+    }
+
+
+    /// Restores the coefficients of a vector of functions to full precision
+    template <typename T, std::size_t NDIM>
+    void unpack(World& world,
+                std::vector< Function<T,NDIM> >& v,
+                bool fence=true) {
+        PROFILE_BLOCK(Vunpack);
+        for (unsigned int i=0; i<v.size(); ++i) {
+            v[i].unpack(false);
+        }
+        if (fence) world.gop.fence();
+    }
+
+
     /// Generates standard form of a vector of functions
     template <typename T, std::size_t NDIM>
     void standard(World& world,
@@ -236,16 +286,18 @@ namespace madness {
                   bool fence=true) {
         PROFILE_BLOCK(Vtruncate);
 
-        compress(world, v);
-
+        // compress_truncate needs no fence between compressing and truncating
         for (unsigned int i=0; i<v.size(); ++i) {
-            v[i].truncate(tol, false);
+            v[i].compress_truncate(tol, false);
         }
 
         if (fence) world.gop.fence();
     }
 
     /// Applies a derivative operator to a vector of functions
+
+    /// The trees of all functions are traversed together and the nodes
+    /// sharing a key are differentiated as one stacked matrix multiply.
     template <typename T, std::size_t NDIM>
     std::vector< Function<T,NDIM> >
     apply(World& world,
@@ -254,10 +306,27 @@ namespace madness {
           bool fence=true)
     {
         reconstruct(world, v);
-        std::vector< Function<T,NDIM> > df(v.size());
-        for (unsigned int i=0; i<v.size(); ++i) {
-            df[i] = D(v[i],false);
-        }
+        if (v.empty()) return std::vector< Function<T,NDIM> >();
+        return D(v, DerivativeHalo<T,NDIM>::make(v, D.get_bc()), fence);
+    }
+
+    /// Applies a set of derivative operators (e.g. the gradient) to a vector of functions
+
+    /// The neighbor coefficients of the functions are gathered once with
+    /// DerivativeHalo::make and shared by all operators.
+    /// @return result[i][j] = D[i](v[j])
+    template <typename T, std::size_t NDIM>
+    std::vector< std::vector< Function<T,NDIM> > >
+    apply_derivatives(World& world,
+                      const std::vector< std::shared_ptr< Derivative<T,NDIM> > >& D,
+                      const std::vector< Function<T,NDIM> >& v,
+                      bool fence=true)
+    {
+        reconstruct(world, v);
+        std::vector< std::vector< Function<T,NDIM> > > df(D.size());
+        if (D.empty() || v.empty()) return df;
+        std::vector< std::shared_ptr< DerivativeHalo<T,NDIM> > > halo = DerivativeHalo<T,NDIM>::make(v, D[0]->get_bc());
+        for (unsigned int i=0; i<D.size(); ++i) df[i] = (*D[i])(v, halo, false);
         if (fence) world.gop.fence();
         return df;
     }
@@ -892,6 +961,13 @@ namespace madness {
 
         world.gop.fence();
 
+        // send the results still held in the apply buffers to their owners
+        bool buffered=false;
+        for (unsigned int i=0; i<f.size(); ++i) {
+            if (result[i].get_impl()->flush_apply_buffer()) buffered=true;
+        }
+        if (buffered) world.gop.fence();
+
         standard(world, ncf, false);  // restores promise of logical constness
         world.gop.fence();
         reconstruct(world, result);
@@ -920,6 +996,13 @@ namespace madness {
 
         world.gop.fence();
 
+        // send the results still held in the apply buffers to their owners
+        bool buffered=false;
+        for (unsigned int i=0; i<f.size(); ++i) {
+            if (result[i].get_impl()->flush_apply_buffer()) buffered=true;
+        }
+        if (buffered) world.gop.fence();
+
         standard(world, ncf, false);  // restores promise of logical constness
         reconstruct(world, result);
 
@@ -899,6 +899,12 @@ namespace madness {
 
       world.gop.fence();
 
+      bool buffered=false;
+      for (unsigned int j=0; j<ff; ++j)
+	if (result[j].get_impl()->flush_apply_buffer()) buffered=true;
+      if (buffered)
+	world.gop.fence();
+
       standard(world, ncf, false);  // restores promise of logical constness
       world.gop.fence();
       reconstruct(world, result, blk);
@@ -933,6 +939,12 @@ namespace madness {
       }
       world.gop.fence();
 
+      bool buffered=false;
+      for (unsigned int j=0; j<ff; ++j)
+	if (result[j].get_impl()->flush_apply_buffer()) buffered=true;
+      if (buffered)
+	world.gop.fence();
+
       standard(world, ncf, blk, false);  // restores promise of logical constness
       world.gop.fence();
       reconstruct(world, result, blk);
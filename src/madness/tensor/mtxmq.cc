@@ -123,9 +123,14 @@ extern "C" void TmTxm2(long dimi, long dimj, long dimk,
 
 namespace madness {
 
+#if defined(X86_64) && !defined(DISABLE_SSE3)
+    void mTxmq_asm(const long dimi, const long dimj, const long dimk,
+                   double* restrict c, const double* a, const double* b) {
+#else
     template<>
     void mTxmq(const long dimi, const long dimj, const long dimk,
                double* restrict c, const double* a, const double* b) {
+#endif
         //PROFILE_BLOCK(mTxmq_double_asm);
         //std::cout << "IN DOUBLE ASM VERSION " << dimi << " " << dimj << " " << dimk << "\n";
 
@@ -321,9 +326,8 @@ namespace madness {
 
 #if defined(X86_64)  && !defined(DISABLE_SSE3)
 namespace madness {
-    template <>
-    void mTxmq(const long dimi, const long dimj, const long dimk,
-               double_complex* restrict c, const double_complex* a, const double_complex* b) {
+    void mTxmq_asm(const long dimi, const long dimj, const long dimk,
+                   double_complex* restrict c, const double_complex* a, const double_complex* b) {
 
         //PROFILE_BLOCK(mTxmq_complex_asm);
         const long dimi16 = dimi<<4;
@@ -769,9 +773,10 @@ namespace madness {
     }
 
 #ifndef __INTEL_COMPILER
-    template <>
-    void mTxmq(const long dimi, const long dimj, const long dimk,
-               double_complex* restrict c, const double_complex* a, const double* b)
+    // The asm blocks below save their operands on the stack, so they first step
+    // over the red zone in which the compiler may keep locals of this leaf function
+    void mTxmq_asm(const long dimi, const long dimj, const long dimk,
+                   double_complex* restrict c, const double_complex* a, const double* b)
     {
       const long itile = 14;
       for (long ilo = 0; ilo < dimi; ilo += itile, a+=itile, c+=itile*dimj)
@@ -785,7 +790,7 @@ namespace madness {
             __asm__ volatile
             (
                 // save registers to be 'clobbered'
-                "push %0; push %1; push %4; push %5;\n "
+                "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
                 // zero out mmx registers
                 "pxor %%xmm2,%%xmm2;\n"
 
@@ -798,11 +803,12 @@ namespace madness {
 
                 "movapd   %%xmm2, (%5);\n"
 
-                "pop %5; pop %4; pop %1; pop %0;\n"
+                "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
                 :
                 : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-                :
+                : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                  "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -813,7 +819,7 @@ namespace madness {
             __asm__ volatile
             (
                 // save registers to be 'clobbered'
-                "push %0; push %1; push %4; push %5;\n "
+                "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
                 // zero out mmx registers
                 "pxor %%xmm2,%%xmm2;\n"
                 "pxor %%xmm3,%%xmm3;\n"
@@ -829,11 +835,12 @@ namespace madness {
                 "movapd   %%xmm2, (%5); add %6,%5;\n"
                 "movapd   %%xmm3, (%5);\n"
 
-                "pop %5; pop %4; pop %1; pop %0;\n"
+                "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
                 :
                 : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-                :
+                : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                  "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -844,7 +851,7 @@ namespace madness {
             __asm__ volatile
             (
                 // save registers to be 'clobbered'
-                "push %0; push %1; push %4; push %5;\n "
+                "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
                 // zero out mmx registers
                 "pxor %%xmm2,%%xmm2;\n"
                 "pxor %%xmm3,%%xmm3;\n"
@@ -863,11 +870,12 @@ namespace madness {
                 "movapd   %%xmm3, (%5); add %6,%5;\n"
                 "movapd   %%xmm4, (%5);\n"
 
-                "pop %5; pop %4; pop %1; pop %0;\n"
+                "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
                 :
                 : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-                :
+                : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                  "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -878,7 +886,7 @@ namespace madness {
             __asm__ volatile
             (
                 // save registers to be 'clobbered'
-                "push %0; push %1; push %4; push %5;\n "
+                "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
                 // zero out mmx registers
                 "pxor %%xmm2,%%xmm2;\n"
                 "pxor %%xmm3,%%xmm3;\n"
@@ -900,11 +908,12 @@ namespace madness {
                 "movapd   %%xmm4, (%5); add %6,%5;\n"
                 "movapd   %%xmm5, (%5);\n"
 
-                "pop %5; pop %4; pop %1; pop %0;\n"
+                "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
                 :
                 : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-                :
+                : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                  "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -915,7 +924,7 @@ namespace madness {
             __asm__ volatile
             (
                 // save registers to be 'clobbered'
-                "push %0; push %1; push %4; push %5;\n "
+                "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
                 // zero out mmx registers
                 "pxor %%xmm2,%%xmm2;\n"
                 "pxor %%xmm3,%%xmm3;\n"
@@ -940,11 +949,12 @@ namespace madness {
                 "movapd   %%xmm5, (%5); add %6,%5;\n"
                 "movapd   %%xmm6, (%5);\n"
 
-                "pop %5; pop %4; pop %1; pop %0;\n"
+                "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
                 :
                 : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-                :
+                : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                  "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -955,7 +965,7 @@ namespace madness {
             __asm__ volatile
             (
                 // save registers to be 'clobbered'
-                "push %0; push %1; push %4; push %5;\n "
+                "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
                 // zero out mmx registers
                 "pxor %%xmm2,%%xmm2;\n"
                 "pxor %%xmm3,%%xmm3;\n"
@@ -983,11 +993,12 @@ namespace madness {
                 "movapd   %%xmm6, (%5); add %6,%5;\n"
                 "movapd   %%xmm7, (%5); \n"
 
-                "pop %5; pop %4; pop %1; pop %0;\n"
+                "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
                 :
                 : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-                :
+                : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                  "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -998,7 +1009,7 @@ namespace madness {
              __asm__ volatile
              (
                // save registers to be 'clobbered'
-               "push %0; push %1; push %4; push %5;\n "
+               "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
                // zero out mmx registers
                "pxor %%xmm2,%%xmm2;\n"
                "pxor %%xmm3,%%xmm3;\n"
@@ -1029,11 +1040,12 @@ namespace madness {
               "movapd   %%xmm7, (%5); add %6,%5;\n"
               "movapd   %%xmm8, (%5);\n"
 
-              "pop %5; pop %4; pop %1; pop %0;\n"
+              "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
               :
               : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-              :
+              : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
              );
            }
          }
@@ -1044,7 +1056,7 @@ namespace madness {
             __asm__ volatile
             (
               // save registers to be 'clobbered'
-              "push %0; push %1; push %4; push %5;\n "
+              "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
               // zero out mmx registers
               "pxor %%xmm2,%%xmm2;\n"
               "pxor %%xmm3,%%xmm3;\n"
@@ -1078,11 +1090,12 @@ namespace madness {
              "movapd   %%xmm8, (%5); add %6,%5;\n"
              "movapd   %%xmm9, (%5);\n"
 
-             "pop %5; pop %4; pop %1; pop %0;\n"
+             "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
              :
              : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-             :
+             : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+               "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -1093,7 +1106,7 @@ namespace madness {
             __asm__ volatile
             (
               // save registers to be 'clobbered'
-              "push %0; push %1; push %4; push %5;\n "
+              "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
               // zero out mmx registers
               "pxor %%xmm2,%%xmm2;\n"
               "pxor %%xmm3,%%xmm3;\n"
@@ -1130,11 +1143,12 @@ namespace madness {
              "movapd   %%xmm9, (%5); add %6,%5;\n"
              "movapd  %%xmm10, (%5);\n"
 
-             "pop %5; pop %4; pop %1; pop %0;\n"
+             "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
              :
              : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-             :
+             : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+               "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -1145,7 +1159,7 @@ namespace madness {
             __asm__ volatile
             (
               // save registers to be 'clobbered'
-              "push %0; push %1; push %4; push %5;\n "
+              "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
               // zero out mmx registers
               "pxor %%xmm2,%%xmm2;\n"
               "pxor %%xmm3,%%xmm3;\n"
@@ -1185,11 +1199,12 @@ namespace madness {
              "movapd  %%xmm10, (%5); add %6,%5;\n"
              "movapd  %%xmm11, (%5);\n"
 
-             "pop %5; pop %4; pop %1; pop %0;\n"
+             "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
              :
              : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-             :
+             : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+               "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -1200,7 +1215,7 @@ namespace madness {
             __asm__ volatile
             (
               // save registers to be 'clobbered'
-              "push %0; push %1; push %4; push %5;\n "
+              "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
               // zero out mmx registers
               "pxor %%xmm2,%%xmm2;\n"
               "pxor %%xmm3,%%xmm3;\n"
@@ -1243,11 +1258,12 @@ namespace madness {
              "movapd  %%xmm11, (%5); add %6,%5;\n"
              "movapd  %%xmm12, (%5);\n"
 
-             "pop %5; pop %4; pop %1; pop %0;\n"
+             "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
              :
              : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-             :
+             : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+               "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -1258,7 +1274,7 @@ namespace madness {
             __asm__ volatile
             (
               // save registers to be 'clobbered'
-              "push %0; push %1; push %4; push %5;\n "
+              "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
               // zero out mmx registers
               "pxor %%xmm2,%%xmm2;\n"
               "pxor %%xmm3,%%xmm3;\n"
@@ -1304,11 +1320,12 @@ namespace madness {
              "movapd  %%xmm12, (%5); add %6,%5;\n"
              "movapd  %%xmm13, (%5);\n"
 
-             "pop %5; pop %4; pop %1; pop %0;\n"
+             "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
              :
              : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-             :
+             : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+               "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -1319,7 +1336,7 @@ namespace madness {
             __asm__ volatile
             (
               // save registers to be 'clobbered'
-              "push %0; push %1; push %4; push %5;\n "
+              "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
               // zero out mmx registers
               "pxor %%xmm2,%%xmm2;\n"
               "pxor %%xmm3,%%xmm3;\n"
@@ -1368,11 +1385,12 @@ namespace madness {
              "movapd  %%xmm13, (%5); add %6,%5;\n"
              "movapd  %%xmm14, (%5);"
 
-             "pop %5; pop %4; pop %1; pop %0;\n"
+             "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
              :
              : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-             :
+             : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+               "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -1383,7 +1401,7 @@ namespace madness {
             __asm__ volatile
             (
               // save registers to be 'clobbered'
-              "push %0; push %1; push %4; push %5;\n "
+              "sub $128,%%rsp; push %0; push %1; push %4; push %5;\n "
               // zero out mmx registers
               "pxor %%xmm2,%%xmm2;\n"
               "pxor %%xmm3,%%xmm3;\n"
@@ -1435,11 +1453,12 @@ namespace madness {
              "movapd  %%xmm14, (%5); add %6,%5;\n"
              "movapd  %%xmm15, (%5);\n"
 
-             "pop %5; pop %4; pop %1; pop %0;\n"
+             "pop %5; pop %4; pop %1; pop %0; add $128,%%rsp;\n"
 
              :
              : "r"(a), "r"(b + j), "r"(dimi<<4), "r"(dimj<<3), "r"(dimk), "r"(c + j), "r"(dimj<<4)
-             :
+             : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+               "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "memory"
             );
           }
         }
@@ -34,6 +34,8 @@
 #define MADNESS_TENSOR_MTXMQ_H__INCLUDED
 
 #include <madness/madness_config.h>
+#include <string>
+#include <vector>
 
 typedef std::complex<double> double_complex;
 
@@ -172,6 +174,19 @@ namespace madness {
     }
 
 #elif defined(X86_64) && !defined(DISABLE_SSE3)
+    // The SSE3 assembly kernels, mTxmq chooses between these and the
+    // generated AVX kernels (see mTxmq_kernels)
+    void mTxmq_asm(long dimi, long dimj, long dimk,
+                   double* restrict c, const double* a, const double* b);
+
+    void mTxmq_asm(long dimi, long dimj, long dimk,
+                   double_complex* restrict c, const double_complex* a, const double_complex* b);
+
+#ifndef __INTEL_COMPILER
+    void mTxmq_asm(long dimi, long dimj, long dimk,
+                   double_complex* restrict c, const double_complex* a, const double* b);
+#endif
+
     template <>
     void mTxmq(long dimi, long dimj, long dimk,
                double* restrict c, const double* a, const double* b);
@@ -186,12 +201,76 @@ namespace madness {
                double_complex* restrict c, const double_complex* a, const double* b);
 #endif
 
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               double_complex* restrict c, const double* a, const double_complex* b);
+
 #elif defined(X86_32)
     template <>
     void mTxmq(long dimi, long dimj, long dimk,
                double* restrict c, const double* a, const double* b);
 #endif
 
+    /// Single precision \c a with double precision \c b and \c c
+
+    /// Panels of \c a are converted to double precision as they are used and
+    /// multiplied by the double precision mTxmq, so transforming single
+    /// precision coefficients (see FunctionNode::pack()) runs at the speed
+    /// of the double precision kernels without a full precision copy.
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               double* restrict c, const float* a, const double* b);
+
+
+    /// A kernel that mTxmq can use, it takes the same arguments as mTxmq
+    template <typename aT, typename bT, typename cT>
+    struct mTxmqKernel {
+        typedef void (*funcT)(long dimi, long dimj, long dimk, cT* c, const aT* a, const bT* b);
+        const char* name;
+        funcT func;
+    };
+
+    /// The kernels that mTxmq chooses from on this processor
+
+    /// The first is used for shapes that have not been tuned (see mTxmq_tune).
+    /// Other than for double and double_complex on x86-64 there is only mTxmq itself.
+    template <typename aT, typename bT, typename cT>
+    std::vector< mTxmqKernel<aT,bT,cT> > mTxmq_kernels() {
+        return std::vector< mTxmqKernel<aT,bT,cT> >(1, mTxmqKernel<aT,bT,cT>{"generic", &mTxmq<aT,bT,cT>});
+    }
+
+#if defined(X86_64) && !defined(DISABLE_SSE3)
+    template <>
+    std::vector< mTxmqKernel<double,double,double> > mTxmq_kernels();
+
+    template <>
+    std::vector< mTxmqKernel<double_complex,double_complex,double_complex> > mTxmq_kernels();
+
+#ifndef __INTEL_COMPILER
+    template <>
+    std::vector< mTxmqKernel<double_complex,double,double_complex> > mTxmq_kernels();
+#endif
+
+    template <>
+    std::vector< mTxmqKernel<double,double_complex,double_complex> > mTxmq_kernels();
+#endif
+
+    /// Times the kernels of mTxmq on the transforms of a box with k^ndim and (2k)^ndim coefficients
+
+    /// For each shape (d^(ndim-1), d, d) with d=k and d=2k the fastest kernel is
+    /// used from then on.  Not thread safe with respect to other calls of
+    /// mTxmq_tune or mTxmq_load_tuning, but mTxmq may run meanwhile.
+    void mTxmq_tune(long k, std::size_t ndim);
+
+    /// Writes the kernel chosen for each tuned shape to a text file
+    void mTxmq_save_tuning(const std::string& filename);
+
+    /// Reads the kernel choices written by mTxmq_save_tuning
+
+    /// Choices of kernels that are not available on this processor are ignored.
+    /// \return false if the file could not be read
+    bool mTxmq_load_tuning(const std::string& filename);
+
 }
 
 #endif // MADNESS_TENSOR_MTXMQ_H__INCLUDED
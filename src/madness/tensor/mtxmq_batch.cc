@@ -0,0 +1,240 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/mtxmq_batch.cc
+/// \brief x86-64 kernels for batches of small matrix products
+
+#include <madness/madness_config.h>
+#include <madness/tensor/mtxmq_batch.h>
+#include <algorithm>
+
+#if defined(X86_64) && defined(__GNUC__)
+#define MADNESS_MTXMQ_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace madness {
+
+#ifdef MADNESS_MTXMQ_BATCH_X86
+
+    // The kernels compute a panel of up to 3 vectors of columns of c for a block
+    // of NI rows.  The NI*NV accumulators stay in registers for the whole k loop,
+    // each step loads NV vectors of a row of b and broadcasts NI elements of a.
+    // The columns past dimj are masked so that any dimj is handled without
+    // touching memory outside of b and c.  The functions are compiled for the
+    // instruction set with target attributes, the rest of the library is not.
+
+    namespace {
+
+        template <int NI, int NV>
+        __attribute__((target("avx512f"))) inline
+        void block_avx512(long dimi, long dimj, long dimk, long ldb,
+                          double* c, const double* a, const double* b, const __mmask8* mask) {
+            __m512d acc[NI][NV];
+#pragma GCC unroll 8
+            for (int i=0; i<NI; ++i)
+#pragma GCC unroll 3
+                for (int v=0; v<NV; ++v) acc[i][v]=_mm512_setzero_pd();
+
+            for (long k=0; k<dimk; ++k, a+=dimi, b+=ldb) {
+                __m512d bk[NV];
+#pragma GCC unroll 3
+                for (int v=0; v<NV; ++v) bk[v]=_mm512_maskz_loadu_pd(mask[v], b+8*v);
+#pragma GCC unroll 8
+                for (int i=0; i<NI; ++i) {
+                    const __m512d aki=_mm512_set1_pd(a[i]);
+#pragma GCC unroll 3
+                    for (int v=0; v<NV; ++v) acc[i][v]=_mm512_fmadd_pd(aki, bk[v], acc[i][v]);
+                }
+            }
+
+#pragma GCC unroll 8
+            for (int i=0; i<NI; ++i)
+#pragma GCC unroll 3
+                for (int v=0; v<NV; ++v) _mm512_mask_storeu_pd(c+i*dimj+8*v, mask[v], acc[i][v]);
+        }
+
+        template <int NV>
+        __attribute__((target("avx512f")))
+        void panel_avx512(long dimi, long dimj, long dimk, long ldb,
+                          double* c, const double* a, const double* b, const __mmask8* mask) {
+            long i=0;
+            for (; i+8<=dimi; i+=8) block_avx512<8,NV>(dimi, dimj, dimk, ldb, c+i*dimj, a+i, b, mask);
+            for (; i+2<=dimi; i+=2) block_avx512<2,NV>(dimi, dimj, dimk, ldb, c+i*dimj, a+i, b, mask);
+            for (; i<dimi; ++i)     block_avx512<1,NV>(dimi, dimj, dimk, ldb, c+i*dimj, a+i, b, mask);
+        }
+
+        /// columns j..j+23 of c
+        __attribute__((target("avx512f")))
+        void mTxmq_avx512(long dimi, long dimj, long dimk, long ldb, long j,
+                          double* c, const double* a, const double* b) {
+            const long nj=std::min(24L, dimj-j);
+            __mmask8 mask[3];
+            for (int v=0; v<3; ++v) {
+                const long n=nj-8*v;
+                mask[v] = (n>=8) ? 0xff : (n<=0) ? 0 : __mmask8((1u<<n)-1);
+            }
+            if (nj>16)     panel_avx512<3>(dimi, dimj, dimk, ldb, c+j, a, b+j, mask);
+            else if (nj>8) panel_avx512<2>(dimi, dimj, dimk, ldb, c+j, a, b+j, mask);
+            else           panel_avx512<1>(dimi, dimj, dimk, ldb, c+j, a, b+j, mask);
+        }
+
+
+        template <int NI, int NV>
+        __attribute__((target("avx2,fma"))) inline
+        void block_avx2(long dimi, long dimj, long dimk, long ldb,
+                        double* c, const double* a, const double* b, const __m256i* mask) {
+            __m256d acc[NI][NV];
+#pragma GCC unroll 4
+            for (int i=0; i<NI; ++i)
+#pragma GCC unroll 3
+                for (int v=0; v<NV; ++v) acc[i][v]=_mm256_setzero_pd();
+
+            for (long k=0; k<dimk; ++k, a+=dimi, b+=ldb) {
+                __m256d bk[NV];
+#pragma GCC unroll 3
+                for (int v=0; v<NV; ++v) bk[v]=_mm256_maskload_pd(b+4*v, mask[v]);
+#pragma GCC unroll 4
+                for (int i=0; i<NI; ++i) {
+                    const __m256d aki=_mm256_broadcast_sd(a+i);
+#pragma GCC unroll 3
+                    for (int v=0; v<NV; ++v) acc[i][v]=_mm256_fmadd_pd(aki, bk[v], acc[i][v]);
+                }
+            }
+
+#pragma GCC unroll 4
+            for (int i=0; i<NI; ++i)
+#pragma GCC unroll 3
+                for (int v=0; v<NV; ++v) _mm256_maskstore_pd(c+i*dimj+4*v, mask[v], acc[i][v]);
+        }
+
+        template <int NV>
+        __attribute__((target("avx2,fma")))
+        void panel_avx2(long dimi, long dimj, long dimk, long ldb,
+                        double* c, const double* a, const double* b, const __m256i* mask) {
+            long i=0;
+            for (; i+4<=dimi; i+=4) block_avx2<4,NV>(dimi, dimj, dimk, ldb, c+i*dimj, a+i, b, mask);
+            for (; i<dimi; ++i)     block_avx2<1,NV>(dimi, dimj, dimk, ldb, c+i*dimj, a+i, b, mask);
+        }
+
+        /// columns j..j+11 of c
+        __attribute__((target("avx2,fma")))
+        void mTxmq_avx2(long dimi, long dimj, long dimk, long ldb, long j,
+                        double* c, const double* a, const double* b) {
+            const long nj=std::min(12L, dimj-j);
+            __m256i mask[3];
+            for (int v=0; v<3; ++v) {
+                long long m[4];
+                for (int l=0; l<4; ++l) m[l] = (4*v+l < nj) ? -1 : 0;
+                mask[v]=_mm256_set_epi64x(m[3], m[2], m[1], m[0]);
+            }
+            if (nj>8)      panel_avx2<3>(dimi, dimj, dimk, ldb, c+j, a, b+j, mask);
+            else if (nj>4) panel_avx2<2>(dimi, dimj, dimk, ldb, c+j, a, b+j, mask);
+            else           panel_avx2<1>(dimi, dimj, dimk, ldb, c+j, a, b+j, mask);
+        }
+
+
+        /// computes the columns j..j+width-1 of c
+        typedef void (*kernelT)(long dimi, long dimj, long dimk, long ldb, long j,
+                                double* c, const double* a, const double* b);
+
+        struct kernel_choice {
+            kernelT kernel;
+            long width;
+            const char* name;
+
+            kernel_choice() : kernel(0), width(0), name("generic") {
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx512f")) {
+                    kernel=mTxmq_avx512;
+                    width=24;
+                    name="avx512";
+                }
+                else if (__builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma")) {
+                    kernel=mTxmq_avx2;
+                    width=12;
+                    name="avx2";
+                }
+            }
+        };
+
+        const kernel_choice& choice() {
+            static const kernel_choice k;
+            return k;
+        }
+    }
+
+
+    template <>
+    void mTxmq_batch(std::size_t nitem, const mTxmqBatchItem<double,double,double>* items) {
+        const kernelT kernel=choice().kernel;
+        const long width=choice().width;
+        if (not kernel) {
+            mTxmq_batch_reference(nitem, items);
+            return;
+        }
+        // consecutive items with the same b go panel by panel of columns,
+        // so that a panel of b is read from L1 by all of them
+        for (std::size_t first=0; first<nitem; ) {
+            const mTxmqBatchItem<double,double,double>& lead=items[first];
+            std::size_t last=first+1;
+            while (last<nitem and items[last].b==lead.b and items[last].dimj==lead.dimj
+                   and items[last].dimk==lead.dimk and items[last].ldb==lead.ldb) ++last;
+            for (long j=0; j<lead.dimj; j+=width) {
+                for (std::size_t n=first; n<last; ++n) {
+                    const mTxmqBatchItem<double,double,double>& it=items[n];
+                    kernel(it.dimi, it.dimj, it.dimk, it.ldb, j, it.c, it.a, it.b);
+                }
+            }
+            first=last;
+        }
+    }
+
+    const char* mTxmq_batch_kernel() {
+        return choice().name;
+    }
+
+#else
+
+#if defined(X86_64)
+    template <>
+    void mTxmq_batch(std::size_t nitem, const mTxmqBatchItem<double,double,double>* items) {
+        mTxmq_batch_reference(nitem, items);
+    }
+#endif
+
+    const char* mTxmq_batch_kernel() {
+        return "generic";
+    }
+
+#endif // MADNESS_MTXMQ_BATCH_X86
+
+}
@@ -0,0 +1,100 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+#ifndef MADNESS_TENSOR_MTXMQ_BATCH_H__INCLUDED
+#define MADNESS_TENSOR_MTXMQ_BATCH_H__INCLUDED
+
+#include <madness/madness_config.h>
+#include <complex>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+#include <madness/tensor/mtxmq.h>
+
+/// \file tensor/mtxmq_batch.h
+/// \brief Batches of small matrix products c = a^T b
+
+namespace madness {
+
+    /// One product of a batch, c(i,j) = sum(k) a(k,i)*b(k,j)
+
+    /// a is dimk x dimi and c is dimi x dimj, both contiguous.  The rows of b are
+    /// ldb >= dimj apart so that the leading columns of a larger matrix (the left
+    /// singular vectors of a truncated SVD) can be used without copying them.
+    template <typename aT, typename bT, typename cT>
+    struct mTxmqBatchItem {
+        long dimi, dimj, dimk, ldb;
+        cT* c;
+        const aT* a;
+        const bT* b;
+    };
+
+
+    /// Reference version of mTxmq_batch that calls mTxmq for each item
+    template <typename aT, typename bT, typename cT>
+    void mTxmq_batch_reference(std::size_t nitem, const mTxmqBatchItem<aT,bT,cT>* items) {
+        std::vector<bT> bcopy;
+        for (std::size_t n=0; n<nitem; ++n) {
+            const mTxmqBatchItem<aT,bT,cT>& it=items[n];
+            const bT* b=it.b;
+            if (it.ldb != it.dimj) {
+                bcopy.resize(it.dimk*it.dimj);
+                for (long k=0; k<it.dimk; ++k)
+                    for (long j=0; j<it.dimj; ++j) bcopy[k*it.dimj+j]=b[k*it.ldb+j];
+                b=bcopy.data();
+            }
+            mTxmq(it.dimi, it.dimj, it.dimk, it.c, it.a, b);
+        }
+    }
+
+
+    /// Compute a batch of independent products c = a^T b (see mTxmqBatchItem)
+
+    /// For double precision on x86-64 the batch is run with register-blocked
+    /// AVX2 or AVX-512 kernels selected at runtime, other types and processors
+    /// use mTxmq_batch_reference.  Consecutive items that share b (the same
+    /// operator matrix) are computed one panel of columns of b at a time for
+    /// all of them, so put items with the same b next to each other.
+    template <typename aT, typename bT, typename cT>
+    void mTxmq_batch(std::size_t nitem, const mTxmqBatchItem<aT,bT,cT>* items) {
+        mTxmq_batch_reference(nitem, items);
+    }
+
+#if defined(X86_64)
+    template <>
+    void mTxmq_batch(std::size_t nitem, const mTxmqBatchItem<double,double,double>* items);
+#endif
+
+    /// Name of the kernel used by mTxmq_batch for double precision ("avx512", "avx2" or "generic")
+    const char* mTxmq_batch_kernel();
+
+}
+
+#endif // MADNESS_TENSOR_MTXMQ_BATCH_H__INCLUDED
@@ -0,0 +1,431 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+
+/// \file tensor/mtxmq_dispatch.cc
+/// \brief Runtime choice of the kernel used by mTxmq, and tuning of the choice per shape
+
+#include <madness/madness_config.h>
+#include <madness/tensor/tensor.h>
+#include <madness/tensor/mtxmq.h>
+#include <madness/world/timers.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if defined(X86_64) && defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define MADNESS_MTXMQ_GENERATED 1
+#endif
+
+#ifdef MADNESS_MTXMQ_GENERATED
+// The generated kernels, compiled in mtxmq_kernels.c
+extern "C" {
+#define MTXMQ_DECLARE(name, aT, bT, cT) \
+    void name(long dimi, long dimj, long dimk, cT* c, const aT* a, const bT* b);
+    MTXMQ_DECLARE(madness_mtxmq_avx_rr, double, double, double)
+    MTXMQ_DECLARE(madness_mtxmq_avx_rc, double, double_complex, double_complex)
+    MTXMQ_DECLARE(madness_mtxmq_avx_cr, double_complex, double, double_complex)
+    MTXMQ_DECLARE(madness_mtxmq_avx_cc, double_complex, double_complex, double_complex)
+    MTXMQ_DECLARE(madness_mtxmq_avx2_rr, double, double, double)
+    MTXMQ_DECLARE(madness_mtxmq_avx2_rc, double, double_complex, double_complex)
+    MTXMQ_DECLARE(madness_mtxmq_avx2_cr, double_complex, double, double_complex)
+    MTXMQ_DECLARE(madness_mtxmq_avx2_cc, double_complex, double_complex, double_complex)
+    MTXMQ_DECLARE(madness_mtxmq_avx512_rr, double, double, double)
+    MTXMQ_DECLARE(madness_mtxmq_avx512_rc, double, double_complex, double_complex)
+    MTXMQ_DECLARE(madness_mtxmq_avx512_cc, double_complex, double_complex, double_complex)
+#undef MTXMQ_DECLARE
+}
+#endif
+
+namespace madness {
+
+#if defined(X86_64) && !defined(DISABLE_SSE3)
+
+    namespace {
+
+        /// Reference kernel for the types without an assembly kernel
+        template <typename aT, typename bT, typename cT>
+        void mTxmq_reference(long dimi, long dimj, long dimk, cT* c, const aT* a, const bT* b) {
+            for (long i=0; i<dimi; ++i,c+=dimj,++a) {
+                for (long j=0; j<dimj; ++j) c[j] = 0.0;
+                const aT *aik_ptr = a;
+                for (long k=0; k<dimk; ++k,aik_ptr+=dimi) {
+                    aT aki = *aik_ptr;
+                    for (long j=0; j<dimj; ++j) {
+                        c[j] += aki*b[k*dimj+j];
+                    }
+                }
+            }
+        }
+
+        enum ISA {SSE3, AVX, AVX2, AVX512};
+
+        bool cpu_supports(ISA isa) {
+#ifdef MADNESS_MTXMQ_GENERATED
+            __builtin_cpu_init();
+            switch (isa) {
+            case SSE3:   return true;
+            case AVX:    return __builtin_cpu_supports("avx");
+            case AVX2:   return __builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma");
+            case AVX512: return __builtin_cpu_supports("avx512f") and __builtin_cpu_supports("fma");
+            }
+#endif
+            return isa == SSE3;
+        }
+
+        /// The kernels for one combination of types and the choice among them
+
+        /// The choices are an immutable table that is replaced as a whole when
+        /// tuning, so that mTxmq can read it without locking.  Replaced tables
+        /// are kept since another thread may still be reading them.
+        template <typename aT, typename bT, typename cT>
+        class Dispatch {
+        public:
+            typedef mTxmqKernel<aT,bT,cT> kernelT;
+            typedef typename kernelT::funcT funcT;
+
+        private:
+            struct Choice {
+                long dimi, dimj, dimk;
+                funcT func;
+            };
+
+            struct Table {
+                std::vector<Choice> choices;
+            };
+
+            std::vector<kernelT> kernels;
+            std::atomic<const Table*> table;
+            std::vector<const Table*> retired;
+
+            Dispatch(const char* code) : table(new Table), code(code) {
+                // the default is the first that is available
+                add(AVX512, "avx512", this->template generated<AVX512>());
+                add(AVX2, "avx2", this->template generated<AVX2>());
+                const kernelT f = fallback();
+                add(SSE3, f.name, f.func);
+                add(AVX, "avx", this->template generated<AVX>());
+            }
+
+            void add(ISA isa, const char* name, funcT func) {
+                if (func && cpu_supports(isa)) kernels.push_back(kernelT{name, func});
+            }
+
+            template <ISA isa> funcT generated() const;
+
+            /// The assembly kernel, or the reference loop for the types without one
+            kernelT fallback() const;
+
+        public:
+            /// Name of the types in the tuning file, e.g. "cr" for complex a and real b
+            const char* code;
+
+            static Dispatch& instance();
+
+            const std::vector<kernelT>& get_kernels() const {return kernels;}
+
+            /// The kernel to use for a shape
+            funcT select(long dimi, long dimj, long dimk) const {
+                const Table* t = table.load(std::memory_order_acquire);
+                for (const Choice& c : t->choices) {
+                    if (c.dimi==dimi && c.dimj==dimj && c.dimk==dimk) return c.func;
+                }
+                return kernels.front().func;
+            }
+
+            /// Chooses the kernel with the given name for a shape, returns false if there is none
+            bool choose(long dimi, long dimj, long dimk, const std::string& name) {
+                funcT func = 0;
+                for (const kernelT& k : kernels) if (name == k.name) func = k.func;
+                if (!func) return false;
+
+                const Table* old = table.load(std::memory_order_acquire);
+                Table* t = new Table(*old);
+                bool found = false;
+                for (Choice& c : t->choices) {
+                    if (c.dimi==dimi && c.dimj==dimj && c.dimk==dimk) {
+                        c.func = func;
+                        found = true;
+                    }
+                }
+                if (!found) t->choices.push_back(Choice{dimi, dimj, dimk, func});
+                table.store(t, std::memory_order_release);
+                retired.push_back(old);
+                return true;
+            }
+
+            /// Writes a line per chosen shape
+            void save(std::ostream& s) const {
+                const Table* t = table.load(std::memory_order_acquire);
+                for (const Choice& c : t->choices) {
+                    for (const kernelT& k : kernels) {
+                        if (k.func == c.func) {
+                            s << code << " " << c.dimi << " " << c.dimj << " " << c.dimk << " " << k.name << "\n";
+                        }
+                    }
+                }
+            }
+
+            /// Times all kernels on one shape and chooses the fastest that gives the right result
+            void tune(long dimi, long dimj, long dimk) {
+                if (kernels.size() == 1) return;
+
+                Tensor<aT> a(dimk*dimi);
+                Tensor<bT> b(dimk*dimj);
+                Tensor<cT> c(dimi*dimj), cref(dimi*dimj);
+                a.fillrandom();
+                b.fillrandom();
+                mTxmq_reference(dimi, dimj, dimk, cref.ptr(), a.ptr(), b.ptr());
+
+                // enough repetitions for a measurable time
+                const long nrep = std::max(1L, 2000000L/(dimi*dimj*dimk));
+                double best = 0.0;
+                const char* best_name = 0;
+                for (const kernelT& k : kernels) {
+                    k.func(dimi, dimj, dimk, c.ptr(), a.ptr(), b.ptr());
+                    if ((c-cref).normf() > 1e-12*cref.normf()) continue;
+
+                    double fastest = 0.0;
+                    for (int trial=0; trial<5; ++trial) {
+                        const double start = wall_time();
+                        for (long rep=0; rep<nrep; ++rep) k.func(dimi, dimj, dimk, c.ptr(), a.ptr(), b.ptr());
+                        const double used = wall_time() - start;
+                        if (trial==0 || used < fastest) fastest = used;
+                    }
+                    if (!best_name || fastest < best) {
+                        best = fastest;
+                        best_name = k.name;
+                    }
+                }
+                if (best_name) choose(dimi, dimj, dimk, best_name);
+            }
+        };
+
+        template <> Dispatch<double,double,double>::kernelT Dispatch<double,double,double>::fallback() const {
+            return kernelT{"sse3", static_cast<funcT>(&mTxmq_asm)};
+        }
+
+        template <> Dispatch<double,double_complex,double_complex>::kernelT Dispatch<double,double_complex,double_complex>::fallback() const {
+            return kernelT{"generic", &mTxmq_reference<double,double_complex,double_complex>};
+        }
+
+        template <> Dispatch<double_complex,double,double_complex>::kernelT Dispatch<double_complex,double,double_complex>::fallback() const {
+#ifndef __INTEL_COMPILER
+            return kernelT{"sse3", static_cast<funcT>(&mTxmq_asm)};
+#else
+            return kernelT{"generic", &mTxmq_reference<double_complex,double,double_complex>};
+#endif
+        }
+
+        template <> Dispatch<double_complex,double_complex,double_complex>::kernelT Dispatch<double_complex,double_complex,double_complex>::fallback() const {
+            return kernelT{"sse3", static_cast<funcT>(&mTxmq_asm)};
+        }
+
+        template <typename aT, typename bT, typename cT>
+        template <ISA isa>
+        typename Dispatch<aT,bT,cT>::funcT Dispatch<aT,bT,cT>::generated() const {
+            return 0;
+        }
+
+#ifdef MADNESS_MTXMQ_GENERATED
+#define MTXMQ_GENERATED(isa, name, aT, bT, cT) \
+        template <> template <> \
+        Dispatch<aT,bT,cT>::funcT Dispatch<aT,bT,cT>::generated<isa>() const {return &name;}
+        MTXMQ_GENERATED(AVX, madness_mtxmq_avx_rr, double, double, double)
+        MTXMQ_GENERATED(AVX, madness_mtxmq_avx_rc, double, double_complex, double_complex)
+        MTXMQ_GENERATED(AVX, madness_mtxmq_avx_cr, double_complex, double, double_complex)
+        MTXMQ_GENERATED(AVX, madness_mtxmq_avx_cc, double_complex, double_complex, double_complex)
+        MTXMQ_GENERATED(AVX2, madness_mtxmq_avx2_rr, double, double, double)
+        MTXMQ_GENERATED(AVX2, madness_mtxmq_avx2_rc, double, double_complex, double_complex)
+        MTXMQ_GENERATED(AVX2, madness_mtxmq_avx2_cr, double_complex, double, double_complex)
+        MTXMQ_GENERATED(AVX2, madness_mtxmq_avx2_cc, double_complex, double_complex, double_complex)
+        MTXMQ_GENERATED(AVX512, madness_mtxmq_avx512_rr, double, double, double)
+        MTXMQ_GENERATED(AVX512, madness_mtxmq_avx512_rc, double, double_complex, double_complex)
+        MTXMQ_GENERATED(AVX512, madness_mtxmq_avx512_cc, double_complex, double_complex, double_complex)
+#undef MTXMQ_GENERATED
+#endif
+
+        template <> Dispatch<double,double,double>& Dispatch<double,double,double>::instance() {
+            static Dispatch d("rr");
+            return d;
+        }
+
+        template <> Dispatch<double,double_complex,double_complex>& Dispatch<double,double_complex,double_complex>::instance() {
+            static Dispatch d("rc");
+            return d;
+        }
+
+        template <> Dispatch<double_complex,double,double_complex>& Dispatch<double_complex,double,double_complex>::instance() {
+            static Dispatch d("cr");
+            return d;
+        }
+
+        template <> Dispatch<double_complex,double_complex,double_complex>& Dispatch<double_complex,double_complex,double_complex>::instance() {
+            static Dispatch d("cc");
+            return d;
+        }
+
+    }
+
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               double* restrict c, const double* a, const double* b) {
+        Dispatch<double,double,double>::instance().select(dimi,dimj,dimk)(dimi, dimj, dimk, c, a, b);
+    }
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               double_complex* restrict c, const double_complex* a, const double_complex* b) {
+        Dispatch<double_complex,double_complex,double_complex>::instance().select(dimi,dimj,dimk)(dimi, dimj, dimk, c, a, b);
+    }
+
+#ifndef __INTEL_COMPILER
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               double_complex* restrict c, const double_complex* a, const double* b) {
+        Dispatch<double_complex,double,double_complex>::instance().select(dimi,dimj,dimk)(dimi, dimj, dimk, c, a, b);
+    }
+#endif
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               double_complex* restrict c, const double* a, const double_complex* b) {
+        Dispatch<double,double_complex,double_complex>::instance().select(dimi,dimj,dimk)(dimi, dimj, dimk, c, a, b);
+    }
+
+    template <>
+    std::vector< mTxmqKernel<double,double,double> > mTxmq_kernels() {
+        return Dispatch<double,double,double>::instance().get_kernels();
+    }
+
+    template <>
+    std::vector< mTxmqKernel<double_complex,double_complex,double_complex> > mTxmq_kernels() {
+        return Dispatch<double_complex,double_complex,double_complex>::instance().get_kernels();
+    }
+
+#ifndef __INTEL_COMPILER
+    template <>
+    std::vector< mTxmqKernel<double_complex,double,double_complex> > mTxmq_kernels() {
+        return Dispatch<double_complex,double,double_complex>::instance().get_kernels();
+    }
+#endif
+
+    template <>
+    std::vector< mTxmqKernel<double,double_complex,double_complex> > mTxmq_kernels() {
+        return Dispatch<double,double_complex,double_complex>::instance().get_kernels();
+    }
+
+    void mTxmq_tune(long k, std::size_t ndim) {
+        for (long d=k; d<=2*k; d+=k) {
+            long dimi = 1;
+            for (std::size_t n=1; n<ndim; ++n) dimi *= d;
+            Dispatch<double,double,double>::instance().tune(dimi, d, d);
+            Dispatch<double,double_complex,double_complex>::instance().tune(dimi, d, d);
+            Dispatch<double_complex,double,double_complex>::instance().tune(dimi, d, d);
+            Dispatch<double_complex,double_complex,double_complex>::instance().tune(dimi, d, d);
+        }
+    }
+
+    void mTxmq_save_tuning(const std::string& filename) {
+        std::ofstream s(filename.c_str());
+        s << "# mTxmq kernel choices: types dimi dimj dimk kernel\n";
+        Dispatch<double,double,double>::instance().save(s);
+        Dispatch<double,double_complex,double_complex>::instance().save(s);
+        Dispatch<double_complex,double,double_complex>::instance().save(s);
+        Dispatch<double_complex,double_complex,double_complex>::instance().save(s);
+    }
+
+    bool mTxmq_load_tuning(const std::string& filename) {
+        std::ifstream s(filename.c_str());
+        if (!s) return false;
+        std::string line;
+        while (std::getline(s, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream l(line);
+            std::string code, name;
+            long dimi, dimj, dimk;
+            if (!(l >> code >> dimi >> dimj >> dimk >> name)) continue;
+            if (code == "rr") Dispatch<double,double,double>::instance().choose(dimi, dimj, dimk, name);
+            else if (code == "rc") Dispatch<double,double_complex,double_complex>::instance().choose(dimi, dimj, dimk, name);
+            else if (code == "cr") Dispatch<double_complex,double,double_complex>::instance().choose(dimi, dimj, dimk, name);
+            else if (code == "cc") Dispatch<double_complex,double_complex,double_complex>::instance().choose(dimi, dimj, dimk, name);
+        }
+        return true;
+    }
+
+#else
+
+    void mTxmq_tune(long k, std::size_t ndim) {}
+
+    void mTxmq_save_tuning(const std::string& filename) {
+        std::ofstream s(filename.c_str());
+        s << "# mTxmq kernel choices: types dimi dimj dimk kernel\n";
+    }
+
+    bool mTxmq_load_tuning(const std::string& filename) {
+        std::ifstream s(filename.c_str());
+        return bool(s);
+    }
+
+#endif // defined(X86_64) && !defined(DISABLE_SSE3)
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               double* restrict c, const float* a, const double* b) {
+        // a(k,i0:i0+nb) in double precision, nb even so c stays aligned
+        const long nwork = 4096;
+        const long nb = std::min(dimi, (nwork/std::max(dimk,1L)) & ~1L);
+        if (nb < 2) {
+            for (long i=0; i<dimi; ++i,c+=dimj,++a) {
+                for (long j=0; j<dimj; ++j) c[j] = 0.0;
+                for (long k=0; k<dimk; ++k) {
+                    const double aki = a[k*dimi];
+                    for (long j=0; j<dimj; ++j) c[j] += aki*b[k*dimj+j];
+                }
+            }
+            return;
+        }
+        alignas(64) double work[nwork];
+        for (long i0=0; i0<dimi; i0+=nb) {
+            const long ni = std::min(nb, dimi-i0);
+            for (long k=0; k<dimk; ++k) {
+                const float* ak = a + k*dimi + i0;
+                double* wk = work + k*ni;
+                for (long i=0; i<ni; ++i) wk[i] = ak[i];
+            }
+            mTxmq(ni, dimj, dimk, c + i0*dimj, static_cast<const double*>(work), b);
+        }
+    }
+
+}
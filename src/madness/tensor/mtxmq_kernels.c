@@ -0,0 +1,103 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+
+/* \file tensor/mtxmq_kernels.c
+   \brief The generated mtxmq kernels of new_mtxmq/bests, one per instruction set
+
+   The generated files are C and all define a function called mtxmq, so each
+   is included under its own name.  They are compiled for their instruction
+   set with a target pragma, the rest of the library is not, and
+   mtxmq_dispatch.cc only calls a kernel if the processor supports it.
+   The SSE variants need aligned data and are not used, the assembly kernels
+   in mtxmq.cc cover SSE3.
+*/
+
+#include <madness/madness_config.h>
+
+#if defined(X86_64) && defined(__GNUC__) && !defined(__INTEL_COMPILER)
+
+#include <immintrin.h>
+#include <complex.h>
+
+#define MTXMQ_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define MTXMQ_TARGET_BEGIN(isa) MTXMQ_PRAGMA(clang attribute push (__attribute__((target(isa))), apply_to = function))
+#define MTXMQ_TARGET_END MTXMQ_PRAGMA(clang attribute pop)
+#else
+#define MTXMQ_TARGET_BEGIN(isa) MTXMQ_PRAGMA(GCC push_options) MTXMQ_PRAGMA(GCC target(isa))
+#define MTXMQ_TARGET_END MTXMQ_PRAGMA(GCC pop_options)
+#endif
+
+MTXMQ_TARGET_BEGIN("avx")
+#define mtxmq madness_mtxmq_avx_rr
+#include "new_mtxmq/bests/avx_rr.cc"
+#undef mtxmq
+#define mtxmq madness_mtxmq_avx_rc
+#include "new_mtxmq/bests/avx_rc.cc"
+#undef mtxmq
+#define mtxmq madness_mtxmq_avx_cr
+#include "new_mtxmq/bests/avx_cr.cc"
+#undef mtxmq
+#define mtxmq madness_mtxmq_avx_cc
+#include "new_mtxmq/bests/avx_cc.cc"
+#undef mtxmq
+MTXMQ_TARGET_END
+
+MTXMQ_TARGET_BEGIN("avx2,fma")
+#define mtxmq madness_mtxmq_avx2_rr
+#include "new_mtxmq/bests/avx2_rr.cc"
+#undef mtxmq
+#define mtxmq madness_mtxmq_avx2_rc
+#include "new_mtxmq/bests/avx2_rc.cc"
+#undef mtxmq
+#define mtxmq madness_mtxmq_avx2_cr
+#include "new_mtxmq/bests/avx2_cr.cc"
+#undef mtxmq
+#define mtxmq madness_mtxmq_avx2_cc
+#include "new_mtxmq/bests/avx2_cc.cc"
+#undef mtxmq
+MTXMQ_TARGET_END
+
+/* there is no complex-real AVX-512 kernel, the AVX2 one is used */
+MTXMQ_TARGET_BEGIN("avx512f,fma")
+#define mtxmq madness_mtxmq_avx512_rr
+#include "new_mtxmq/bests/avx512_rr.cc"
+#undef mtxmq
+#define mtxmq madness_mtxmq_avx512_rc
+#include "new_mtxmq/bests/avx512_rc.cc"
+#undef mtxmq
+#define mtxmq madness_mtxmq_avx512_cc
+#include "new_mtxmq/bests/avx512_cc.cc"
+#undef mtxmq
+MTXMQ_TARGET_END
+
+#endif
@@ -519,6 +519,62 @@ class MTXMAVX2(MTXMAVX):
     def _fmaddsub(self, at, bt, ct):
         return ct + ' = _mm256_fmaddsub_pd(' + ','.join([at,bt,ct]) + ');'
 
+class MTXMAVX512(MTXMAVX2):
+    def __init__(self, *args):
+        super().__init__(*args)
+        if self.complex_real:
+            raise NotImplementedError("complex-real is not generated for AVX-512")
+        self.vector_length = 8
+
+        self.vector_type = '__m512d'
+        self.vector_load = '_mm512_loadu_pd'
+        self.vector_store = '_mm512_storeu_pd'
+        self.vector_zero = '_mm512_setzero_pd()'
+
+        self.mask_store = '_mm512_mask_storeu_pd'
+
+        self.splat_type = '__m512d'
+        self.splat_op = '_mm512_set1_pd'
+
+    def _load_a(self, unrolls, indent):
+        # there is no broadcast from memory, so dereference the address
+        spaces = ' ' * (self.indent*indent)
+        ret = []
+        for temp, k, i in self._temps_to_load(unrolls, 'a', 'k', 'i'):
+            addr = '(pa+' + str((self.complex_a and 2 or 1)*i) + ')'
+            ret.append(spaces + temp + ' = {}(*{});'.format(self.splat_op, addr))
+            if self.complex_complex:
+                ret.append(spaces + self._temp('_ai', k, i) + ' = {}(*({}+1));'.format(self.splat_op, addr))
+        return ret
+
+    def _load_b(self, unrolls, indent):
+        # the last vector of a row is loaded with the store mask so that
+        # nothing past the end of b is read
+        ret = super()._load_b(unrolls, indent)
+        if self._MTXMGen__in_main_loop:
+            return ret
+        last = '(pb+{})'.format((unrolls['j'] - self.vector_length) // (self.complex_real and 2 or 1))
+        load = self.vector_load + last
+        return [x.replace(load, '_mm512_maskz_loadu_pd(mask, {})'.format(last)) for x in ret]
+
+    def _load_br(self, spaces, addr, temp, k, j):
+        return spaces + self._temp('_br', k, j) + ' = _mm512_permute_pd({}, 0x55);'.format(temp)
+
+    def _fma(self, at, bt, ct):
+        return ct + ' = _mm512_fmadd_pd(' + ','.join([at,bt,ct]) + ');'
+
+    def _fmaddsub(self, at, bt, ct):
+        return ct + ' = _mm512_fmaddsub_pd(' + ','.join([at,bt,ct]) + ');'
+
+    def _extra(self):
+        # mask of the doubles in the last vector of a row of c
+        n = self.real_real and 8 or 4
+        w = self.real_real and 1 or 2
+        return [' ' * self.indent + """
+    __mmask8 mask;
+    j = effj % {0};
+    mask = j ? (__mmask8)((1u << {1}j) - 1) : (__mmask8)0xff;""".format(n, w == 2 and "2*" or "")]
+
 class MTXMSSE(MTXMGen):
     def __init__(self, *args):
         super().__init__(*args)
@@ -33,6 +33,9 @@ def tester(m, versions):
             if type(m) == MTXMAVX2:
                 march = "avx2"
                 extra = "-march=core-avx2"
+            if type(m) == MTXMAVX512:
+                march = "avx512f"
+                extra = "-mfma"
             print("\tCXXFLAGS=-O3 {} -m{} -lrt -lm".format(extra, march), file=mf)
         print("all:", file=mf)
 
@@ -65,7 +68,7 @@ def main():
             help='A (left) matrix is complex', dest='cxa')
     parser.add_argument('-b', '--complex-b', action='store_true', default=False,
             help='B (right) matrix is complex', dest='cxb')
-    parser.add_argument('-m', '--arch', default='sse', choices=['sse', 'avx', 'avx2', 'bgp', 'bgq'],
+    parser.add_argument('-m', '--arch', default='sse', choices=['sse', 'avx', 'avx2', 'avx512', 'bgp', 'bgq'],
             help='Target architecture')
     parser.add_argument('-n', '--name', default='mtxmq',
             help='Name of function to generate')
@@ -108,6 +111,13 @@ def main():
                 (False, True) : ("jik", {'i':3, 'j':16, 'k':1}, args.name),
                 (True, True)  : ("ijk", {'i':2, 'j':20, 'k':1}, args.name)}
         versions = [(lo, {'i':i, 'j':j, 'k':1}, '{}_i{}j{}k1'.format(lo, i,j)) for i in range(1,10) for j in range(4,21,4) for lo in ["ijk", "jik"] if i*j <= 60]
+    elif args.arch == 'avx512':
+        M = MTXMAVX512
+        bests = {
+                (False, False): ("jik", {'i':2, 'j':24, 'k':1}, args.name),
+                (False, True) : ("jik", {'i':3, 'j':16, 'k':1}, args.name),
+                (True, True)  : ("ijk", {'i':2, 'j':24, 'k':1}, args.name)}
+        versions = [(lo, {'i':i, 'j':j, 'k':1}, '{}_i{}j{}k1'.format(lo, i,j)) for i in range(1,10) for j in range(8,33,8) for lo in ["ijk", "jik"] if i*j <= 96]
     elif args.arch == 'bgp':
         M = MTXMBGP
         bests = {
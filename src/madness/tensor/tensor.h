@@ -35,6 +35,10 @@
 #include <madness/madness_config.h>
 #include <madness/misc/ran.h>
 #include <madness/world/posixmem.h>
+#include <madness/world/worldnuma.h>
+#ifdef TENSOR_USE_SLAB
+#include <madness/world/slab_allocator.h>
+#endif
 
 #include <memory>
 #include <complex>
@@ -292,7 +296,11 @@ namespace madness {
 
     protected:
         T* restrict _p;
+#ifdef TENSOR_USE_SLAB
+        SlabPtr<T> _shptr;
+#else
         std::shared_ptr<T> _shptr;
+#endif
 
 
         void allocate(long nd, const long d[], bool dozero) {
@@ -329,12 +337,23 @@ namespace madness {
 #define TENSOR_ALIGNMENT 16
 #endif
 
-#ifdef WORLD_GATHER_MEM_STATS
+#if defined(TENSOR_USE_SLAB)
+                    _p = static_cast<T*>(SlabAllocator::allocate(sizeof(T)*_size));
+                    _shptr.reset(_p);
+#elif defined(WORLD_GATHER_MEM_STATS)
                     _p = new T[size];
                     _shptr = std::shared_ptr<T>(_p);
 #else
-                    if (posix_memalign((void **) &_p, TENSOR_ALIGNMENT, sizeof(T)*_size)) throw 1;
-                    _shptr.reset(_p, &free);
+                    if (NumaTopology::enabled()) {
+                        // Prefer the NUMA node of the thread creating the tensor
+                        _p = static_cast<T*>(NumaTopology::allocate_local(sizeof(T)*_size, TENSOR_ALIGNMENT));
+                        if (!_p) throw 1;
+                        _shptr.reset(_p, &NumaTopology::deallocate_local);
+                    }
+                    else {
+                        if (posix_memalign((void **) &_p, TENSOR_ALIGNMENT, sizeof(T)*_size)) throw 1;
+                        _shptr.reset(_p, &free);
+                    }
 #endif
                 }
                 catch (...) {
@@ -0,0 +1,160 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#include <madness/madness_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include <madness/world/posixmem.h>
+#include <madness/world/safempi.h>
+#include <madness/tensor/tensor.h>
+#include <madness/tensor/mtxmq.h>
+#include <madness/tensor/mtxmq_batch.h>
+
+using namespace madness;
+
+double ran()
+{
+  static unsigned long seed = 76521;
+
+  seed = seed *1812433253 + 12345;
+
+  return ((double) (seed & 0x7fffffff)) * 4.6566128752458e-10;
+}
+
+void ran_fill(int n, double *a) {
+    while (n--) *a++ = ran();
+}
+
+/// reference c(i,j) = sum(k) a(k,i)*b(k,j) with b of leading dimension ldb
+void mTxm(long dimi, long dimj, long dimk, long ldb,
+          double* c, const double* a, const double* b) {
+    for (long i=0; i<dimi*dimj; ++i) c[i] = 0.0;
+    for (long k=0; k<dimk; ++k) {
+        for (long j=0; j<dimj; ++j) {
+            for (long i=0; i<dimi; ++i) {
+                c[i*dimj+j] += a[k*dimi+i]*b[k*ldb+j];
+            }
+        }
+    }
+}
+
+/// time the transformations of nterm separated terms of a 3D box, one by one and batched
+void timer(long nterm, long dimk, double *a, double *b, double *c) {
+    const long dimi=dimk*dimk;
+    const double nflop = 3.0*2.0*nterm*dimi*dimk*dimk;
+    std::vector< mTxmqBatchItem<double,double,double> > items(nterm);
+
+    double fastest=0.0, fastest_batch=0.0;
+    for (int t=0; t<20; t++) {
+        double start = SafeMPI::Wtime();
+        for (long mu=0; mu<nterm; ++mu) {
+            double* w1=c+2*mu*dimi*dimk;
+            double* w2=w1+dimi*dimk;
+            mTxmq(dimi,dimk,dimk,w1,a,b+mu*dimk*dimk);
+            mTxmq(dimi,dimk,dimk,w2,w1,b+mu*dimk*dimk);
+            mTxmq(dimi,dimk,dimk,w1,w2,b+mu*dimk*dimk);
+        }
+        double rate = 1.e-9*nflop/(SafeMPI::Wtime() - start);
+        if (rate > fastest) fastest = rate;
+
+        start = SafeMPI::Wtime();
+        for (int stage=0; stage<3; ++stage) {
+            for (long mu=0; mu<nterm; ++mu) {
+                double* w1=c+2*mu*dimi*dimk;
+                double* w2=w1+dimi*dimk;
+                const double* in = (stage==0) ? a : ((stage==1) ? w1 : w2);
+                double* out = (stage==1) ? w2 : w1;
+                items[mu] = mTxmqBatchItem<double,double,double>{dimi,dimk,dimk,dimk,out,in,b+mu*dimk*dimk};
+            }
+            mTxmq_batch(nterm, items.data());
+        }
+        rate = 1.e-9*nflop/(SafeMPI::Wtime() - start);
+        if (rate > fastest_batch) fastest_batch = rate;
+    }
+    printf("%8ld %3ld %8.2f %8.2f\n", nterm, dimk, fastest, fastest_batch);
+}
+
+int main(int argc, char * argv[]) {
+    const long nimax=30*30;
+    const long njmax=40;
+    const long nkmax=40;
+    double *a, *b, *c, *d;
+
+    SafeMPI::Init_thread(argc, argv, MPI_THREAD_SINGLE);
+
+    posix_memalign((void **) &a, 64, nkmax*nimax*sizeof(double));
+    posix_memalign((void **) &b, 64, 100*nkmax*njmax*sizeof(double));
+    posix_memalign((void **) &c, 64, 100*nimax*njmax*sizeof(double));
+    posix_memalign((void **) &d, 64, nimax*njmax*sizeof(double));
+
+    ran_fill(nkmax*nimax, a);
+    ran_fill(100*nkmax*njmax, b);
+
+    printf("Starting to test kernel %s ... \n", mTxmq_batch_kernel());
+    std::vector< mTxmqBatchItem<double,double,double> > items;
+    for (long ni=1; ni<40; ni+=1) {
+        for (long nj=1; nj<30; nj+=1) {
+            for (long nk=1; nk<30; nk+=1) {
+                // the second product uses the leading columns of a wider b, the
+                // last two share b and are run panel by panel
+                items.clear();
+                items.push_back(mTxmqBatchItem<double,double,double>{ni,nj,nk,nj,c,a,b});
+                items.push_back(mTxmqBatchItem<double,double,double>{ni,nj,nk,njmax,c+nimax*njmax,a+1,b+7});
+                items.push_back(mTxmqBatchItem<double,double,double>{ni,nj,nk,nj,c+2*nimax*njmax,a+2,b});
+                items.push_back(mTxmqBatchItem<double,double,double>{ni+1,nj,nk,nj,c+3*nimax*njmax,a+3,b});
+                mTxmq_batch(items.size(), items.data());
+                for (std::size_t n=0; n<items.size(); ++n) {
+                    const mTxmqBatchItem<double,double,double>& it=items[n];
+                    mTxm(it.dimi,nj,nk,it.ldb,d,it.a,it.b);
+                    for (long i=0; i<it.dimi*nj; ++i) {
+                        double err = std::abs(d[i]-it.c[i]);
+                        if (err > 1e-13) {
+                            printf("test_mtxmq_batch: error %ld %ld %ld %ld %e\n",ni,nj,nk,it.ldb,err);
+                            exit(1);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    printf("... OK!\n");
+
+    printf("%8s %3s %8s %8s (GF/s)\n", "nterm", "k", "mTxmq", "batch");
+    for (long k=6; k<=20; k+=2) timer(32, k, a, b, c);
+
+    SafeMPI::Finalize();
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#include <madness/madness_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <complex>
+#include <vector>
+
+#include <madness/world/posixmem.h>
+#include <madness/world/safempi.h>
+#include <madness/tensor/tensor.h>
+#include <madness/tensor/mtxmq.h>
+
+using namespace madness;
+
+double ran()
+{
+  static unsigned long seed = 76521;
+
+  seed = seed *1812433253 + 12345;
+
+  return ((double) (seed & 0x7fffffff)) * 4.6566128752458e-10;
+}
+
+void ran_fill(int n, double *a) {
+    while (n--) *a++ = ran();
+}
+
+void ran_fill(int n, float *a) {
+    while (n--) *a++ = ran();
+}
+
+void ran_fill(int n, double_complex *a) {
+    while (n--) {
+        double re = ran();
+        *a++ = double_complex(re, ran());
+    }
+}
+
+/// reference c(i,j) = sum(k) a(k,i)*b(k,j)
+template <typename aT, typename bT, typename cT>
+void mTxm_reference(long dimi, long dimj, long dimk, cT* c, const aT* a, const bT* b) {
+    for (long i=0; i<dimi*dimj; ++i) c[i] = 0.0;
+    for (long k=0; k<dimk; ++k) {
+        for (long j=0; j<dimj; ++j) {
+            for (long i=0; i<dimi; ++i) {
+                c[i*dimj+j] += a[k*dimi+i]*b[k*dimj+j];
+            }
+        }
+    }
+}
+
+/// compare one kernel against the reference for one shape, exit on error
+template <typename aT, typename bT, typename cT>
+void check(const mTxmqKernel<aT,bT,cT>& kernel, long ni, long nj, long nk,
+           cT* c, cT* d, const aT* a, const bT* b) {
+    mTxm_reference(ni,nj,nk,d,a,b);
+    kernel.func(ni,nj,nk,c,a,b);
+    // the sums over nk are formed in a different order than the reference
+    const double tol = 1e-13*(1.0 + nk/30.0);
+    for (long i=0; i<ni*nj; ++i) {
+        double err = std::abs(d[i]-c[i]);
+        if (err > tol) {
+            printf("test_mtxmq_kernels: error %s %ld %ld %ld %e\n",kernel.name,ni,nj,nk,err);
+            exit(1);
+        }
+    }
+}
+
+/// check every kernel that mTxmq may use against the reference, then time them on the (k*k,k,k) transforms
+
+/// All small shapes are swept, with nj and nk up to 2k for k=16 (the
+/// two-scale transforms act on 2k).  The transform shapes (k*k,k,k) and
+/// ((2k)^2,2k,2k) are checked for every k up to kmax=30.
+template <typename aT, typename bT, typename cT>
+void test(const char* code) {
+    const long kmax=30;
+    const long nimax=4*kmax*kmax;
+    const long njmax=2*kmax;
+    const long nkmax=2*kmax;
+    aT *a;
+    bT *b;
+    cT *c, *d;
+    posix_memalign((void **) &a, 64, nkmax*nimax*sizeof(aT));
+    posix_memalign((void **) &b, 64, nkmax*njmax*sizeof(bT));
+    posix_memalign((void **) &c, 64, nimax*njmax*sizeof(cT));
+    posix_memalign((void **) &d, 64, nimax*njmax*sizeof(cT));
+    ran_fill(nkmax*nimax, a);
+    ran_fill(nkmax*njmax, b);
+
+    const std::vector< mTxmqKernel<aT,bT,cT> > kernels = mTxmq_kernels<aT,bT,cT>();
+    for (std::size_t n=0; n<kernels.size(); ++n) {
+        printf("Starting to test %s kernel %s ... ", code, kernels[n].name);
+        for (long ni=1; ni<40; ni+=1) {
+            for (long nj=1; nj<=33; nj+=1) {
+                for (long nk=1; nk<=33; nk+=1) {
+                    check(kernels[n],ni,nj,nk,c,d,a,b);
+                }
+            }
+        }
+        for (long k=1; k<=kmax; ++k) {
+            check(kernels[n],k*k,k,k,c,d,a,b);
+            check(kernels[n],4*k*k,2*k,2*k,c,d,a,b);
+        }
+        printf("OK!\n");
+    }
+
+    printf("%3s", "k");
+    for (std::size_t n=0; n<kernels.size(); ++n) printf(" %8s", kernels[n].name);
+    printf(" (GF/s)\n");
+    for (long k=6; k<=kmax; k+=2) {
+        const long dimi=k*k;
+        // a complex times a real is two real multiply-adds, complex times complex four
+        const double nflop = 2.0*dimi*k*k*(sizeof(aT)/sizeof(double))*(sizeof(bT)/sizeof(double));
+        printf("%3ld", k);
+        for (std::size_t n=0; n<kernels.size(); ++n) {
+            double fastest=0.0;
+            for (int t=0; t<20; t++) {
+                double start = SafeMPI::Wtime();
+                kernels[n].func(dimi,k,k,c,a,b);
+                double rate = 1.e-9*nflop/(SafeMPI::Wtime() - start);
+                if (rate > fastest) fastest = rate;
+            }
+            printf(" %8.2f", fastest);
+        }
+        printf("\n");
+    }
+
+    free(a);
+    free(b);
+    free(c);
+    free(d);
+}
+
+/// check mTxmq of single precision a with double precision b and c, and a transform of single precision coefficients
+void test_mixed() {
+    const long kmax=30;
+    const long nimax=4*kmax*kmax;
+    const long njmax=2*kmax;
+    const long nkmax=2*kmax;
+    float *a;
+    double *b, *c, *d;
+    posix_memalign((void **) &a, 64, nkmax*nimax*sizeof(float));
+    posix_memalign((void **) &b, 64, nkmax*njmax*sizeof(double));
+    posix_memalign((void **) &c, 64, nimax*njmax*sizeof(double));
+    posix_memalign((void **) &d, 64, nimax*njmax*sizeof(double));
+    ran_fill(nkmax*nimax, a);
+    ran_fill(nkmax*njmax, b);
+
+    const mTxmqKernel<float,double,double> kernel = {"mixed", &mTxmq<float,double,double>};
+    printf("Starting to test fr kernel %s ... ", kernel.name);
+    for (long ni=1; ni<40; ni+=1) {
+        for (long nj=1; nj<=33; nj+=1) {
+            for (long nk=1; nk<=33; nk+=1) {
+                check(kernel,ni,nj,nk,c,d,a,b);
+            }
+        }
+    }
+    for (long k=1; k<=kmax; ++k) {
+        check(kernel,k*k,k,k,c,d,a,b);
+        check(kernel,4*k*k,2*k,2*k,c,d,a,b);
+    }
+    printf("OK!\n");
+
+    for (long k=2; k<=2*kmax; k+=2) {
+        Tensor<float> t(k,k,k);
+        Tensor<double> s(k,k);
+        ran_fill(t.size(), t.ptr());
+        ran_fill(s.size(), s.ptr());
+        Tensor<double> td = t;
+        Tensor<double> r = transform(t,s);
+        Tensor<double> rd = transform(td,s);
+        double err = (r-rd).normf();
+        if (err > 1e-12*k) {
+            printf("test_mtxmq_kernels: error in transform of single precision %ld %e\n",k,err);
+            exit(1);
+        }
+    }
+    printf("transform of single precision coefficients OK!\n");
+
+    free(a);
+    free(b);
+    free(c);
+    free(d);
+}
+
+int main(int argc, char * argv[]) {
+    SafeMPI::Init_thread(argc, argv, MPI_THREAD_SINGLE);
+
+    test<double,double,double>("rr");
+    test<double,double_complex,double_complex>("rc");
+    test<double_complex,double,double_complex>("cr");
+    test<double_complex,double_complex,double_complex>("cc");
+    test_mixed();
+
+    SafeMPI::Finalize();
+
+    return 0;
+}
@@ -93,6 +93,11 @@ namespace madness {
 
             /// Flush the filestream.
             void flush();
+
+            /// Returns the current write position in the file.
+            unsigned long tellp() const {
+                return os.tellp();
+            }
         };
 
         /// Wraps an archive around a binary filestream for input.
@@ -41,10 +41,11 @@
 #include <utility>
 #include <algorithm>
 #include <iostream>
+#include <atomic>
 #include <stdint.h>
 
 /// \file dqueue.h
-/// \brief Implements DQueue
+/// \brief Implements DQueue and WSDeque
 
 namespace madness {
 
@@ -54,9 +55,24 @@ namespace madness {
         uint64_t npop_front;    ///< #calls to pop_front
         uint64_t ngrow;         ///< #calls to grow
         uint64_t nmax;          ///< Lifetime max. entries in the queue
+        uint64_t nsteal;        ///< #tasks taken from another thread's queue
+        uint64_t nsteal_fail;   ///< #steal attempts that found nothing
 
         DQStats()
-                : npush_back(0), npush_front(0), npop_front(0), ngrow(0), nmax(0) {}
+                : npush_back(0), npush_front(0), npop_front(0), ngrow(0), nmax(0)
+                , nsteal(0), nsteal_fail(0) {}
+
+        /// Accumulate statistics from another queue (nmax is the max of both)
+        DQStats& operator+=(const DQStats& other) {
+            npush_back += other.npush_back;
+            npush_front += other.npush_front;
+            npop_front += other.npop_front;
+            ngrow += other.ngrow;
+            nmax = std::max(nmax, other.nmax);
+            nsteal += other.nsteal;
+            nsteal_fail += other.nsteal_fail;
+            return *this;
+        }
     };
 
 
@@ -288,6 +304,161 @@ namespace madness {
         }
     };
 
+
+    /// A lock-free work-stealing deque (Chase-Lev) for pointer types.
+
+    /// Only the owning thread may call push() and pop(), which operate
+    /// on the bottom of the deque in LIFO order.  Any thread may call
+    /// steal(), which takes from the top in FIFO order, so thieves get
+    /// the oldest (usually largest) pieces of work.  A default
+    /// constructed \c T (i.e., a null pointer) is never stored.
+    ///
+    /// The circular buffer grows as needed but does not shrink.
+    /// Retired buffers are kept until destruction since a thief may
+    /// still be reading from them.
+    ///
+    /// See Chase and Lev, SPAA'05, and Le et al., PPoPP'13, for the
+    /// memory ordering used here.
+    template <typename T>
+    class WSDeque {
+        struct Array {
+            const long size;            ///< Capacity (a power of 2)
+            std::atomic<T>* const buf;  ///< Circular buffer
+            Array* const prev;          ///< Retired buffer (freed at destruction)
+
+            Array(long size, Array* prev)
+                : size(size), buf(new std::atomic<T>[size]), prev(prev) {}
+
+            ~Array() { delete [] buf; }
+
+            T get(long i) const {
+                return buf[i & (size-1)].load(std::memory_order_relaxed);
+            }
+
+            void put(long i, T value) {
+                buf[i & (size-1)].store(value, std::memory_order_relaxed);
+            }
+        };
+
+        char pad[64]; ///< To put top and bottom in separate cache lines
+        std::atomic<long> top __attribute__((aligned(64)));    ///< Next index to steal
+        std::atomic<long> bottom __attribute__((aligned(64))); ///< Next index to push
+        std::atomic<Array*> array;
+        DQStats stats; ///< Only modified by the owning thread
+
+        Array* grow(Array* a, long b, long t) {
+            ++(stats.ngrow);
+            Array* na = new Array(2*a->size, a);
+            for (long i=t; i<b; ++i) na->put(i, a->get(i));
+            array.store(na, std::memory_order_release);
+            return na;
+        }
+
+        WSDeque(const WSDeque&);            // Verboten
+        WSDeque& operator=(const WSDeque&); // Verboten
+
+    public:
+        WSDeque(long hint=1024) : top(0), bottom(0) {
+            long sz = 2;
+            while (sz < hint) sz <<= 1;
+            array.store(new Array(sz, nullptr), std::memory_order_relaxed);
+        }
+
+        ~WSDeque() {
+            Array* a = array.load(std::memory_order_relaxed);
+            while (a) {
+                Array* prev = a->prev;
+                delete a;
+                a = prev;
+            }
+        }
+
+        /// Push value onto the bottom of the deque (owner only)
+        void push(T value) {
+            const long b = bottom.load(std::memory_order_relaxed);
+            const long t = top.load(std::memory_order_acquire);
+            Array* a = array.load(std::memory_order_relaxed);
+            if (b - t > a->size - 1) a = grow(a, b, t);
+            a->put(b, value);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+
+            ++(stats.npush_back);
+            const uint64_t nn = b - t + 1;
+            if (nn > stats.nmax) stats.nmax = nn;
+        }
+
+        /// Pop value off the bottom of the deque (owner only)
+
+        /// \return True if a value was popped
+        bool pop(T& value) {
+            const long b = bottom.load(std::memory_order_relaxed) - 1;
+            Array* a = array.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long t = top.load(std::memory_order_relaxed);
+
+            bool got = false;
+            if (t <= b) {
+                value = a->get(b);
+                got = true;
+                if (t == b) {
+                    // Last element ... race against thieves for it
+                    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed))
+                        got = false;
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                }
+            }
+            else {
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            if (got) ++(stats.npop_front);
+            return got;
+        }
+
+        /// Steal value off the top of the deque (any thread)
+
+        /// \return True if a value was stolen; false if the deque was
+        /// empty or another thread won the race for the top element.
+        bool steal(T& value) {
+            long t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const long b = bottom.load(std::memory_order_acquire);
+            if (t < b) {
+                Array* a = array.load(std::memory_order_acquire);
+                T x = a->get(t);
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed))
+                    return false;
+                value = x;
+                return true;
+            }
+            return false;
+        }
+
+        /// Record the outcome of a steal attempt made by the owning thread
+        void record_steal(bool success) {
+            if (success) ++(stats.nsteal);
+            else ++(stats.nsteal_fail);
+        }
+
+        /// Approximate number of elements (exact only when called by the owner)
+        size_t size() const {
+            const long b = bottom.load(std::memory_order_relaxed);
+            const long t = top.load(std::memory_order_relaxed);
+            return (b > t) ? size_t(b - t) : 0;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        const DQStats& get_stats() const {
+            return stats;
+        }
+    };
+
 }
 
 #endif // MADNESS_WORLD_DQUEUE_H__INCLUDED
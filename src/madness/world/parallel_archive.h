@@ -47,6 +47,9 @@
 #include <unistd.h>
 #include <cstring>
 #include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace madness {
     namespace archive {
@@ -70,13 +73,51 @@ namespace madness {
             bool do_fence; ///< If true (default), a read/write of parallel objects fences before and after I/O.
             char fname[256]; ///< Name of the archive.
             int nclient; ///< Number of clients of this node, including self. Zero if not I/O node.
+            int nshard; ///< Number of shards, or zero if the data of containers go through the I/O nodes.
+            mutable Archive shard; ///< The shard of this process (output only).
+            mutable unsigned long shard_size; ///< Bytes written to the shard so far (output only).
+            mutable std::vector< std::shared_ptr<Archive> > index; ///< Index of the shard of this process, or of the shards this process reads.
+
+            /// Opens the shard and index of this process, or the indices of the shards this process reads.
+            void open_shards() {
+                index.clear();
+                if (Archive::is_output_archive) {
+                    shard.open(shard_filename(world->rank()).c_str());
+                    shard_size = position(shard); // past whatever open() wrote
+                    index.push_back(std::make_shared<Archive>(index_filename(world->rank()).c_str()));
+                }
+                else {
+                    for (ProcessID s=world->rank(); s<nshard; s+=world->size()) {
+                        index.push_back(std::make_shared<Archive>(index_filename(s).c_str()));
+                    }
+                }
+            }
+
+            /// Name of file \c s of the archive \c filename with the given suffix.
+            static std::string shard_filename(const char* filename, const char* suffix, ProcessID s) {
+                char buf[256];
+                const int n = snprintf(buf, sizeof(buf), "%s.%s.%5.5d", filename, suffix, s);
+                MADNESS_ASSERT(n > 0 && std::size_t(n) < sizeof(buf));
+                return std::string(buf);
+            }
+
+            /// Write position in the shard \c a.
+            static unsigned long position(BinaryFstreamOutputArchive& a) {
+                return a.tellp();
+            }
+
+            /// Input shards are only read through their indices.
+            template <typename otherT>
+            static unsigned long position(otherT&) {
+                return 0;
+            }
 
         public:
             static const bool is_parallel_archive = true; ///< Mark this class as a parallel archive.
 
             /// Default constructor.
             BaseParallelArchive()
-                : world(nullptr), ar(), nio(0), do_fence(true) {}
+                : world(nullptr), ar(), nio(0), do_fence(true), nshard(0) {}
 
             /// Returns the process doing I/O for given node.
 
@@ -130,16 +171,29 @@ namespace madness {
             /// fewer processes originally used to write it. If you
             /// want to fix this have a look in worlddc.h for the only
             /// spot that currently needs changing to make that work.
+            /// Archives written in shards (see below) have no such limit.
             ///
             /// \note The default number of I/O nodes is one and there is an
             /// arbitrary maximum of 50 set. On IBM BG/P the maximum
             /// is nproc/64.
+            ///
+            /// If the number of writers is zero every process writes the
+            /// entries of containers to its own shard, `filename.shard.rank`,
+            /// and their keys, offsets and sizes to `filename.index.rank`.
+            /// Other data are written by process zero as usual.  Such an
+            /// archive is read by any number of processes, each reading the
+            /// entries that the process map of the container assigns to it.
             /// \param[in] world The world.
             /// \param[in] filename Name of the file.
-            /// \param[in] nwriter The number of writers.
+            /// \param[in] nwriter The number of writers, or zero for one shard per process.
             void open(World& world, const char* filename, int nwriter=1) {
                 this->world = &world;
                 nio = nwriter;
+                nshard = 0;
+                if (nio <= 0) {
+                    nio = 1;
+                    nshard = world.size();
+                }
 #if defined(HAVE_IBMBGP) || defined(HAVE_IBMBGQ)
                 /* Jeff believes that BG is designed to handle up to *
                  * one file per node and I assume no more than 8 ppn */
@@ -159,18 +213,25 @@ namespace madness {
 
                 if (world.rank() == 0) {
                     ar.open(buf);
-                    ar & nio; // read/write nio from/to the archive
+                    // read/write nio from/to the archive, negative for the number of shards
+                    int header = (nshard ? -nshard : nio);
+                    ar & header;
+                    nio = (header < 0 ? 1 : header);
+                    nshard = (header < 0 ? -header : 0);
                     MADNESS_ASSERT(nio <= world.size());
                 }
 
                 // Ensure all agree on value of nio that may also have changed if reading
                 world.gop.broadcast(nio, 0);
+                world.gop.broadcast(nshard, 0);
 
                 // Other reader/writers can now open the local archive
                 if (is_io_node() && world.rank()) {
                     ar.open(buf);
                 }
 
+                if (nshard) open_shards();
+
                 // Count #client
                 ProcessID me = world.rank();
                 nclient=0;
@@ -207,6 +268,58 @@ namespace madness {
             void close() {
                 MADNESS_ASSERT(world);
                 if (is_io_node()) ar.close();
+                if (nshard && Archive::is_output_archive) shard.close();
+                for (std::size_t i=0; i<index.size(); ++i) index[i]->close();
+                index.clear();
+            }
+
+            /// Returns true if every process writes the entries of containers to its own shard.
+            bool is_sharded() const {
+                return nshard > 0;
+            }
+
+            /// Returns the number of shards, i.e., of processes that wrote the archive.
+            int num_shards() const {
+                return nshard;
+            }
+
+            /// Returns the name of shard \c s.
+            std::string shard_filename(ProcessID s) const {
+                return shard_filename(fname, "shard", s);
+            }
+
+            /// Returns the name of the index of shard \c s.
+            std::string index_filename(ProcessID s) const {
+                return shard_filename(fname, "index", s);
+            }
+
+            /// Returns the shard of this process (output only).
+            Archive& shard_archive() const {
+                MADNESS_ASSERT(nshard && Archive::is_output_archive);
+                return shard;
+            }
+
+            /// Returns the number of bytes written to the shard of this process (output only).
+            unsigned long& shard_offset() const {
+                MADNESS_ASSERT(nshard && Archive::is_output_archive);
+                return shard_size;
+            }
+
+            /// Returns the number of indices this process reads or writes.
+            std::size_t num_local_indices() const {
+                return index.size();
+            }
+
+            /// Returns the \c i th index this process reads or writes.
+            Archive& index_archive(std::size_t i) const {
+                MADNESS_ASSERT(i < index.size());
+                return *index[i];
+            }
+
+            /// Returns the shard described by the \c i th index this process reads or writes.
+            ProcessID index_shard(std::size_t i) const {
+                MADNESS_ASSERT(world);
+                return world->rank() + i*world->size();
             }
 
             /// Returns a reference to the local archive.
@@ -243,6 +356,10 @@ namespace madness {
                         sprintf(buf, "%s.%5.5d", filename, p);
                         if (::remove(buf)) break;
                     }
+                    // shards, whose number may differ from the number of processes
+                    for (ProcessID p=0; ::remove(shard_filename(filename, "shard", p).c_str()) == 0; ++p) {
+                        ::remove(shard_filename(filename, "index", p).c_str());
+                    }
                 }
             }
 
@@ -280,6 +397,10 @@ namespace madness {
         ///
         /// Process zero records the number of writers so that, when the archive is opened
         /// for reading, the number of readers is forced to match.
+        ///
+        /// With zero writers every process instead writes its own data to
+        /// `filename.shard.rank`, with an index in `filename.index.rank`, and
+        /// nothing is sent to another process.
         class ParallelOutputArchive : public BaseParallelArchive<BinaryFstreamOutputArchive>, public BaseOutputArchive {
         public:
             /// Default constructor.
@@ -297,6 +418,10 @@ namespace madness {
             /// Flush any data in the archive.
             void flush() {
                 if (is_io_node()) local_archive().flush();
+                if (is_sharded()) {
+                    shard_archive().flush();
+                    index_archive(0).flush();
+                }
             }
         };
 
@@ -311,6 +436,9 @@ namespace madness {
         /// forced to be the same as the original number of writers and,
         /// therefore, you cannot presently read an archive from a parallel job
         /// with fewer total processes than the number of writers.
+        ///
+        /// An archive written in shards is read by any number of processes,
+        /// each loading the entries that it owns under the current process map.
         class ParallelInputArchive : public BaseParallelArchive<BinaryFstreamInputArchive>, public  BaseInputArchive {
         public:
             /// Default constructor.
@@ -0,0 +1,279 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file slab_allocator.cc
+ \brief Thread-caching size-class allocator with intrusive reference counts.
+ \ingroup world
+*/
+
+#include <madness/world/slab_allocator.h>
+#include <madness/world/worldmutex.h>
+#include <madness/world/worldnuma.h>
+#include <madness/world/posixmem.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <pthread.h>
+
+namespace madness {
+
+    namespace {
+
+        typedef detail::SlabHeader Header;
+
+        const std::size_t slab_bytes = std::size_t(1) << 20;  ///< Minimum bytes per slab
+        const std::size_t batch_bytes = std::size_t(1) << 18; ///< Target bytes per transfer
+
+        /// Shared state of one size class
+        struct SizeClass {
+            Spinlock lock;
+            std::size_t size;     ///< User bytes per block
+            std::size_t stride;   ///< Bytes per block including header
+            int batch;            ///< Blocks per transfer to/from a thread
+            Header* free;         ///< Shared free list
+            long nfree;           ///< Length of free list
+            long nreserved;       ///< Blocks carved from slabs
+            std::atomic<long> ninuse;     ///< Blocks in use, i.e., in neither list nor a thread cache
+            std::atomic<long> max_ninuse; ///< High-water mark of ninuse
+
+            SizeClass() : size(0), stride(0), batch(1), free(nullptr)
+                        , nfree(0), nreserved(0), ninuse(0), max_ninuse(0) {}
+        };
+
+        /// All size classes ... the key is published once the class is initialized
+        struct SlabState {
+            Mutex table_mutex;
+            int nclass;
+            std::atomic<std::size_t> key[SlabAllocator::max_nclass];
+            SizeClass cls[SlabAllocator::max_nclass];
+            pthread_key_t cache_key;
+
+            SlabState();
+        };
+
+        /// Per-thread free lists
+        struct ThreadCache {
+            Header* head[SlabAllocator::max_nclass];
+            int count[SlabAllocator::max_nclass];
+
+            ThreadCache() {
+                for (int i=0; i<SlabAllocator::max_nclass; ++i) {
+                    head[i] = nullptr;
+                    count[i] = 0;
+                }
+            }
+        };
+
+        SlabState& state() {
+            static SlabState s; // Thread-safe initialization and usable during static init
+            return s;
+        }
+
+        // Move up to n blocks from the list at head to the shared list of class c
+        void give_back(SizeClass& c, Header*& head, int& count, int n) {
+            if (n <= 0) return;
+            Header* first = head;
+            Header* last = head;
+            for (int i=1; i<n; ++i) last = last->next;
+            head = last->next;
+            count -= n;
+
+            ScopedMutex<Spinlock> guard(c.lock);
+            last->next = c.free;
+            c.free = first;
+            c.nfree += n;
+        }
+
+        // Return all cached blocks of an exiting thread
+        void destroy_cache(void* p) {
+            ThreadCache* cache = static_cast<ThreadCache*>(p);
+            SlabState& s = state();
+            for (int i=0; i<SlabAllocator::max_nclass; ++i)
+                give_back(s.cls[i], cache->head[i], cache->count[i], cache->count[i]);
+            delete cache;
+        }
+
+        SlabState::SlabState() : nclass(0) {
+            for (int i=0; i<SlabAllocator::max_nclass; ++i)
+                key[i].store(0, std::memory_order_relaxed);
+            const int rc = pthread_key_create(&cache_key, &destroy_cache);
+            if (rc != 0)
+                MADNESS_EXCEPTION("SlabAllocator: pthread_key_create failed", rc);
+        }
+
+        ThreadCache* thread_cache(SlabState& s) {
+            ThreadCache* cache = static_cast<ThreadCache*>(pthread_getspecific(s.cache_key));
+            if (!cache) {
+                cache = new ThreadCache;
+                pthread_setspecific(s.cache_key, cache);
+            }
+            return cache;
+        }
+
+        // Find (or create) the class of blocks of size bytes ... -1 if none
+        int find_class(SlabState& s, std::size_t size) {
+            const int nc = SlabAllocator::max_nclass;
+            const int start = int(((size / SlabAllocator::header_size) * 2654435761ul) % nc);
+            for (int probe=0; probe<nc; ++probe) {
+                const int i = (start + probe) % nc;
+                const std::size_t k = s.key[i].load(std::memory_order_acquire);
+                if (k == size) return i;
+                if (k == 0) {
+                    ScopedMutex<Mutex> guard(s.table_mutex);
+                    const std::size_t kk = s.key[i].load(std::memory_order_relaxed);
+                    if (kk == size) return i;
+                    if (kk != 0) continue;
+                    // Keep the table at most half full so probing stays short
+                    if (2*s.nclass >= nc) return -1;
+                    SizeClass& c = s.cls[i];
+                    c.size = size;
+                    c.stride = SlabAllocator::header_size + size;
+                    c.batch = int(std::max(std::size_t(1), std::min(std::size_t(32), batch_bytes/c.stride)));
+                    ++s.nclass;
+                    s.key[i].store(size, std::memory_order_release);
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        // Get a batch of blocks from the shared list, carving a new slab if needed
+        Header* take_batch(SizeClass& c, int& n) {
+            ScopedMutex<Spinlock> guard(c.lock);
+            if (!c.free) {
+                const long nblock = std::max(long(2*c.batch), long(slab_bytes/c.stride));
+                const std::size_t bytes = nblock*c.stride;
+                void* slab = (NumaTopology::enabled()
+                              ? NumaTopology::allocate_local(bytes, SlabAllocator::header_size)
+                              : nullptr);
+                if (!slab && posix_memalign(&slab, SlabAllocator::header_size, bytes))
+                    throw std::bad_alloc();
+                char* p = static_cast<char*>(slab);
+                for (long i=0; i<nblock; ++i, p+=c.stride) {
+                    Header* h = reinterpret_cast<Header*>(p);
+                    h->next = c.free;
+                    c.free = h;
+                }
+                c.nfree += nblock;
+                c.nreserved += nblock;
+            }
+
+            Header* first = c.free;
+            Header* last = first;
+            n = 1;
+            while (n < c.batch && last->next) {
+                last = last->next;
+                ++n;
+            }
+            c.free = last->next;
+            last->next = nullptr;
+            c.nfree -= n;
+            return first;
+        }
+
+    } // namespace
+
+    void* SlabAllocator::allocate(std::size_t size) {
+        // Round up so that the data of every block stays aligned
+        const std::size_t rsize = ((size + header_size - 1)/header_size)*header_size;
+        SlabState& s = state();
+        const int ic = (rsize && rsize <= max_block_size) ? find_class(s, rsize) : -1;
+
+        Header* h = nullptr;
+        if (ic >= 0) {
+            ThreadCache* cache = thread_cache(s);
+            if (!cache->head[ic]) {
+                int n = 0;
+                cache->head[ic] = take_batch(s.cls[ic], n);
+                cache->count[ic] += n;
+            }
+            h = cache->head[ic];
+            cache->head[ic] = h->next;
+            --(cache->count[ic]);
+
+            SizeClass& c = s.cls[ic];
+            const long n = c.ninuse.fetch_add(1, std::memory_order_relaxed) + 1;
+            long max = c.max_ninuse.load(std::memory_order_relaxed);
+            while (n > max && !c.max_ninuse.compare_exchange_weak(max, n, std::memory_order_relaxed)) {}
+        }
+        else {
+            void* p = nullptr;
+            if (posix_memalign(&p, header_size, header_size + rsize)) throw std::bad_alloc();
+            h = static_cast<Header*>(p);
+        }
+
+        h->refcount = 1;
+        h->sclass = ic;
+        h->next = nullptr;
+        return reinterpret_cast<char*>(h) + header_size;
+    }
+
+    void SlabAllocator::free_block(Header* h) {
+        const int ic = h->sclass;
+        if (ic < 0) {
+            std::free(h);
+            return;
+        }
+
+        SlabState& s = state();
+        ThreadCache* cache = thread_cache(s);
+        h->next = cache->head[ic];
+        cache->head[ic] = h;
+        ++(cache->count[ic]);
+        SizeClass& c = s.cls[ic];
+        c.ninuse.fetch_sub(1, std::memory_order_relaxed);
+
+        // Keep at most two batches per thread ... blocks freed by a thread
+        // other than the allocating one flow back through the shared list
+        if (cache->count[ic] > 2*c.batch)
+            give_back(c, cache->head[ic], cache->count[ic], c.batch);
+    }
+
+    std::vector<SlabAllocator::ClassStats> SlabAllocator::get_stats() {
+        std::vector<ClassStats> result;
+        SlabState& s = state();
+        for (int i=0; i<max_nclass; ++i) {
+            if (s.key[i].load(std::memory_order_acquire) == 0) continue;
+            SizeClass& c = s.cls[i];
+            ScopedMutex<Spinlock> guard(c.lock);
+            ClassStats stats;
+            stats.block_bytes = c.size;
+            stats.reserved_bytes = c.nreserved*c.stride;
+            stats.inuse_bytes = c.ninuse.load(std::memory_order_relaxed)*c.size;
+            stats.max_inuse_bytes = c.max_ninuse.load(std::memory_order_relaxed)*c.size;
+            result.push_back(stats);
+        }
+        return result;
+    }
+
+} // namespace madness
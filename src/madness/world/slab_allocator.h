@@ -0,0 +1,208 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_SLAB_ALLOCATOR_H__INCLUDED
+#define MADNESS_WORLD_SLAB_ALLOCATOR_H__INCLUDED
+
+/**
+ \file slab_allocator.h
+ \brief Thread-caching size-class allocator with intrusive reference counts.
+ \ingroup world
+*/
+
+#include <madness/madness_config.h>
+#include <madness/world/atomicint.h>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace madness {
+
+    namespace detail {
+
+        /// Header stored immediately before the user data of each slab block.
+        struct SlabHeader {
+            AtomicInt refcount; ///< Number of references to the block
+            int sclass;         ///< Size class or -1 if individually allocated
+            SlabHeader* next;   ///< Link in free lists
+        };
+
+    } // namespace detail
+
+    /// Thread-caching, size-class (slab) allocator for tensor data blocks.
+
+    /// Numerical trees hold millions of blocks of just a few sizes
+    /// (\f$ k^d \f$, \f$ (2k)^d \f$, ...).  Each distinct size gets its
+    /// own class whose blocks are carved from large slabs and recycled
+    /// through a per-thread free list; a thread only takes the class
+    /// lock to move a batch of blocks to or from the shared free list.
+    /// Slabs are never returned to the OS.
+    ///
+    /// Each block is preceded by a header holding an intrusive reference
+    /// count, so no separate control block is allocated (see \c SlabPtr).
+    /// User data is aligned on \c header_size bytes.  Blocks larger than
+    /// \c max_block_size, or of a new size once all classes are in use,
+    /// are allocated individually with the same header.
+    ///
+    /// Enabled for \c Tensor at build time by \c TENSOR_USE_SLAB.
+    class SlabAllocator {
+    public:
+        static const std::size_t header_size = 64; ///< Bytes of header preceding each block
+        static const std::size_t max_block_size = std::size_t(1) << 22; ///< Largest size served from slabs
+        static const int max_nclass = 256; ///< Maximum number of size classes
+
+        /// Statistics of one size class.
+        struct ClassStats {
+            std::size_t block_bytes;     ///< User bytes per block
+            std::size_t reserved_bytes;  ///< Bytes of slabs carved for this class
+            std::size_t inuse_bytes;     ///< Bytes of blocks allocated and not freed
+            std::size_t max_inuse_bytes; ///< High-water mark of inuse_bytes
+        };
+
+    private:
+        static detail::SlabHeader* header(const void* p) {
+            return reinterpret_cast<detail::SlabHeader*>(
+                    const_cast<char*>(static_cast<const char*>(p)) - header_size);
+        }
+
+        /// Return a block whose reference count dropped to zero.
+        static void free_block(detail::SlabHeader* h);
+
+    public:
+        /// Allocate an uninitialized block of \c size bytes with reference count 1.
+
+        /// Throws \c std::bad_alloc on failure.
+        /// \param[in] size The number of bytes.
+        /// \return Pointer to the user data.
+        static void* allocate(std::size_t size);
+
+        /// Increment the reference count of a block.
+
+        /// \param[in] p Pointer returned by \c allocate().
+        static void incref(const void* p) {
+            ++(header(p)->refcount);
+        }
+
+        /// Decrement the reference count of a block, releasing it when it drops to zero.
+
+        /// \param[in] p Pointer returned by \c allocate().
+        static void decref(const void* p) {
+            detail::SlabHeader* h = header(p);
+            if (h->refcount.dec_and_test()) free_block(h);
+        }
+
+        /// Returns the reference count of a block.
+
+        /// \param[in] p Pointer returned by \c allocate().
+        static long use_count(const void* p) {
+            return header(p)->refcount;
+        }
+
+        /// Returns the statistics of all size classes in use.
+        static std::vector<ClassStats> get_stats();
+    };
+
+
+    /// Intrusively reference counted pointer to a \c SlabAllocator block.
+
+    /// Provides the subset of the \c std::shared_ptr interface used by
+    /// \c Tensor.
+    /// \tparam T The element type.
+    template <typename T>
+    class SlabPtr {
+        T* p; ///< Pointer to the user data or null
+
+        void release() {
+            if (p) SlabAllocator::decref(p);
+        }
+
+    public:
+        SlabPtr() : p(nullptr) { }
+
+        /// Adopt a block with reference count 1 from \c SlabAllocator::allocate().
+
+        /// \param[in] q The block.
+        explicit SlabPtr(T* q) : p(q) { }
+
+        SlabPtr(const SlabPtr<T>& other) : p(other.p) {
+            if (p) SlabAllocator::incref(p);
+        }
+
+        SlabPtr(SlabPtr<T>&& other) : p(other.p) {
+            other.p = nullptr;
+        }
+
+        SlabPtr<T>& operator=(const SlabPtr<T>& other) {
+            if (other.p) SlabAllocator::incref(other.p);
+            release();
+            p = other.p;
+            return *this;
+        }
+
+        SlabPtr<T>& operator=(SlabPtr<T>&& other) {
+            std::swap(p, other.p);
+            return *this;
+        }
+
+        ~SlabPtr() {
+            release();
+        }
+
+        /// Release the block.
+        void reset() {
+            release();
+            p = nullptr;
+        }
+
+        /// Release the current block and adopt a new one with reference count 1.
+
+        /// \param[in] q The block from \c SlabAllocator::allocate().
+        void reset(T* q) {
+            release();
+            p = q;
+        }
+
+        T* get() const {
+            return p;
+        }
+
+        long use_count() const {
+            return p ? SlabAllocator::use_count(p) : 0;
+        }
+
+        explicit operator bool() const {
+            return p != nullptr;
+        }
+    };
+
+} // namespace madness
+
+#endif // MADNESS_WORLD_SLAB_ALLOCATOR_H__INCLUDED
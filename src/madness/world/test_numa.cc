@@ -0,0 +1,112 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file test_numa.cc
+/// \brief Benchmark of NUMA placement (run with MAD_NUMA=0 and MAD_NUMA=1)
+
+#include <madness/world/MADworld.h>
+#include <madness/world/worldnuma.h>
+#include <cstdlib>
+#include <iostream>
+
+using namespace madness;
+
+const int NBLOCK = 1024;       // Number of blocks
+const int BLOCKSIZE = 4096;    // Doubles per block (32KB)
+const int NSWEEP = 20;         // Number of read sweeps
+
+World* pworld;
+double* blocks[NBLOCK];
+double sums[NBLOCK];
+
+// Allocate and first touch a block from a pool thread
+void make_block(int i) {
+    double* p = static_cast<double*>(NumaTopology::allocate_local(BLOCKSIZE*sizeof(double), 64));
+    MADNESS_ASSERT(p);
+    for (int j=0; j<BLOCKSIZE; ++j) p[j] = double(i);
+    blocks[i] = p;
+}
+
+// Read a block NSWEEP times
+void sum_block(int i) {
+    const double* p = blocks[i];
+    double sum = 0.0;
+    for (int sweep=0; sweep<NSWEEP; ++sweep)
+        for (int j=0; j<BLOCKSIZE; ++j) sum += p[j];
+    sums[i] = sum;
+}
+
+// Binary tree of tasks so that work is spawned (and stolen) by pool threads
+void spawn(int lo, int hi, void (*op)(int)) {
+    if (hi - lo <= 8) {
+        for (int i=lo; i<hi; ++i) op(i);
+    }
+    else {
+        const int mid = (lo + hi)/2;
+        pworld->taskq.add(spawn, lo, mid, op);
+        pworld->taskq.add(spawn, mid, hi, op);
+    }
+}
+
+int main(int argc, char** argv) {
+    World& world = initialize(argc, argv);
+    pworld = &world;
+
+    if (world.rank() == 0) NumaTopology::print();
+
+    double start = wall_time();
+    world.taskq.add(spawn, 0, NBLOCK, &make_block);
+    world.taskq.fence();
+    const double tmake = wall_time() - start;
+
+    start = wall_time();
+    world.taskq.add(spawn, 0, NBLOCK, &sum_block);
+    world.taskq.fence();
+    const double tsum = wall_time() - start;
+
+    int nerr = 0;
+    for (int i=0; i<NBLOCK; ++i) {
+        if (sums[i] != double(i)*BLOCKSIZE*NSWEEP) ++nerr;
+        NumaTopology::deallocate_local(blocks[i]);
+    }
+
+    const DQStats stats = ThreadPool::get_stats();
+    if (world.rank() == 0) {
+        std::cout << "NUMA mode " << (NumaTopology::enabled() ? "on" : "off")
+                  << ": make " << tmake << " s, sum " << tsum << " s, "
+                  << (double(NBLOCK)*BLOCKSIZE*NSWEEP*sizeof(double))/tsum/1e9 << " GB/s, "
+                  << stats.nsteal << " steals, " << stats.nsteal_fail << " failed steals\n";
+        std::cout << (nerr ? "FAILED" : "OK") << std::endl;
+    }
+
+    finalize();
+    return nerr ? 1 : 0;
+}
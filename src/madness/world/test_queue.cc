@@ -89,6 +89,12 @@ int main(int argc, char** argv) {
     for (unsigned long i = 0; i < (madness::ThreadPool::size() + 1); ++i)
         std::cout << i << " " << thread_counters[i] << "\n";
 
+    std::cout << "Steals (ok/failed) per pool thread:\n";
+    for (int i = 0; i < int(madness::ThreadPool::size()); ++i) {
+        const madness::DQStats stats = madness::ThreadPool::get_thread_stats(i);
+        std::cout << i << " " << stats.nsteal << " " << stats.nsteal_fail << "\n";
+    }
+
     cleanup_tls();
     madness::finalize();
 
@@ -0,0 +1,132 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file test_slab.cc
+/// \brief Tests and times the slab allocator used for tensor data
+
+#include <madness/world/MADworld.h>
+#include <madness/world/slab_allocator.h>
+#include <madness/world/worldmem.h>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+using namespace madness;
+
+const int NBLOCK = 4096;
+const int NREPEAT = 20;
+const std::size_t sizes[] = {1000*sizeof(double), 8000*sizeof(double), 100*sizeof(double)};
+
+SlabPtr<double> blocks[NBLOCK];
+AtomicInt nerr;
+
+// Allocate and fill a range of blocks
+void make_blocks(int lo, int hi) {
+    for (int i=lo; i<hi; ++i) {
+        const std::size_t size = sizes[i%3];
+        double* p = static_cast<double*>(SlabAllocator::allocate(size));
+        if ((reinterpret_cast<unsigned long>(p) & (SlabAllocator::header_size-1)) != 0) nerr++;
+        for (std::size_t j=0; j<size/sizeof(double); ++j) p[j] = i;
+        blocks[i].reset(p);
+    }
+}
+
+// Check and release a range of blocks ... usually not the thread that allocated them
+void free_blocks(int lo, int hi) {
+    for (int i=lo; i<hi; ++i) {
+        SlabPtr<double> copy(blocks[i]);
+        if (copy.use_count() != 2) nerr++;
+        blocks[i].reset();
+        if (copy.use_count() != 1) nerr++;
+        const std::size_t n = sizes[i%3]/sizeof(double);
+        if (copy.get()[0] != i || copy.get()[n-1] != i) nerr++;
+    }
+}
+
+int main(int argc, char** argv) {
+    World& world = initialize(argc, argv);
+    nerr = 0;
+
+    // Threaded allocation and release
+    const int nchunk = 64;
+    for (int r=0; r<NREPEAT; ++r) {
+        for (int c=0; c<nchunk; ++c)
+            world.taskq.add(make_blocks, c*NBLOCK/nchunk, (c+1)*NBLOCK/nchunk);
+        world.taskq.fence();
+        // Reverse order so that blocks move between threads
+        for (int c=nchunk-1; c>=0; --c)
+            world.taskq.add(free_blocks, c*NBLOCK/nchunk, (c+1)*NBLOCK/nchunk);
+        world.taskq.fence();
+    }
+
+    // Time allocation versus posix_memalign plus a shared_ptr control block
+    double start = wall_time();
+    for (int r=0; r<NREPEAT; ++r) {
+        for (int i=0; i<NBLOCK; ++i)
+            blocks[i].reset(static_cast<double*>(SlabAllocator::allocate(sizes[i%3])));
+        for (int i=0; i<NBLOCK; ++i)
+            blocks[i].reset();
+    }
+    const double tslab = wall_time() - start;
+
+    static std::shared_ptr<double> shblocks[NBLOCK];
+    start = wall_time();
+    for (int r=0; r<NREPEAT; ++r) {
+        for (int i=0; i<NBLOCK; ++i) {
+            void* p = nullptr;
+            if (posix_memalign(&p, SlabAllocator::header_size, sizes[i%3])) nerr++;
+            shblocks[i].reset(static_cast<double*>(p), &std::free);
+        }
+        for (int i=0; i<NBLOCK; ++i)
+            shblocks[i].reset();
+    }
+    const double tmalloc = wall_time() - start;
+
+    // Large blocks are allocated individually
+    SlabPtr<double> big(static_cast<double*>(SlabAllocator::allocate(2*SlabAllocator::max_block_size)));
+    big.get()[0] = 1.0;
+    big.reset();
+
+    // Blocks parked in thread caches are not in use
+    const std::vector<SlabAllocator::ClassStats> stats = SlabAllocator::get_stats();
+    for (std::size_t i=0; i<stats.size(); ++i)
+        if (stats[i].inuse_bytes != 0) nerr++;
+
+    if (world.rank() == 0) {
+        world_mem_info()->print_slab();
+        std::cout << "\nslab " << tslab << " s   posix_memalign " << tmalloc << " s\n";
+        std::cout << (nerr ? "FAILED" : "OK") << std::endl;
+    }
+
+    const int result = nerr;
+    finalize();
+    return result;
+}
@@ -466,6 +466,48 @@ void test6(World& world) {
 }
 
 
+void test6b(World& world) {
+    PROFILE_FUNC;
+    ProcessID me = world.rank();
+    ProcessID nproc = world.nproc();
+    const bool aggregate = world.am.get_aggregation();
+    world.am.set_aggregation(true);
+    Foo a(world, me*100);
+
+    // Many small messages to every process, mixed with large ones that
+    // must flush what is packed first
+    std::vector< Future<int> > small;
+    std::vector< Future<double> > large;
+    for (int i=0; i<1000; ++i) {
+        for (ProcessID p=0; p<nproc; ++p) {
+            small.push_back(a.task(p,&Foo::get1,i));
+            small.push_back(a.send(p,&Foo::get2,i,2));
+        }
+        if (i%250 == 0) large.push_back(a.task((me+1)%nproc,&Foo::getbuf0,a.dbuf_short()));
+    }
+    world.gop.fence();
+    for (std::size_t j=0; j<small.size(); j+=2) {
+        const int i = j/(2*nproc);
+        const ProcessID p = (j/2)%nproc;
+        MADNESS_ASSERT(small[j].get() == p*100+i);
+        MADNESS_ASSERT(small[j+1].get() == p*100+i+2);
+    }
+    const double dbuf_sum = std::accumulate(a.dbuf_short().begin(), a.dbuf_short().end(), 0.0);
+    for (std::size_t j=0; j<large.size(); ++j) {
+        MADNESS_ASSERT(large[j].get() == ((me+1)%nproc)*100+dbuf_sum);
+    }
+
+    // Waiting on a single remote reply relies on the timed flush
+    if (nproc > 1) {
+        MADNESS_ASSERT(a.send((me+1)%nproc,&Foo::get0).get() == ((me+1)%nproc)*100);
+    }
+    world.gop.fence();
+
+    world.am.set_aggregation(aggregate);
+    print("test 6b (aggregated active messages) seems to be working");
+}
+
+
 class TestFutureForwarding : public WorldObject<TestFutureForwarding> {
 public:
     TestFutureForwarding(World& world)
@@ -1214,6 +1256,7 @@ int main(int argc, char** argv) {
         test5(world);
         test6(world);
         test6a(world);
+        test6b(world);
         test7(world);
         test8(world);
         test9(world);
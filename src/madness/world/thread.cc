@@ -42,6 +42,8 @@
 #include <madness/world/worldpapi.h>
 #include <madness/world/safempi.h>
 #include <madness/world/atomicint.h>
+#include <madness/world/worldnuma.h>
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 
@@ -225,6 +227,36 @@ namespace madness {
             return;
         }
 
+        // In NUMA mode pool threads are confined to the processors of
+        // their node (one processor if binding pool threads)
+        if (logical_id == 2 && NumaTopology::enabled()) {
+            if (ind < 0) {
+                std::cout << "ThreadBase: set_affinity: pool thread index bad?" << std::endl;
+                return;
+            }
+            const int nthread = ThreadPool::size();
+            const int node = NumaTopology::node_of_pool_thread(ind, nthread);
+            const std::vector<int>& cpus = NumaTopology::cpus(node);
+            if (cpus.empty()) return;
+#ifndef ON_A_MAC
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            if (bind[2]) {
+                int first = 0; // Index of the first thread on this node
+                while (NumaTopology::node_of_pool_thread(first, nthread) != node) ++first;
+                CPU_SET(cpus[(ind - first) % cpus.size()], &mask);
+            }
+            else {
+                for (int cpu : cpus) CPU_SET(cpu, &mask);
+            }
+            if (sched_setaffinity(0, sizeof(mask), &mask) == -1) {
+                perror("system error message");
+                std::cout << "ThreadBase: set_affinity: Could not set NUMA cpu affinity" << std::endl;
+            }
+#endif
+            return;
+        }
+
         if (!bind[logical_id]) return;
 
         // If binding the main or rmi threads the cpu id is a specific cpu.
@@ -338,6 +370,8 @@ namespace madness {
             threads(nullptr), main_thread(), nthreads(nthread), finish(false)
     {
         nfinished = 0;
+        nsleeping = 0;
+        nhipri = 0;
         instance_ptr = this;
         if (nthreads < 0) nthreads = default_nthread();
         MADNESS_ASSERT(nthreads >= 0);
@@ -377,6 +411,8 @@ namespace madness {
 
         for (int i=0; i<nthreads; ++i) {
             threads[i].set_pool_thread_index(i);
+            threads[i].steal_seed = 2654435761u*(i+1);
+            threads[i].numa_node = NumaTopology::node_of_pool_thread(i, nthreads);
             threads[i].start(pool_thread_main, (void *)(threads+i));
         }
 #endif
@@ -407,6 +443,80 @@ namespace madness {
         return nthread;
     }
 
+#ifndef HAVE_INTEL_TBB
+    bool ThreadPool::steal(ThreadPoolThread* const thief, PoolTaskInterface*& task) {
+        if (nthreads == 0) return false;
+
+        ThreadPoolThread* const rec = (thief ? thief : &main_thread);
+        // xorshift ... quality is irrelevant, just need to spread thieves out
+        unsigned int x = rec->steal_seed;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        rec->steal_seed = x;
+
+        const int self = (thief ? thief->get_pool_thread_index() : -1);
+        const int start = x % nthreads;
+
+        // In NUMA mode the first pass only visits threads on our own node
+        const bool numa = NumaTopology::enabled() && thief;
+        for (int pass = (numa ? 0 : 1); pass < 2; ++pass) {
+            for (int k=0; k<nthreads; ++k) {
+                int victim = start + k;
+                if (victim >= nthreads) victim -= nthreads;
+                if (victim == self || threads[victim].tasks.empty()) continue;
+                if (numa && ((threads[victim].numa_node == thief->numa_node) != (pass == 0))) continue;
+                const bool success = threads[victim].tasks.steal(task);
+                rec->tasks.record_steal(success);
+                if (success) return true;
+            }
+        }
+        return false;
+    }
+
+    int ThreadPool::pop_shared(int nmax, PoolTaskInterface** taskbuf, bool wait) {
+        const int ntask = queue.pop_front(nmax, taskbuf, wait);
+        for (int i=0; i<ntask; ++i) {
+            if (taskbuf[i]->is_high_priority() && taskbuf[i]->get_nthread() == 1) nhipri--;
+        }
+        return ntask;
+    }
+
+    int ThreadPool::pop_tasks(int nmax, PoolTaskInterface** taskbuf, bool wait) {
+        ThreadPoolThread* const thread = pool_thread();
+
+        // High priority tasks are at the front of the shared queue and
+        // must not wait behind the local deque
+        const int nhi = nhipri;
+        if (nhi > 0) {
+            const int ntask = pop_shared(std::min(nhi, nmax), taskbuf, false);
+            if (ntask) return ntask;
+        }
+
+        if (thread && thread->tasks.pop(*taskbuf)) return 1;
+
+        if (!queue.empty()) {
+            const int ntask = pop_shared(nmax, taskbuf, false);
+            if (ntask) return ntask;
+        }
+
+        if (steal(thread, *taskbuf)) return 1;
+
+        if (wait) {
+            // Announce that we are going to sleep before the last attempt
+            // to steal ... see push_local()
+            nsleeping++;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int ntask = (steal(thread, *taskbuf) ? 1 : 0);
+            if (!ntask) ntask = pop_shared(nmax, taskbuf, true);
+            nsleeping--;
+            return ntask;
+        }
+
+        return 0;
+    }
+#endif // HAVE_INTEL_TBB
+
     void ThreadPool::thread_main(ThreadPoolThread* const thread) {
         PROFILE_MEMBER_FUNC(ThreadPool);
         thread->set_affinity(2, thread->get_pool_thread_index());
@@ -517,8 +627,25 @@ namespace madness {
     }
 
     // Returns queue statistics
-    const DQStats& ThreadPool::get_stats() {
-        return instance()->queue.get_stats();
+    DQStats ThreadPool::get_stats() {
+        DQStats stats = instance()->queue.get_stats();
+#ifndef HAVE_INTEL_TBB
+        stats += instance()->main_thread.tasks.get_stats();
+        for (int i=0; i<instance()->nthreads; ++i)
+            stats += instance()->threads[i].tasks.get_stats();
+#endif // HAVE_INTEL_TBB
+        return stats;
+    }
+
+    // Returns queue statistics of a single pool thread
+    DQStats ThreadPool::get_thread_stats(int i) {
+        MADNESS_ASSERT(i >= -1 && i < instance()->nthreads);
+#ifndef HAVE_INTEL_TBB
+        if (i < 0) return instance()->main_thread.tasks.get_stats();
+        return instance()->threads[i].tasks.get_stats();
+#else
+        return DQStats();
+#endif // HAVE_INTEL_TBB
     }
 
 } // namespace madness
@@ -41,6 +41,7 @@
 #include <madness/world/dqueue.h>
 #include <madness/world/function_traits.h>
 #include <vector>
+#include <atomic>
 #include <cstddef>
 #include <cstdio>
 #include <pthread.h>
@@ -1085,13 +1086,24 @@ namespace madness {
     /// accessed via \c ThreadBase::this_thread().
     class ThreadPoolThread : public Thread {
     private:
+        friend class ThreadPool;
+
         // Thread local data for thread pool
 #ifdef MADNESS_TASK_PROFILING
         profiling::TaskProfiler profiler_; ///< \todo Description needed.
 #endif // MADNESS_TASK_PROFILING
+#ifndef HAVE_INTEL_TBB
+        WSDeque<PoolTaskInterface*> tasks; ///< Tasks spawned by this thread (stealable).
+        unsigned int steal_seed; ///< State of the victim selection generator.
+        int numa_node; ///< NUMA node this thread is placed on.
+#endif // HAVE_INTEL_TBB
 
     public:
+#ifndef HAVE_INTEL_TBB
+        ThreadPoolThread() : Thread(), tasks(), steal_seed(1), numa_node(0) { }
+#else
         ThreadPoolThread() : Thread() { }
+#endif // HAVE_INTEL_TBB
         virtual ~ThreadPoolThread() = default;
 
 #ifdef MADNESS_TASK_PROFILING
@@ -1116,10 +1128,12 @@ namespace madness {
         // Thread pool data
         ThreadPoolThread *threads; ///< Array of threads.
         ThreadPoolThread main_thread; ///< Placeholder for main thread tls.
-        DQueue<PoolTaskInterface*> queue; ///< Queue of tasks.
+        DQueue<PoolTaskInterface*> queue; ///< Shared (injection) queue of tasks.
         int nthreads; ///< Number of threads.
         volatile bool finish; ///< Set to true when time to stop.
         AtomicInt nfinished; ///< Thread pool exit counter.
+        AtomicInt nsleeping; ///< Number of pool threads blocked on the shared queue.
+        AtomicInt nhipri; ///< Number of high priority tasks at the front of the shared queue.
 
         // Static data
         static ThreadPool* instance_ptr; ///< Singleton pointer.
@@ -1145,6 +1159,61 @@ namespace madness {
         /// \return The number of threads.
         int default_nthread();
 
+#ifndef HAVE_INTEL_TBB
+        /// Returns the pool thread that is calling, or null if the caller is not in the pool.
+        ThreadPoolThread* pool_thread() const {
+            const ThreadBase* const t = ThreadBase::this_thread();
+            if (t) {
+                const int ind = t->get_pool_thread_index();
+                if (ind >= 0) return threads + ind;
+            }
+            return nullptr;
+        }
+
+        /// Push a single-threaded task onto the deque of the calling pool thread.
+
+        /// If some pool threads are asleep on the shared queue a task is
+        /// moved there instead so that it wakes one of them.  The sleeper
+        /// increments \c nsleeping before its final steal attempt, so
+        /// either it sees the task or we see it (no lost wake ups).
+        /// \param[in,out] thread The calling pool thread.
+        /// \param[in] task The task.
+        void push_local(ThreadPoolThread* const thread, PoolTaskInterface* task) {
+            thread->tasks.push(task);
+            // Order the push before reading nsleeping, cf. pop_tasks()
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (nsleeping > 0) {
+                PoolTaskInterface* t;
+                if (thread->tasks.pop(t))
+                    queue.push_back(t);
+            }
+        }
+
+        /// Try to steal one task from another pool thread.
+
+        /// Victims are visited starting from a random thread.
+        /// \param[in,out] thief The calling pool thread (null if not in the pool).
+        /// \param[out] task The stolen task.
+        /// \return True if a task was stolen.
+        bool steal(ThreadPoolThread* const thief, PoolTaskInterface*& task);
+
+        /// Get up to \c nmax tasks for the calling thread.
+
+        /// Pool threads first take the high priority tasks at the front of
+        /// the shared queue, then pop their own deque (LIFO), then the rest
+        /// of the shared queue, and finally try to steal from other threads
+        /// (FIFO).  If \c wait is true and there is no work the thread
+        /// blocks on the shared queue.
+        /// \param[in] nmax Maximum number of tasks (at least 1).
+        /// \param[out] taskbuf Array of dimension at least \c nmax.
+        /// \param[in] wait Block if true.
+        /// \return The number of tasks obtained (might be zero).
+        int pop_tasks(int nmax, PoolTaskInterface** taskbuf, bool wait);
+
+        /// Pop up to \c nmax tasks from the front of the shared queue, keeping \c nhipri up to date
+        int pop_shared(int nmax, PoolTaskInterface** taskbuf, bool wait);
+#endif // HAVE_INTEL_TBB
+
         /// Run the next task.
 
         /// \todo Verify and complete this documentation.
@@ -1156,21 +1225,21 @@ namespace madness {
             MADNESS_EXCEPTION("run_task should not be called when using Intel TBB", 1);
 #else
 
-            if (!wait && queue.empty()) return false;
-            std::pair<PoolTaskInterface*,bool> t = queue.pop_front(wait);
+            PoolTaskInterface* t = nullptr;
+            const int ntask = pop_tasks(1, &t, wait);
 #ifdef MADNESS_TASK_PROFILING
             profiling::TaskEventList* event_list =
                     this_thread->profiler().new_list(1);
 #endif // MADNESS_TASK_PROFILING
             // Task pointer might be zero due to stealing
-            if (t.second && t.first) {
+            if (ntask && t) {
 #ifdef MADNESS_TASK_PROFILING
-                t.first->set_event(event_list->event());
+                t->set_event(event_list->event());
 #endif // MADNESS_TASK_PROFILING
-                if (t.first->run_multi_threaded())         // What we are here to do
-                    delete t.first;
+                if (t->run_multi_threaded())         // What we are here to do
+                    delete t;
             }
-            return t.second;
+            return (ntask > 0);
 #endif
         }
 
@@ -1196,7 +1265,7 @@ namespace madness {
 #else
 
             PoolTaskInterface* taskbuf[nmax];
-            int ntask = queue.pop_front(nmax, taskbuf, wait);
+            int ntask = pop_tasks(nmax, taskbuf, wait);
 #ifdef MADNESS_TASK_PROFILING
             profiling::TaskEventList* event_list =
                     this_thread->profiler().new_list(ntask);
@@ -1274,14 +1343,25 @@ namespace madness {
             }
 #else
             if (!task) MADNESS_EXCEPTION("ThreadPool: inserting a NULL task pointer", 1);
+            ThreadPool* const pool = instance();
             int task_threads = task->get_nthread();
             // Currently multithreaded tasks must be shoved on the end of the q
             // to avoid a race condition as multithreaded task is starting up
             if (task->is_high_priority() && (task_threads == 1)) {
-                instance()->queue.push_front(task);
+                pool->nhipri++;
+                pool->queue.push_front(task);
+            }
+            else if (task_threads == 1) {
+                // Tasks spawned by a pool thread stay on its own deque;
+                // those from the main or RMI threads are injected.
+                ThreadPoolThread* const thread = pool->pool_thread();
+                if (thread)
+                    pool->push_local(thread, task);
+                else
+                    pool->queue.push_back(task);
             }
             else {
-                instance()->queue.push_back(task, task_threads);
+                pool->queue.push_back(task, task_threads);
             }
 #endif // HAVE_INTEL_TBB
         }
@@ -1351,15 +1431,32 @@ namespace madness {
 
         /// Returns the number of tasks in the queue.
 
+        /// Includes the tasks in the per-thread deques, so the value is
+        /// only approximate while the pool is busy.
         /// \return The number of tasks in the queue.
         static std::size_t queue_size() {
-            return instance()->queue.size();
+            std::size_t n = instance()->queue.size();
+#ifndef HAVE_INTEL_TBB
+            for (int i=0; i<instance()->nthreads; ++i)
+                n += instance()->threads[i].tasks.size();
+#endif // HAVE_INTEL_TBB
+            return n;
         }
 
         /// Returns queue statistics.
 
+        /// Sums the statistics of the shared queue and of all the
+        /// per-thread deques.
+        /// \return Queue statistics.
+        static DQStats get_stats();
+
+        /// Returns the statistics of the deque of one pool thread.
+
+        /// Steal counters are those of the attempts made by the thread;
+        /// \c i=-1 selects the attempts made by threads not in the pool.
+        /// \param[in] i The pool thread index (-1,...,nthread-1).
         /// \return Queue statistics.
-        static const DQStats& get_stats();
+        static DQStats get_thread_stats(int i);
 
         /// Gracefully wait for a condition to become true, executing any tasks in the queue.
 
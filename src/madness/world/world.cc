@@ -41,6 +41,7 @@
 #include <madness/world/worldam.h>
 #include <madness/world/world_task_queue.h>
 #include <madness/world/worldgop.h>
+#include <madness/world/worldnuma.h>
 #include <cstdlib>
 #include <sstream>
 
@@ -168,6 +169,11 @@ namespace madness {
         }
 
         ThreadBase::set_affinity_pattern(bind, cpulo); // Decide how to locate threads before doing anything
+
+        // MAD_NUMA=1 places pool threads and tensor data by NUMA node
+        const char* snuma = getenv("MAD_NUMA");
+        NumaTopology::initialize(snuma && std::atoi(snuma) != 0);
+
         ThreadBase::set_affinity(0);         // The main thread is logical thread 0
 
 #if defined(HAVE_IBMBGQ) and defined(HPM)
@@ -213,6 +219,8 @@ namespace madness {
         if(SafeMPI::COMM_WORLD.Get_rank() == 0)
             std::cout << "MADNESS runtime initialized with " << ThreadPool::size()
                 << " threads in the pool and affinity " << sbind << "\n";
+        if(SafeMPI::COMM_WORLD.Get_rank() == 0 && NumaTopology::enabled())
+            NumaTopology::print();
 
         return * World::default_world;
     }
@@ -281,33 +289,45 @@ namespace madness {
         double npop_front = q.npop_front;
         double ntask = q.npush_back + q.npush_front;
         double nmax = q.nmax;
+        double nsteal = q.nsteal;
+        double nsteal_fail = q.nsteal_fail;
         world.gop.sum(npush_back);
         world.gop.sum(npush_front);
         world.gop.sum(npop_front);
         world.gop.sum(ntask);
         world.gop.sum(nmax);
+        world.gop.sum(nsteal);
+        world.gop.sum(nsteal_fail);
 
         double max_npush_back = q.npush_back;
         double max_npush_front = q.npush_front;
         double max_npop_front = q.npop_front;
         double max_ntask = q.npush_back + q.npush_front;
         double max_nmax = q.nmax;
+        double max_nsteal = q.nsteal;
+        double max_nsteal_fail = q.nsteal_fail;
         world.gop.max(max_npush_back);
         world.gop.max(max_npush_front);
         world.gop.max(max_npop_front);
         world.gop.max(max_ntask);
         world.gop.max(max_nmax);
+        world.gop.max(max_nsteal);
+        world.gop.max(max_nsteal_fail);
 
         double min_npush_back = q.npush_back;
         double min_npush_front = q.npush_front;
         double min_npop_front = q.npop_front;
         double min_ntask = q.npush_back + q.npush_front;
         double min_nmax = q.nmax;
+        double min_nsteal = q.nsteal;
+        double min_nsteal_fail = q.nsteal_fail;
         world.gop.min(min_npush_back);
         world.gop.min(min_npush_front);
         world.gop.min(min_npop_front);
         world.gop.min(min_ntask);
         world.gop.min(min_nmax);
+        world.gop.min(min_nsteal);
+        world.gop.min(min_nsteal_fail);
 
 #ifdef HAVE_PAPI
         double val[NUMEVENTS], max_val[NUMEVENTS], min_val[NUMEVENTS];
@@ -355,6 +375,10 @@ namespace madness {
                    min_nmax, nmax/world.size(), max_nmax);
             printf("  #hi-pri tasks per node    %.2e / %.2e / %.2e\n",
                    min_npush_front, npush_front/world.size(), max_npush_front);
+            printf("  #stolen tasks per node    %.2e / %.2e / %.2e\n",
+                   min_nsteal, nsteal/world.size(), max_nsteal);
+            printf("  #failed steals per node   %.2e / %.2e / %.2e\n",
+                   min_nsteal_fail, nsteal_fail/world.size(), max_nsteal_fail);
             printf("\n");
 #ifdef HAVE_PAPI
             printf("         PAPI statistics (min / avg / max)\n");
@@ -375,6 +399,8 @@ namespace madness {
 #endif
 #ifdef WORLD_GATHER_MEM_STATS
             world_mem_info()->print();
+#elif defined(TENSOR_USE_SLAB)
+            world_mem_info()->print_slab();
 #endif
 
             printf("         Total wall time    %.1fs\n", total_wall_time);
@@ -82,6 +82,16 @@ namespace madness {
     class WorldAmInterface;
     class WorldGopInterface;
 
+    namespace detail {
+        /// Sends all active messages packed by WorldAmInterface in any world
+
+        /// Called before the main thread blocks so that what it waits for is
+        /// not held back by message aggregation.  Does nothing on the threads
+        /// of the pool, whose packed messages are sent by the RMI thread once
+        /// they are older than flush_us (see WorldAmInterface::set_aggregation).
+        void flush_aggregated_am();
+    }
+
     /// \todo Brief description needed.
 
     /// \todo Description needed.
@@ -499,6 +509,8 @@ namespace madness {
         /// \param dowork Description needed. I'm guessing this has to do with blocking/nonblocking options.
         template <typename Probe>
         static void inline await(const Probe& probe, bool dowork = true) {
+            if (probe()) return;
+            detail::flush_aggregated_am();
             ThreadPool::await(probe, dowork);
         }
 
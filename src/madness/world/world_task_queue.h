@@ -40,6 +40,7 @@
 
 #include <type_traits>
 #include <iostream>
+#include <vector>
 #include <madness/world/nodefaults.h>
 #include <madness/world/range.h>
 #include <madness/world/timers.h>
@@ -292,9 +293,126 @@ namespace madness {
             public memfunc_enabler<objT, memfnT>
         { };
 
+        /// Assigns a future vector once every future of a vector is assigned.
+
+        /// Deletes itself after the last notification.
+        /// \tparam T The type of the futures.
+        template <typename T>
+        class FutureVectorGather : public CallbackInterface {
+        private:
+            std::vector< Future<T> > v; ///< The futures to gather.
+            Future< std::vector<T> > result; ///< The gathered values.
+            AtomicInt nleft; ///< Unassigned futures, plus one while registering.
+
+        public:
+            FutureVectorGather(const std::vector< Future<T> >& v,
+                    const Future< std::vector<T> >& result)
+                : v(v), result(result)
+            {
+                nleft = v.size() + 1;
+            }
+
+            /// Registers with all futures; may delete \c this before returning.
+            void start() {
+                for (std::size_t i=0; i<v.size(); ++i) v[i].register_callback(this);
+                notify();
+            }
+
+            void notify() {
+                if (nleft.dec_and_test()) {
+                    std::vector<T> values;
+                    values.reserve(v.size());
+                    for (std::size_t i=0; i<v.size(); ++i) values.push_back(v[i].get());
+                    result.set(values);
+                    delete this;
+                }
+            }
+        };
+
+        /// Distributes the values of a future vector onto individual futures.
+
+        /// Deletes itself after assigning the futures.
+        /// \tparam T The type of the values.
+        template <typename T>
+        class FutureVectorScatter : public CallbackInterface {
+        private:
+            Future< std::vector<T> > batch; ///< The values to distribute.
+            std::vector< Future<T> > v; ///< The destination futures.
+            std::vector<std::size_t> index; ///< Position in \c v of each value.
+
+        public:
+            FutureVectorScatter(const Future< std::vector<T> >& batch,
+                    const std::vector< Future<T> >& v,
+                    const std::vector<std::size_t>& index)
+                : batch(batch), v(v), index(index)
+            { }
+
+            void notify() {
+                const std::vector<T>& values = batch.get();
+                MADNESS_ASSERT(values.size() == index.size());
+                for (std::size_t i=0; i<index.size(); ++i) v[index[i]].set(values[i]);
+                delete this;
+            }
+        };
+
     }  // namespace detail
 
 
+    /// Groups a list of keys by owner so that each group can be processed by one task.
+
+    /// Groups are ordered by first appearance of their owner in the list, and
+    /// keys keep their relative order within a group.
+    /// \tparam keyT The key type.
+    template <typename keyT>
+    class KeyBatches {
+    private:
+        std::vector<ProcessID> owners; ///< Owner of each group.
+        std::vector< std::vector<keyT> > keys; ///< Keys of each group.
+        std::vector< std::vector<std::size_t> > indices; ///< Positions in the original list.
+
+    public:
+        /// Groups \c keylist using \c owner(key).
+
+        /// \tparam ownerT A functor mapping a key to a \c ProcessID.
+        /// \param[in] keylist The keys.
+        /// \param[in] owner The owner map.
+        template <typename ownerT>
+        KeyBatches(const std::vector<keyT>& keylist, const ownerT& owner) {
+            for (std::size_t i=0; i<keylist.size(); ++i) {
+                const ProcessID p = owner(keylist[i]);
+                std::size_t b = 0;
+                while (b<owners.size() && owners[b]!=p) ++b;
+                if (b == owners.size()) {
+                    owners.push_back(p);
+                    keys.push_back(std::vector<keyT>());
+                    indices.push_back(std::vector<std::size_t>());
+                }
+                keys[b].push_back(keylist[i]);
+                indices[b].push_back(i);
+            }
+        }
+
+        /// Number of groups.
+        std::size_t size() const { return owners.size(); }
+
+        /// Total number of keys in all groups.
+        std::size_t nkeys() const {
+            std::size_t n = 0;
+            for (std::size_t b=0; b<keys.size(); ++b) n += keys[b].size();
+            return n;
+        }
+
+        /// Owner of group \c b.
+        ProcessID owner(std::size_t b) const { return owners[b]; }
+
+        /// Keys of group \c b.
+        const std::vector<keyT>& batch(std::size_t b) const { return keys[b]; }
+
+        /// Positions in the original list of the keys of group \c b.
+        const std::vector<std::size_t>& index(std::size_t b) const { return indices[b]; }
+    };
+
+
     /// Multi-threaded queue to manage and run tasks.
 
     /// \todo A concise description of the inner workings...
@@ -564,6 +682,51 @@ namespace madness {
             return result;
         }
 
+        /// Combine a vector of futures into a future vector of their values.
+
+        /// No task is created; the result is assigned by the last of the
+        /// futures to be assigned (immediately if they all are already).
+        /// \tparam T The type of the futures.
+        /// \param[in] v The futures.
+        /// \return A future to the values of \c v, in order.
+        template <typename T>
+        Future< std::vector<T> > gather(const std::vector< Future<T> >& v) {
+            Future< std::vector<T> > result;
+            (new detail::FutureVectorGather<T>(v, result))->start();
+            return result;
+        }
+
+        /// Submit one task per owner for a list of keys.
+
+        /// For every group of \c batches, `submit(owner, keys)` is invoked
+        /// and must return a \c Future<std::vector<T>> holding one value per
+        /// key of the group, typically by sending a single (possibly remote)
+        /// task that processes all the keys. This replaces one task per key
+        /// with one task per owner.
+        ///
+        /// The returned futures are per key, in the order of the original
+        /// list, so they can be used wherever the futures of individual
+        /// tasks were used before (e.g. as a vector of task dependencies).
+        /// No extra task is created to distribute the results.
+        /// \tparam T The result type for each key.
+        /// \tparam keyT The key type.
+        /// \tparam submitT Functor with signature
+        ///     `Future<std::vector<T>> (ProcessID, const std::vector<keyT>&)`.
+        /// \param[in] batches The keys grouped by owner.
+        /// \param[in] submit Submits the task for one group.
+        /// \return A future for each key.
+        template <typename T, typename keyT, typename submitT>
+        std::vector< Future<T> > batch(const KeyBatches<keyT>& batches, const submitT& submit) {
+            std::vector< Future<T> > v;
+            v.reserve(batches.nkeys());
+            for (std::size_t i=0; i<batches.nkeys(); ++i) v.push_back(Future<T>());
+            for (std::size_t b=0; b<batches.size(); ++b) {
+                Future< std::vector<T> > fb = submit(batches.owner(b), batches.batch(b));
+                fb.register_callback(new detail::FutureVectorScatter<T>(fb, v, batches.index(b)));
+            }
+            return v;
+        }
+
 
         /// Create a local task with no arguments.
 
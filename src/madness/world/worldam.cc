@@ -33,10 +33,16 @@
 #include <madness/world/MADworld.h>
 #include <madness/world/worldmpi.h>
 #include <sstream>
+#include <algorithm>
 
 namespace madness {
 
-
+    namespace {
+        // Instances with aggregation enabled, polled by the RMI server thread
+        std::vector<WorldAmInterface*> agg_instances;
+        Mutex agg_instances_mutex;
+        volatile int agg_ninstance = 0;
+    }
 
     WorldAmInterface::WorldAmInterface(World& world)
             : nsend(DEFAULT_NSEND)
@@ -49,6 +55,13 @@ namespace madness {
             , nsent(0)
             , nrecv(0)
             , map_to_comm_world(nproc)
+            , aggregate(false)
+            , agg_max_len(0)
+            , agg_small_len(0)
+            , agg_flush_time(0.0)
+            , agg_next_check(0.0)
+            , agg_buf()
+            , agg_nbuf(0)
     {
         lock();
 
@@ -82,9 +95,19 @@ namespace madness {
         // }
 
         unlock();
+
+        // Optionally pack small messages
+        const char* mad_am_aggregate = getenv("MAD_AM_AGGREGATE");
+        if(mad_am_aggregate) {
+            std::stringstream ss(mad_am_aggregate);
+            int enable = 0;
+            ss >> enable;
+            if(enable) set_aggregation(true);
+        }
     }
 
     WorldAmInterface::~WorldAmInterface() {
+        set_aggregation(false);
         if(SafeMPI::Is_finalized()) {
             for(int i=0; i < nsend; ++i)
                 free_managed_send_buf(i);
@@ -98,4 +121,142 @@ namespace madness {
         }
     }
 
+    void WorldAmInterface::set_aggregation(bool enable, std::size_t small_len, double flush_us) {
+        // Without other processes there is no RMI layer and nothing to pack
+        if(enable && SafeMPI::COMM_WORLD.Get_size() == 1) enable = false;
+
+        // Register first so that the RMI thread never sees a half-built state
+        if(enable) {
+            ScopedMutex<Mutex> guard(agg_instances_mutex);
+            if(std::find(agg_instances.begin(), agg_instances.end(), this) == agg_instances.end()) {
+                agg_instances.push_back(this);
+                agg_ninstance = agg_instances.size();
+            }
+            RMI::set_poll_hook(&WorldAmInterface::poll_aggregation);
+        }
+
+        lock();
+        for(ProcessID p=0; p<ProcessID(agg_buf.size()); ++p) flush_buffer(p);
+        if(enable) {
+            agg_max_len = RMI::max_msg_len();
+            agg_small_len = small_len ? std::min(small_len, agg_max_len/2) : agg_max_len/16;
+            agg_flush_time = flush_us*1e-6;
+            agg_next_check = wall_time() + agg_flush_time;
+            agg_buf.resize(nproc);
+        }
+        else {
+            for(std::size_t p=0; p<agg_buf.size(); ++p) free_am_arg(agg_buf[p].arg);
+            std::vector<AggBuffer>().swap(agg_buf);
+        }
+        aggregate = enable;
+        unlock();
+
+        if(!enable) {
+            ScopedMutex<Mutex> guard(agg_instances_mutex);
+            std::vector<WorldAmInterface*>::iterator it =
+                    std::find(agg_instances.begin(), agg_instances.end(), this);
+            if(it != agg_instances.end()) agg_instances.erase(it);
+            agg_ninstance = agg_instances.size();
+        }
+    }
+
+    void WorldAmInterface::pack(ProcessID dest, const AmArg* arg, std::size_t nbyte) {
+        // WE ASSUME WE ARE INSIDE A CRITICAL SECTION WHEN IN HERE
+        const std::size_t len = agg_padded(nbyte);
+        AggBuffer& b = agg_buf[dest];
+
+        // Send what is there if this message would overflow the recv buffer
+        if(b.used && (sizeof(AmArg) + b.used + len > agg_max_len))
+            flush_buffer(dest);
+
+        if(b.used + len > b.capacity || !b.arg) {
+            // Grow geometrically up to the max. message length
+            std::size_t capacity = std::max(b.capacity, std::size_t(4096));
+            while(capacity < b.used + len) capacity *= 2;
+            capacity = std::min(capacity, agg_max_len - sizeof(AmArg));
+            if(capacity < b.used + len) capacity = b.used + len;
+            if(!b.arg || capacity > b.capacity) {
+                AmArg* newarg = alloc_am_arg(capacity);
+                if(b.arg) {
+                    memcpy(newarg->buf(), b.arg->buf(), b.used);
+                    free_am_arg(b.arg);
+                }
+                b.arg = newarg;
+                b.capacity = capacity;
+            }
+        }
+
+        if(b.used == 0) {
+            b.start = wall_time();
+            ++agg_nbuf;
+        }
+        memcpy(b.arg->buf() + b.used, arg, nbyte);
+        b.used += len;
+    }
+
+    void WorldAmInterface::flush_buffer(ProcessID dest) {
+        // WE ASSUME WE ARE INSIDE A CRITICAL SECTION WHEN IN HERE
+        AggBuffer& b = agg_buf[dest];
+        if(b.used == 0) return;
+
+        AmArg* arg = b.arg;
+        arg->set_size(b.used);
+        arg->set_worldid(worldid);
+        arg->set_src(rank);
+        arg->clear_flags();
+        b.arg = 0;
+        b.used = 0;
+        --agg_nbuf;
+
+        send_managed(map_to_comm_world[dest], arg, arg->size()+sizeof(AmArg),
+                     batch_handler, RMI::ATTR_ORDERED);
+    }
+
+    void WorldAmInterface::flush_stale_buffers(bool nowait) {
+        // WE ASSUME WE ARE INSIDE A CRITICAL SECTION WHEN IN HERE
+        if(!agg_nbuf) return;
+        const double now = wall_time();
+        if(now < agg_next_check) return;
+        double oldest = now;
+        for(ProcessID p=0; p<nproc; ++p) {
+            if(agg_buf[p].used) {
+                if(now - agg_buf[p].start >= agg_flush_time) {
+                    // send_managed would wait for the send slot to free up;
+                    // leave the rest to the next poll, sender or fence
+                    if(nowait && !send_req[cur_msg].Test()) return;
+                    flush_buffer(p);
+                }
+                else oldest = std::min(oldest, agg_buf[p].start);
+            }
+        }
+        agg_next_check = oldest + agg_flush_time;
+    }
+
+    namespace detail {
+        void flush_aggregated_am() {
+            if(!agg_ninstance) return;
+            // Pool threads wait on each other all the time; flushing for them
+            // would undo the packing.  Their messages go out with the next
+            // poll of the RMI thread (flush_us) or the next fence.
+            const ThreadBase* thread = ThreadBase::this_thread();
+            if(thread && thread->get_pool_thread_index() >= 0) return;
+            ScopedMutex<Mutex> guard(agg_instances_mutex);
+            for(std::size_t i=0; i<agg_instances.size(); ++i)
+                agg_instances[i]->fence();
+        }
+    } // namespace detail
+
+    void WorldAmInterface::poll_aggregation() {
+        if(!agg_ninstance) return;
+        if(!agg_instances_mutex.try_lock()) return;
+        for(std::size_t i=0; i<agg_instances.size(); ++i) {
+            WorldAmInterface* am = agg_instances[i];
+            if(am->agg_nbuf && am->try_lock()) {
+                if(am->aggregate) am->flush_stale_buffers(true);
+                am->unlock();
+            }
+        }
+        agg_instances_mutex.unlock();
+    }
+
 } // namespace madness
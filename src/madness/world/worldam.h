@@ -229,6 +229,32 @@ namespace madness {
 
         std::vector<int> map_to_comm_world; ///< Maps rank in current MPI communicator to SafeMPI::COMM_WORLD
 
+        /// Small AM packed for one destination
+
+        /// The outer AmArg is sent with batch_handler; its payload holds the
+        /// packed messages (AmArg plus user payload), each padded to a
+        /// multiple of sizeof(AmArg) to keep the payloads aligned.
+        struct AggBuffer {
+            AmArg* arg;             ///< Outer message (null if nothing is packed)
+            std::size_t used;       ///< Bytes of payload in use
+            std::size_t capacity;   ///< Bytes of payload allocated (kept as a hint once flushed)
+            double start;           ///< wall_time() when the first message was packed
+
+            AggBuffer() : arg(0), used(0), capacity(0), start(0.0) {}
+        };
+
+        bool aggregate;               ///< If true small AM are packed per destination
+        std::size_t agg_max_len;      ///< Max. size of an aggregated message in bytes
+        std::size_t agg_small_len;    ///< Only AM up to this size (incl. AmArg) are packed
+        double agg_flush_time;        ///< Packed AM older than this (in s) are sent
+        double agg_next_check;        ///< wall_time() of next scan for stale buffers
+        std::vector<AggBuffer> agg_buf; ///< Indexed by destination rank in this world
+        volatile int agg_nbuf;        ///< No. of non-empty buffers
+
+        static std::size_t agg_padded(std::size_t nbyte) {
+            return ((nbyte+sizeof(AmArg)-1)/sizeof(AmArg))*sizeof(AmArg);
+        }
+
         void free_managed_send_buf(int i) {
             // WE ASSUME WE ARE INSIDE A CRITICAL SECTION WHEN IN HERE
             if (managed_send_buf[i]) {
@@ -253,13 +279,89 @@ namespace madness {
             w->am.nrecv++;  // Must be AFTER execution of the function
         }
 
+        /// This handles incoming aggregated messages by unpacking them in order
+        static void batch_handler(void *buf, std::size_t nbyte) {
+            AmArg* arg = static_cast<AmArg*>(buf);
+            MADNESS_ASSERT(arg->size() + sizeof(AmArg) == nbyte);
+            unsigned char* p = arg->buf();
+            unsigned char* const end = p + arg->size();
+            while (p < end) {
+                AmArg* sub = reinterpret_cast<AmArg*>(p);
+                const std::size_t n = sub->size() + sizeof(AmArg);
+                handler(sub, n);
+                p += agg_padded(n);
+            }
+        }
+
+        /// Sends a message to dest (rank in SafeMPI::COMM_WORLD) ... must hold the lock
+        void send_managed(ProcessID dest, const AmArg* arg, std::size_t nbyte,
+                          rmi_handlerT func, const int attr)
+        {
+            // Wait for oldest request to complete
+            while (!send_req[cur_msg].Test()) {
+                // If the oldest message has still not completed then there is likely
+                // severe network or end-point congestion, so pause for 100us in a rather
+                // arbitrary attempt to decrease the injection rate.  The server thread
+                // is still polling every 1us (which is required to suck data off the net
+                // and by some engines to ensure progress on sends).
+                myusleep(100);
+            }
+
+            free_managed_send_buf(cur_msg);
+            const int i = cur_msg;
+            cur_msg = (cur_msg + 1) % nsend;
+
+            send_req[i] = RMI::isend(arg, nbyte, dest, func, attr);
+            managed_send_buf[i] = (AmArg*)(arg);
+        }
+
+        /// Packs arg into the buffer for dest ... must hold the lock
+        void pack(ProcessID dest, const AmArg* arg, std::size_t nbyte);
+
+        /// Sends the packed messages for dest ... must hold the lock
+        void flush_buffer(ProcessID dest);
+
+        /// Sends buffers that have waited longer than the flush time ... must hold the lock
+
+        /// With nowait set, stops at the first buffer that could not be sent
+        /// without waiting for a free send slot.
+        void flush_stale_buffers(bool nowait=false);
+
+        /// Called by the RMI server thread to flush stale buffers of all worlds
+        static void poll_aggregation();
+
     public:
         WorldAmInterface(World& world);
 
         virtual ~WorldAmInterface();
 
-        /// Currently a noop
-        void fence() {}
+        /// Sends all packed messages
+        void fence() {
+            if (!aggregate || !agg_nbuf) return;
+            lock();
+            for (ProcessID p=0; p<nproc; ++p) flush_buffer(p);
+            unlock();
+        }
+
+        /// Enables or disables packing of small AM per destination
+
+        /// Messages up to small_len bytes (including the AmArg header) are
+        /// packed into one buffer per destination, which is sent once it
+        /// would exceed RMI::max_msg_len(), once its oldest message has
+        /// waited flush_us microseconds, when the main thread blocks in
+        /// World::await, or at the next fence.  Larger
+        /// messages first flush the buffer for their destination so that
+        /// ordering is kept.  A small_len of zero means RMI::max_msg_len()/16.
+        /// Has no effect when running on a single process.
+        /// Also enabled at startup by setting the environment variable
+        /// MAD_AM_AGGREGATE to a nonzero value.
+        /// @param[in] enable True to pack small messages
+        /// @param[in] small_len Largest message size that is packed, in bytes
+        /// @param[in] flush_us Max. time a packed message waits, in microseconds
+        void set_aggregation(bool enable, std::size_t small_len=0, double flush_us=100.0);
+
+        /// Returns true if small messages are packed per destination
+        bool get_aggregation() const { return aggregate; }
 
         /// Sends a managed non-blocking active message
         void send(ProcessID dest, am_handlerT op, const AmArg* arg,
@@ -277,28 +379,25 @@ namespace madness {
             MADNESS_ASSERT(arg->get_world());
             MADNESS_ASSERT(arg->get_func());
 
-            // Map dest from world's communicator to comm_world
-            dest = map_to_comm_world[dest];
+            const std::size_t nbyte = arg->size()+sizeof(AmArg);
 
             lock();    // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
             nsent++;
 
-            // Wait for oldest request to complete
-            while (!send_req[cur_msg].Test()) {
-                // If the oldest message has still not completed then there is likely
-                // severe network or end-point congestion, so pause for 100us in a rather
-                // arbitrary attempt to decrease the injection rate.  The server thread
-                // is still polling every 1us (which is required to suck data off the net
-                // and by some engines to ensure progress on sends).
-                myusleep(100);
+            if (aggregate) {
+                if (nbyte <= agg_small_len) {
+                    pack(dest, arg, nbyte);
+                    free_am_arg(const_cast<AmArg*>(arg));
+                    flush_stale_buffers();
+                    unlock();  // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+                    return;
+                }
+                // Packed messages must go first to keep them ordered
+                flush_buffer(dest);
             }
 
-            free_managed_send_buf(cur_msg);
-            const int i = cur_msg;
-            cur_msg = (cur_msg + 1) % nsend;
-
-            send_req[i] = RMI::isend(arg, arg->size()+sizeof(AmArg), dest, handler, attr);
-            managed_send_buf[i] = (AmArg*)(arg);
+            // Map dest from world's communicator to comm_world
+            send_managed(map_to_comm_world[dest], arg, nbyte, handler, attr);
             unlock();  // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
         }
 
@@ -41,9 +41,14 @@
 */
 
 #include <madness/world/parallel_archive.h>
+#include <madness/world/buffer_archive.h>
 #include <madness/world/worldhashmap.h>
 #include <madness/world/mpi_archive.h>
 #include <madness/world/world_object.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
 #include <set>
 
 namespace madness {
@@ -63,12 +68,36 @@ namespace madness {
     template <typename keyT>
     class WorldDCRedistributeInterface {
     public:
-        virtual void redistribute_phase1(const std::shared_ptr< WorldDCPmapInterface<keyT> >& newmap) = 0;
+        /// Switches to the new map and returns the number of local entries to move
+        virtual std::size_t redistribute_phase1(const std::shared_ptr< WorldDCPmapInterface<keyT> >& newmap) = 0;
         virtual void redistribute_phase2() = 0;
+        /// Number of local entries
+        virtual std::size_t size() const = 0;
 	virtual ~WorldDCRedistributeInterface() {};
     };
 
 
+    /// What a redistribution moved, summed over all processes and containers
+
+    /// \ingroup worlddc
+    /// The imbalance is the largest number of entries on a process divided
+    /// by the average, counting the entries of all containers on the map.
+    struct WorldDCRedistributeStats {
+        double nmoved;              ///< Number of entries that changed owner
+        double nbyte;               ///< Bytes sent while moving them
+        double imbalance_before;    ///< Imbalance with the old map
+        double imbalance_after;     ///< Imbalance with the new map
+
+        WorldDCRedistributeStats()
+            : nmoved(0.0), nbyte(0.0), imbalance_before(1.0), imbalance_after(1.0) {}
+
+        void print() const {
+            std::printf("redistribute: moved %.0f entries %.0f bytes, imbalance %.2f -> %.2f\n",
+                        nmoved, nbyte, imbalance_before, imbalance_after);
+        }
+    };
+
+
     /// Interface to be provided by any process map
 
     /// \ingroup worlddc
@@ -107,24 +136,47 @@ namespace madness {
 
         /// After invoking this routine all objects will be registered with the
         /// new map and no objects will be registered in the current map.
+        /// The entries of all objects move at once, in batches of tasks, so
+        /// that sending one batch overlaps packing the next.
         /// @param[in] world The associated world
         /// @param[in] newpmap The new process map
-        void redistribute(World& world, const std::shared_ptr< WorldDCPmapInterface<keyT> >& newpmap) {
+        /// @return What was moved and the imbalance before and after
+        WorldDCRedistributeStats redistribute(World& world, const std::shared_ptr< WorldDCPmapInterface<keyT> >& newpmap) {
+            // local entries before and after, number moved and bytes sent
+            double counts[4] = {0.0, 0.0, 0.0, 0.0};
             world.gop.fence();
             for (typename std::set<ptrT>::iterator iter = ptrs.begin();
                  iter != ptrs.end();
                  ++iter) {
-                (*iter)->redistribute_phase1(newpmap);
+                counts[0] += (*iter)->size();
+                counts[2] += (*iter)->redistribute_phase1(newpmap);
             }
             world.gop.fence();
+            const uint64_t nbyte = RMI::get_stats().nbyte_sent;
             for (typename std::set<ptrT>::iterator iter = ptrs.begin();
                  iter != ptrs.end();
                  ++iter) {
                 (*iter)->redistribute_phase2();
                 newpmap->register_callback(*iter);
             }
-            ptrs.clear();
             world.gop.fence();
+            counts[3] = RMI::get_stats().nbyte_sent - nbyte;
+            for (typename std::set<ptrT>::iterator iter = ptrs.begin();
+                 iter != ptrs.end();
+                 ++iter) {
+                counts[1] += (*iter)->size();
+            }
+            ptrs.clear();
+
+            double largest[2] = {counts[0], counts[1]};
+            world.gop.max(largest, 2);
+            world.gop.sum(counts, 4);
+            WorldDCRedistributeStats stats;
+            stats.nmoved = counts[2];
+            stats.nbyte = counts[3];
+            if (counts[0] > 0.0) stats.imbalance_before = largest[0]*world.size()/counts[0];
+            if (counts[1] > 0.0) stats.imbalance_after = largest[1]*world.size()/counts[1];
+            return stats;
         }
     };
 
@@ -294,6 +346,7 @@ namespace madness {
         typedef typename std::pair<const keyT,valueT> pairT;
         typedef const pairT const_pairT;
         typedef WorldContainerImpl<keyT,valueT,hashfunT> implT;
+        typedef std::pair< keyT, std::pair<unsigned long,unsigned long> > shard_entryT; ///< Key, offset and size of an entry in a shard
 
         typedef ConcurrentHashMap< keyT,valueT,hashfunT > internal_containerT;
 
@@ -581,22 +634,51 @@ namespace madness {
         }
 
         // First phase of redistributions changes pmap and makes list of stuff to move
-        void redistribute_phase1(const std::shared_ptr< WorldDCPmapInterface<keyT> >& newpmap) {
+        std::size_t redistribute_phase1(const std::shared_ptr< WorldDCPmapInterface<keyT> >& newpmap) {
             pmap = newpmap;
             move_list = new std::vector<keyT>();
             for (typename internal_containerT::iterator iter=local.begin(); iter!=local.end(); ++iter) {
                 if (owner(iter->first) != me) move_list->push_back(iter->first);
             }
+            return move_list->size();
+        }
+
+        // Moves one batch of entries to their new owners
+        void redistribute_batch(const std::vector<keyT>& keys) {
+            for (unsigned int i=0; i<keys.size(); ++i) {
+                accessor acc;
+                bool found = local.find(acc, keys[i]);
+                MADNESS_ASSERT(found);
+                insert(*acc);
+                local.erase(acc);
+            }
+        }
+
+        // Reads entries from a shard of a parallel archive and inserts them
+        void read_shard(const std::string& filename, const std::vector<shard_entryT>& entries) {
+            std::ifstream is(filename.c_str(), std::ios_base::binary);
+            if (!is) MADNESS_EXCEPTION("WorldContainer: cannot open shard", 0);
+            std::vector<unsigned char> buf;
+            for (std::size_t i=0; i<entries.size(); ++i) {
+                buf.resize(entries[i].second.second);
+                is.seekg(entries[i].second.first);
+                is.read(reinterpret_cast<char*>(buf.data()), buf.size());
+                if (!is) MADNESS_EXCEPTION("WorldContainer: cannot read shard", 0);
+                archive::BufferInputArchive bufar(buf.data(), buf.size());
+                pairT datum;
+                bufar & datum;
+                insert(datum);
+            }
         }
 
-        // Second phase moves data and cleans up
+        // Second phase moves data in batches of tasks and cleans up
         void redistribute_phase2() {
+            const std::size_t batch = 256;
             std::vector<keyT>& mvlist = *move_list;
-            for (unsigned int i=0; i<move_list->size(); ++i) {
-                typename internal_containerT::iterator iter = local.find(mvlist[i]);
-                MADNESS_ASSERT(iter != local.end());
-                insert(*iter);
-                local.erase(iter);
+            for (std::size_t lo=0; lo<mvlist.size(); lo+=batch) {
+                const std::size_t hi = std::min(lo+batch, mvlist.size());
+                this->get_world().taskq.add(*this, &implT::redistribute_batch,
+                                            std::vector<keyT>(mvlist.begin()+lo, mvlist.begin()+hi));
             }
             delete move_list;
         }
@@ -634,6 +716,7 @@ namespace madness {
         typedef WorldContainer<keyT,valueT,hashfunT> containerT;
         typedef WorldContainerImpl<keyT,valueT,hashfunT> implT;
         typedef typename implT::pairT pairT;
+        typedef typename implT::shard_entryT shard_entryT;
         typedef typename implT::iterator iterator;
         typedef typename implT::const_iterator const_iterator;
         typedef typename implT::accessor accessor;
@@ -888,6 +971,15 @@ namespace madness {
             return p->get_pmap();
         }
 
+        /// Has process \c dest read the given entries from a shard of a parallel archive
+
+        /// Used when loading from a sharded ParallelInputArchive; \c dest
+        /// should own the keys.  Fence before using the entries.
+        void read_shard(ProcessID dest, const std::string& filename, const std::vector<shard_entryT>& entries) {
+            check_initialized();
+            p->task(dest, &implT::read_shard, filename, entries);
+        }
+
         /// Returns a reference to the hashing functor
         hashfunT& get_hash() const {
             check_initialized();
@@ -1483,7 +1575,28 @@ namespace madness {
                 Tag tag = world->mpi.unique_tag();
                 ProcessID me = world->rank();
                 if (ar.dofence()) world->gop.fence();
-                if (ar.is_io_node()) {
+                if (ar.is_sharded()) {
+                    // Every process appends its entries to its shard and their
+                    // keys, offsets and sizes to its index
+                    if (me == 0) ar.local_archive() & magic;
+                    BinaryFstreamOutputArchive& shard = ar.shard_archive();
+                    unsigned long& offset = ar.shard_offset();
+                    std::vector<typename dcT::shard_entryT> index;
+                    index.reserve(t.size());
+                    std::vector<unsigned char> buf;
+                    for (typename dcT::const_iterator it=t.begin(); it!=t.end(); ++it) {
+                        BufferOutputArchive count;
+                        count & *it;
+                        buf.resize(count.size());
+                        BufferOutputArchive bufar(buf.data(), buf.size());
+                        bufar & *it;
+                        shard.store(buf.data(), buf.size());
+                        index.push_back(std::make_pair(it->first, std::make_pair(offset, (unsigned long)(buf.size()))));
+                        offset += buf.size();
+                    }
+                    ar.index_archive(0) & index;
+                }
+                else if (ar.is_io_node()) {
                     BinaryFstreamOutputArchive& localar = ar.local_archive();
                     localar & magic & ar.num_io_clients();
                     for (ProcessID p=0; p<world->size(); ++p) {
@@ -1533,6 +1646,11 @@ namespace madness {
             /// can always run a separate job to copy to a different number.
             ///
             /// The IO node simply reads all data and inserts entries.
+            ///
+            /// A sharded archive may be read by any number of processes.  The
+            /// indices are shared out among the processes, each of which sends
+            /// the entries of its indices to their owners under the process map
+            /// of the container, who then read those entries from the shards.
             static void load(const ParallelInputArchive& ar, WorldContainer<keyT,valueT>& t) {
                 const long magic = -5881828; // Sitar Indian restaurant in Knoxville (negative to indicate parallel!)
                 // typedef WorldContainer<keyT,valueT> dcT; // unused
@@ -1540,7 +1658,28 @@ namespace madness {
                 // typedef typename dcT::pairT pairT; // unused
                 World* world = ar.get_world();
                 if (ar.dofence()) world->gop.fence();
-                if (ar.is_io_node()) {
+                if (ar.is_sharded()) {
+                    typedef typename WorldContainer<keyT,valueT>::shard_entryT entryT;
+                    if (world->rank() == 0) {
+                        long cookie = 0l;
+                        ar.local_archive() & cookie;
+                        MADNESS_ASSERT(cookie == magic);
+                    }
+                    for (std::size_t i=0; i<ar.num_local_indices(); ++i) {
+                        std::vector<entryT> index;
+                        ar.index_archive(i) & index;
+                        std::map< ProcessID, std::vector<entryT> > entries;
+                        for (std::size_t j=0; j<index.size(); ++j) {
+                            entries[t.owner(index[j].first)].push_back(index[j]);
+                        }
+                        const std::string shard = ar.shard_filename(ar.index_shard(i));
+                        for (typename std::map< ProcessID, std::vector<entryT> >::const_iterator it=entries.begin();
+                             it!=entries.end(); ++it) {
+                            t.read_shard(it->first, shard, it->second);
+                        }
+                    }
+                }
+                else if (ar.is_io_node()) {
                     long cookie = 0l;
                     int nclient = 0;
                     BinaryFstreamInputArchive& localar = ar.local_archive();
@@ -70,6 +70,7 @@ namespace madness {
             uint64_t ntask1, nsent1, nrecv1, ntask2, nsent2, nrecv2;
             do {
                 world_.taskq.fence();
+                world_.am.fence(); // send packed AM before counting
 
                 // Since the number of outstanding tasks and number of AM sent/recv
                 // don't share a critical section read each twice and ensure they
@@ -33,6 +33,7 @@
 */
 
 #include <madness/world/worldmem.h>
+#include <madness/world/slab_allocator.h>
 #include <cstdlib>
 //#include <cstdio>
 #include <limits.h>
@@ -98,6 +99,42 @@ namespace madness {
             << cur_num_frags << " " << std::setw(12) << max_num_frags << "\n";
         std::cout << "  cur and max bytes allocated " << std::setw(12)
             << cur_num_bytes << " " << std::setw(12) << max_num_bytes << "\n";
+        print_slab();
+    }
+
+    std::vector<WorldMemInfo::SlabClassStats> WorldMemInfo::slab_stats() const {
+        std::vector<SlabAllocator::ClassStats> stats = SlabAllocator::get_stats();
+        std::vector<SlabClassStats> result(stats.size());
+        for (std::size_t i=0; i<stats.size(); ++i) {
+            result[i].block_bytes = stats[i].block_bytes;
+            result[i].reserved_bytes = stats[i].reserved_bytes;
+            result[i].inuse_bytes = stats[i].inuse_bytes;
+            result[i].max_inuse_bytes = stats[i].max_inuse_bytes;
+        }
+        return result;
+    }
+
+    void WorldMemInfo::print_slab() const {
+        std::vector<SlabClassStats> stats = slab_stats();
+        if (stats.empty()) return;
+
+        std::cout.flush();
+        std::cout << "\n    MADNESS slab allocator statistics\n";
+        std::cout << "    ---------------------------------\n";
+        std::cout << "    block bytes     reserved       in use     max in use\n";
+        std::size_t reserved = 0, inuse = 0, max_inuse = 0;
+        for (std::size_t i=0; i<stats.size(); ++i) {
+            std::cout << "   " << std::setw(12) << stats[i].block_bytes
+                      << " " << std::setw(12) << stats[i].reserved_bytes
+                      << " " << std::setw(12) << stats[i].inuse_bytes
+                      << " " << std::setw(14) << stats[i].max_inuse_bytes << "\n";
+            reserved += stats[i].reserved_bytes;
+            inuse += stats[i].inuse_bytes;
+            max_inuse += stats[i].max_inuse_bytes;
+        }
+        std::cout << "          total " << std::setw(12) << reserved
+                  << " " << std::setw(12) << inuse
+                  << " " << std::setw(14) << max_inuse << "\n";
     }
 
     void WorldMemInfo::reset() {
@@ -40,6 +40,7 @@
 #include <new>
 #endif // WORLD_GATHER_MEM_STATS
 #include <cstddef>
+#include <vector>
 
 namespace madness {
 
@@ -74,9 +75,23 @@ namespace madness {
         unsigned long max_mem_limit;   ///< if size+cur_num_bytes>max_mem_limit new will throw MadnessException
         bool trace;
 
+        /// Statistics of one size class of the slab allocator used for tensor data
+        struct SlabClassStats {
+            std::size_t block_bytes;     ///< User bytes per block
+            std::size_t reserved_bytes;  ///< Bytes of slabs carved for this class
+            std::size_t inuse_bytes;     ///< Bytes of blocks in use, not counting blocks in per-thread caches or on the shared free list
+            std::size_t max_inuse_bytes; ///< High-water mark of inuse_bytes
+        };
+
         /// Prints memory use statistics to std::cout
         void print() const;
 
+        /// Returns the statistics of the slab allocator (empty if not used)
+        std::vector<SlabClassStats> slab_stats() const;
+
+        /// Prints the statistics of the slab allocator to std::cout
+        void print_slab() const;
+
         /// Resets all counters to zero
         void reset();
 
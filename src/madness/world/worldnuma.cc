@@ -0,0 +1,259 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file worldnuma.cc
+ \brief NUMA topology discovery plus thread and memory placement.
+ \ingroup threads
+*/
+
+#include <madness/world/worldnuma.h>
+#include <madness/world/thread.h>
+#include <madness/world/posixmem.h>
+#include <madness/world/worldmutex.h>
+#include <madness/world/madness_exception.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include <sys/mman.h>
+
+namespace madness {
+
+    bool NumaTopology::enabled_ = false;
+    std::vector< std::vector<int> > NumaTopology::node_cpus;
+    std::vector<int> NumaTopology::cpu_node;
+
+    namespace {
+
+        const std::size_t chunk_bytes = std::size_t(64) << 20;  // Bytes mapped at a time for an arena
+        const std::size_t max_class_bytes = std::size_t(4) << 20; // Larger blocks are mapped on their own
+        const std::size_t block_align = 64; // Alignment of the blocks of an arena
+        const int max_class = 64;
+
+        // Sits just below the memory handed out
+        struct BlockHeader {
+            char* start;        // Start of the block
+            std::size_t bytes;  // Length of the mapping, for blocks mapped on their own
+            int node;           // Arena of the block
+            int cls;            // Size class, -1 if mapped on its own
+        };
+
+        struct FreeList {
+            Spinlock lock;
+            char* head;
+            FreeList() : head(nullptr) {}
+        };
+
+        struct NodeArena {
+            Spinlock lock;      // Protects next and end
+            char* next;         // Unused part of the current chunk
+            char* end;
+            FreeList free[max_class];
+            NodeArena() : next(nullptr), end(nullptr) {}
+        };
+
+        NodeArena* arenas = nullptr;
+        std::vector<std::size_t> class_bytes; // Multiples of 64 up to 1KB, then four per power of 2
+
+        // Map fresh memory and prefer node for its pages, which are placed on first touch
+        char* map_on_node(std::size_t bytes, int node) {
+            void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) return nullptr;
+#if defined(__linux__) && defined(SYS_mbind)
+            if (NumaTopology::num_nodes() > 1) {
+                const int MPOL_PREFERRED_ = 1; // From <numaif.h>
+                unsigned long mask[16];
+                std::memset(mask, 0, sizeof(mask));
+                if (node < int(8*sizeof(mask))) {
+                    mask[node/(8*sizeof(long))] = 1ul << (node%(8*sizeof(long)));
+                    // Failure is harmless ... the pages are placed by first touch
+                    syscall(SYS_mbind, p, bytes, MPOL_PREFERRED_, mask, 8*sizeof(mask), 0);
+                }
+            }
+#endif
+            return static_cast<char*>(p);
+        }
+
+        // Cut a block for size class cls from the current chunk of an arena
+        char* carve(NodeArena& arena, int cls, int node) {
+            const std::size_t bytes = class_bytes[cls];
+            ScopedMutex<Spinlock> guard(arena.lock);
+            if (std::size_t(arena.end - arena.next) < bytes) {
+                // The rest of the old chunk was never touched and costs no memory
+                char* chunk = map_on_node(chunk_bytes, node);
+                if (!chunk) return nullptr;
+                arena.next = chunk;
+                arena.end = chunk + chunk_bytes;
+            }
+            char* p = arena.next;
+            arena.next += bytes;
+            return p;
+        }
+
+        // Parse a kernel cpu list such as "0-3,8-11"
+        std::vector<int> parse_cpulist(const std::string& s) {
+            std::vector<int> cpus;
+            std::istringstream ss(s);
+            std::string range;
+            while (std::getline(ss, range, ',')) {
+                int lo, hi;
+                const int n = std::sscanf(range.c_str(), "%d-%d", &lo, &hi);
+                if (n == 1) hi = lo;
+                else if (n != 2) continue;
+                for (int i=lo; i<=hi; ++i) cpus.push_back(i);
+            }
+            return cpus;
+        }
+
+    } // namespace
+
+    void NumaTopology::initialize(bool enable) {
+        node_cpus.clear();
+        cpu_node.clear();
+
+#if defined(__linux__)
+        for (int node=0; ; ++node) {
+            std::ostringstream fname;
+            fname << "/sys/devices/system/node/node" << node << "/cpulist";
+            std::ifstream f(fname.str().c_str());
+            if (!f) break;
+            std::string line;
+            std::getline(f, line);
+            node_cpus.push_back(parse_cpulist(line));
+        }
+#endif
+
+        // Fall back to one node holding all processors
+        if (node_cpus.empty()) {
+            node_cpus.resize(1);
+            const int ncpu = ThreadBase::num_hw_processors();
+            for (int i=0; i<ncpu; ++i) node_cpus[0].push_back(i);
+        }
+
+        for (int node=0; node<num_nodes(); ++node) {
+            for (int cpu : node_cpus[node]) {
+                if (cpu >= int(cpu_node.size())) cpu_node.resize(cpu+1, 0);
+                cpu_node[cpu] = node;
+            }
+        }
+
+        if (!arenas) {
+            for (std::size_t b=block_align; b<=1024; b+=block_align) class_bytes.push_back(b);
+            for (std::size_t b=1024; b<max_class_bytes; b*=2) {
+                for (int q=5; q<=8; ++q) class_bytes.push_back(b*q/4);
+            }
+            MADNESS_ASSERT(int(class_bytes.size()) <= max_class);
+            arenas = new NodeArena[num_nodes()];
+        }
+
+        enabled_ = enable;
+    }
+
+    int NumaTopology::current_node() {
+#if defined(__linux__)
+        return node_of_cpu(sched_getcpu());
+#else
+        return 0;
+#endif
+    }
+
+    void* NumaTopology::allocate_local(std::size_t size, std::size_t alignment) {
+        MADNESS_ASSERT(arenas && alignment <= block_align);
+        const std::size_t offset = ((sizeof(BlockHeader) + alignment - 1)/alignment)*alignment;
+        const std::size_t bytes = size + offset;
+        int node = current_node();
+        if (node >= num_nodes()) node = 0;
+
+        char* start = nullptr;
+        std::size_t mapped = 0;
+        int cls = -1;
+        if (bytes > max_class_bytes) {
+            static const std::size_t pagesize = sysconf(_SC_PAGESIZE);
+            mapped = ((bytes + pagesize - 1)/pagesize)*pagesize;
+            start = map_on_node(mapped, node);
+        }
+        else {
+            cls = std::lower_bound(class_bytes.begin(), class_bytes.end(), bytes) - class_bytes.begin();
+            FreeList& list = arenas[node].free[cls];
+            {
+                ScopedMutex<Spinlock> guard(list.lock);
+                start = list.head;
+                if (start) list.head = *reinterpret_cast<char**>(start);
+            }
+            if (!start) start = carve(arenas[node], cls, node);
+        }
+        if (!start) return nullptr;
+
+        char* p = start + offset;
+        BlockHeader* h = reinterpret_cast<BlockHeader*>(p) - 1;
+        h->start = start;
+        h->bytes = mapped;
+        h->node = node;
+        h->cls = cls;
+        return p;
+    }
+
+    void NumaTopology::deallocate_local(void* p) {
+        if (!p) return;
+        const BlockHeader h = *(reinterpret_cast<BlockHeader*>(p) - 1);
+        if (h.cls < 0) {
+            munmap(h.start, h.bytes);
+            return;
+        }
+        // Back to the arena the block came from, whichever thread frees it
+        FreeList& list = arenas[h.node].free[h.cls];
+        ScopedMutex<Spinlock> guard(list.lock);
+        *reinterpret_cast<char**>(h.start) = list.head;
+        list.head = h.start;
+    }
+
+    void NumaTopology::print() {
+        std::cout << "NUMA topology: " << num_nodes() << " node(s), mode "
+                  << (enabled_ ? "on" : "off") << "\n";
+        for (int node=0; node<num_nodes(); ++node) {
+            std::cout << "    node " << node << ":";
+            for (int cpu : node_cpus[node]) std::cout << " " << cpu;
+            std::cout << "\n";
+        }
+    }
+
+} // namespace madness
@@ -0,0 +1,132 @@
+/*
+  This file is part of MADNESS.
+  
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+  
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+  
+  For more information please contact:
+  
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+  
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_WORLDNUMA_H__INCLUDED
+#define MADNESS_WORLD_WORLDNUMA_H__INCLUDED
+
+/**
+ \file worldnuma.h
+ \brief NUMA topology discovery plus thread and memory placement.
+ \ingroup threads
+*/
+
+#include <madness/madness_config.h>
+#include <cstddef>
+#include <vector>
+
+namespace madness {
+
+    /// NUMA topology of this node and helpers for thread and memory placement.
+
+    /// The topology is read from \c /sys/devices/system/node on Linux.  If
+    /// that is not available (or NUMA mode is not enabled) the node is
+    /// treated as a single NUMA domain containing all processors.
+    ///
+    /// NUMA mode is enabled by setting the environment variable
+    /// \c MAD_NUMA to a non-zero value.  In NUMA mode pool threads are
+    /// distributed in contiguous blocks over the NUMA nodes and bound to
+    /// the processors of their node (or to a single processor of their
+    /// node if \c MAD_BIND binds pool threads), idle threads steal
+    /// preferentially from threads on the same node, and \c Tensor
+    /// allocates its data with a preference for the node of the
+    /// allocating thread.
+    class NumaTopology {
+        static bool enabled_; ///< True if NUMA mode is enabled.
+        static std::vector< std::vector<int> > node_cpus; ///< CPUs of each node.
+        static std::vector<int> cpu_node; ///< Node of each CPU.
+
+    public:
+        /// Discover the topology.
+
+        /// Invoke while single threaded.
+        /// \param[in] enable If true turn on NUMA mode.
+        static void initialize(bool enable);
+
+        /// Returns true if NUMA mode is enabled.
+        static bool enabled() {
+            return enabled_;
+        }
+
+        /// Returns the number of NUMA nodes.
+        static int num_nodes() {
+            return node_cpus.size();
+        }
+
+        /// Returns the CPUs of a NUMA node.
+
+        /// \param[in] node The node (0,...,num_nodes()-1).
+        static const std::vector<int>& cpus(int node) {
+            return node_cpus[node];
+        }
+
+        /// Returns the NUMA node of a CPU (0 if unknown).
+
+        /// \param[in] cpu The CPU index.
+        static int node_of_cpu(int cpu) {
+            return (cpu >= 0 && cpu < int(cpu_node.size())) ? cpu_node[cpu] : 0;
+        }
+
+        /// Returns the NUMA node of the CPU the calling thread is running on.
+        static int current_node();
+
+        /// Returns the NUMA node assigned to a pool thread.
+
+        /// Threads are assigned to nodes in contiguous blocks.
+        /// \param[in] ind The index of the thread in the pool.
+        /// \param[in] nthread The number of threads in the pool.
+        static int node_of_pool_thread(int ind, int nthread) {
+            return (nthread > 0) ? int((long(ind)*num_nodes())/nthread) : 0;
+        }
+
+        /// Allocate memory preferably placed on the node of the calling thread.
+
+        /// Blocks are carved from per-node arenas, chunks of memory mapped
+        /// fresh and given a placement policy once per chunk, and freed
+        /// blocks are kept for reuse on their node.  Blocks larger than the
+        /// biggest size class are mapped on their own.  The memory is
+        /// released with \c deallocate_local().
+        /// \param[in] size The number of bytes.
+        /// \param[in] alignment The alignment (a power of 2, at most 64).
+        /// \return Pointer to the memory or null on failure.
+        static void* allocate_local(std::size_t size, std::size_t alignment);
+
+        /// Release memory from \c allocate_local().
+
+        /// \param[in] p The memory (may be null).
+        static void deallocate_local(void* p);
+
+        /// Print the topology to \c std::cout.
+        static void print();
+    };
+
+} // namespace madness
+
+#endif // MADNESS_WORLD_WORLDNUMA_H__INCLUDED
@@ -44,6 +44,7 @@ namespace madness {
     RMI::RmiTask* RMI::task_ptr = nullptr;
     RMIStats RMI::stats;
     volatile bool RMI::debugging = false;
+    volatile rmi_poll_hookT RMI::poll_hook = nullptr;
 
 #if HAVE_INTEL_TBB
     tbb::task* RMI::tbb_rmi_parent_task = nullptr;
@@ -65,6 +66,8 @@ namespace madness {
         while((narrived == 0) && (iterations < 1000)) {
 	  narrived = SafeMPI::Request::Testsome(maxq_, recv_req.get(), ind.get(), status.get());
 	  ++iterations;
+	  const rmi_poll_hookT hook = RMI::poll_hook;
+	  if (hook) hook();
 	  myusleep(RMI::testsome_backoff_us);
         }
 
@@ -282,6 +285,8 @@ namespace madness {
         // Initialize the send/recv counts
         std::fill_n(send_counters.get(), nproc, 0);
         std::fill_n(recv_counters.get(), nproc, 0);
+        RMI::stats.nmsg_sent_to.assign(nproc, 0);
+        RMI::stats.nbyte_sent_to.assign(nproc, 0);
 
         // Allocate buffers for message tracking
         status.reset(new SafeMPI::Status[maxq_]);
@@ -365,6 +370,8 @@ namespace madness {
 
         ++(RMI::stats.nmsg_sent);
         RMI::stats.nbyte_sent += nbyte;
+        ++(RMI::stats.nmsg_sent_to[dest]);
+        RMI::stats.nbyte_sent_to[dest] += nbyte;
 
         Request result = comm.Isend(buf, nbyte, MPI_BYTE, dest, tag);
 
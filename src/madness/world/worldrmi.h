@@ -39,6 +39,7 @@
 #include <utility>
 #include <list>
 #include <memory>
+#include <vector>
 
 /*
   There is just one server thread and it is the only one
@@ -99,6 +100,9 @@ namespace madness {
     /// This is the generic low-level interface for a message handler
     typedef void (*rmi_handlerT)(void* buf, size_t nbyte);
 
+    /// Function called by the server thread each time it polls for messages
+    typedef void (*rmi_poll_hookT)();
+
     struct qmsg {
         typedef uint16_t counterT;
         typedef uint32_t attrT;
@@ -126,9 +130,12 @@ namespace madness {
         uint64_t nbyte_sent;
         uint64_t nmsg_recv;
         uint64_t nbyte_recv;
+        std::vector<uint64_t> nmsg_sent_to;  ///< Messages sent to each process in COMM_WORLD
+        std::vector<uint64_t> nbyte_sent_to; ///< Bytes sent to each process in COMM_WORLD
 
         RMIStats()
-                : nmsg_sent(0), nbyte_sent(0), nmsg_recv(0), nbyte_recv(0) {}
+                : nmsg_sent(0), nbyte_sent(0), nmsg_recv(0), nbyte_recv(0)
+                , nmsg_sent_to(), nbyte_sent_to() {}
     };
 
 
@@ -245,6 +252,7 @@ namespace madness {
         static RmiTask* task_ptr;    // Pointer to the singleton instance
         static RMIStats stats;
         static volatile bool debugging;    // True if debugging
+        static volatile rmi_poll_hookT poll_hook; // Called by the server thread while polling
 
         static const size_t DEFAULT_MAX_MSG_LEN = 3*512*1024;  //!< the default size of recv buffers, in bytes; the actual size can be configured by the user via envvar MAD_BUFFER_SIZE
         static const int DEFAULT_NRECV = 128;  //!< the default # of recv buffers; the actual number can be configured by the user via envvar MAD_RECV_BUFFERS
@@ -334,6 +342,12 @@ namespace madness {
 
         static void set_debug(bool status) { debugging = status; }
 
+        /// Sets a function the server thread calls each time it polls for messages
+
+        /// The hook runs on the server thread so it must be cheap and must
+        /// not block; it may send messages.  Null removes the hook.
+        static void set_poll_hook(rmi_poll_hookT hook) { poll_hook = hook; }
+
         static bool get_debug() { return debugging; }
 
         static const RMIStats& get_stats() { return stats; }